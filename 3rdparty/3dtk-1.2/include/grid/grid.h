@@ -5,9 +5,12 @@
 
 /**
  * The class represents the base class for all 2D views.
- * It contains a two dimensional array of gridPoints, 
+ * It contains the counters of a two dimensional array of cells,
  * the offset (in absolute coordinates) of the grid and
  * the size of the grid.
+ * The counters are stored in two flat, contiguous arrays (column
+ * major in x, i.e. cell (i, j) is at i * sizeZ + j). gridPoint
+ * objects are handed out by value as a view of a single cell.
  * The size of the grid must be set during the instanciation of
  * the grid and cant be changed afterwards.
  *
@@ -22,11 +25,13 @@
  */
 class grid
 {
- public:
-    /** Array containing the gridPoints */
-    gridPoint*** points;
-
  private:
+    /** Visited counters of all cells */
+    unsigned int *counts;
+
+    /** Occupied counters of all cells */
+    unsigned int *occupieds;
+
     /** X offset (absolute coordinate) */
     long offsetX;
 
@@ -43,7 +48,18 @@ class grid
     void clear();
 
     /** @brief The method allocates and initialises the internal array */
-    void allocate(long maxX, long maxZ);
+    void allocate(long sizeX, long sizeZ);
+
+    /**
+     * Index of the cell with the relative coordinates (i, j)
+     * within the flat counter arrays
+     */
+    inline long index(long i, long j) const {
+	return i * this->sizeZ + j;
+    }
+
+    /** @brief Returns the index of the absolute coordinates */
+    long getAbsoluteIndex(long x, long z) const;
 
  public:
     /** @brief CTor */
@@ -61,8 +77,23 @@ class grid
     /** @brief Sets the fixed values for a points */
     virtual void setPoint(long x, long z, unsigned int count, unsigned int occupied);
     
+    /** @brief Adds the counters of a grid with the same offset and size */
+    void merge(const grid& other);
+
     /** @brief Returns the point of the absolute coordinates */
-    gridPoint* getAbsolutePoint(long x, long z) const;
+    gridPoint getAbsolutePoint(long x, long z) const;
+
+    /**
+     * Returns a view of the cell with the relative coordinates (i, j)
+     * @param i the relative x coordinate, 0 <= i < sizeX
+     * @param j the relative z coordinate, 0 <= j < sizeZ
+     * @return the cell as gridPoint with absolute coordinates
+     */
+    inline gridPoint getPoint(long i, long j) const {
+	long idx = index(i, j);
+	return gridPoint(this->offsetX + i, this->offsetZ + j,
+			 this->counts[idx], this->occupieds[idx]);
+    }
 
     /**
      * Method checks if the given Point is in this grid
@@ -28,6 +28,9 @@ class gridPoint
  public:
     /** @brief CTor */
     gridPoint(long x, long z);
+
+    /** @brief CTor with preset counters */
+    gridPoint(long x, long z, unsigned int count, unsigned int occupied);
     
     /** @brief Adds amount to the internal counter */
     void addCount(unsigned int count, unsigned int occupied);
@@ -0,0 +1,109 @@
+#ifndef __PARCELIO_H_
+#define __PARCELIO_H_
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+#include <pthread.h>
+
+#include "grid/parcel.h"
+
+/**
+ * The class reads and writes parcels on a background thread, so that
+ * the parcelmanager does not block on disk I/O while gridding.
+ *
+ * Jobs are processed in the order they were queued, hence a load
+ * always sees the result of an earlier store of the same parcel.
+ * A parcel whose store is still queued is handed back directly
+ * without touching the disk. Parcels are identified by their
+ * tile key (see parcelmanager).
+ *
+ * @date 18.10.2026
+ */
+class parcelio
+{
+ private:
+    /** A single load or store request */
+    struct job
+    {
+	/** true for a store, false for a load */
+	bool store;
+
+	/** The tile key of the parcel */
+	long long key;
+
+	/** The file of the parcel */
+	std::string filename;
+
+	/** The parcel to store (owned by the job), NULL for loads */
+	parcel *data;
+    };
+
+    /** Jobs not yet started */
+    std::deque<job> jobs;
+
+    /** Loaded parcels not yet taken */
+    std::map<long long, parcel*> done;
+
+    /** true while the thread executes a job */
+    bool running;
+
+    /** true if the running job is a load */
+    bool runningLoad;
+
+    /** The tile key of the running job */
+    long long runningKey;
+
+    /** Set to tell the thread to exit once all jobs are done */
+    bool stop;
+
+    /** Guards all members above */
+    pthread_mutex_t mutex;
+
+    /** Signalled when a job was queued or finished */
+    pthread_cond_t changed;
+
+    /** The background thread */
+    pthread_t thread;
+
+    /** @brief Returns the queued job for key or jobs.end() */
+    std::deque<job>::iterator findJob(long long key);
+
+    /** @brief Returns true if the parcel is being read right now */
+    bool isLoading(long long key);
+
+    /** @brief Main loop of the background thread */
+    void run();
+
+    /** @brief Entry point for pthread_create */
+    static void* runThread(void *io);
+
+ public:
+    /** @brief CTor, starts the background thread */
+    parcelio();
+
+    /** @brief DTor, finishes all jobs and stops the thread */
+    ~parcelio();
+
+    /** @brief Queues writing and freeing of the parcel */
+    void store(long long key, const std::string& filename, parcel *data);
+
+    /** @brief Queues reading of the parcel (prefetch) */
+    void load(long long key, const std::string& filename);
+
+    /** @brief Returns the parcel, waiting for it if necessary */
+    parcel* take(long long key, const std::string& filename);
+
+    /** @brief Hands out all parcels loaded in the background so far */
+    void collect(std::vector< std::pair<long long, parcel*> >& loaded);
+
+    /** @brief Returns the number of queued and running jobs */
+    size_t pending();
+
+    /** @brief Waits until all queued jobs are done */
+    void flush();
+};
+
+#endif
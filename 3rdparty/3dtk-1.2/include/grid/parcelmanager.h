@@ -2,23 +2,34 @@
 #define __PARCELMANAGER_H_
 
 #include <string>
-#include <map>
-using std::map;
+#include <list>
+#include <vector>
+#include <tr1/unordered_map>
 
 #include "grid/parcel.h"
 #include "grid/parcelinfo.h"
+#include "grid/parcelio.h"
 #include <string>
 using std::string;
 
 
 #define PARCELINFOFILE "parcelinfo.conf"
 
+/** Default memory budget of the loaded parcels in MB */
+#define PARCELBUDGET 512
+
 /**
  * The parcelmanager manages all views of the map 
  * (Views are represented as parcels)
  * It provides methods for adding scangrids and creating the entire map.
  * It contains an internal memorymanagment for managing the parcels 
  * during runtime.
+ *
+ * The parcels are indexed by their integer tile coordinates in a hash
+ * map. Loaded parcels are kept in a least recently used list and only
+ * written back once the memory budget is exceeded. Reading and writing
+ * runs on a background thread (see parcelio), and the parcels lying
+ * ahead in the direction of travel are prefetched.
  * 
  * 
  * @author Uwe Hebbelmann, Sebastian Stock, Andre Schemschat
@@ -27,12 +38,40 @@ using std::string;
 class parcelmanager
 {
  private:
-    /** Typedef for the map */
-    typedef map<parcelinfo*, parcel*> parcelmap;
+    /** A parcel along with its position in the LRU list */
+    struct parcelentry
+    {
+	/** The info about the parcel */
+	parcelinfo *info;
+
+	/** The parcel, NULL if not in memory */
+	parcel *data;
+
+	/** Position in lru, only valid if data is set */
+	std::list<long long>::iterator lru;
+    };
+
+    /** Typedef for the map, the key is made by tileKey */
+    typedef std::tr1::unordered_map<long long, parcelentry> parcelmap;
     
     /** The map for all parcelinfos and parcels */
     parcelmap parcels;
 
+    /** Keys of the parcels in memory, most recently used first */
+    std::list<long long> lru;
+
+    /** Number of parcels in memory */
+    size_t loaded;
+
+    /** Maximal number of parcels in memory */
+    size_t maxLoaded;
+
+    /** Background reader and writer of the parcels */
+    parcelio io;
+
+    /** Set as soon as the first grid was added */
+    bool hasViewpoint;
+
     /** The width of each parcel */
     int parcelwidth;
     /** The height of each parcel */
@@ -60,24 +99,51 @@ class parcelmanager
     /** The path where all infos should be stored */
     string path;
 
-    /** @brief The method frees each (not used) parcel */ 
+    /** @brief The method frees parcels until the memory budget is kept */ 
     void freeMemory(bool all);
 
     /** @brief The method clears all internal data */
     void clear();
 
-    /** @brief The method loads a parcel specified by info */
-    void loadParcel(parcelinfo *info);
+    /** @brief The method returns the parcel, loading it if needed */
+    parcel* loadParcel(long long key, parcelentry &entry);
 
     /** @brief The method creates a new parcel */
-    void createParcel(long x, long z);
+    parcelentry& createParcel(long tileX, long tileZ);
+
+    /** @brief The method takes over parcels loaded in the background */
+    void collectParcels();
+
+    /** @brief The method queues the parcels ahead of the trajectory */
+    void prefetch(const grid* g, long vpX, long vpZ);
+
+    /**
+     * Returns the tile coordinate of an absolute coordinate
+     * @param x the absolute coordinate
+     * @param size the parcel width or height
+     * @return the tile coordinate, rounded towards minus infinity
+     */
+    static inline long tileOf(long x, long size) {
+	return x >= 0 ? x / size : -((-x + size - 1) / size);
+    }
+
+    /**
+     * Combines the tile coordinates to the key of the parcel map
+     * @param tileX the x tile coordinate
+     * @param tileZ the z tile coordinate
+     * @return the key
+     */
+    static inline long long tileKey(long tileX, long tileZ) {
+	return ((long long)tileX << 32) | (unsigned int)tileZ;
+    }
 
     /** @brief Method keeps min/Max-X/Z up to date */
     void updateOuterPoints(const grid* g);
 
  public:
     /** @brief CTor */
-    parcelmanager(long width, long height, string path, int resolution, bool resume);
+    parcelmanager(long width, long height, string path, int resolution, bool resume,
+		  int budget = PARCELBUDGET);
 
     /** @brief Dtor */
     ~parcelmanager();
@@ -72,6 +72,9 @@ class scanToGrid
     /** @brief Method adds a point (and maybee its neighbours) to the grid */
     void createPoint(scanGrid* grid, long x, long z, float weighting);
 
+    /** @brief Method adds a scanpoint, its waypoints and neighbours to the grid */
+    void rasterisePoint(scanGrid* grid, const Point& p);
+
     /** @brief Method checks the grid for values which stand alone and deletes them */
     void killAlonePoints(scanGrid* grid, int distance, int neighbours);
  
@@ -0,0 +1,46 @@
+#ifndef CONNECTEDCOMPONENTS_H
+#define CONNECTEDCOMPONENTS_H
+
+/**
+ * @brief Labels the 4-connected regions of an image
+ *
+ * Two neighbouring pixels belong to the same region if their values
+ * differ by at most a distance. The image is split into strips of rows
+ * that are labeled in parallel with union-find, the roots of the
+ * regions are the first pixel in row-major order. The strips are then
+ * joined at their borders and a last pass numbers the regions in the
+ * order they start, as the recursive relabeling of Image did.
+ */
+class ConnectedComponents {
+
+public:
+  /**
+   * @param width, height size of the image
+   */
+  ConnectedComponents(int width, int height);
+  ~ConnectedComponents();
+
+  /**
+   * Labels the regions of an image
+   *
+   * @param values the image in row-major order, width * height values
+   * @param dist neighbouring pixels whose values differ by at most dist are connected
+   * @param background if true, pixels with the value 0 belong to no region
+   * @param labels receives the region of every pixel in row-major order,
+   *        0 for the background and 1 to the number of regions otherwise
+   * @return the number of regions
+   */
+  int label(const float *values, float dist, bool background, int *labels);
+
+private:
+  inline bool connected(const float *values, int p, int q, float dist, bool background);
+  inline int find(int p);
+  inline void join(int p, int q);
+
+  int width;
+  int height;
+  /** union-find forest over the pixels, every pixel points to a pixel before it */
+  int *parent;
+};
+
+#endif
@@ -20,8 +20,16 @@ public:
   float getMax();
 
   int calcMarker(float threshold, int ** regdat);
-  void mergeregion(int x, int y, int delreg, int targetreg, int** img, int it = 0);
+  /**
+   * Labels the regions of neighbouring pixels that differ by at most dist,
+   * regdat receives 1 to the number of regions
+   */
   int blobColor(float dist, int ** regdat);
+  /**
+   * Labels the regions of non-zero pixels of dat that differ by at most
+   * dist, regdat receives 0 for the zero pixels and 1 to the number of
+   * regions otherwise
+   */
   int cluster(float dist, int** dat, int ** regdat);
   void writeCenters(int regions, int** clusters, const vector<Point> *points);
   void printScans(int ** regdat, double * const* points, int size); 
@@ -1,39 +1,158 @@
 #ifndef __RANSAC_H__
 #define __RANSAC_H__
 
+#include <math.h>
+
 #include "shape.h"
 #include "slam6d/scan.h"
 #include "shapes/ransac_Boctree.h"
 
-// TODO implement some parameters to modify ransac (maybe in CollisionShape?)
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/**
+ * Parameters of the RANSAC shape detection
+ */
+struct RansacParams {
+  /// upper bound for the number of hypotheses
+  int max_iterations;
+  /// probability of having drawn at least one outlier free sample, used for early termination
+  double confidence;
+  /// number of points every hypothesis is scored on before the full octree count
+  int preempt_points;
+  /// number of hypotheses evaluated in parallel between two termination checks
+  int batch_size;
+  /// seed of the random streams, equal seeds give equal results for any number of threads
+  unsigned long long seed;
+
+  RansacParams()
+    : max_iterations(5000), confidence(0.99), preempt_points(300),
+      batch_size(256), seed(42) {}
+};
+
+/**
+ * Draws the sample of hypothesis number i and fits the shape to it. Every
+ * hypothesis has its own random stream derived from the seed, so the i-th
+ * hypothesis is the same regardless of which thread evaluates it.
+ */
 template <class T>
-void Ransac(CollisionShape<T> &shape, Scan *scan, vector<T*> *best_points = 0) {
-  int best_score = 0;
-  CollisionShape<T> *best = shape.copy();
+inline bool RansacHypothesize(RansacOctTree<T> *oct, CollisionShape<T> &shape,
+                              unsigned long long seed, int i, vector<T *> &ps) {
+  unsigned long long state = seed ^ ((unsigned long long)i * 0xD1B54A32D192ED03ULL);
+  ps.clear();
+  oct->DrawPoints(ps, shape.getNrPoints(), state);
+  return shape.hypothesize(ps);
+}
+
+/**
+ * Number of hypotheses needed to draw an outlier free sample of nrp points
+ * with the given confidence if a fraction w of all points are inliers.
+ */
+inline double RansacNeededIterations(double w, unsigned char nrp, double confidence) {
+  double wn = pow(w, (double)nrp);
+  if (wn >= 1.0) return 0.0;
+  if (wn <= 0.0) return HUGE_VAL;
+  return log(1.0 - confidence) / log1p(-wn);
+}
+
+/**
+ * Parallel RANSAC. Hypotheses are evaluated in batches on all threads.
+ * Each one is first scored on a fixed random subset of the points and is
+ * rejected if its inlier count cannot beat the best count of the previous
+ * batches with high probability. Survivors are counted on the octree. After
+ * every batch the number of needed hypotheses is updated from the inlier
+ * ratio of the best shape.
+ */
+template <class T>
+void Ransac(CollisionShape<T> &shape, Scan *scan, const RansacParams &params,
+            vector<T*> *best_points = 0) {
+  int n = scan->get_points_red_size();
+  unsigned char nrp = shape.getNrPoints();
 
-  // stores 3 sample points    
-  vector<T *> ps;
   // create octree from the points
-  RansacOctTree<T> *oct = new RansacOctTree<T>(scan->get_points_red(), scan->get_points_red_size(), 50.0 );
-  
-  cout << "start 5000 iterations" << endl;
-  for(int i = 0; i < 5000; i++) {
-    ps.clear();
-    // randomly select points from the octree
-    oct->DrawPoints(ps, shape.getNrPoints());
-    // compute shape parameters from points
-    if ( shape.hypothesize(ps) ) {
-      // count number of points on the shape
-      int r = oct->PointsOnShape(shape);
-      if (r > best_score) {
-        if (best) delete best;
-        // remember this best fitted shape
-        best_score = r;
-        best = shape.copy();
+  RansacOctTree<T> *oct = new RansacOctTree<T>(scan->get_points_red(), n, 50.0 );
+
+  // fixed subset for the preemptive scoring
+  vector<T *> subset;
+  if (params.preempt_points > 0 && params.preempt_points < n) {
+    unsigned long long state = params.seed;
+    subset.reserve(params.preempt_points);
+    for (int j = 0; j < params.preempt_points; j++) {
+      subset.push_back(scan->get_points_red()[rand(n, state)]);
+    }
+  }
+  double m = subset.size();
+
+  long best_score = 0;
+  int best_index = -1;
+  int evaluated = 0;
+  int rejected = 0;
+  double needed = params.max_iterations;
+  vector<long> score(params.batch_size);
+
+  cout << "start RANSAC with at most " << params.max_iterations << " iterations" << endl;
+  while (evaluated < params.max_iterations && evaluated < needed) {
+    int batch = params.batch_size;
+    if (evaluated + batch > params.max_iterations) batch = params.max_iterations - evaluated;
+    long threshold = best_score;
+
+#ifdef _OPENMP
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel
+#endif
+    {
+      CollisionShape<T> *local = shape.copy();
+      vector<T *> ps;
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+      for (int k = 0; k < batch; k++) {
+        score[k] = -1;
+        if (!RansacHypothesize(oct, *local, params.seed, evaluated + k, ps)) continue;
+
+        if (m > 0) {
+          int s = 0;
+          for (unsigned int j = 0; j < subset.size(); j++) {
+            if (local->containsPoint(subset[j])) s++;
+          }
+          // optimistic (3 sigma) estimate of the inlier ratio
+          double p = s / m;
+          double upper = p + 3.0 * sqrt(p * (1.0 - p) / m) + 1.0 / m;
+          if (upper * n < threshold) {
+            score[k] = -2;
+            continue;
+          }
+        }
+        // count number of points on the shape
+        score[k] = oct->PointsOnShape(*local);
       }
+      delete local;
+    }
+
+    // reduce in order of the hypotheses, so that ties are broken reproducibly
+    for (int k = 0; k < batch; k++) {
+      if (score[k] == -2) rejected++;
+      if (score[k] > best_score) {
+        best_score = score[k];
+        best_index = evaluated + k;
+      }
+    }
+    evaluated += batch;
+
+    if (best_score > 0) {
+      needed = RansacNeededIterations((double)best_score / n, nrp, params.confidence);
     }
   }
-  cout << "5000 iterations done" << endl;
+  cout << evaluated << " iterations done, " << rejected << " rejected early" << endl;
+
+  // recreate the best fitted shape from its random stream
+  CollisionShape<T> *best = shape.copy();
+  if (best_index >= 0) {
+    vector<T *> ps;
+    RansacHypothesize(oct, *best, params.seed, best_index, ps);
+  }
+
   if (best_points) {
     best_points->clear();
     oct->PointsOnShape(*best, *best_points);
@@ -47,8 +166,11 @@ void Ransac(CollisionShape<T> &shape, Scan *scan, vector<T*> *best_points = 0) {
   delete best;
 
   delete oct;
+}
 
-
+template <class T>
+void Ransac(CollisionShape<T> &shape, Scan *scan, vector<T*> *best_points = 0) {
+  Ransac(shape, scan, RansacParams(), best_points);
 }
 
 #endif
@@ -48,7 +48,15 @@ public:
   RansacOctTree(std::string filename) : BOctTree<T> (filename) {}
 
   void DrawPoints(vector<T *> &p, unsigned char nrp) {
-    DrawPoints(p, *BOctTree<T>::root, nrp);
+    DrawPoints(p, *BOctTree<T>::root, nrp, 0);
+  }
+
+  /**
+   * Draws nrp points from a random leaf, using the caller owned random
+   * stream instead of std::rand(). This is safe to call concurrently.
+   */
+  void DrawPoints(vector<T *> &p, unsigned char nrp, unsigned long long &state) {
+    DrawPoints(p, *BOctTree<T>::root, nrp, &state);
   }
  
 
@@ -166,12 +174,12 @@ void showbits(char a)
   }
 
 
-  void DrawPoints(vector<T *> &p, bitoct &node, unsigned char nrp) {
+  void DrawPoints(vector<T *> &p, bitoct &node, unsigned char nrp, unsigned long long *state) {
     bitunion<T> *children;
     bitoct::getChildren(node, children);
 
     unsigned char n_children = POPCOUNT(node.valid);
-    unsigned char r = randUC(n_children);
+    unsigned char r = state ? randUC(n_children, *state) : randUC(n_children);
     if (r == n_children) r--;
 
 /*    cout << (unsigned int)r << " nc " << (unsigned int)n_children << endl;
@@ -230,7 +238,7 @@ void showbits(char a)
 
       // randomly get nrp points, we will not check if this succeeds in getting nrp distinct points
       for (char c = 0; c < nrp; c++) {
-        int tmp = rand(points[0].length);
+        int tmp = state ? rand(points[0].length, *state) : rand(points[0].length);
         p.push_back(&(points[BOctTree<T>::POINTDIM*tmp+1].v));
       }
     } else {
@@ -240,7 +248,7 @@ void showbits(char a)
     showbits(node.leaf);
     cout << endl;
       cout << "RECURSED" << endl;*/
-      DrawPoints(p, children[r].node, nrp);
+      DrawPoints(p, children[r].node, nrp, state);
     }
   }
 
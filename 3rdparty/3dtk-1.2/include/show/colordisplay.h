@@ -1,12 +1,18 @@
 #ifndef __COLORDISPLAY_H__
 #define __COLORDISPLAY_H__
 #include "show/colormanager.h"
+#include "show/vertexbuffer.h"
+#include "show/raypick.h"
 #include "limits.h"
 #include <set>
 using std::set;
+#include <vector>
+using std::vector;
 
 class colordisplay {
   public:
+  virtual ~colordisplay() {}
+
   inline void setColorManager(ColorManager *_cm) { cm = _cm; }
   
   void displayLOD(float lod) { 
@@ -21,6 +27,20 @@ class colordisplay {
     if (cm) cm->unload();
   }
 
+  /** draws points extracted by updateLOD */
+  void displayBuffer(vertexBuffer &vb) {
+    if (cm) cm->load();
+    vb.draw();
+    if (cm) cm->unload();
+  }
+
+  /**
+   * Makes vb hold the points displayLOD(lod) would render for the current
+   * frustum. The tree is only traversed if vb was filled for another view.
+   * Returns false if the current LOD mode cannot be stored in a buffer.
+   */
+  virtual bool updateLOD(float lod, vertexBuffer &vb) = 0;
+
   virtual void selectRay(float * &point) {};
   virtual void selectRay(double * &point) {};
   virtual void selectRay(set<float*> &points, int depth=INT_MAX) {};
@@ -28,6 +48,15 @@ class colordisplay {
   virtual void selectRayBrushSize(set<float*> &points, int brushsize) {};
   virtual void selectRayBrushSize(set<double*> &points, int brushsize) {};
 
+  /**
+   * Adds the points in the cone of ray to hits. With k > 0 only the k
+   * points nearest to the near plane are kept, hits is then a heap with
+   * the farthest of them in front. Trees that cannot return pointers to
+   * their points do nothing.
+   */
+  virtual void pickRay(const PickRay &ray, unsigned int k, vector<PickHit<float> > &hits) {};
+  virtual void pickRay(const PickRay &ray, unsigned int k, vector<PickHit<double> > &hits) {};
+
   virtual void cycleLOD() {};
 
   protected:
@@ -107,7 +107,7 @@ class ColorManager {
 
   public: 
   
-    ColorManager(unsigned int _buckets, unsigned int pointdim, float *_mins, float *_maxs, const float *_color = 0) : buckets(_buckets) {
+    ColorManager(unsigned int _buckets, unsigned int pointdim, float *_mins, float *_maxs, const float *_color = 0) : buckets(_buckets), revision(0) {
       if (_color) {
         color[0] = _color[0];
         color[1] = _color[1];
@@ -189,8 +189,23 @@ class ColorManager {
         max = _max;
       }
       extent = max - min;
+      revision++;
     }
 
+    /**
+     * The following describe the per point colour without touching OpenGL,
+     * so that it can be stored in a vertex buffer. The colour is either a
+     * texture coordinate (val[getColorDim()] - getMin()) / getExtent() or,
+     * if isTextured() is false, the three bytes stored at val[getColorDim()].
+     */
+    virtual bool isTextured() const { return true; }
+    virtual unsigned int getColorDim() const { return currentdim; }
+    float getMin() const { return min; }
+    float getExtent() const { return extent; }
+
+    /** changes whenever the colour of any point changes */
+    unsigned int getRevision() const { return revision; }
+
   protected:
     
     
@@ -221,6 +236,7 @@ class ColorManager {
       max = maxs[currentdim];
 
       extent = max - min;
+      revision++;
     }
 
     unsigned int buckets;
@@ -240,6 +256,8 @@ class ColorManager {
 
     float color[3];
 
+    unsigned int revision;
+
 };
 
 class CColorManager : public ColorManager {
@@ -284,6 +302,9 @@ class CColorManager : public ColorManager {
       glColor3ubv(color); 
     }
 
+    virtual bool isTextured() const { return false; }
+    virtual unsigned int getColorDim() const { return colordim; }
+
   private:
     unsigned int colordim;
     GLboolean color_state;
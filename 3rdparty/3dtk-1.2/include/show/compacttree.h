@@ -31,6 +31,7 @@ using std::list;
 #include "show/colormanager.h"
 #include "show/colordisplay.h"
 #include "show/viewcull.h"
+#include "show/vertexbuffer.h"
 #include "show/scancolormanager.h"
 #include "slam6d/allocator.h"
 
@@ -173,7 +174,7 @@ public:
   template <class P>
   compactTree(vector<P *> &pts, double voxelSize, PointType _pointtype = PointType());
   
-  compactTree(std::string filename, ScanColorManager *scm = 0) {
+  compactTree(std::string filename, ScanColorManager *scm = 0) : mapped(0), mappedSize(0) {
     deserialize(filename); 
     if (scm) {
       scm->registerTree(this);
@@ -181,7 +182,7 @@ public:
       scm->updateRanges(maxs);
     }
     setColorManager(0);
-    maxtargetpoints =  maxTargetPoints(*root);
+    if (!mapped) maxtargetpoints =  maxTargetPoints(*root);  // stored in mapped files
     current_lod_mode = 0;
   }
 
@@ -195,6 +196,15 @@ public:
   void setColorManager(ColorManager *_cm);
   void drawLOD(float lod);
   void draw();
+
+  /**
+   * Fills vb with the points drawLOD (extractLOD) or draw (extract) would
+   * render for the frustum set by ExtractFrustum, without calling OpenGL
+   */
+  void extractLOD(float lod, vertexBuffer &vb);
+  void extract(vertexBuffer &vb);
+  bool updateLOD(float lod, vertexBuffer &vb);
+
   void displayOctTree(double minsize = FLT_MAX);
   template <class T>
   void selectRay(vector<T *> &points);
@@ -204,6 +214,8 @@ public:
   inline void getCenter(double center[3]) const;
 
   void serialize(std::string filename);
+  void serializeMapped(std::string filename);
+  static PointType readType(std::string filename);
 protected:
   
   PackedAllocator alloc;
@@ -236,15 +248,15 @@ inline unsigned char childIndex(const double *center, const P *point);
   
   unsigned long maxTargetPoints( cbitoct &node );
  
-  void displayOctTreeAll( cbitoct &node, double *center, double size); 
+  void extractOctTreeAll(vertexBuffer &vb, cbitoct &node, double *center, double size); 
 
-  void displayOctTreeAllCulled( cbitoct &node, double *center, double size );
+  void extractOctTreeAllCulled(vertexBuffer &vb, cbitoct &node, double *center, double size );
 
-  void displayOctTreeCulledLOD(long targetpts, cbitoct &node, double *center, double size ); 
-  void displayOctTreeLOD(long targetpts, cbitoct &node, double *center, double size ); 
+  void extractOctTreeCulledLOD(vertexBuffer &vb, long targetpts, cbitoct &node, double *center, double size ); 
+  void extractOctTreeLOD(vertexBuffer &vb, long targetpts, cbitoct &node, double *center, double size ); 
 
-  void displayOctTreeCulledLOD2(float lod, cbitoct &node, double *center, double size ); 
-  void displayOctTreeLOD2(float lod, cbitoct &node, double *center, double size ); 
+  void extractOctTreeCulledLOD2(vertexBuffer &vb, float lod, cbitoct &node, double *center, double size ); 
+  void extractOctTreeLOD2(vertexBuffer &vb, float lod, cbitoct &node, double *center, double size ); 
   
   
   void displayOctTreeCAllCulled( cbitoct &node, double *center, double size, double minsize ); 
@@ -291,10 +303,27 @@ inline unsigned char childIndex(const double *center, const P *point);
   void deserialize(std::string filename );
   void deserialize(std::ifstream &f, cbitoct &node);
   void serialize(std::ofstream &of, cbitoct &node);
+
+  bool deserializeMapped(std::string filename);
+  void serializeNodes(cbitoct &node, vector<cbitunion<tshort> > &image, unsigned long index,
+                      unsigned long &pointbytes, vector<unsigned long> &leaves);
+  void serializePoints(std::ofstream &of, cbitoct &node);
+
+  /**
+   * the file the tree was mapped from (see serializeMapped), 0 if the
+   * tree lives in the allocator
+   */
+  char *mapped;
+  size_t mappedSize;
   
   
   unsigned long maxtargetpoints;
   unsigned int current_lod_mode;
+
+  /**
+   * the points last drawn, reused while the view does not change
+   */
+  vertexBuffer vbuffer;
   
   void cycleLOD() {
     current_lod_mode = (current_lod_mode+1)%3;
@@ -302,7 +331,7 @@ inline unsigned char childIndex(const double *center, const P *point);
 };
   
 template <class P>
-  compactTree::compactTree(vector<P *> &pts, double voxelSize, PointType _pointtype) {
+  compactTree::compactTree(vector<P *> &pts, double voxelSize, PointType _pointtype) : mapped(0), mappedSize(0) {
     this->voxelSize = voxelSize;
 
     this->POINTDIM = pointtype.getPointDim();
@@ -458,7 +487,7 @@ template <class P>
     //selectRay(point, *root, center, size, FLT_MAX); 
   }
 template <class P>
-    compactTree::compactTree(P * const* pts, int n, double voxelSize, PointType _pointtype , ScanColorManager *scm ) : pointtype(_pointtype) {
+    compactTree::compactTree(P * const* pts, int n, double voxelSize, PointType _pointtype , ScanColorManager *scm ) : pointtype(_pointtype), mapped(0), mappedSize(0) {
     
     cm = 0;
     if (scm) {
@@ -0,0 +1,103 @@
+/**
+ * @file
+ * @brief Pick rays for selecting points without an OpenGL context
+ */
+
+#ifndef __RAYPICK_H__
+#define __RAYPICK_H__
+
+#include <float.h>
+
+/**
+ * @brief The cone of points around a picked pixel
+ *
+ * The ray starts on the near plane and runs through the picked pixel
+ * in the coordinates of one scan. It is widened to a cone holding every
+ * point within a number of pixels of the picked one. The cone grows
+ * with the depth for a perspective projection and is a cylinder for an
+ * orthographic one.
+ */
+class PickRay {
+public:
+  /**
+   * @param modelview the camera matrix times the pose of the scan
+   * @param projection the projection matrix
+   * @param viewport x, y, width and height of the viewport
+   * @param x, y the picked pixel, y counted from the top as by GLUT
+   * @param radius the radius of the cone in pixels
+   */
+  void set(const double *modelview, const double *projection, const int *viewport,
+           int x, int y, float radius);
+
+  /**
+   * Returns true if the point lies in the cone
+   *
+   * @param p the point
+   * @param depth receives the distance of the point from the near plane
+   */
+  template <class T>
+  inline bool contains(const T *p, float &depth) const {
+    float v[3] = {p[0] - origin[0], p[1] - origin[1], p[2] - origin[2]};
+    depth = v[0] * dir[0] + v[1] * dir[1] + v[2] * dir[2];
+    if (depth < 0.0) return false;
+    float r = width + slope * depth;
+    return v[0] * v[0] + v[1] * v[1] + v[2] * v[2] - depth * depth <= r * r;
+  }
+
+  /**
+   * Returns true if the cone intersects the cube
+   *
+   * @param center the center of the cube
+   * @param size half the edge length of the cube
+   * @param tnear receives the smallest depth a point of the cube in the cone can have
+   */
+  template <class T>
+  inline bool hitsCube(const T *center, T size, float &tnear) const {
+    // the cube is grown by the radius of the cone at its far side
+    float tc = (center[0] - origin[0]) * dir[0] + (center[1] - origin[1]) * dir[1]
+      + (center[2] - origin[2]) * dir[2];
+    float far = tc + 1.7320508f * size;
+    float extent = size + width + slope * (far > 0.0 ? far : 0.0);
+
+    float t0 = 0.0, t1 = FLT_MAX;
+    for (int i = 0; i < 3; i++) {
+      float lo = center[i] - extent - origin[i];
+      float hi = center[i] + extent - origin[i];
+      if (dir[i] == 0.0) {
+        if (lo > 0.0 || hi < 0.0) return false;
+        continue;
+      }
+      float a = lo * invdir[i], b = hi * invdir[i];
+      if (a > b) { float t = a; a = b; b = t; }
+      if (a > t0) t0 = a;
+      if (b < t1) t1 = b;
+      if (t0 > t1) return false;
+    }
+    tnear = t0;
+    return true;
+  }
+
+  float origin[3];
+  float dir[3];
+  float invdir[3];
+
+  /** radius of the cone on the near plane and its growth per unit of depth */
+  float width;
+  float slope;
+};
+
+/**
+ * @brief A point found by a pick ray
+ */
+template <class T>
+struct PickHit {
+  T *point;
+  /** distance from the near plane along the ray */
+  float depth;
+  /** index of the scan the point belongs to */
+  unsigned int scan;
+
+  inline bool operator<(const PickHit<T> &other) const { return depth < other.depth; }
+};
+
+#endif
@@ -0,0 +1,69 @@
+/**
+ * @file
+ * @brief Culls the display octrees of all scans in parallel
+ */
+
+#ifndef __SCANCULLER_H__
+#define __SCANCULLER_H__
+
+#include <vector>
+using std::vector;
+
+#include "show/colordisplay.h"
+#include "show/vertexbuffer.h"
+
+/**
+ * @brief Selects the points of all scans shown in a frame
+ *
+ * Every scan keeps the points selected for it in its own vertex buffer.
+ * cull() computes the frustum of every scan and updates the buffers in
+ * parallel. A scan whose view did not change since the last frame is not
+ * traversed again, a scan outside the frustum is rejected at its root.
+ *
+ * With a point budget the level of detail of all scans is lowered in
+ * the same frame if too many points were selected, and raised again in
+ * later frames as soon as there is room.
+ */
+class ScanCuller {
+public:
+  ScanCuller(const vector<colordisplay*> &trees, unsigned long budget = 0);
+  ~ScanCuller();
+
+  /** sets the maximal number of points per frame, 0 for no limit */
+  inline void setBudget(unsigned long _budget) { budget = _budget; scale = 1.0; }
+
+  unsigned long cull(const double *modelview, const double *projection, const int *viewport,
+                     short detail, const vector<const double*> &poses, float lod);
+
+  void display(unsigned int scan);
+
+  /** number of points selected by the last cull */
+  inline unsigned long getPoints() const { return points; }
+
+  /** number of scans traversed by the last cull */
+  inline unsigned int getTraversals() const { return traversals; }
+
+private:
+  unsigned long extract(const double *modelview, const double *projection, const int *viewport,
+                        short detail, const vector<const double*> &poses, float lod);
+
+  /** the display octrees and the points selected from them */
+  vector<colordisplay*> trees;
+  vector<vertexBuffer*> buffers;
+
+  /** false if a tree could not store its points in the buffer */
+  vector<char> buffered;
+
+  unsigned long budget;
+
+  /** factor on the requested level of detail to stay within budget */
+  float scale;
+
+  /** the level of detail used by the last cull */
+  float ratio;
+
+  unsigned long points;
+  unsigned int traversals;
+};
+
+#endif
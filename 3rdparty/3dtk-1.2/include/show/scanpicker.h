@@ -0,0 +1,82 @@
+/**
+ * @file
+ * @brief Picks points in all scans in parallel
+ */
+
+#ifndef __SCANPICKER_H__
+#define __SCANPICKER_H__
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+using std::vector;
+
+#include "show/colordisplay.h"
+#include "show/raypick.h"
+#include "slam6d/globals.icc"
+
+/**
+ * Finds the points within radius pixels of a picked pixel, nearest
+ * first. Every scan is searched by its own thread, the scans stop
+ * descending as soon as they cannot improve on the k nearest hits they
+ * found. No OpenGL context is needed.
+ *
+ * @param trees the display octrees
+ * @param poses the transformation matrix of each scan, NULL for scans not searched
+ * @param modelview the camera matrix
+ * @param projection the projection matrix
+ * @param viewport x, y, width and height of the viewport
+ * @param x, y the picked pixel, y counted from the top as by GLUT
+ * @param radius the radius around the pixel in pixels
+ * @param k the number of points to return, 0 for all points
+ * @param hits receives the points sorted by depth
+ */
+template <class T>
+void pickScans(const vector<colordisplay*> &trees, const vector<const double*> &poses,
+               const double *modelview, const double *projection, const int *viewport,
+               int x, int y, float radius, unsigned int k, vector<PickHit<T> > &hits)
+{
+  hits.clear();
+  int n = trees.size();
+
+#ifdef _OPENMP
+  omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel
+#endif
+  {
+    vector<PickHit<T> > found;
+    vector<PickHit<T> > scanhits;
+
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (int i = 0; i < n; i++) {
+      if (!poses[i]) continue;
+
+      double scanview[16];
+      MMult(modelview, poses[i], scanview);
+      PickRay ray;
+      ray.set(scanview, projection, viewport, x, y, radius);
+
+      scanhits.clear();
+      trees[i]->pickRay(ray, k, scanhits);
+      for (unsigned int j = 0; j < scanhits.size(); j++) {
+        scanhits[j].scan = i;
+        found.push_back(scanhits[j]);
+      }
+    }
+
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+    hits.insert(hits.end(), found.begin(), found.end());
+  }
+
+  std::sort(hits.begin(), hits.end());
+  if (k > 0 && hits.size() > k) hits.resize(k);
+}
+
+#endif
@@ -8,11 +8,16 @@
 #ifndef SHOWBOCTREE_H
 #define SHOWBOCTREE_H
 
+#include <algorithm>
+using std::push_heap;
+using std::pop_heap;
+
 #include "slam6d/Boctree.h"
 #include "show/colormanager.h"
 #include "show/scancolormanager.h"
 #include "show/viewcull.h"
 #include "show/colordisplay.h"
+#include "show/vertexbuffer.h"
 
 
 class ScanColorManager;
@@ -58,22 +63,49 @@ public:
   }
 
   void displayOctTreeCulled(long targetpts) { 
-    glBegin(GL_POINTS);
-    displayOctTreeCulledLOD(targetpts, *BOctTree<T>::root, BOctTree<T>::center, BOctTree<T>::size); 
-    glEnd();
+    vbuffer.begin(targetpts, -2, cm);
+    extractOctTreeCulledLOD(vbuffer, targetpts, *BOctTree<T>::root, BOctTree<T>::center, BOctTree<T>::size); 
+    vbuffer.draw();
   }
 
-  void drawLOD(float ratio) { 
+  /**
+   * Fills vb with the points drawLOD (extractLOD) or draw (extract) would
+   * render for the frustum set by ExtractFrustum, without calling OpenGL.
+   * The point sprites of LOD mode 2 are always drawn directly.
+   */
+  void extractLOD(float ratio, vertexBuffer &vb) { 
+    vb.begin(ratio, current_lod_mode, cm);
     switch (current_lod_mode) {
       case 0:
-        glBegin(GL_POINTS);
-        displayOctTreeCulledLOD(maxtargetpoints * ratio, *BOctTree<T>::root, BOctTree<T>::center, BOctTree<T>::size); 
-        glEnd();
+        extractOctTreeCulledLOD(vb, maxtargetpoints * ratio, *BOctTree<T>::root, BOctTree<T>::center, BOctTree<T>::size); 
+        break;
+      case 1:
+        extractOctTreeCulledLOD2(vb, ratio , *BOctTree<T>::root, BOctTree<T>::center, BOctTree<T>::size);
         break;
+      default:
+      break;
+    }
+  }
+
+  void extract(vertexBuffer &vb) { 
+    vb.begin(1.0, -1, cm);
+    extractOctTreeAllCulled(vb, *BOctTree<T>::root, BOctTree<T>::center, BOctTree<T>::size); 
+  }
+
+  bool updateLOD(float ratio, vertexBuffer &vb) { 
+    if (current_lod_mode > 1) return false;
+    if (!vb.isCurrent(ratio, current_lod_mode, cm)) {
+      extractLOD(ratio, vb);
+    }
+    return true;
+  }
+
+  void drawLOD(float ratio) { 
+    switch (current_lod_mode) {
+      case 0:
       case 1:
-        glBegin(GL_POINTS);
-        displayOctTreeCulledLOD2(ratio , *BOctTree<T>::root, BOctTree<T>::center, BOctTree<T>::size);
-        glEnd();
+        updateLOD(ratio, vbuffer);
+        vbuffer.draw();
         break;
       case 2:
 #ifdef WITH_GLEE
@@ -95,9 +127,10 @@ public:
   }
   
   void draw() { 
-    glBegin(GL_POINTS);
-    displayOctTreeAllCulled(*BOctTree<T>::root, BOctTree<T>::center, BOctTree<T>::size); 
-    glEnd();
+    if (!vbuffer.isCurrent(1.0, -1, cm)) {
+      extract(vbuffer);
+    }
+    vbuffer.draw();
   }
   
   void displayOctTree(T minsize = FLT_MAX) {
@@ -113,6 +146,9 @@ public:
   void selectRay(T * &point) { 
     selectRay(point, *BOctTree<T>::root, BOctTree<T>::center, BOctTree<T>::size, FLT_MAX); 
   }
+  void pickRay(const PickRay &ray, unsigned int k, vector<PickHit<T> > &hits) { 
+    pickRay(ray, k, hits, *BOctTree<T>::root, BOctTree<T>::center, BOctTree<T>::size); 
+  }
 
 
   void cycleLOD() {
@@ -144,7 +180,7 @@ protected:
     return max*POPCOUNT(node.valid);
   }
   
-  void displayOctTreeAll( bitoct &node) {
+  void extractOctTreeAll(vertexBuffer &vb, bitoct &node) {
 //    T ccenter[3];
     bitunion<T> *children;
     bitoct::getChildren(node, children);
@@ -156,24 +192,23 @@ protected:
           unsigned int length = points[0].length;
           T *point = &(points[1].v);  // first point
           for(unsigned int iterator = 0; iterator < length; iterator++ ) {
-            if(cm) cm->setColor(point);
-            glVertex3f( point[0], point[1], point[2]);
+            vb.add(point[0], point[1], point[2], point);
             point+=BOctTree<T>::POINTDIM;
           }
         } else { // recurse
-          displayOctTreeAll( children->node);
+          extractOctTreeAll(vb, children->node);
         }
         ++children; // next child
       }
     }
   }
 
-  void displayOctTreeAllCulled( bitoct &node, T *center, T size ) {
+  void extractOctTreeAllCulled(vertexBuffer &vb, bitoct &node, T *center, T size ) {
     int res = CubeInFrustum2(center[0], center[1], center[2], size);
     if (res==0) return;  // culled do not continue with this branch of the tree
 
     if (res == 2) { // if entirely within frustrum discontinue culling
-      displayOctTreeAll(node);
+      extractOctTreeAll(vb, node);
       return;
     }
 
@@ -191,20 +226,19 @@ protected:
             unsigned int length = points[0].length;
             T *point = &(points[1].v);  // first point
             for(unsigned int iterator = 0; iterator < length; iterator++ ) {
-              if(cm) cm->setColor(point);
-              glVertex3f( point[0], point[1], point[2]);
+              vb.add(point[0], point[1], point[2], point);
               point+=BOctTree<T>::POINTDIM;
             }
           //}
         } else { // recurse
-          displayOctTreeAllCulled( children->node, ccenter, size/2.0);
+          extractOctTreeAllCulled(vb, children->node, ccenter, size/2.0);
         }
         ++children; // next child
       }
     }
   }
   
-  void displayOctTreeLOD2(float ratio,  bitoct &node, T *center, T size ) {
+  void extractOctTreeLOD2(vertexBuffer &vb, float ratio,  bitoct &node, T *center, T size ) {
 
     T ccenter[3];
     bitunion<T> *children;
@@ -228,28 +262,24 @@ protected:
               for(int iterator = 0; iterator < l; iterator++ ) {
                 index = (T)iterator * each;
                 p = point + index - index%BOctTree<T>::POINTDIM;
-                if(cm) cm->setColor(p);
-                glVertex3f( p[0], p[1], p[2]);
+                vb.add(p[0], p[1], p[2], p);
               }
             } else if ((int)length <= l) { 
               for(unsigned int iterator = 0; iterator < length; iterator++ ) {
-                if(cm) cm->setColor(point);
-                glVertex3f( point[0], point[1], point[2]);
+                vb.add(point[0], point[1], point[2], point);
                 point+=BOctTree<T>::POINTDIM;
               }
             } /* else if (l == 1) {
-              if(cm) cm->setColor(point);
-              glVertex3f( point[0], point[1], point[2]);
+              vb.add(point[0], point[1], point[2], point);
             }*/
           } else {
-              if(cm) cm->setColor(point);
-              glVertex3f( point[0], point[1], point[2]);
+              vb.add(point[0], point[1], point[2], point);
           }
         } else { // recurse
             int l = LOD2(ccenter[0], ccenter[1], ccenter[2], size/2.0);  // only a single pixel on screen only paint one point
             l = max((int)(l*l*ratio), 0);
             if (l > 0) {
-              displayOctTreeCulledLOD2(ratio, children->node, ccenter, size/2.0);
+              extractOctTreeCulledLOD2(vb, ratio, children->node, ccenter, size/2.0);
             }
         }
         ++children; // next child
@@ -257,13 +287,13 @@ protected:
     }
   }
   
-  void displayOctTreeCulledLOD2(float ratio, bitoct &node, T *center, T size ) {
+  void extractOctTreeCulledLOD2(vertexBuffer &vb, float ratio, bitoct &node, T *center, T size ) {
 
     int res = CubeInFrustum2(center[0], center[1], center[2], size);
     if (res==0) return;  // culled do not continue with this branch of the tree
 
     if (res == 2) { // if entirely within frustrum discontinue culling
-      displayOctTreeLOD2(ratio, node, center, size);
+      extractOctTreeLOD2(vb, ratio, node, center, size);
       return;
     }
 
@@ -291,18 +321,15 @@ protected:
                 for(int iterator = 0; iterator < l; iterator++ ) {
                   index = (T)iterator * each;
                   p = point + index - index%BOctTree<T>::POINTDIM;
-                  if(cm) cm->setColor(p);
-                  glVertex3f( p[0], p[1], p[2]);
+                  vb.add(p[0], p[1], p[2], p);
                 }
               } else if ((int)length <= l) { 
                 for(unsigned int iterator = 0; iterator < length; iterator++ ) {
-                  if(cm) cm->setColor(point);
-                  glVertex3f( point[0], point[1], point[2]);
+                  vb.add(point[0], point[1], point[2], point);
                   point+=BOctTree<T>::POINTDIM;
                 }
               } else if (l == 1) {
-                if(cm) cm->setColor(point);
-                glVertex3f( point[0], point[1], point[2]);
+                vb.add(point[0], point[1], point[2], point);
               }
             } 
           }
@@ -310,7 +337,7 @@ protected:
           //int l = LOD2(ccenter[0], ccenter[1], ccenter[2], size/2.0);  // only a single pixel on screen only paint one point
           //l = max((int)(l*l*ratio), 0);
           //if (l > 0) {
-            displayOctTreeCulledLOD2(ratio, children->node, ccenter, size/2.0);
+            extractOctTreeCulledLOD2(vb, ratio, children->node, ccenter, size/2.0);
           //}
         }
         ++children; // next child
@@ -402,14 +429,14 @@ protected:
     }
   }
 
-  void displayOctTreeCulledLOD(long targetpts, bitoct &node, T *center, T size ) {
+  void extractOctTreeCulledLOD(vertexBuffer &vb, long targetpts, bitoct &node, T *center, T size ) {
     if (targetpts <= 0) return; // no need to display anything
 
     int res = CubeInFrustum2(center[0], center[1], center[2], size);
     if (res==0) return;  // culled do not continue with this branch of the tree
 
     if (res == 2) { // if entirely within frustrum discontinue culling
-      displayOctTreeLOD(targetpts, node, center, size);
+      extractOctTreeLOD(vb, targetpts, node, center, size);
       return;
     }
 
@@ -435,12 +462,10 @@ protected:
             T *point = &(points[1].v);  // first point
 
             if (length > 10 && !LOD(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {  // only a single pixel on screen only paint one point
-              if(cm) cm->setColor(point);
-              glVertex3f( point[0], point[1], point[2]);
+              vb.add(point[0], point[1], point[2], point);
             } else if (length <= newtargetpts) {        // more points requested than possible, plot all
               for(unsigned int iterator = 0; iterator < length; iterator++ ) {
-                if(cm) cm->setColor(point);
-                glVertex3f( point[0], point[1], point[2]);
+                vb.add(point[0], point[1], point[2], point);
                 point+=BOctTree<T>::POINTDIM;
               }
             } else {                         // select points to show
@@ -451,22 +476,21 @@ protected:
               for(unsigned int iterator = 0; iterator < newtargetpts; iterator++ ) {
                 index = (T)iterator * each;
                 p = point + index - index%BOctTree<T>::POINTDIM;
-                if(cm) cm->setColor(p);
-                glVertex3f( p[0], p[1], p[2]);
+                vb.add(p[0], p[1], p[2], p);
                 //point += each;
               }
             }
           }
 
         } else { // recurse
-          displayOctTreeCulledLOD(newtargetpts, children->node, ccenter, size/2.0);
+          extractOctTreeCulledLOD(vb, newtargetpts, children->node, ccenter, size/2.0);
         }
         ++children; // next child
       }
     }
   }
 
-  void displayOctTreeLOD(long targetpts, bitoct &node, T *center, T size ) {
+  void extractOctTreeLOD(vertexBuffer &vb, long targetpts, bitoct &node, T *center, T size ) {
     if (targetpts <= 0) return; // no need to display anything
 
     T ccenter[3];
@@ -489,12 +513,10 @@ protected:
           unsigned int length = points[0].length;
           T *point = &(points[1].v);  // first point
           if (length > 10 && !LOD(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {  // only a single pixel on screen only paint one point
-            if(cm) cm->setColor(point);
-            glVertex3f( point[0], point[1], point[2]);
+            vb.add(point[0], point[1], point[2], point);
           } else if (length <= newtargetpts) {        // more points requested than possible, plot all
             for(unsigned int iterator = 0; iterator < length; iterator++ ) {
-              if(cm) cm->setColor(point);
-              glVertex3f( point[0], point[1], point[2]);
+              vb.add(point[0], point[1], point[2], point);
               point+=BOctTree<T>::POINTDIM;
             }
           } else {                         // select points to show
@@ -505,13 +527,12 @@ protected:
             for(unsigned int iterator = 0; iterator < newtargetpts; iterator++ ) {
               index = (T)iterator * each;
               p = point + index - index%BOctTree<T>::POINTDIM;
-              if(cm) cm->setColor(p);
-              glVertex3f( p[0], p[1], p[2]);
+              vb.add(p[0], p[1], p[2], p);
               //point += each;
             }
           }
         } else { // recurse
-          displayOctTreeLOD(newtargetpts, children->node, ccenter, size/2.0);
+          extractOctTreeLOD(vb, newtargetpts, children->node, ccenter, size/2.0);
         }
         ++children; // next child
       }
@@ -546,6 +567,73 @@ protected:
     }
   }
 
+  /**
+   * Visits the children hit by the cone front to back and stops as soon
+   * as a child cannot contain a point nearer than the k hits found
+   */
+  void pickRay(const PickRay &ray, unsigned int k, vector<PickHit<T> > &hits, bitoct &node, T *center, T size) {
+    T ccenter[8][3];
+    float tnear[8];
+    bitunion<T> *child[8];
+    bool leaf[8];
+    int n = 0;
+
+    bitunion<T> *children;
+    bitoct::getChildren(node, children);
+
+    for (short i = 0; i < 8; i++) {
+      if (  ( 1 << i ) & node.valid ) {   // if ith node exists
+        T c[3];
+        childcenter(center, c, size, i);  // childrens center
+        float t;
+        if (ray.hitsCube(c, size/2, t)) {
+          // insert sorted by depth
+          int j = n;
+          for (; j > 0 && tnear[j-1] > t; j--) {
+            tnear[j] = tnear[j-1];
+            child[j] = child[j-1];
+            leaf[j] = leaf[j-1];
+            for (int d = 0; d < 3; d++) ccenter[j][d] = ccenter[j-1][d];
+          }
+          for (int d = 0; d < 3; d++) ccenter[j][d] = c[d];
+          tnear[j] = t;
+          child[j] = children;
+          leaf[j] = ( 1 << i ) & node.leaf;
+          n++;
+        }
+        ++children; // next child
+      }
+    }
+
+    for (int j = 0; j < n; j++) {
+      if (k > 0 && hits.size() == k && tnear[j] > hits.front().depth) return;
+      if (leaf[j]) {
+        pointrep *points = child[j]->points;
+        unsigned int length = points[0].length;
+        T *point = &(points[1].v);  // first point
+        for(unsigned int iterator = 0; iterator < length; iterator++ ) {
+          float depth;
+          if (ray.contains(point, depth)) {
+            PickHit<T> hit = {point, depth, 0};
+            if (k == 0) {
+              hits.push_back(hit);
+            } else if (hits.size() < k) {
+              hits.push_back(hit);
+              push_heap(hits.begin(), hits.end());
+            } else if (depth < hits.front().depth) {
+              pop_heap(hits.begin(), hits.end());
+              hits.back() = hit;
+              push_heap(hits.begin(), hits.end());
+            }
+          }
+          point+=BOctTree<T>::POINTDIM;
+        }
+      } else { // recurse
+        pickRay(ray, k, hits, child[j]->node, ccenter[j], size/2.0);
+      }
+    }
+  }
+
   void selectRayBS(set<T *> &selpoints, bitoct &node, T *center, T size, int brushsize) {
     T ccenter[3];
     bitunion<T> *children;
@@ -793,7 +881,7 @@ protected:
   }
   
   
-  void displayOctTreeAllCulled( bitoct &node, T *center, T size, float *frustum[6], unsigned char frustsize ) {
+  void extractOctTreeAllCulled(vertexBuffer &vb, bitoct &node, T *center, T size, float *frustum[6], unsigned char frustsize ) {
     float *new_frustum[6]; unsigned char counter = 0;
     for (unsigned char p = 0; p < frustsize; p++ ) {
       char res = PlaneAABB(center[0], center[1], center[2], size, frustum[p]);
@@ -804,7 +892,7 @@ protected:
       } // other case is simply not to continue culling with the respective plane
     }
     if (counter == 0) { // if entirely within frustrum discontinue culling
-      displayOctTreeAll(node);
+      extractOctTreeAll(vb, node);
       return;
     }
     
@@ -820,12 +908,11 @@ protected:
           unsigned int length = points[0].length;
           T *point = &(points[1].v);  // first point
           for(unsigned int iterator = 0; iterator < length; iterator++ ) {
-            if(cm) cm->setColor(point);
-            glVertex3f( point[0], point[1], point[2]);
+            vb.add(point[0], point[1], point[2], point);
             point+=BOctTree<T>::POINTDIM;
           }
         } else { // recurse
-          displayOctTreeAllCulled( children->node, ccenter, size/2.0, new_frustum, counter);
+          extractOctTreeAllCulled(vb, children->node, ccenter, size/2.0, new_frustum, counter);
         }
         ++children; // next child
       }
@@ -864,6 +951,11 @@ protected:
 
   unsigned int current_lod_mode;
 
+  /**
+   * the points last drawn, reused while the view does not change
+   */
+  vertexBuffer vbuffer;
+
 };
 
 #endif
@@ -0,0 +1,105 @@
+/**
+ * @file
+ * @brief Representation of a reusable buffer of decoded points
+ */
+
+#ifndef __VERTEXBUFFER_H__
+#define __VERTEXBUFFER_H__
+
+#include <string.h>
+#include <vector>
+
+#include "show/colormanager.h"
+
+/**
+ * @brief Points selected by a culling and LOD traversal
+ *
+ * The octrees fill the buffer instead of calling glVertex for every
+ * point, so the traversal itself does not need an OpenGL context. The
+ * buffer remembers the view it was filled for, as long as neither the
+ * view nor the colours change it is simply drawn again.
+ */
+class vertexBuffer
+{
+public:
+  vertexBuffer();
+  ~vertexBuffer();
+
+  /**
+   * Empties the buffer (keeping its memory) and remembers the current view
+   * of viewcull, the level of detail and the color manager
+   */
+  void begin(float ratio, int mode, ColorManager *cm);
+
+  /**
+   * Returns true if the buffer was filled for the current view of viewcull
+   * and the given level of detail and color manager
+   */
+  bool isCurrent(float ratio, int mode, ColorManager *cm) const;
+
+  /** Forces the next isCurrent to fail */
+  inline void invalidate() { valid = false; }
+
+  /** Number of calls to begin, i.e. how often the buffer was filled */
+  inline unsigned int getFills() const { return fills; }
+
+  /**
+   * Appends a vertex, the color is taken from the original point
+   *
+   * @param x, y, z the decoded position
+   * @param point the point in the octree
+   */
+  template <class T>
+  inline void add(float x, float y, float z, T *point) {
+    vertices.push_back(x);
+    vertices.push_back(y);
+    vertices.push_back(z);
+    if (!colored) return;
+    if (textured) {
+      texcoords.push_back( (float)((point[colordim] - min)/extent) );
+    } else {
+      GLubyte color[3];
+      memcpy(color, &point[colordim], 3);
+      colors.push_back(color[0]);
+      colors.push_back(color[1]);
+      colors.push_back(color[2]);
+    }
+  }
+
+  /** Number of vertices in the buffer */
+  inline unsigned int size() const { return vertices.size() / 3; }
+
+  /** Renders all vertices as GL_POINTS */
+  void draw();
+
+  std::vector<GLfloat> vertices;
+  std::vector<GLfloat> texcoords;
+  std::vector<GLubyte> colors;
+
+private:
+  /** the view the buffer was filled for */
+  float viewmatrix[16];
+  short viewport[4];
+  short detail;
+  float ratio;
+  int mode;
+  ColorManager *cm;
+  unsigned int revision;
+  bool valid;
+
+  /** how points are colored, copied from the color manager */
+  bool colored;
+  bool textured;
+  unsigned int colordim;
+  float min;
+  float extent;
+
+  /** how often the buffer was filled */
+  unsigned int fills;
+
+  /** the vertex buffer object on the graphics card and wether it is up to date */
+  GLuint vbo;
+  bool uploaded;
+};
+
+#endif
@@ -29,6 +29,11 @@ extern float right[3];
 /** how much detail is shown, 0 means everything is plotted */
 extern short DETAIL;
 
+#ifdef _OPENMP
+// every thread culls with its own frustum, see ScanCuller
+#pragma omp threadprivate(frustum, matrix, VP, right, DETAIL)
+#endif
+
 extern double SX, SY, SZ, EX, EY, EZ;
 extern float origin[3], dir[3];   /*ray */
 extern float dist;
@@ -150,6 +155,7 @@ short ScreenDist(T *point) {
 }
 
 void ExtractFrustum(short detail);
+void ExtractFrustum(const double *modelMatrix, const double *projMatrix, const int *viewport, short detail);
 void ExtractFrustum(float *frust[6]);
 
 
@@ -158,6 +164,7 @@ int  CubeInFrustum2( float x, float y, float z, float size );
 char PlaneAABB( float x, float y, float z, float size, float *plane );
 
 void remViewport();
+void remViewport(const double *modelMatrix, const double *projMatrix, const int *viewport);
 bool LOD(float x, float y, float z, float size);
 int LOD2(float x, float y, float z, float size);
 
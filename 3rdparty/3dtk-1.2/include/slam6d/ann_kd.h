@@ -48,6 +48,9 @@ public:
   */  
   double *FindClosest(double *_p, double maxdist2, int threadNum = 0);
 
+  int FindKClosest(double *_p, int k, double maxdist2,
+                   double **closest, double *closest_d2);
+
 private:
 
   /**
@@ -46,7 +46,12 @@ public:
   virtual ~icp6D() {};
   
   void doICP(vector <Scan *> allScans);
+  void doICPConcurrent(vector <Scan *> allScans);
   virtual int match(Scan* PreviousScan, Scan* CurrentScan);
+  int matchCopy(Scan* PreviousScan, Scan* CurrentScan, int thread_num, double *relxf);
+  int matchLevels(Scan* PreviousScan, Scan* CurrentScan, int thread_num);
+  int matchLevel(Scan* PreviousLevel, Scan* CurrentLevel, Scan* CurrentScan,
+                 double max_dist_match2, bool last, int thread_num = -1);
   void covarianceEuler(Scan *scan1, Scan *scan2, NEWMAT::Matrix *C);
   void covarianceQuat(Scan *scan1, Scan *scan2, NEWMAT::Matrix *C);
   double Point_Point_Error(Scan* PreviousScan, Scan* CurrentScan, double max_dist_match, unsigned int *nrp=0);
@@ -61,9 +66,16 @@ public:
   inline void set_max_num_iterations(int max_num_iterations);
   inline void set_cad_matching (bool cad_matching);
   inline bool get_cad_matching (void);
+  inline void set_pyramid(bool pyramid);
+  inline bool get_pyramid();
+  inline void set_concurrent(bool concurrent);
+  inline bool get_concurrent();
   
 protected:
 
+  void getPtPlaneSystem(Scan* PreviousLevel, Scan* CurrentLevel, const double *center,
+                        double max_dist_match2, int thread_num, PtPlaneSystem &system);
+
   /**
    * suppress output to cout
    */
@@ -128,6 +140,16 @@ protected:
    * determines if CAD models are matched against one scan
    */
   bool cad_matching;
+
+  /**
+   * match coarse-to-fine on the reduction levels of the scans
+   */
+  bool pyramid;
+
+  /**
+   * match all scan pairs at the same time and chain the results afterwards
+   */
+  bool concurrent;
 };
 
 #include "icp6D.icc"
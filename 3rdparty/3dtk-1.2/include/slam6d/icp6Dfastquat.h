@@ -0,0 +1,46 @@
+/** @file
+ *  @brief Definition of the ICP error function minimization via quaternions
+ *         with SIMD accumulation and a closed form eigen solver
+ */
+
+#ifndef __ICP6DFASTQUAT_H__
+#define __ICP6DFASTQUAT_H__
+
+#include "icp6Dquat.h"
+
+/**
+ * @brief Implementation of the ICP error function minimization via quaternions
+ *
+ * Computes the same transformation as icp6D_QUAT. The cross covariance
+ * is accumulated about the centroids with SSE2 if available, x and y of
+ * a point in one register. The eigenvector of Horn's matrix is found in
+ * closed form by the functions of fixedmatrix.icc, which allocate no
+ * memory.
+ */
+class icp6D_FASTQUAT : public icp6D_QUAT
+{
+public:
+  /** constructor */
+  icp6D_FASTQUAT(bool quiet = false) : icp6D_QUAT(quiet) {};
+  /** destructor */
+  virtual ~icp6D_FASTQUAT() {};
+
+  double Point_Point_Align(const vector<PtPair>& Pairs, double *alignxf,
+					  const double centroid_m[3], const double centroid_d[3]);
+  double Point_Point_Align_Parallel(const int openmp_num_threads,
+							 const unsigned int n[OPENMP_NUM_THREADS],
+							 const double sum[OPENMP_NUM_THREADS],
+							 const double centroid_m[OPENMP_NUM_THREADS][3],
+							 const double centroid_d[OPENMP_NUM_THREADS][3],
+							 const double Si[OPENMP_NUM_THREADS][9], double *alignxf);
+  inline int getAlgorithmID() { return 11; };
+
+  static double crossCovariance(const vector<PtPair> &pairs,
+						  const double centroid_m[3], const double centroid_d[3],
+						  double S[3][3]);
+  void alignCovariance(const double S[3][3],
+				   const double centroid_m[3], const double centroid_d[3],
+				   double *alignxf);
+};
+
+#endif
@@ -82,6 +82,15 @@ public:
     exit(-1);
   }
 
+  /**
+   * aligning the point to plane pairs collected in a linear system
+   */
+  virtual double Point_Plane_Align(const PtPlaneSystem &system, double *alignxf)
+  {
+    cout << "this function is not implemented!!!" << endl;
+    exit(-1);
+  }
+
   virtual int getAlgorithmID() = 0; 
 
 protected:
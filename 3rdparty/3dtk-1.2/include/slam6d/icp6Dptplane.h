@@ -0,0 +1,36 @@
+/** @file 
+ *  @brief Definition of the point to plane ICP error function minimization
+ */
+
+#ifndef __ICP6DPTPLANE_H__
+#define __ICP6DPTPLANE_H__
+
+#include "icp6Dapx.h"
+
+/**
+ * @brief Implementation of the point to plane ICP error function minimization
+ *
+ * Minimizes the sum of the squared distances of the points of the moving
+ * scan to the tangent planes of their closest points in the model,
+ * linearised with the small angle approximation. The pairs are collected
+ * in a PtPlaneSystem, the 6x6 system is solved in one step. Point pairs
+ * without normals are aligned point to point like icp6D_APX.
+ */
+class icp6D_PTPLANE : public icp6D_APX
+{
+public:
+  /** 
+   * Constructor 
+   */
+  icp6D_PTPLANE(bool quiet = false) : icp6D_APX(quiet) {};
+  /** 
+   * Destructor 
+   */
+  virtual ~icp6D_PTPLANE() {};                                  
+
+  double Point_Plane_Align(const PtPlaneSystem &system, double *alignxf);
+
+  inline int getAlgorithmID() { return 10; }; 
+};
+
+#endif
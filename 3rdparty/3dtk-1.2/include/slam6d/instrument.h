@@ -0,0 +1,156 @@
+/**
+ * @file
+ * @brief Counters and scoped timers for the hot paths of slam6D
+ *
+ * The instrumentation is compiled in with -DWITH_INSTRUMENTATION (cmake
+ * option WITH_INSTRUMENTATION), otherwise the macros expand to nothing.
+ * Every thread counts into a record of its own. At exit the records are
+ * written as JSON to the file named by the environment variable
+ * SLAM6D_INSTRUMENT (default instrument.json). If SLAM6D_TRACE names a
+ * file, every timed scope is written there as well, as an event of the
+ * Chrome trace format (chrome://tracing).
+ */
+
+#ifndef __INSTRUMENT_H__
+#define __INSTRUMENT_H__
+
+/**
+ * Events that are counted
+ */
+enum InstrumentCounter {
+  INSTR_NN_QUERIES,          ///< closest point queries of getPtPairs
+  INSTR_NODES_VISITED,       ///< nodes of a KDtree visited by the queries
+  INSTR_PAIRS_FOUND,         ///< point pairs found by getPtPairs
+  INSTR_TREES_BUILT,         ///< search trees built, also when swapped in
+  INSTR_POINTS_TRANSFORMED,  ///< reduced points moved by Scan::transform
+  INSTR_FRAMES_STORED,       ///< transformations written to .frames files
+  INSTR_COUNTERS
+};
+
+/**
+ * Phases that are timed. Nested scopes of the same phase are counted as
+ * calls, but their time only once.
+ */
+enum InstrumentPhase {
+  INSTR_GETPTPAIRS,          ///< SearchTree::getPtPairs, queries and pair building
+  INSTR_ICP_MATCH,           ///< icp6D::match of a pair of scans on all levels
+  INSTR_MINIMIZE,            ///< the minimizer of icp6D
+  INSTR_TRANSFORM,           ///< Scan::transform
+  INSTR_FRAMES,              ///< writing the .frames files in Scan::transform
+  INSTR_CREATETREE,          ///< Scan::createTree
+  INSTR_COVARIANCE,          ///< lum6DEuler::covarianceEuler
+  INSTR_FILLGB,              ///< lum6DEuler::FillGB3D
+  INSTR_SOLVE,               ///< the solvers of graphSlam6D
+  INSTR_PHASES
+};
+
+#ifdef WITH_INSTRUMENTATION
+
+#include <cstddef>
+#include <vector>
+
+#ifdef _MSC_VER
+  #define INSTRUMENT_TLS __declspec(thread)
+#else
+  #define INSTRUMENT_TLS __thread
+#endif
+
+/**
+ * @brief A timed scope for the Chrome trace
+ */
+struct InstrumentEvent {
+  int phase;
+  unsigned long long start;     ///< ns since the first thread was registered
+  unsigned long long duration;  ///< ns
+};
+
+/**
+ * @brief The counts and times of one thread
+ */
+class InstrumentThread
+{
+public:
+  InstrumentThread(int id);
+
+  int id;                                     ///< order of registration
+  unsigned long long counts[INSTR_COUNTERS];
+  unsigned long long calls[INSTR_PHASES];
+  unsigned long long ns[INSTR_PHASES];
+  int depth[INSTR_PHASES];                    ///< open scopes of each phase
+  std::vector<InstrumentEvent> events;
+  unsigned long long dropped;                 ///< events beyond maxEvents
+};
+
+/**
+ * @brief Registry of the thread records
+ */
+class Instrument
+{
+public:
+  /** the record of the calling thread, registered on first use */
+  static inline InstrumentThread *thread() {
+    return current ? current : registerThread();
+  }
+
+  static inline void count(InstrumentCounter counter, unsigned long long n) {
+    thread()->counts[counter] += n;
+  }
+
+  static unsigned long long now();
+  static void trace(InstrumentThread *t, InstrumentPhase phase,
+                    unsigned long long start, unsigned long long duration);
+  static void dump();
+
+  /** are the scopes written to a Chrome trace? */
+  static bool tracing;
+  /** maximal number of trace events kept per thread */
+  static size_t maxEvents;
+
+private:
+  static InstrumentThread *registerThread();
+  static INSTRUMENT_TLS InstrumentThread *current;
+};
+
+/**
+ * @brief Times the enclosing scope, see INSTRUMENT_SCOPE
+ */
+class InstrumentScope
+{
+public:
+  inline InstrumentScope(InstrumentPhase phase)
+    : phase(phase), t(Instrument::thread()) {
+    t->depth[phase]++;
+    start = Instrument::now();
+  }
+
+  inline ~InstrumentScope() {
+    unsigned long long duration = Instrument::now() - start;
+    t->calls[phase]++;
+    if (--t->depth[phase] == 0) t->ns[phase] += duration;
+    if (Instrument::tracing) Instrument::trace(t, phase, start, duration);
+  }
+
+private:
+  InstrumentPhase phase;
+  InstrumentThread *t;
+  unsigned long long start;
+};
+
+#define INSTRUMENT_CONCAT2(a, b) a##b
+#define INSTRUMENT_CONCAT(a, b) INSTRUMENT_CONCAT2(a, b)
+
+/** times the rest of the enclosing scope as phase */
+#define INSTRUMENT_SCOPE(phase) \
+  InstrumentScope INSTRUMENT_CONCAT(instrumentScope, __LINE__)(phase)
+/** adds n to counter */
+#define INSTRUMENT_COUNT(counter, n) Instrument::count(counter, n)
+
+#else
+
+#define INSTRUMENT_SCOPE(phase)
+// n is not evaluated, but counts as used
+#define INSTRUMENT_COUNT(counter, n) ((void)sizeof(n))
+
+#endif
+
+#endif
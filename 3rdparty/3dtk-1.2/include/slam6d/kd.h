@@ -20,6 +20,8 @@
 #include <omp.h>
 #endif
 
+#include <cstdio>
+
 /**
  * @brief The optimized k-d tree. 
  * 
@@ -32,6 +34,7 @@ class KDtree : public SearchTree {
 public:
 
   KDtree(double **pts, int n);
+  KDtree(FILE *file, double **pts, int n, int dim, int &next);
   
   /**
    * destructor
@@ -52,6 +55,10 @@ public:
   }
 
   double *FindClosest(double *_p, double maxdist2, int threadNum = 0);
+  int FindKClosest(double *_p, int k, double maxdist2,
+                   double **closest, double *closest_d2);
+
+  void save(FILE *file, int dim) const;
 
 private:
   /**
@@ -106,6 +113,7 @@ private:
   };
 
   void _FindClosest(int threadNum);
+  void _FindKClosest(KDKnnParams &params);
 };
 
 #endif
@@ -56,17 +56,22 @@ public:
     }
 
     // delete entries in cache
-    vector <KDCache*>::iterator Iter1;
-    for(Iter1 = closest_cache.begin(); Iter1 != closest_cache.end(); Iter1++) {
-      delete [] (*Iter1)->item;
-      delete *Iter1;
-    }
-    closest_cache.clear();
-    
+    if (closest_cache) deleteCaches();
   }
 
   KDCacheItem* FindClosestCache(double *_p, double maxdist2, int threadNum = 0);
   KDCacheItem* FindClosestCacheInit(double *_p, double maxdist2, int threadNum = 0);
+  bool HasClosest(double *_p, double maxdist2, int threadNum = 0);
+  int FindKClosest(double *_p, int k, double maxdist2,
+                   double **closest, double *closest_d2);
+
+  /**
+   * Maximal number of bytes of the caches of all cached k-d trees, 0 for
+   * no limit. If a new cache would exceed it, the least recently used
+   * caches are evicted. If this does not suffice, the points are
+   * searched from the root without a cache.
+   */
+  static size_t maxCacheMemory;
 
 private:
 #ifdef _OPENMP
@@ -83,6 +88,11 @@ private:
    * number of points. If this is 0: intermediate node.  If nonzero: leaf.
    */
   int npts;
+
+  /**
+   * index of the node in the nodes of the cache table, see numberNodes
+   */
+  int index;
   
   KDtree_cache *parent;
   double center[3];
@@ -113,9 +123,28 @@ private:
    */
   void _FindClosestCacheInit(int threadNum = 0);
   void _FindClosestCache(KDtree_cache *prev = 0, int threadNum = 0);
+  void _FindKClosest(KDKnnParams &params);
+  KDCacheItem* FindClosestCached(KDCacheEntry *entry, KDtree_cache * const *nodes,
+                                 double *_p, double maxdist2, int threadNum);
 
-  KDCacheItem* initCache(const Scan* Target);
-  vector<KDCache*> closest_cache;
+  void numberNodes(vector<KDtree_cache*> &nodes);
+  KDCache* acquireCache(const Scan* Target);
+  KDCache* insertCache(const Scan* Target);
+  static void releaseCache(KDCache *cache);
+  static bool evictCache(KDCacheTable *table);
+  void deleteCaches();
+
+  /**
+   * the caches of the root, keyed by target scan. Created with the first cache.
+   */
+  KDCacheTable * volatile closest_cache;
+
+  /** bytes of the caches of all trees */
+  static size_t cacheMemory;
+  /** counts the uses of caches, for evicting the least recently used */
+  static volatile int cacheClock;
+  /** all trees with caches */
+  static vector<KDtree_cache*> cachedTrees;
 public:
   virtual void getPtPairs(vector <PtPair> *pairs, 
 				  double *source_alignxf, 
@@ -124,6 +153,12 @@ public:
 				  int rnd, double max_dist_match2, double &sum,
 				  double *centroid_m, double *centroid_d,
           Scan *Target = 0);
+
+  virtual void getPtPlaneSystem(PtPlaneSystem &system,
+          double *source_alignxf,
+          double * const *q_points, unsigned int startindex, unsigned int nr_qpts,
+          int thread_num, int rnd, double max_dist_match2,
+          Scan *Target = 0);
 };
 
 #endif
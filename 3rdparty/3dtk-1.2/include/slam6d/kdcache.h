@@ -11,6 +11,9 @@
 #include "searchCache.h"
 #include "kdparams.h"
 
+#include <vector>
+using std::vector;
+
 // just a prototype
 class KDtree_cache;
 class Scan;
@@ -29,22 +32,45 @@ public:
   KDtree_cache *node;
 };
 
+/**
+ * @brief compact cache entry
+ *
+ * What is kept of a KDCacheItem for every point of a target scan,
+ * 4 bytes instead of the padded item.
+ **/
+struct KDCacheEntry {
+  int node;  ///< index of the node the next search starts at, -1 for the root
+};
+
 /**
  * @brief cache 
  * 
- * The cache consists of an array of KDCacheItems
- * and two Scan numbers.
+ * The cache of one target scan, an array of KDCacheEntries
+ * with one entry per point of the target.
  **/
 class KDCache {
 public:
-//  KDCache() { SourceScanNr = TargetScanNr = 0; item = 0; };
-  KDCache() { target = 0; item = 0; };
-  KDCacheItem *item;  // array of items
-//  unsigned int SourceScanNr;
-//  unsigned int TargetScanNr;
-  Scan const * target; 
+  KDCache() { target = 0; item = 0; size = 0; users = 0; lastUse = 0; };
+  KDCacheEntry *item;  // array of items
+  int size;            // number of items
+  Scan const * volatile target;  // key, 0 for a free slot
+  volatile int users;  // number of threads working with the items
+  volatile int lastUse;  // time of the last use, for evicting the least recently used
 };
 
-#endif
+/** number of target scans a cached k-d tree keeps caches for */
+#define KDCACHE_SLOTS 64
 
+/**
+ * @brief hash table of caches
+ *
+ * The caches of a cached k-d tree, an open addressing hash table keyed
+ * by the target scan, together with the nodes of the tree by index.
+ **/
+class KDCacheTable {
+public:
+  vector<KDtree_cache*> nodes;
+  KDCache slot[KDCACHE_SLOTS];
+};
 
+#endif
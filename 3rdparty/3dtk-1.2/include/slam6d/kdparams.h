@@ -33,9 +33,45 @@ public:
   double *p;
 
   /** 
-   * expand to 128 bytes to avoid false-sharing, 16 bytes from above + 28*4 bytes = 128 bytes
+   * number of nodes visited by the search, counted with WITH_INSTRUMENTATION
    */
-  int padding[28];
+  unsigned int visited;
+
+  /** 
+   * expand to 128 bytes to avoid false-sharing, 20 bytes from above + 27*4 bytes = 128 bytes
+   */
+  int padding[27];
+};
+
+/**
+ * @brief Contains the intermediate values of a search for the k closest points
+ *
+ * Unlike KDParams it is kept by the searching thread itself, so the
+ * search needs no thread number and may run alongside other searches.
+ **/
+class KDKnnParams
+{
+public:
+  double *p;           ///< the query point
+  int k;               ///< number of points searched for
+  int found;           ///< number of points found so far, at most k
+  double **closest;    ///< the points found so far, closest first
+  double *closest_d2;  ///< their squared distances
+  double maxdist2;     ///< squared distance a point has to beat to be inserted
+
+  /**
+   * Inserts a point closer than maxdist2, dropping the k+1-th
+   */
+  inline void insert(double *q, double d2) {
+    int i = (found < k) ? found++ : k - 1;
+    for (; i > 0 && closest_d2[i-1] > d2; i--) {
+      closest[i] = closest[i-1];
+      closest_d2[i] = closest_d2[i-1];
+    }
+    closest[i] = q;
+    closest_d2[i] = d2;
+    if (found == k) maxdist2 = closest_d2[k-1];
+  }
 };
 
 #endif
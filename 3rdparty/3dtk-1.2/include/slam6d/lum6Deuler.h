@@ -12,6 +12,10 @@
 
 #include <vector>
 using std::vector;
+#include <map>
+using std::map;
+#include <utility>
+using std::pair;
 
 #include "graphSlam6D.h"
 
@@ -19,6 +23,27 @@ using std::vector;
 
 typedef vector <PtPair> vPtPair;  ///< just a typedef: vPtPair = vector of type PtPair
 
+/**
+ * @brief The constraint of a link as computed from its point pairs,
+ * reused by the iterations that update the pose graph only.
+ */
+struct lumConstraint {
+  /// inverse covariance of the pose difference, see covarianceEuler
+  NEWMAT::Matrix C;
+  /// pose of the second scan relative to the first one the point pairs agree on
+  double relative[16];
+  /// transformations of the scans when the point pairs were found
+  double transMat[2][16];
+  /// positions of the scans when the point pairs were found
+  double rPos[2][3];
+  /// largest distance of a reduced point to the position of its scan
+  double radius[2];
+  /// false until the constraint was computed from points
+  bool valid;
+
+  lumConstraint() : valid(false) {};
+};
+
 
 /*
  * @brief Representation of 3D scan matching with Lu/Milios in 6D.
@@ -33,7 +58,7 @@ public:
   /**
    * Constructor (default)
    */
-  lum6DEuler() {};
+  lum6DEuler() : refreshDist(-1.0) {};
   lum6DEuler(icp6Dminimizer *my_icp6Dminimizer,
 		   double mdm = 25.0,
 		   double max_dist_match = 25.0,
@@ -53,9 +78,24 @@ public:
 
   static void covarianceEuler(Scan *first, Scan *second, int nns_method,
 						int rnd, double max_dist_match2, NEWMAT::Matrix *C, NEWMAT::ColumnVector *CD=0);
+
+  void set_refreshDist(double refreshDist);
   
 private:
   void FillGB3D(Graph *gr, GraphMatrix *G, NEWMAT::ColumnVector* B, vector <Scan *> allScans);
+  bool linkConstraint(Scan *first, Scan *second, lumConstraint *constraint,
+				  NEWMAT::Matrix *C, NEWMAT::ColumnVector *CD);
+
+  /**
+   * the constraints of a link are only computed from the point pairs
+   * again if a scan moved by more than this, negative for always
+   */
+  double refreshDist;
+
+  /**
+   * the constraints of the links, by their scans
+   */
+  map< pair<Scan*, Scan*>, lumConstraint > constraints;
 //  void CalculateLinks3D(int numLinks, vPtPair **ptpairs, vector <ColumnVector >* CD , vector <NEWMAT::Matrix>* C);
     
 };
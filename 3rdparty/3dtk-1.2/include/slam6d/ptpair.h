@@ -35,5 +35,31 @@ public:
         p2;  ///< The two points forming the pair
 };
 
+/**
+ * @brief The linear system of point to plane pairs
+ *
+ * Instead of storing the pairs, every pair of a point q of the moving
+ * scan and a point p with normal n of the model adds its row of the
+ * linearised point to plane error ((R (q - c) + c + t - p) * n)^2 to the
+ * 6x6 normal equations. The rotation is taken about the center c, the
+ * position of the moving scan, to keep the system well conditioned.
+ * The unknowns are the small rotation angles about x, y, z followed by
+ * the translation.
+ */
+class PtPlaneSystem {
+public:
+  inline PtPlaneSystem();
+
+  inline void clear(const double *center);
+  inline void add(const double *p, const double *n, const double *q);
+  inline void add(const PtPlaneSystem &other);
+
+  double A[6][6];     ///< upper triangle of the normal matrix
+  double b[6];        ///< right hand side
+  double sum;         ///< sum of the squared point to plane distances
+  unsigned int n;     ///< number of pairs
+  double center[3];   ///< center of the rotation
+};
+
 #include "ptpair.icc"
 #endif
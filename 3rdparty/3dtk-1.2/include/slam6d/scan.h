@@ -18,6 +18,8 @@
 using std::string;
 #include <vector>
 using std::vector;
+#include <list>
+using std::list;
 #include <sstream>
 using std::stringstream;
 
@@ -55,6 +57,8 @@ public:
   Scan(const double *euler, int maxDist = -1);
   Scan(const double rPos[3], const double rPosTheta[3], int maxDist = -1);
   Scan(const double _rPos[3], const double _rPosTheta[3], vector<double *> &pts);
+  Scan(const double *euler, const float *xyz, unsigned int n, unsigned int stride,
+       int maxDist = -1, int minDist = -1);
   Scan(const vector < Scan* >& MetaScan, int nns_method, bool cuda_enabled);
   Scan(const Scan& s);
 
@@ -86,10 +90,16 @@ public:
 				   const AlgoType type, int islum = 0);
   
   void toGlobal(double voxelSize, int nrpts);
+  void prepareSearch(double voxelSize, int nrpts, int nns_method, bool cuda_enabled,
+                     int pyramid_levels = 1, const string &cacheFile = "");
+  void finishSearch(int nns_method, bool cuda_enabled);
   void calcReducedPoints(double voxelSize, int nrpts = 0);
+  void calcPyramid(int levels, double voxelSize, int nrpts);
+  Scan* copyReduced() const;
   void trim(double top, double bottom);
   
   void createTree(int nns_method, bool cuda_enabled);
+  void calcNormals(int k = 10);
   static void createTrees(int nns_method, bool cuda_enabled);
   static void deleteTrees();
 
@@ -115,11 +125,23 @@ public:
 						   int rnd, double max_dist_match2,
 						   double *sum,
 						   double centroid_m[OPENMP_NUM_THREADS][3], double centroid_d[OPENMP_NUM_THREADS][3]);
+  static void getPtPlaneSystem(PtPlaneSystem &system,
+                               Scan* Source, Scan* Target,
+                               int thread_num, unsigned int startindex, unsigned int endindex,
+                               int rnd, double max_dist_match2);
+  static int countPairs(Scan* Source, Scan* Target,
+                        int thread_num, int rnd,
+                        double max_dist_match2, int threshold);
+  static void countPairs(Scan* Source, const vector <Scan*> &Targets,
+                         int thread_num, int rnd,
+                         double max_dist_match2, int threshold,
+                         vector <int> &counts);
    
   inline friend ostream& operator<<(ostream& os, const Scan& s); 
   inline friend ostream& operator<<(ostream& os, const double matrix[16]);
 
   inline int get_points_red_size() const;
+  inline int get_fileNr() const;
 
   inline void resetPose();
   
@@ -138,6 +160,30 @@ public:
    */  
   static string dir;
 
+  /**
+   * Directory of the cache of reduced scans, see readScansRedSearch.
+   * Empty if no cache is used.
+   */
+  static string cacheDir;
+
+  /**
+   * Memory for the reduced points and search trees of all scans in bytes,
+   * 0 for no limit. Beyond it, the least recently used scans are swapped
+   * out to swapFileName and read back on their next use, see acquire.
+   * Has to be set before the search trees are built.
+   */
+  static size_t maxResidentMemory;
+
+  /**
+   * The file the scans are swapped out to, see maxResidentMemory. If
+   * empty, a temporary file is used.
+   */
+  static string swapFileName;
+
+  static void acquire(const Scan *scan);
+  static void release(const Scan *scan);
+  static void prefetch(const Scan *scan);
+
   static bool toType(const char* string, reader_type &type);
 
   static void readScans(reader_type type,
@@ -147,7 +193,8 @@ public:
                            int start, int end, const string &dir, int maxDist, int minDist,
 						   double voxelSize, int nrpts, // reduction parameters
 						   int nns_method, bool cuda_enabled, 
-						   bool openFileForWriting = false);  
+						   bool openFileForWriting = false,
+						   int pyramid_levels = 1);  
   inline const vector <Point>* get_points() const;
   inline double* const* get_points_red() const;
   inline void setPoints(vector <Point> *_points);
@@ -155,15 +202,19 @@ public:
 
   inline void clearPoints();
 
+  inline int get_pyramid_size() const;
+  inline Scan* get_pyramid_level(int level);
+
   //FIXME
   inline const ANNkd_tree* getANNTree() const;
   inline const double* getDAlign() const;
   inline const double* getDAlign_inv() const;
   inline double** get_org_points_red() const;
 
-private:
-
-
+  /**
+   * Loads the shared library of a scan format. readScans returns the
+   * points of one scan per call, without creating Scan objects.
+   */
   class scanIOwrapper : public ScanIO {
     public:
 
@@ -221,6 +272,13 @@ private:
    */
   vector <Scan *> meta_parts;
 
+  /**
+   * Coarser reduction levels of this scan, each with its own points_red and
+   * search tree. Entry i is reduced with 2^(i+1) times the voxel size of this
+   * scan. The levels are transformed together with the scan.
+   */
+  vector <Scan *> pyramid;
+
   /**
    * Array for storing reduced points. In case there is no reduction the points will
    * be copied. All transformations are applied only to this array, sving a lot of
@@ -262,9 +320,18 @@ private:
    * ATTENTION: points_red is NOT a vector of "Points", an array of "double*" instead,
    * since this data structure is necessary in later functions; storing a vector<Points>
    * here would mean too many conversions, therefore loss of speed for LUM.
+   *
+   * Every point is followed by its normal, see calcNormals. The search tree
+   * reorders the array, so the normal of a closest point is found only
+   * through the point itself.
    */
   double** points_red_lum;
 
+  /**
+   * Whether the normals in points_red_lum have been computed
+   */
+  volatile bool normals_red;
+
   /**
    * The treeTransMat_inv holds the current transformation of a 3D scan that is stored 
    * in a search tree. 
@@ -313,6 +380,33 @@ private:
   int maxDist2;
 
   void deleteTree();
+  void buildTree();
+
+  /**
+   * State of the scan with regard to the swap file, see maxResidentMemory
+   */
+  struct SwapState {
+    SwapState() : swapped(false), listed(false), treeStored(false),
+                  pins(0), bytes(0), offset(-1), length(0) {}
+    bool swapped;     ///< the reduced points and the search tree are in the swap file
+    bool listed;      ///< the scan is in the list of resident scans
+    bool treeStored;  ///< the swap file holds the current search tree
+    int pins;         ///< number of acquire calls not released yet
+    size_t bytes;     ///< memory of the reduced points and the search tree
+    long long offset; ///< position of the scan in the swap file, -1 for none
+    long long length; ///< bytes of the scan in the swap file
+    double xf[16];    ///< transformation of the scan while swapped out
+    list<Scan *>::iterator entry;  ///< position in the list of resident scans
+  } swapState;
+
+  void listResident();
+  void unlistResident();
+  void swapOut();
+  void swapIn();
+  static void evict(const Scan *keep);
+
+  static Scan* readCache(const string &filename, int maxDist);
+  void writeCache(const string &filename) const;
 };
 
 #include "scan.icc"
@@ -66,6 +66,35 @@ public:
    */
   virtual double *FindClosest(double *_p, double maxdist2, int threadNum = 0) = 0;
 
+  /**
+   * Tests whether the query point has a closest point within maxdist2,
+   * as countPairs needs it. Searches with FindClosest unless a search
+   * tree knows a cheaper way.
+   *
+   * @param _p Pointer to query point
+   * @param maxdist2 Maximal distance for closest points
+   * @param threadNum If parallel threads share the search tree the thread num must be given
+   * @return true if there is a closest point
+   */
+  virtual bool HasClosest(double *_p, double maxdist2, int threadNum = 0) {
+    return FindClosest(_p, maxdist2, threadNum) != 0;
+  }
+
+  /**
+   * Finds the k closest points of the query point within maxdist2.
+   * Unlike FindClosest it uses no thread slot, so it may run alongside
+   * other searches. Not every search tree implements it.
+   *
+   * @param _p Pointer to query point
+   * @param k Number of points to search for
+   * @param maxdist2 Maximal distance for closest points
+   * @param closest receives the pointers to the points found, closest first
+   * @param closest_d2 receives their squared distances
+   * @return the number of points found, at most k
+   */
+  virtual int FindKClosest(double *_p, int k, double maxdist2,
+                           double **closest, double *closest_d2);
+
   
   virtual void getPtPairs(vector <PtPair> *pairs, 
 				  double *source_alignxf, 
@@ -75,6 +104,51 @@ public:
 				  double *centroid_m, double *centroid_d,
           Scan *Target);
 
+  /**
+   * Counts the query points that have a closest point within
+   * max_dist_match2, without storing any point pairs. The query points
+   * are selected like in getPtPairs, so the count is the number of pairs
+   * getPtPairs would find, but the counting stops as soon as threshold
+   * is reached or cannot be reached anymore with the remaining query
+   * points. The closest points are looked up with HasClosest.
+   *
+   * @param source_alignxf Transformation of the tree since its creation
+   * @param q_points The query points
+   * @param startindex Index of the first query point
+   * @param nr_qpts Index behind the last query point
+   * @param thread_num If parallel threads share the search tree the thread num must be given
+   * @param rnd randomized point selection
+   * @param max_dist_match2 Maximal distance for closest points
+   * @param threshold Number of pairs that suffices
+   * @param Target The scan of the query points
+   * @return The number of pairs found, at most threshold
+   */
+  int countPairs(double *source_alignxf,
+          double * const *q_points, unsigned int startindex, unsigned int nr_qpts,
+          int thread_num, int rnd, double max_dist_match2, int threshold,
+          Scan *Target = 0);
+
+  /**
+   * Adds the point to plane pairs of the query points to a linear system
+   * instead of storing them. The points of the tree carry their normal
+   * behind their coordinates, see Scan::calcNormals.
+   *
+   * @param system The system the pairs are added to
+   * @param source_alignxf Transformation of the tree since its creation
+   * @param q_points The query points
+   * @param startindex Index of the first query point
+   * @param nr_qpts Index behind the last query point
+   * @param thread_num If parallel threads share the search tree the thread num must be given
+   * @param rnd randomized point selection
+   * @param max_dist_match2 Maximal distance for closest points
+   * @param Target The scan of the query points
+   */
+  virtual void getPtPlaneSystem(PtPlaneSystem &system,
+          double *source_alignxf,
+          double * const *q_points, unsigned int startindex, unsigned int nr_qpts,
+          int thread_num, int rnd, double max_dist_match2,
+          Scan *Target);
+
 };
 
 
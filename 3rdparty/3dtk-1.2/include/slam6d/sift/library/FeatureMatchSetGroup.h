@@ -9,9 +9,20 @@
 #define __FEATURE_MATCH_SET_GROUP_H__
 
 #include <list>
+#include <fstream>
 #include "FeatureMatchSet.h"
 
-class FeatureMatchSetGroup
+/**
+ * @brief Receives FeatureMatchSets one at a time, e.g. while they are matched
+ */
+class FeatureMatchSetConsumer
+{
+ public:
+  virtual ~FeatureMatchSetConsumer() {}
+  virtual void consume(FeatureMatchSet &set) = 0;
+};
+
+class FeatureMatchSetGroup : public FeatureMatchSetConsumer
 {
  public:
   FeatureMatchSetGroup();
@@ -19,9 +30,41 @@ class FeatureMatchSetGroup
   
   void serialize(const char * filename);
   FeatureMatchSetGroup(const char * filename);
+
+  /** appends the set to matchsets */
+  void consume(FeatureMatchSet &set);
+
+  /**
+   * Reads a serialized group one set at a time and passes the sets on
+   * without keeping them in memory
+   */
+  static void stream(const char * filename, FeatureMatchSetConsumer &consumer);
   
   std::list<FeatureMatchSet> matchsets;
 };
 
+/**
+ * @brief Serializes a FeatureMatchSetGroup one set at a time
+ *
+ * Every set is written as soon as it is consumed and the count at the
+ * start of the file is updated, so the file is a complete group after
+ * every set.
+ */
+class FeatureMatchSetWriter : public FeatureMatchSetConsumer
+{
+ public:
+  FeatureMatchSetWriter(const char * filename);
+  virtual ~FeatureMatchSetWriter();
+
+  void consume(FeatureMatchSet &set);
+  void close();
+
+  inline int size() const { return length; }
+
+ private:
+  std::ofstream out;
+  int length;
+};
+
 #endif /* __FEATURE_MATCH_SET_GROUP_H__ */
 
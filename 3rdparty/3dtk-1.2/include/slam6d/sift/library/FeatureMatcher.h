@@ -0,0 +1,80 @@
+/**
+ * @file FeatureMatcher.h
+ * @brief Matches the sift features of all pairs of scans in parallel
+ */
+#ifndef __FEATURE_MATCHER_H__
+#define __FEATURE_MATCHER_H__
+
+#include <vector>
+#include "Coord.h"
+#include "Feature.h"
+#include "FeatureMatchSetGroup.h"
+
+// from autopano-sift-c_modified/AutoPanoSift.h, which defines bool, min,
+// max and abs as macros and is only included by the implementation
+struct ArrayList;
+struct KDTree;
+struct KeypointN;
+
+/**
+ * @brief Pairwise matching of keysets
+ *
+ * Every keyset gets its own k-d tree, built once. The keypoints of the
+ * first scan of a pair are looked up in the tree of the second scan
+ * with a best bin first search and kept if the nearest neighbour is
+ * clearly better than the second nearest (Lowe's ratio test). The pairs
+ * are matched in parallel, every finished pair is handed to the consumer
+ * right away, so the results can be written or registered while the
+ * remaining pairs are still being matched.
+ *
+ * If positions of the scans are known, e.g. from odometry or GPS, only
+ * pairs that are closer than a maximal distance are matched.
+ */
+class FeatureMatcher
+{
+ public:
+  /**
+   * @param keysets the KeypointXMLList of every scan, as loaded by MultiMatch_LoadKeysets.
+   *        The keysets are not copied and have to outlive the matcher.
+   */
+  FeatureMatcher(ArrayList *keysets);
+  virtual ~FeatureMatcher();
+
+  /**
+   * Restricts matching to pairs of scans closer than maxDistance
+   *
+   * @param positions the position of every scan, in the order of the keysets
+   * @param maxDistance the maximal distance of two scans that are matched
+   */
+  void setPositions(const std::vector<Coord> &positions, double maxDistance);
+
+  /**
+   * Matches all candidate pairs and passes every pair with enough matches
+   * to the consumer. The consumer is called by one thread at a time.
+   *
+   * @param consumer receives the FeatureMatchSets
+   * @param minimumMatches pairs with fewer matches are dropped
+   * @param bestMatches keep only the best matches of every pair, 0 keeps all
+   * @return the number of FeatureMatchSets passed to the consumer
+   */
+  int match(FeatureMatchSetConsumer &consumer, int minimumMatches = 3, int bestMatches = 0);
+
+  /** Converts an autopano keypoint into a Feature */
+  static Feature getFeature(KeypointN *p);
+
+  /** number of tree nodes visited by the best bin first search */
+  int searchDepth;
+  /** maximal ratio of the distances to the nearest and second nearest neighbour */
+  double ratio;
+
+ private:
+  bool isCandidate(int first, int second);
+  bool matchPair(int first, int second, int minimumMatches, int bestMatches, FeatureMatchSet &set);
+
+  ArrayList *keysets;
+  std::vector<KDTree*> trees;
+  std::vector<Coord> positions;
+  double maxDistance;
+};
+
+#endif /* __FEATURE_MATCHER_H__ */
@@ -11,6 +11,7 @@
 #include "SuperPixel.h"
 #include "PolarPointCloud.h"
 #include <string>
+#include <iostream>
 
 //for creating panorama images
 #define RANGE 1
@@ -35,7 +36,15 @@ class PanoramaMap
   PanoramaMap();
   
   void serialize(const char* filename);
+  void serialize(std::ostream &out);
+  void deserialize(std::istream &in);
   void toJpeg(std::string filename, int method);
+
+  //the cache holds a serialized map together with the size and modification
+  //time of the scan file and the parameters it was created with
+  //readCache returns false if the cache is missing or the scan or any parameter changed
+  bool readCache(const char* cachefile, const char* scanfile, int width, int height, int method, double panninid, int imagen, double stereor);
+  void writeCache(const char* cachefile, const char* scanfile, double panninid, int imagen, double stereor);
   
   virtual ~PanoramaMap();
   
@@ -21,13 +21,26 @@ enum MODE
   MAXIMUM
 };
 
-class Register
+class Register : public FeatureMatchSetConsumer
 {
  public:
+  /**
+   * @param group the match sets registered by registerScans, may be NULL
+   *        if the sets are passed to consume instead
+   */
   Register (FeatureMatchSetGroup *group, std::vector<PanoramaMap*> &maps);
   virtual ~Register () {}
   
   void registerScans();
+
+  /**
+   * Registers one pair of scans and adds it to the connected components,
+   * the sets can be passed while they are matched or read
+   */
+  void consume(FeatureMatchSet &set);
+
+  /** Prints the components and writes the .frames and .dat file of every scan */
+  void writeComponents();
   
   bool registerSet(FeatureMatchSet *set, PanoramaMap *map1, PanoramaMap *map2, double trans[][4]);
   inline void processTrianglePair(FeatureMatchSet *set, PanoramaMap *map1, PanoramaMap *map2,
@@ -55,5 +68,8 @@ class Register
   
   FeatureMatchSetGroup *group;
   std::map<std::string, PanoramaMap *> maps;
+
+  /** the scans registered so far, grouped in connected components */
+  std::list< std::list<ScanTransform> > components;
 };
 #endif /* __REGISTER_H__ */
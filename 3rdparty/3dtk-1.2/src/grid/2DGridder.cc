@@ -58,7 +58,7 @@ void usage(char* prog)
 	 << "Usage: " << prog << endl
 	 << "       [-s NR] [-e NR] [-m NR] [-M NR] [-f F] [-o DIR] [-t] " << endl
 	 << "       [-h NR] [-H NR] [-r NR] [-w] [-p NR] [-P Nr] [-y] [-n] " <<endl
-	 << "       [-g] [-d] [-l] [-a NR] inputdirectory" << endl << endl;
+	 << "       [-g] [-d] [-l] [-a NR] [-b NR] inputdirectory" << endl << endl;
     
     cout << "  -s NR   start at scan NR (i.e., neglects the first NR scans)" << endl
 	 << "          [ATTENTION: counting starts with 0]" << endl
@@ -95,6 +95,8 @@ void usage(char* prog)
 	 << "  -c      default 50. This is the numbers of scans which " << endl
 	 << "          will be process at a time" << endl
 	 << "  -R      default false, if set the programm will resume " << endl
+	 << "  -b NR   memory budget of the parcels kept in memory in MB" << endl
+	 << "          (default " << PARCELBUDGET << ")" << endl
 	 << endl << endl;
 
     exit(1);
@@ -140,6 +142,7 @@ bool directoryExists(const string path )
  * @param parcel_width the width of the parcel
  * @param parcel_height the height of the parcel
  * @param correctY default true, if set false (if true the transformationmatrix of the scans will be corrected (the value for Y)
+ * @param budget memory budget of the parcels in MB
  * @return 0, if the parsing was successful, 1 otherwise 
  */
 int parseArgs(int argc, char **argv,
@@ -151,7 +154,7 @@ int parseArgs(int argc, char **argv,
 	      int &parcelWidth, int &parcelHeight,
 	      bool &writeWorld, bool &writeLines, bool &writeGrids,
 	      int &spotradius, bool &writeWorldppm, int& count,
-	      bool &resume)
+	      bool &resume, int &budget)
 {
     int  c;
     
@@ -160,7 +163,7 @@ int parseArgs(int argc, char **argv,
     extern int optind;
     
     cout << endl;
-    while ((c = getopt (argc, argv, "o:s:a:e:m:ncwgidlRM:h:H:f:r:p:P:yt")) != -1)
+    while ((c = getopt (argc, argv, "o:s:a:e:m:ncwgidlRM:h:H:f:r:p:P:ytb:")) != -1)
     {
       switch (c)
       {
@@ -199,6 +202,13 @@ int parseArgs(int argc, char **argv,
         case 'R':
           resume = true;
           break;
+        case 'b':
+          budget = atoi(optarg);
+          if (budget < 1) {
+            cerr << "Error: <budget> must be at least 1 MB.\n";
+            exit(1);
+          }
+          break;
         case 'm':
           maxDist = atoi(optarg);
           break;
@@ -347,6 +357,7 @@ int main(int argc, char **argv){
     double isSolidPoint = 0.2;
     int count = 50;
     bool resume = false;
+    int budget = PARCELBUDGET;
     ///////////////////////////////////////
 
 
@@ -358,7 +369,7 @@ int main(int argc, char **argv){
 	      createWaypoints, createNeighbours,
 	      parcelWidth, parcelHeight,
 	      writeWorld, writeLines, writeGrids, spotradius, writeWorldppm,
-	      count, resume);
+	      count, resume, budget);
 
     // calculate parcel width and height
     parcelWidth /= resolution;
@@ -367,7 +378,7 @@ int main(int argc, char **argv){
     // create parcelmanager
     cout << "Create parcelmanager ..." << endl;
     parcelmanager parcelman(parcelWidth, parcelHeight,
-			    outputdir, resolution, resume);
+			    outputdir, resolution, resume, budget);
 
     cout << "Create viewpointlist ... " << endl;
     viewpointinfo viewpoint(outputdir);
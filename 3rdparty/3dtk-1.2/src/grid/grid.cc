@@ -2,10 +2,11 @@
 
 #include "grid/grid.h"
 #include <cstdlib>
+#include <algorithm>
 
 /**
  * CTor.
- * Allocates an array of gridPoints
+ * Allocates the counter arrays
  * and sets the offsets and sizes
  *
  * @param offsetX the x-offest of the array
@@ -21,24 +22,13 @@ grid::grid(long offsetX, long offsetZ, long sizeX, long sizeZ)
 	exit(1);
     }
  
-    points = NULL;
+    this->counts = NULL;
+    this->occupieds = NULL;
 
-    // Allocate array
-    this->points = new gridPoint**[sizeX];
-
-    for(int i=0; i < sizeX; ++i)
-    {
-        this->points[i] = new gridPoint*[sizeZ];
-        for(int j=0; j < sizeZ; ++j)
-        {
-            this->points[i][j] = new gridPoint(offsetX + i, offsetZ + j);       
-        }
-    }
-    
     this->offsetX = offsetX;
     this->offsetZ = offsetZ;
-    this->sizeX = sizeX;
-    this->sizeZ = sizeZ;
+
+    allocate(sizeX, sizeZ);
 }
 
 /**
@@ -49,28 +39,40 @@ grid::~grid()
     clear();
 }
 
+/**
+ * Allocates both counter arrays as one contiguous block each
+ * and sets all counters to 0
+ *
+ * @param sizeX the x-size of the array
+ * @param sizeZ the z-size of the array
+ */
+void grid::allocate(long sizeX, long sizeZ)
+{
+    clear();
+
+    this->sizeX = sizeX;
+    this->sizeZ = sizeZ;
+
+    long size = sizeX * sizeZ;
+    this->counts = new unsigned int[size];
+    this->occupieds = new unsigned int[size];
+    std::fill(this->counts, this->counts + size, 0u);
+    std::fill(this->occupieds, this->occupieds + size, 0u);
+}
+
 /**
  * Frees the memory if array is set
  */
 void grid::clear()
 {
-    if(this->points == NULL)
+    if(this->counts == NULL)
         return;
 
-    // delete all points
-    for(int i=0; i < getSizeX(); ++i)
-    {
-        for(int j=0; j < getSizeZ(); ++j)
-        {
-            delete this->points[i][j];      
-        }
-        
-        delete[] this->points[i];
-    }
-
-    delete[] this->points;
+    delete[] this->counts;
+    delete[] this->occupieds;
 
-    this->points = NULL;
+    this->counts = NULL;
+    this->occupieds = NULL;
 }
 
 /**
@@ -83,17 +85,16 @@ void grid::clear()
  */
 void grid::addPoint(long x, long z, unsigned int count, unsigned int occupied)
 {
-    if(this->points == NULL)
+    if(this->counts == NULL)
     {
 	std::cerr << "ERROR: In grid::addPoint, allocate never called!" << std::endl;
 	exit(1);
     }
 
-    // get the absolute gridPoint 
-    gridPoint *p = getAbsolutePoint(x, z);
-
-    // increase counters 
-    p->addCount(count, occupied);
+    // increase counters of the absolute cell
+    long idx = getAbsoluteIndex(x, z);
+    this->counts[idx] += count;
+    this->occupieds[idx] += occupied;
 }
 
 /**
@@ -103,8 +104,7 @@ void grid::addPoint(long x, long z, unsigned int count, unsigned int occupied)
  */
 void grid::addPoint(const gridPoint& point)
 {
-    gridPoint *p = getAbsolutePoint(point.getX(), point.getZ());
-    p->addCount(point.getCount(), point.getOccupied());
+    addPoint(point.getX(), point.getZ(), point.getCount(), point.getOccupied());
 }
 
 /**
@@ -117,20 +117,45 @@ void grid::addPoint(const gridPoint& point)
  */
 void grid::setPoint(long x, long z, unsigned int count, unsigned int occupied)
 {
-    gridPoint* p = getAbsolutePoint(x, z);
-    p->setFixed(count, occupied);
+    long idx = getAbsoluteIndex(x, z);
+    this->counts[idx] = count;
+    this->occupieds[idx] = occupied;
 }
 
 /**
- * Returns point of the absolute coordinates
- * The absolute coordinates get transformed to relative coordinates
+ * Adds the counters of all cells of the other grid to this grid.
+ * Both grids must cover exactly the same area, this is used to
+ * merge grids that were filled independently, e.g. per thread.
+ *
+ * @param other the grid to add
+ */
+void grid::merge(const grid& other)
+{
+    if(other.getOffsetX() != getOffsetX() || other.getOffsetZ() != getOffsetZ() ||
+       other.getSizeX() != getSizeX() || other.getSizeZ() != getSizeZ())
+    {
+	std::cerr << "ERROR: In grid::merge, grids differ in offset or size!" << std::endl;
+	exit(1);
+    }
+
+    long size = getSizeX() * getSizeZ();
+    for(long i = 0; i < size; ++i)
+    {
+	this->counts[i] += other.counts[i];
+	this->occupieds[i] += other.occupieds[i];
+    }
+}
 
+/**
+ * Returns the index of the absolute coordinates within the counter arrays.
+ * The absolute coordinates get transformed to relative coordinates
+ *
  * @param x the absolute x coordinate
  * @param z the absolute z coordinate
  *
- * @return gridPoint* pointer to the found gridPoint
+ * @return index of the cell
  */
-gridPoint* grid::getAbsolutePoint(long x, long z) const
+long grid::getAbsoluteIndex(long x, long z) const
 {
     // Transform to relative coordinates
     x -= getOffsetX();
@@ -143,8 +168,19 @@ gridPoint* grid::getAbsolutePoint(long x, long z) const
 	exit(1);
     }
     
-    return this->points[x][z];
+    return index(x, z);
 }
 
+/**
+ * Returns point of the absolute coordinates
 
- 
+ * @param x the absolute x coordinate
+ * @param z the absolute z coordinate
+ *
+ * @return gridPoint view of the found cell
+ */
+gridPoint grid::getAbsolutePoint(long x, long z) const
+{
+    long idx = getAbsoluteIndex(x, z);
+    return gridPoint(x, z, this->counts[idx], this->occupieds[idx]);
+}
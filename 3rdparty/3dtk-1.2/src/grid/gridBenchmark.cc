@@ -0,0 +1,171 @@
+#include "grid/scanGrid.h"
+#include "grid/scanToGrid.h"
+#include "slam6d/scan.h"
+#include "slam6d/globals.icc"
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using std::cout;
+using std::endl;
+using std::vector;
+
+#ifdef _MSC_VER
+  #include "XGetopt.h"
+#else
+  #include <getopt.h>
+#endif
+
+/**
+ * gridBenchmark
+ *
+ * Measures how many points per second scanToGrid::convert rasterises.
+ * A synthetic city block (four walls around the scanner, some
+ * facade structure and the ground) is created once and converted
+ * several times.
+ *
+ * @date 18.10.2026
+ */
+
+/**
+ * Explains the usage of this program's command line parameters
+ *
+ * @param prog name of the program
+ */
+void usage(char* prog)
+{
+    cout << endl
+	 << "Usage: " << prog << " [-n NR] [-i NR] [-r NR] [-w] [-g]" << endl << endl;
+
+    cout << "  -n NR   number of synthetic points (default 1000000)" << endl
+	 << "  -i NR   number of conversions to average over (default 5)" << endl
+	 << "  -r NR   the width of the gridunit (default 10 units)" << endl
+	 << "  -w      do not create waypoints" << endl
+	 << "  -g      do not weight neighbours" << endl
+	 << endl;
+
+    exit(1);
+}
+
+/**
+ * Creates the points of a synthetic city block around the origin.
+ * The block is 100 m wide, its walls are up to 20 m high and carry
+ * a simple facade pattern. A third of the points lie on the ground.
+ *
+ * @param nrPoints number of points to create
+ * @param xyz receives the coordinates, three floats per point
+ */
+void createCityBlock(int nrPoints, vector<float>& xyz)
+{
+    const float half = 5000.0;
+
+    srand(0);
+    xyz.resize(3 * nrPoints);
+    for(int i = 0; i < nrPoints; ++i)
+    {
+	float u = (float)rand() / RAND_MAX;
+	float v = (float)rand() / RAND_MAX;
+	float x, y, z;
+
+	if(i % 3 == 0)
+	{
+	    // ground
+	    x = (2 * u - 1) * half;
+	    y = 0;
+	    z = (2 * v - 1) * half;
+	}
+	else
+	{
+	    // one of the four walls, with 50 cm deep window recesses
+	    float along = (2 * u - 1) * half;
+	    float depth = half - ((int)(along / 300) % 2 == 0 ? 0 : 50);
+	    y = v * 2000.0;
+	    switch(i % 4)
+	    {
+	    case 0:  x = along;  z = depth;  break;
+	    case 1:  x = along;  z = -depth; break;
+	    case 2:  x = depth;  z = along;  break;
+	    default: x = -depth; z = along;  break;
+	    }
+	}
+
+	xyz[3 * i + 0] = x;
+	xyz[3 * i + 1] = y;
+	xyz[3 * i + 2] = z;
+    }
+}
+
+/**
+ * Main program. Converts the synthetic scan several times and prints
+ * the rasterised points per second and a checksum of the grid.
+ *
+ * @param argc count of the command-line arguments
+ * @param argv command-line arguments
+ */
+int main(int argc, char **argv)
+{
+    int nrPoints = 1000000;
+    int iterations = 5;
+    double resolution = 10;
+    bool createWaypoints = true;
+    bool createNeighbours = true;
+
+    int c;
+    while((c = getopt(argc, argv, "n:i:r:wgh")) != -1)
+    {
+	switch(c)
+	{
+	case 'n': nrPoints = atoi(optarg); break;
+	case 'i': iterations = atoi(optarg); break;
+	case 'r': resolution = atof(optarg); break;
+	case 'w': createWaypoints = false; break;
+	case 'g': createNeighbours = false; break;
+	default:  usage(argv[0]);
+	}
+    }
+
+    if(nrPoints < 1 || iterations < 1 || resolution <= 0)
+	usage(argv[0]);
+
+    vector<float> xyz;
+    createCityBlock(nrPoints, xyz);
+
+    double euler[6] = {0, 0, 0, 0, 0, 0};
+    Scan scan(euler, &xyz[0], nrPoints, 3);
+    double transformation[16];
+    M4identity(transformation);
+
+    scanToGrid stg(resolution, 2, 50, -1, 15,
+		   createWaypoints, createNeighbours);
+
+    cout << "Rasterising " << nrPoints << " points, "
+	 << iterations << " iterations, "
+	 << OPENMP_NUM_THREADS << " thread(s) ..." << endl;
+
+    unsigned long total = 0;
+    unsigned long long checksum = 0;
+    for(int it = 0; it < iterations; ++it)
+    {
+	unsigned long start = GetCurrentTimeInMilliSec();
+	scanGrid *g = stg.convert(scan, transformation);
+	total += GetCurrentTimeInMilliSec() - start;
+
+	checksum = 0;
+	for(long i = 0; i < g->getSizeX(); ++i)
+	    for(long j = 0; j < g->getSizeZ(); ++j)
+	    {
+		gridPoint p = g->getPoint(i, j);
+		checksum += p.getCount() + 3 * (unsigned long long)p.getOccupied();
+	    }
+
+	delete g;
+    }
+
+    double seconds = total / 1000.0 / iterations;
+    cout << "Time per conversion: " << seconds << " s" << endl
+	 << "Points per second:   " << (seconds > 0 ? nrPoints / seconds : 0) << endl
+	 << "Grid checksum:       " << checksum << endl;
+
+    return 0;
+}
@@ -77,10 +77,10 @@ void ppmWriter::write(const grid& grid)
     {
 	for(long j=0; j < grid.getSizeX(); ++j)
 	{
-	    if(grid.points[j][i]->getPercent() < 0)
+	    if(grid.getPoint(j, i).getPercent() < 0)
 		stream << "50 ";
 	    else
-		stream << 100 - (int)(grid.points[j][i]->getPercent() * 100) << " ";
+		stream << 100 - (int)(grid.getPoint(j, i).getPercent() * 100) << " ";
 	}
 	stream << endl;
     }
@@ -117,10 +117,10 @@ void parcelWriter::write(const grid& grid)
 
     for(long i = 0; i < grid.getSizeX(); ++i)
 	for(long j = 0; j < grid.getSizeZ(); j++)
-	    stream << grid.points[i][j]->getX() << " "
-		   << grid.points[i][j]->getZ() << " "
-		   << grid.points[i][j]->getCount() << " "
-		   << grid.points[i][j]->getOccupied() << endl;
+	    stream << grid.getPoint(i, j).getX() << " "
+		   << grid.getPoint(i, j).getZ() << " "
+		   << grid.getPoint(i, j).getCount() << " "
+		   << grid.getPoint(i, j).getOccupied() << endl;
 }
       
 /**
@@ -151,9 +151,9 @@ void gnuplotWriter::write(const grid& grid)
 {
     for(long i=0; i < grid.getSizeX(); ++i)
 	for(long j=0; j < grid.getSizeZ(); ++j)
-	    stream << grid.points[i][j]->getX() << " "
-		   << grid.points[i][j]->getZ() << " "
-		   << grid.points[i][j]->getPercent() << endl;
+	    stream << grid.getPoint(i, j).getX() << " "
+		   << grid.getPoint(i, j).getZ() << " "
+		   << grid.getPoint(i, j).getPercent() << endl;
 }
 
 /**
@@ -212,9 +212,9 @@ void worldWriter::write(const grid& grid)
     {
 	for(int j=0; j < grid.getSizeZ(); ++j)
 	{
-	    stream << grid.points[i][j]->getX() << " " 
-		   << grid.points[i][j]->getZ() << " "
-		   << grid.points[i][j]->getPercent() << endl;
+	    stream << grid.getPoint(i, j).getX() << " " 
+		   << grid.getPoint(i, j).getZ() << " "
+		   << grid.getPoint(i, j).getPercent() << endl;
 	}
     }
 }
@@ -42,9 +42,9 @@ void gridlines::createLines(grid* g, int max_distance)
     for (int i = 0; i < g->getSizeX(); i++) {
         for (int j = 0; j < g->getSizeZ(); j++) { 
 	    //store the point if percentage > ISSOLIDPOINT
-	    if (g->points[i][j]->getPercent() > isSolidPoint) {
-	        x = g->points[i][j]->getX();
-	        z = g->points[i][j]->getZ();
+	    if (g->getPoint(i, j).getPercent() > isSolidPoint) {
+	        x = g->getPoint(i, j).getX();
+	        z = g->getPoint(i, j).getZ();
 
 		vx.push_back(x);
 		vz.push_back(z);
@@ -46,7 +46,7 @@ void parcel::addGrid(const grid* g)
     {
 	for(int j = startZ; j < endZ; j++)
 	{
-	    this->addPoint(*g->getAbsolutePoint(i, j));
+	    this->addPoint(g->getAbsolutePoint(i, j));
 	}
     }
 } 
@@ -81,7 +81,7 @@ parcel* parcel::readParcel(std::string filename)
     infile >> offsetX >> offsetZ;
 
     // Create parcel
-    parcel* p = new parcel(offsetX, offsetZ, sizeX, sizeX);
+    parcel* p = new parcel(offsetX, offsetZ, sizeX, sizeZ);
     
     // Read all information
     long x, z, count, occupied;
@@ -0,0 +1,280 @@
+#include "grid/parcelio.h"
+#include "grid/gridWriter.h"
+
+#include <cstdlib>
+#include <iostream>
+using std::cerr;
+using std::endl;
+using std::deque;
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+
+/**
+ * CTor. Starts the background thread.
+ */
+parcelio::parcelio()
+{
+    this->running = false;
+    this->runningLoad = false;
+    this->runningKey = 0;
+    this->stop = false;
+
+    pthread_mutex_init(&this->mutex, NULL);
+    pthread_cond_init(&this->changed, NULL);
+
+    if(pthread_create(&this->thread, NULL, runThread, (void*)this) != 0)
+    {
+	cerr << "ERROR: In parcelio::parcelio, unable to start the I/O thread!" << endl;
+	exit(1);
+    }
+}
+
+/**
+ * DTor. Executes all queued jobs, stops the thread and frees
+ * all parcels that were loaded but never taken.
+ */
+parcelio::~parcelio()
+{
+    pthread_mutex_lock(&this->mutex);
+    this->stop = true;
+    pthread_cond_broadcast(&this->changed);
+    pthread_mutex_unlock(&this->mutex);
+
+    pthread_join(this->thread, NULL);
+
+    for(map<long long, parcel*>::iterator it = this->done.begin();
+	it != this->done.end(); ++it)
+	delete it->second;
+
+    pthread_cond_destroy(&this->changed);
+    pthread_mutex_destroy(&this->mutex);
+}
+
+/**
+ * Entry point of the background thread
+ *
+ * @param io the parcelio object
+ */
+void* parcelio::runThread(void *io)
+{
+    ((parcelio*)io)->run();
+    return NULL;
+}
+
+/**
+ * Main loop of the background thread. Takes the oldest job,
+ * executes it without holding the lock and publishes the result.
+ */
+void parcelio::run()
+{
+    pthread_mutex_lock(&this->mutex);
+    while(true)
+    {
+	while(this->jobs.empty() && !this->stop)
+	    pthread_cond_wait(&this->changed, &this->mutex);
+
+	if(this->jobs.empty())
+	    break;
+
+	job j = this->jobs.front();
+	this->jobs.pop_front();
+	this->running = true;
+	this->runningLoad = !j.store;
+	this->runningKey = j.key;
+	pthread_mutex_unlock(&this->mutex);
+
+	parcel *p = NULL;
+	if(j.store)
+	{
+	    // Must use parcelFormat, otherwise parcel cant be loaded again!
+	    parcelWriter writer(j.filename);
+	    writer.write(*j.data);
+	    delete j.data;
+	}
+	else
+	{
+	    p = parcel::readParcel(j.filename);
+	}
+
+	pthread_mutex_lock(&this->mutex);
+	if(p != NULL)
+	    this->done[j.key] = p;
+	this->running = false;
+	pthread_cond_broadcast(&this->changed);
+    }
+    pthread_mutex_unlock(&this->mutex);
+}
+
+/**
+ * Returns the queued job of the given parcel.
+ * The mutex must be held by the caller.
+ *
+ * @param key the tile key of the parcel
+ * @return iterator to the job or jobs.end()
+ */
+deque<parcelio::job>::iterator parcelio::findJob(long long key)
+{
+    deque<job>::iterator it = this->jobs.begin();
+    while(it != this->jobs.end() && it->key != key)
+	++it;
+    return it;
+}
+
+/**
+ * Returns true if the background thread is reading the given parcel.
+ * The mutex must be held by the caller.
+ *
+ * @param key the tile key of the parcel
+ * @return true while the parcel is loaded
+ */
+bool parcelio::isLoading(long long key)
+{
+    return this->running && this->runningLoad && this->runningKey == key;
+}
+
+/**
+ * Queues the parcel for writing. The parcel is freed by the
+ * background thread afterwards, so the caller must not use it anymore.
+ *
+ * @param key the tile key of the parcel
+ * @param filename the file to write to
+ * @param data the parcel
+ */
+void parcelio::store(long long key, const string& filename, parcel *data)
+{
+    job j;
+    j.store = true;
+    j.key = key;
+    j.filename = filename;
+    j.data = data;
+
+    pthread_mutex_lock(&this->mutex);
+    this->jobs.push_back(j);
+    pthread_cond_broadcast(&this->changed);
+    pthread_mutex_unlock(&this->mutex);
+}
+
+/**
+ * Queues the parcel for reading, the result can be fetched with
+ * collect() or take(). Nothing happens if the parcel is already
+ * queued, being read or loaded. If its store is still queued, the store is
+ * cancelled and the parcel is moved to the loaded ones directly.
+ *
+ * @param key the tile key of the parcel
+ * @param filename the file to read from
+ */
+void parcelio::load(long long key, const string& filename)
+{
+    pthread_mutex_lock(&this->mutex);
+    deque<job>::iterator it = findJob(key);
+
+    if(it != this->jobs.end() && it->store)
+    {
+	this->done[key] = it->data;
+	this->jobs.erase(it);
+    }
+    else if(it == this->jobs.end() && !isLoading(key) &&
+	    this->done.find(key) == this->done.end())
+    {
+	job j;
+	j.store = false;
+	j.key = key;
+	j.filename = filename;
+	j.data = NULL;
+	this->jobs.push_back(j);
+	pthread_cond_broadcast(&this->changed);
+    }
+    pthread_mutex_unlock(&this->mutex);
+}
+
+/**
+ * Returns the parcel and removes it from the loaded ones.
+ * A queued store is cancelled, a queued or running load is awaited
+ * and otherwise the parcel is read ahead of all prefetches.
+ * The caller owns the returned parcel.
+ *
+ * @param key the tile key of the parcel
+ * @param filename the file to read from
+ * @return the parcel
+ */
+parcel* parcelio::take(long long key, const string& filename)
+{
+    pthread_mutex_lock(&this->mutex);
+
+    deque<job>::iterator it = findJob(key);
+    if(it != this->jobs.end() && it->store)
+    {
+	parcel *p = it->data;
+	this->jobs.erase(it);
+	pthread_mutex_unlock(&this->mutex);
+	return p;
+    }
+
+    if(it != this->jobs.end())
+    {
+	// move a queued prefetch ahead of all others
+	job j = *it;
+	this->jobs.erase(it);
+	this->jobs.push_front(j);
+    }
+    else if(!isLoading(key) && this->done.find(key) == this->done.end())
+    {
+	// a running store of this parcel finishes before the new job starts
+	job j;
+	j.store = false;
+	j.key = key;
+	j.filename = filename;
+	j.data = NULL;
+	this->jobs.push_front(j);
+	pthread_cond_broadcast(&this->changed);
+    }
+
+    map<long long, parcel*>::iterator result;
+    while((result = this->done.find(key)) == this->done.end())
+	pthread_cond_wait(&this->changed, &this->mutex);
+
+    parcel *p = result->second;
+    this->done.erase(result);
+    pthread_mutex_unlock(&this->mutex);
+    return p;
+}
+
+/**
+ * Hands out all parcels loaded in the background so far.
+ * The caller owns the parcels afterwards.
+ *
+ * @param loaded receives the tile keys and parcels
+ */
+void parcelio::collect(vector< pair<long long, parcel*> >& loaded)
+{
+    pthread_mutex_lock(&this->mutex);
+    loaded.insert(loaded.end(), this->done.begin(), this->done.end());
+    this->done.clear();
+    pthread_mutex_unlock(&this->mutex);
+}
+
+/**
+ * Returns the number of queued and running jobs
+ *
+ * @return the number of jobs
+ */
+size_t parcelio::pending()
+{
+    pthread_mutex_lock(&this->mutex);
+    size_t n = this->jobs.size() + (this->running ? 1 : 0);
+    pthread_mutex_unlock(&this->mutex);
+    return n;
+}
+
+/**
+ * Waits until all queued jobs are done
+ */
+void parcelio::flush()
+{
+    pthread_mutex_lock(&this->mutex);
+    while(!this->jobs.empty() || this->running)
+	pthread_cond_wait(&this->changed, &this->mutex);
+    pthread_mutex_unlock(&this->mutex);
+}
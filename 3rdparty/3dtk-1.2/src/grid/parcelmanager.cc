@@ -23,15 +23,17 @@ using std::endl;
  * @param path The path of the files
  * @param resolution The resolution of a cell
  * @param resume If true, last parcelinfofile will be loaded
+ * @param budget Memory budget of the parcels kept in memory (MB)
  */
 parcelmanager::parcelmanager(long width, long height,
 			     string path, int resolution,
-			     bool resume)
+			     bool resume, int budget)
 {
     this->parcelwidth = width;
     this->parcelheight = height;
     this->viewpointX = 0;
     this->viewpointZ = 0;
+    this->hasViewpoint = false;
     this->path = path;
     this->resolution = resolution;
     
@@ -39,6 +41,13 @@ parcelmanager::parcelmanager(long width, long height,
     this->maxX = 0;
     this->minZ = 0;
     this->maxZ = 0;
+
+    // each cell holds two counters
+    double parcelBytes = (double)width * height * 2 * sizeof(unsigned int);
+    this->loaded = 0;
+    this->maxLoaded = (size_t)(budget * 1024.0 * 1024.0 / parcelBytes);
+    if(this->maxLoaded < 1)
+	this->maxLoaded = 1;
     
     parcelinfo::setParcelsize(width, height);
 
@@ -61,44 +70,38 @@ parcelmanager::~parcelmanager()
 }
 
 /**
- * This methods removes all parcels with a not set
- * used-flag (in parcelinfo). They are saved to disk
- * before they are freed.
- * If all is set, all parcels are saved and free regardless
- * of their used-flag
+ * This methods hands the least recently used parcels without a set
+ * used-flag (in parcelinfo) to the I/O thread, which saves them to
+ * disk and frees them, until the memory budget is kept again.
+ * Parcels needed by the current grid are never freed, so the budget
+ * may be exceeded temporarily.
+ * If all is set, all parcels are saved and freed regardless
+ * of their used-flag, and the method waits until they are written.
  *
  * @param all Delete all parcels or not?
  */
 void parcelmanager::freeMemory(bool all)
 {
-    parcelmap::iterator cur = this->parcels.begin();
-    parcelmap::iterator end = this->parcels.end();
-    
-    // iterate through each parcel
-    while(cur != end)
+    collectParcels();
+
+    std::list<long long>::iterator cur = this->lru.end();
+    while(cur != this->lru.begin() && (all || this->loaded > this->maxLoaded))
     {
-	// if parcel is loaded and wasnt used (or all free)
-	if(cur->second != NULL &&
-	   (!cur->first->wasUsed() || all))
-	{	    
-	    // saving the parcel using the parcel format
-            // (Must use parcelFormat, otherwise parcel cant be loaded again!)
-	    string filename = cur->first->getFilename();
-	    parcelWriter writer(filename);
-
-	    writer.write(*cur->second);
-	    
-	    delete cur->second;
-	    cur->second = NULL;
-	    
-	}
-	
-	// reset used-flag of parcelinfo
-	parcelinfo *p = cur->first;
-	p->resetUsed();
-	
-	++cur;
+	--cur;
+	parcelentry &entry = this->parcels[*cur];
+
+	if(!all && entry.info->wasUsed())
+	    continue;
+
+	// saving the parcel using the parcel format
+	this->io.store(*cur, entry.info->getFilename(), entry.data);
+	entry.data = NULL;
+	cur = this->lru.erase(cur);
+	--this->loaded;
     }
+
+    if(all)
+	this->io.flush();
 }
 
 /**
@@ -114,7 +117,7 @@ void parcelmanager::clear()
 
   while(it != end)
   {
-      delete it->first;      
+      delete it->second.info;      
       ++it;
   }
 
@@ -122,55 +125,95 @@ void parcelmanager::clear()
 }
 
 /**
- * The methods loads the parcel specified by info
- * into memory. The method does check, if the 
- * parcel is already loaded, so calling this method
- * on an already loaded parcel does nothing.
+ * The methods returns the parcel of the given entry and marks it
+ * as most recently used. If the parcel is not in memory, it is taken
+ * from the I/O thread, which reads it unless it was prefetched or
+ * is still waiting to be written.
  *
- * @param *info A pointer to the parcelinfo 
+ * @param key The tile key of the parcel
+ * @param entry The entry of the parcel
+ * @return the parcel
  */
-void parcelmanager::loadParcel(parcelinfo* info)
+parcel* parcelmanager::loadParcel(long long key, parcelentry &entry)
 {
-    if(this->parcels[info] == NULL)
-    	this->parcels[info] = parcel::readParcel(info->getFilename());
+    if(entry.data == NULL)
+    {
+	entry.data = this->io.take(key, entry.info->getFilename());
+	this->lru.push_front(key);
+	entry.lru = this->lru.begin();
+	++this->loaded;
+
+	updateOuterPoints(entry.data);
+    }
+    else
+    {
+	this->lru.splice(this->lru.begin(), this->lru, entry.lru);
+    }
 
-    updateOuterPoints(this->parcels[info]);    
+    return entry.data;
 }
 
+/**
+ * The method takes over all parcels the I/O thread has loaded
+ * in the background so far. A parcel whose entry is in memory
+ * already is outdated and dropped.
+ */
+void parcelmanager::collectParcels()
+{
+    std::vector< std::pair<long long, parcel*> > prefetched;
+    this->io.collect(prefetched);
+
+    for(size_t i = 0; i < prefetched.size(); ++i)
+    {
+	parcelentry &entry = this->parcels[prefetched[i].first];
+	if(entry.data != NULL)
+	{
+	    delete prefetched[i].second;
+	    continue;
+	}
+
+	entry.data = prefetched[i].second;
+	this->lru.push_front(prefetched[i].first);
+	entry.lru = this->lru.begin();
+	++this->loaded;
+
+	updateOuterPoints(entry.data);
+    }
+}
 
 /**
- * The method creates a new parcel. It calculates the offset
- * of the new parcel based on the absolute coordinates it is given.
+ * The method creates a new parcel for the given tile.
  * The new parcel is added to the internal map, along with its
  * parcelinfo
  *
- * @param x The absolute x coordinate
- * @param z The absolute z coordinate
+ * @param tileX The x tile coordinate
+ * @param tileZ The z tile coordinate
+ * @return the entry of the new parcel
  */
-void parcelmanager::createParcel(long x, long z)
+parcelmanager::parcelentry& parcelmanager::createParcel(long tileX, long tileZ)
 {
     // calculate offset
-    long offsetX = (long) (x / this->parcelwidth) * this->parcelwidth;
-    if (x < 0) 
-	offsetX = offsetX - this->parcelwidth;
-
-    long offsetZ = (long) (z/ this->parcelheight) * this->parcelheight;
-    if (z < 0)
-	offsetZ = offsetZ - this->parcelheight;
-
+    long offsetX = tileX * this->parcelwidth;
+    long offsetZ = tileZ * this->parcelheight;
 
     // create parcelinfo and parcel
     string filename = this->path + "parcel" + to_string(offsetX) + to_string(offsetZ) + ".pcl";
     
-    parcelinfo *p = new parcelinfo(offsetX, offsetZ, filename);
-    
-    this->parcels[p] = new parcel(offsetX,
-				  offsetZ,
-				  this->parcelwidth,
-				  this->parcelheight);  
+    long long key = tileKey(tileX, tileZ);
+    parcelentry &entry = this->parcels[key];
+    entry.info = new parcelinfo(offsetX, offsetZ, filename);
+    entry.data = new parcel(offsetX,
+			    offsetZ,
+			    this->parcelwidth,
+			    this->parcelheight);  
+    this->lru.push_front(key);
+    entry.lru = this->lru.begin();
+    ++this->loaded;
 
     // update the new borders
-    updateOuterPoints(this->parcels[p]);    
+    updateOuterPoints(entry.data);    
+
+    return entry;
 }
 
 /**
@@ -190,11 +233,49 @@ void parcelmanager::updateOuterPoints(const grid *g)
 	maxZ = g->getOffsetZ() + g->getSizeZ();
 }
 
+/**
+ * The method queues the parcels for loading that the next grid
+ * will probably need. The next grid is expected to cover the area
+ * of the given grid moved by the last step of the viewpoint.
+ * Only existing parcels that are on disk are queued, and only as
+ * long as the memory budget allows.
+ *
+ * @param g The grid which was just added
+ * @param vpX The x-coordiante of the viewpoint
+ * @param vpZ The z-coordinate of the viewpoint
+ */
+void parcelmanager::prefetch(const grid* g, long vpX, long vpZ)
+{
+    long dx = vpX - this->viewpointX;
+    long dz = vpZ - this->viewpointZ;
+
+    if(!this->hasViewpoint || (dx == 0 && dz == 0))
+	return;
+
+    long startX = tileOf(g->getOffsetX() + dx, this->parcelwidth);
+    long endX = tileOf(g->getOffsetX() + g->getSizeX() - 1 + dx, this->parcelwidth);
+    long startZ = tileOf(g->getOffsetZ() + dz, this->parcelheight);
+    long endZ = tileOf(g->getOffsetZ() + g->getSizeZ() - 1 + dz, this->parcelheight);
+
+    size_t budget = this->loaded + this->io.pending();
+    for(long i = startX; i <= endX && budget < this->maxLoaded; ++i)
+    {
+	for(long j = startZ; j <= endZ && budget < this->maxLoaded; ++j)
+	{
+	    parcelmap::iterator it = this->parcels.find(tileKey(i, j));
+	    if(it == this->parcels.end() || it->second.data != NULL)
+		continue;
+
+	    this->io.load(it->first, it->second.info->getFilename());
+	    ++budget;
+	}
+    }
+}
 
 /**
  * The method adds the given grid to the needed parcels.
- * It checks which parcels are affected by the grid, loads them if
- * they already exist or creates new ones.
+ * It looks up the parcels affected by the grid by their tile
+ * coordinates, loads them if they already exist or creates new ones.
  * Afterwards it adds the information of the grid to each relevant
  * parcels
  *
@@ -204,65 +285,56 @@ void parcelmanager::updateOuterPoints(const grid *g)
  */
 void parcelmanager::addGrid(const grid* g, long vpX, long vpZ)
 {
-  bool parcelFound;
- 
-  this->viewpointX = vpX;
-  this->viewpointZ = vpZ;
-  
-  long iSize = g->getOffsetX() + g->getSizeX();
-  long jSize = g->getOffsetZ() + g->getSizeZ();
+  collectParcels();
+
+  long startX = tileOf(g->getOffsetX(), this->parcelwidth);
+  long endX = tileOf(g->getOffsetX() + g->getSizeX() - 1, this->parcelwidth);
+  long startZ = tileOf(g->getOffsetZ(), this->parcelheight);
+  long endZ = tileOf(g->getOffsetZ() + g->getSizeZ() - 1, this->parcelheight);
+
+  std::vector<parcelentry*> needed;
 
-  // iterate through all parcels needed in this grid
-  for(int i=g->getOffsetX() ; i < iSize + this->parcelwidth; i += this->parcelwidth)
+  // get all parcels needed in this grid
+  for(long i = startX; i <= endX; ++i)
   {
-      for(int j=g->getOffsetZ() ; j < jSize + this->parcelheight; j += this->parcelheight)
+      for(long j = startZ; j <= endZ; ++j)
       {
-	  parcelmap::iterator it = this->parcels.begin();
-	  parcelmap::iterator end = this->parcels.end();
-      
-	  parcelFound = false;
+	  long long key = tileKey(i, j);
+	  parcelmap::iterator it = this->parcels.find(key);
 
-	  // for each point, iterate through the existing parcels
-	  while(it != end)
+	  // if parcel was not found, create new
+	  parcelentry *entry;
+	  if(it == this->parcels.end())
 	  {
-	      // parcel contains point
-	      if(it->first->contains(i, j))
-	      {
-		  // load Parcel if not in memory
-		  if(it->second == NULL)
-		      loadParcel(it->first);
-		  
-		  // reset the counter
-		  it->first->setUsed();
-		  parcelFound = true;
-	      }	
-
-	      ++it;
+	      entry = &createParcel(i, j);
 	  }
-	  
-	  // if parcel was not found, create new
-	  if(parcelFound == false)
-	      createParcel(i, j);
+	  else
+	  {
+	      entry = &it->second;
+	      loadParcel(key, *entry);
+	  }
+
+	  entry->info->setUsed();
+	  needed.push_back(entry);
       }
   }
 
-  // remove all parcels not needed for the scan
-  freeMemory(false); 
-
-  
-  // Call addGrid for each parcel in memory
   // The parcel only integrates the points which are
   // relevant to it 
-  parcelmap::iterator it = this->parcels.begin();
-  parcelmap::iterator end = this->parcels.end();
-  
-  while(it != end)
-  {
-      if(it->second != NULL)
-	  it->second->addGrid(g);
+  for(size_t k = 0; k < needed.size(); ++k)
+      needed[k]->data->addGrid(g);
 
-      ++it;
-  }
+  prefetch(g, vpX, vpZ);
+
+  this->viewpointX = vpX;
+  this->viewpointZ = vpZ;
+  this->hasViewpoint = true;
+
+  // remove parcels not needed for the scan if over budget
+  freeMemory(false); 
+
+  for(size_t k = 0; k < needed.size(); ++k)
+      needed[k]->info->resetUsed();
 }
 
 
@@ -292,9 +364,9 @@ void parcelmanager::saveParcelinfo(string filename)
   
   while(it != end)
   {
-       outfile << it->first->getOffsetX() << " " 
-	       << it->first->getOffsetZ() << " " 
-	       << it->first->getFilename() << endl; 
+       outfile << it->second.info->getOffsetX() << " " 
+	       << it->second.info->getOffsetZ() << " " 
+	       << it->second.info->getFilename() << endl; 
 
         ++it;
   }
@@ -336,8 +408,11 @@ void parcelmanager::loadParcelinfo(string filename)
     infile >> file;
     if(infile.eof()) continue;
 
-    parcelinfo *p = new parcelinfo(offsetX, offsetZ, file);
-    this->parcels[p] = NULL;
+    parcelentry &entry = this->parcels[tileKey(tileOf(offsetX, this->parcelwidth),
+					       tileOf(offsetZ, this->parcelheight))];
+    entry.info = new parcelinfo(offsetX, offsetZ, file);
+    entry.data = NULL;
+    entry.info->resetUsed();
   }
 
   infile.close();
@@ -366,10 +441,10 @@ void parcelmanager::writeWorld(string file)
     
     while(it != end)
     {
-	if(it->second == NULL)
-	    loadParcel(it->first);
+	writer.write(*loadParcel(it->first, it->second));
 
-	writer.write(*it->second);
+	// keep the budget, the parcel is not needed anymore
+	freeMemory(false);
 	
 	++it;
     }
@@ -392,16 +467,18 @@ grid* parcelmanager::createWorldGrid()
     // Go through all parcels
     while(it != end)
     {
-	if(it->second == NULL)
-	    loadParcel(it->first);
+	parcel *p = loadParcel(it->first, it->second);
 
-	for(int i=0; i < it->second->getSizeX(); ++i)
+	for(int i=0; i < p->getSizeX(); ++i)
 	{
-	    for(int j=0; j < it->second->getSizeZ(); ++j)
+	    for(int j=0; j < p->getSizeZ(); ++j)
 	    {
-		g->addPoint(*(it->second->points[i][j]));
+		g->addPoint(p->getPoint(i, j));
 	    }
 	}
+
+	// keep the budget, the parcel is not needed anymore
+	freeMemory(false);
 	
 	++it;
     }
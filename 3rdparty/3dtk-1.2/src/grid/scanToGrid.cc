@@ -4,6 +4,10 @@
 
 #include "grid/scanToGrid.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 using std::vector;
 using std::map;
 
@@ -181,7 +185,7 @@ scanGrid* scanToGrid::createGrid(const Scan& scan,
 void scanToGrid::killAlonePoints(scanGrid* grid,
 				 int distance, int neighbours)
 {
-    std::vector< gridPoint* > exPoints;
+    std::vector< gridPoint > exPoints;
 
     
     for(int i=0; i < grid->getSizeX(); ++i)
@@ -197,7 +201,7 @@ void scanToGrid::killAlonePoints(scanGrid* grid,
 		    if(a > 0 && b > 0 &&
 		       a < grid->getSizeX() && b < grid->getSizeZ())
 		    {
-			if(grid->points[a][b]->getPercent() > 0)
+			if(grid->getPoint(a, b).getPercent() > 0)
 			{
 			    ++found;
 			}
@@ -209,19 +213,19 @@ void scanToGrid::killAlonePoints(scanGrid* grid,
 	    // not enough neigbours found
 	    if(found < neighbours)
 	    {
-		exPoints.push_back(grid->points[i][j]);
+		exPoints.push_back(grid->getPoint(i, j));
 	    }
 	    
 	}
     }
     
-    vector<gridPoint*>::iterator it = exPoints.begin();
-    vector<gridPoint*>::iterator end = exPoints.end();
+    vector<gridPoint>::iterator it = exPoints.begin();
+    vector<gridPoint>::iterator end = exPoints.end();
 
     while(it != end)
     {
-	//std::cout << "Deleting " << (*it)->getX() << " " << (*it)->getZ() << " " << std::endl;
-	(*it)->setFixed(0, 0);
+	//std::cout << "Deleting " << it->getX() << " " << it->getZ() << " " << std::endl;
+	grid->setPoint(it->getX(), it->getZ(), 0, 0);
 	++it;
     }
 }
@@ -330,6 +334,34 @@ void scanToGrid::createPoint(scanGrid *grid, long x, long z, float weighting)
   grid->addPoint(x, z, SOLIDWEIGHT, SOLIDWEIGHT);
 }
 
+/**
+ * The method rasterises a single scanpoint into the grid, including its
+ * waypoints and neighbours if enabled. Points that are not relevant
+ * are ignored.
+ *
+ * @param grid The grid to add the point to
+ * @param p The scanpoint (not scaled to grid)
+ */
+void scanToGrid::rasterisePoint(scanGrid *grid, const Point& p)
+{
+    // if the scan is in the relevant area, create Point for it
+    if(!isPointRelevant(p))
+	return;
+
+    long x = scaleToGrid(p.x);
+    long z = scaleToGrid(p.z);
+
+    float weighting = calculateWeighting(x - grid->getViewpointX(),
+					 z - grid->getViewpointZ());
+    createPoint(grid, x, z, weighting);
+
+    if(this->waypoints)
+	createWaypoints(grid, x, z, weighting);
+
+    if(this->neighbours)
+	createNeighbours(grid, x, z, weighting);
+}
+
 /**
  * Converts a scan(3D) to a grid(2D). It iterates through each
  * found point of the scan, translates it to the grid and adds it
@@ -341,6 +373,12 @@ void scanToGrid::createPoint(scanGrid *grid, long x, long z, float weighting)
  * If Neighbours should be created, it will also weight the surrounding 
  * spaces of the found point.
  *
+ * With OpenMP the points are rasterised in parallel. The first thread
+ * writes into the result grid, every other thread into a private tile
+ * with the same offset and size. The tiles are merged afterwards; since
+ * the counters are only summed up the result does not depend on the
+ * number of threads.
+ *
  * @param scan The scan to be converted
  * @param transformation The transformationmatrix
  * @return pointer to the grid
@@ -348,30 +386,38 @@ void scanToGrid::createPoint(scanGrid *grid, long x, long z, float weighting)
 scanGrid* scanToGrid::convert(const Scan& scan, const double* transformation)
 {
     scanGrid* grid = createGrid(scan, transformation);
+    const vector<Point> &points = *scan.get_points();
+    int nrPoints = (int)points.size();
  
-    // go through all points and create the grid
-    for(size_t i = 0; i < scan.get_points()->size(); ++i)
+#ifdef _OPENMP
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel
     {
-	 Point p = scan.get_points()->at(i);
-
-	// if the scan is in the relevant area, create Point for it
-	if(isPointRelevant(p))
+	scanGrid *tile = grid;
+	if(omp_get_thread_num() != 0)
+	    tile = new scanGrid(grid->getViewpointX(), grid->getViewpointZ(),
+				grid->getOffsetX(), grid->getOffsetZ(),
+				grid->getSizeX(), grid->getSizeZ());
+
+	// go through all points and create the grid
+#pragma omp for schedule(static)
+	for(int i = 0; i < nrPoints; ++i)
+	    rasterisePoint(tile, points[i]);
+
+	// the implicit barrier above ensures that the result grid is complete
+	if(tile != grid)
 	{
-	    long x = scaleToGrid(p.x);
-	    long z = scaleToGrid(p.z);
-
-	     float weighting = calculateWeighting(x - grid->getViewpointX(),
-						  z - grid->getViewpointZ());
-	     createPoint(grid, x, z, weighting);
-	     
-	     if(this->waypoints)
-		 createWaypoints(grid, x, z, weighting);
+#pragma omp critical
+	    grid->merge(*tile);
 
-	     if(this->neighbours)
-		 createNeighbours(grid, x, z, weighting);
-	     
+	    delete tile;
 	}
     }
+#else
+    // go through all points and create the grid
+    for(int i = 0; i < nrPoints; ++i)
+	rasterisePoint(grid, points[i]);
+#endif
 
     // Kill all points which have less then 8 out of 25 neighbours
     /*killAlonePoints(grid, 3, 1);
@@ -380,15 +426,15 @@ scanGrid* scanToGrid::convert(const Scan& scan, const double* transformation)
     {
 	for(int j = 0; j < grid->getSizeZ(); ++j)
 	{
-	    gridPoint *p = grid->points[i][j];
+	    gridPoint p = grid->getPoint(i, j);
 	    
-	    float weighting = calculateWeighting(p->getX() - grid->getViewpointX(), p->getZ() - grid->getViewpointZ());
+	    float weighting = calculateWeighting(p.getX() - grid->getViewpointX(), p.getZ() - grid->getViewpointZ());
 	    
 	     if(this->waypoints)
-		createWaypoints(grid, p->getX(), p->getZ(), weighting);
+		createWaypoints(grid, p.getX(), p.getZ(), weighting);
 
 	     if(this->neighbours)
-		 createNeighbours(grid, p->getX(), p->getZ(), weighting);
+		 createNeighbours(grid, p.getX(), p.getZ(), weighting);
 	}
 	}*/
 
@@ -0,0 +1,156 @@
+/**
+ * @file
+ * @brief Measures labeling the regions of panorama sized range images
+ *
+ * componentsBenchmark
+ *
+ * Random rectangles of constant range with a little noise are drawn on
+ * an empty image of the size of a panorama. Their regions are labeled
+ * with ConnectedComponents, as Image::cluster does, and with a flood
+ * fill for reference. The time per image is printed and the labels of
+ * both are compared.
+ */
+
+#include "shapes/connectedcomponents.h"
+#include "slam6d/globals.icc"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+#include <iostream>
+#include <vector>
+using std::cout;
+using std::endl;
+using std::vector;
+
+#ifdef _MSC_VER
+  #include "XGetopt.h"
+#else
+  #include <getopt.h>
+#endif
+
+/**
+ * Explains the usage of this program's command line parameters
+ *
+ * @param prog name of the program
+ */
+void usage(char* prog)
+{
+  cout << endl
+       << "Usage: " << prog << " [-w NR] [-h NR] [-n NR] [-d NR] [-r NR]" << endl << endl;
+
+  cout << "  -w NR   width of the image (default 3600)" << endl
+       << "  -h NR   height of the image (default 1000)" << endl
+       << "  -n NR   number of rectangles (default 2000)" << endl
+       << "  -d NR   maximal difference of connected pixels (default 0.5)" << endl
+       << "  -r NR   number of runs (default 10)" << endl
+       << endl;
+
+  exit(1);
+}
+
+/**
+ * Labels the regions with a flood fill, the reference for ConnectedComponents
+ */
+int floodFill(const vector<float> &values, int width, int height, float dist, vector<int> &labels)
+{
+  int regions = 0;
+  vector<int> stack;
+  labels.assign(width * height, -1);
+  for (int p = 0; p < width * height; p++) {
+    if (values[p] == 0) {
+      labels[p] = 0;
+      continue;
+    }
+    if (labels[p] >= 0) continue;
+    labels[p] = ++regions;
+    stack.push_back(p);
+    while (!stack.empty()) {
+      int q = stack.back();
+      stack.pop_back();
+      int x = q % width, y = q / width;
+      int n[4] = {x > 0 ? q - 1 : -1, x < width - 1 ? q + 1 : -1,
+                  y > 0 ? q - width : -1, y < height - 1 ? q + width : -1};
+      for (int i = 0; i < 4; i++) {
+        int r = n[i];
+        if (r < 0 || labels[r] >= 0 || values[r] == 0) continue;
+        if (fabs(values[r] - values[q]) > dist) continue;
+        labels[r] = regions;
+        stack.push_back(r);
+      }
+    }
+  }
+  return regions;
+}
+
+/**
+ * Main program. Draws the image and labels it.
+ *
+ * @param argc count of the command-line arguments
+ * @param argv command-line arguments
+ */
+int main(int argc, char **argv)
+{
+  int width = 3600;
+  int height = 1000;
+  int nrRects = 2000;
+  float dist = 0.5;
+  int runs = 10;
+
+  int c;
+  while ((c = getopt(argc, argv, "w:h:n:d:r:")) != -1) {
+    switch (c) {
+      case 'w': width = atoi(optarg); break;
+      case 'h': height = atoi(optarg); break;
+      case 'n': nrRects = atoi(optarg); break;
+      case 'd': dist = atof(optarg); break;
+      case 'r': runs = atoi(optarg); break;
+      default:  usage(argv[0]);
+    }
+  }
+
+  if (width < 1 || height < 1 || nrRects < 0 || dist < 0 || runs < 1)
+    usage(argv[0]);
+
+  // rectangles with ranges 1 to 50 m, the noise stays below the distance
+  srand(0);
+  vector<float> values(width * height, 0.0);
+  for (int i = 0; i < nrRects; i++) {
+    int x0 = rand() % width, y0 = rand() % height;
+    int x1 = std::min(width, x0 + 1 + rand() % 200), y1 = std::min(height, y0 + 1 + rand() % 100);
+    float range = 1 + rand() % 50;
+    for (int y = y0; y < y1; y++) {
+      for (int x = x0; x < x1; x++) {
+        values[y * width + x] = range + 0.4 * dist * rand() / RAND_MAX;
+      }
+    }
+  }
+
+  cout << "Labeling " << width << " x " << height << " pixels, " << runs << " runs ..." << endl;
+
+  vector<int> labels(width * height), reference;
+  ConnectedComponents components(width, height);
+  int regions = 0;
+  unsigned long start = GetCurrentTimeInMilliSec();
+  for (int i = 0; i < runs; i++) {
+    regions = components.label(&values[0], dist, true, &labels[0]);
+  }
+  double unionfind = (GetCurrentTimeInMilliSec() - start) / (double)runs;
+
+  start = GetCurrentTimeInMilliSec();
+  int refregions = 0;
+  for (int i = 0; i < runs; i++) {
+    refregions = floodFill(values, width, height, dist, reference);
+  }
+  double flood = (GetCurrentTimeInMilliSec() - start) / (double)runs;
+
+  int wrong = 0;
+  for (int p = 0; p < width * height; p++) {
+    if (labels[p] != reference[p]) wrong++;
+  }
+
+  cout << "union-find: " << unionfind << " ms, " << regions << " regions" << endl
+       << "flood fill: " << flood << " ms, " << refregions << " regions" << endl
+       << "pixels labeled differently: " << wrong << endl;
+  return wrong ? 1 : 0;
+}
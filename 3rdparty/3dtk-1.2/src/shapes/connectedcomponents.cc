@@ -0,0 +1,99 @@
+#include "shapes/connectedcomponents.h"
+#include <math.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+ConnectedComponents::ConnectedComponents(int _width, int _height) {
+  width = _width;
+  height = _height;
+  parent = new int[width * height];
+}
+
+ConnectedComponents::~ConnectedComponents() {
+  delete[] parent;
+}
+
+inline bool ConnectedComponents::connected(const float *values, int p, int q, float dist, bool background) {
+  if(background && (values[p] == 0 || values[q] == 0)) return false;
+  return fabs(values[p] - values[q]) <= dist;
+}
+
+inline int ConnectedComponents::find(int p) {
+  // path halving
+  while(parent[p] != p) {
+    parent[p] = parent[parent[p]];
+    p = parent[p];
+  }
+  return p;
+}
+
+inline void ConnectedComponents::join(int p, int q) {
+  p = find(p);
+  q = find(q);
+  // the earlier pixel stays the root
+  if(p < q) {
+    parent[q] = p;
+  } else if(q < p) {
+    parent[p] = q;
+  }
+}
+
+int ConnectedComponents::label(const float *values, float dist, bool background, int *labels) {
+  int strips = 1;
+#ifdef _OPENMP
+  omp_set_num_threads(OPENMP_NUM_THREADS);
+  strips = OPENMP_NUM_THREADS;
+#endif
+  if(strips > height) strips = height;
+  int rows = (height + strips - 1) / strips;
+
+  // first pass: every strip only joins pixels inside of it
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for(int s = 0; s < strips; s++) {
+    int y0 = s * rows;
+    int y1 = y0 + rows < height ? y0 + rows : height;
+    for(int y = y0; y < y1; y++) {
+      for(int x = 0; x < width; x++) {
+        int p = y * width + x;
+        parent[p] = p;
+        if(x > 0 && connected(values, p, p - 1, dist, background)) {
+          join(p, p - 1);
+        }
+        if(y > y0 && connected(values, p, p - width, dist, background)) {
+          join(p, p - width);
+        }
+      }
+    }
+  }
+
+  // join the strips along their borders
+  for(int s = 1; s < strips; s++) {
+    int y = s * rows;
+    if(y >= height) break;
+    for(int x = 0; x < width; x++) {
+      int p = y * width + x;
+      if(connected(values, p, p - width, dist, background)) {
+        join(p, p - width);
+      }
+    }
+  }
+
+  // second pass: every parent lies before the pixel, so in row-major
+  // order it already carries the label of the root
+  int regions = 0;
+  int size = width * height;
+  for(int p = 0; p < size; p++) {
+    if(background && values[p] == 0) {
+      labels[p] = 0;
+    } else if(parent[p] == p) {
+      labels[p] = ++regions;
+    } else {
+      labels[p] = labels[parent[p]];
+    }
+  }
+  return regions;
+}
@@ -1,4 +1,5 @@
 #include "shapes/image.h"
+#include "shapes/connectedcomponents.h"
 #include "slam6d/globals.icc"
 #include <limits>
 #include <algorithm>
@@ -11,6 +12,10 @@ using std::set;
 #include <iterator>
 using std::insert_iterator;
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 Image::Image(float _minw, float _maxw, float _minh, float _maxh, float
 _resolution, const vector <Point> *points) {
   minh = _minh;
@@ -219,44 +224,17 @@ float Image::getMax() {
   return max;
 }
 
-void Image::mergeregion(int x, int y, int delreg, int targetreg, int** img, int it) {
-  cout << x << " " << y << " " << delreg << " " << targetreg << " " << it << endl;
-  // traversed more than necessary
-  if(it > 0) return;
-//  cout << (j % width) << ", " << j / width << "   " << width << "   " <<  old<< " ->> " << targetreg << endl;
-  img[x][y] = targetreg;
-  cout << "A" << endl;
-  // left
-  if ( x > 0 && (img[x - 1][y] == delreg)){
-    cout << "1" << endl;
-    mergeregion(x-1, y ,delreg, targetreg, img);
-    cout << "2" << endl;
-  }
-  cout << "B" << endl;
-  // right
-  if ( x < width - 1  && (img[x + 1][y] == delreg)){
-    mergeregion(x+1, y, delreg, targetreg, img);
-  }
-  cout << "C" << endl;
-  // up
-  if ( y > 0 && (img[x][y-1] == delreg )) {
-    mergeregion(x, y - 1, delreg, targetreg, img);
-  }
-  cout << "D" << endl;
-  // down
-  if ( y + 1 < height && (img[x][y+1] == delreg )) {
-    mergeregion(x, y + 1, delreg, targetreg, img);
-  }
-  cout << "E" << endl;
-}
-
 int Image::calcMarker(float _threshold, int ** regdat) {
   // segment picture
   threshold = _threshold;
   cout << threshold << " ";
   int counter = 0;
-  for(int y = 0; y < height; y++) {
-    for(int x = 0; x < width; x++) {
+#ifdef _OPENMP
+  omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for reduction(+:counter) schedule(static)
+#endif
+  for(int x = 0; x < width; x++) {
+    for(int y = 0; y < height; y++) {
       if(data[x][y] > threshold) {
         counter++;
         regdat[x][y] = 100;
@@ -276,112 +254,27 @@ int Image::calcMarker(float _threshold, int ** regdat) {
 }
 
 int Image::cluster(float dist, int ** dat, int ** regdat) {
-  vector<set<int> > linked;
-  int up, left;
-  int region = 0;
-  for(int y = 0; y < height; y++) {
-    for(int x = 0; x < width; x++) {
-      float value = dat[x][y];
-      
-      if(value != 0) {
-        // left border
-        if(x==0) {
-          left = value + dist*2.0;
-        } else {
-          left = dat[x-1][y];
-        }
-        // upper border
-        if(y==0) {
-          up = value + dist*2.0;
-        } else {
-          up = dat[x][y-1];
-        }
-      
-        if (fabs(left - value) > dist) {
-          if (fabs(up - value) > dist) {
-            regdat[x][y] = ++region;                           // new region
-            set<int> *joined = new set<int>;
-            joined->insert(region);
-            linked.push_back(*joined);
-          } else {
-            regdat[x][y] = regdat[x][y - 1];  // use upper region
-          }
-        } else if (fabs(up - value) > dist) {
-          regdat[x][y] = regdat[x-1][y];                      // use left region
-        } else {
-          // merge left and upper region, default to lower regioning number
-          if (regdat[x][y - 1] == regdat[ x - 1][y]) {
-            regdat[x][y] = regdat[x-1][y];
-            continue; // already same region, nothing to do
-          }
-
-          /*
-          int minreg, maxreg;
-          falschrum??
-          minreg = regdat[x][y - 1];
-          maxreg = regdat[x - 1][y];
-          */
-          int up = regdat[x][y - 1];
-          int left = regdat[x - 1][y];
-          regdat[x][y] = up;
-          set<int> current;
-          set<int> *joined = new set<int>;
-          joined->insert(up);
-          joined->insert(left);
-          
-          for(vector<set<int> >::iterator itr = linked.begin(); itr != linked.end(); ) {
-            current = (*itr);
-            if(current.find(up) != current.end() || current.find(left) != current.end()) {
-              set<int> *newjoined = new set<int>();
-              insert_iterator<set<int> > res_ins(*newjoined, newjoined->begin());
-
-              set_union(joined->begin(), joined->end(), current.begin(), current.end(), res_ins); 
-              joined->clear();
-              delete joined;
-              joined = newjoined;
-              itr=linked.erase(itr);
-            } else {
-              itr++;
-            }
-          }
-
-          linked.push_back(*joined);
-      }
-    }
+  vector<float> values(width * height);
+  vector<int> labels(width * height);
+  for(int x = 0; x < width; x++) {
+    for(int y = 0; y < height; y++) {
+      values[y * width + x] = dat[x][y];
     }
   }
 
-  cout << region << " " << linked.size();
-  int linkedindex[region+1];
-  linkedindex[0] = 0;
-  set<int> current;
-  int link = 0;
-  for(vector<set<int> >::iterator itr = linked.begin(); itr != linked.end(); itr++) {
-    current = (*itr);
-    for(set<int>::iterator sitr = current.begin(); 
-        sitr != current.end(); 
-        sitr++) {
-      linkedindex[*sitr] = link;
-    }
-    link++;
-  }
+  ConnectedComponents components(width, height);
+  int regions = components.label(&values[0], dist, true, &labels[0]);
 
-  
-  cout << "Regions "  << linked.size() << endl;
-  /*
-  for(int i = 0; i <= region; i++) {
-    cout << i << " " << linkedindex[i] << endl;
-  }
-  */
-  for(int y = 0; y < height; y++) {
-    for(int x = 0; x < width; x++) {
-      regdat[x][y] = linkedindex[regdat[x][y]];
+  for(int x = 0; x < width; x++) {
+    for(int y = 0; y < height; y++) {
+      regdat[x][y] = labels[y * width + x];
     }
   }
-  
-  printImage("cluster.ppm", false, regdat, height, width, 0, linked.size());
+
+  cout << "Regions "  << regions << endl;
+  printImage("cluster.ppm", false, regdat, height, width, 0, regions);
  
-  return linked.size();
+  return regions;
 
 }
 
@@ -475,54 +368,20 @@ void Image::writeCenters(int regions, int** cluster, const vector<Point> *points
 
 int Image::blobColor(float dist, int ** regdat) {
   // segment picture
-  int region = 0; // start at 12 to incresae visibility 
-  float up, left;
-
-  for(int y = 0; y < height; y++) {
-    for(int x = 0; x < width; x++) {
-
-      float value = data[x][y];
-      // left border
-      if (x == 0 ) {
-        left = value + dist*2.0;
-      } else {
-        left = data[x - 1][y];
-      }
-      // or upper border
-      if ( y == 0) {
-        up = value + dist*2;
-      } else {
-        up = data[x][y - 1];
-      }
+  vector<float> values(width * height);
+  vector<int> labels(width * height);
+  for(int x = 0; x < width; x++) {
+    for(int y = 0; y < height; y++) {
+      values[y * width + x] = data[x][y];
+    }
+  }
 
-      if (fabs(left - value) > dist) {
-        if (fabs(up - value) > dist) {
-          regdat[x][y] = ++region;                           // new region
-        } else {
-          regdat[x][y] = regdat[x][y - 1];  // use upper region
-        }
-      } else if (fabs(up - value) > dist) {
-        regdat[x][y] = regdat[x-1][y];                      // use left region
-      } else {
-        // merge left and upper region, default to lower regioning number
-        if (regdat[x][y - 1] == regdat[ x - 1][y]) {
-          regdat[x][y] = regdat[x-1][y];
-          continue; // already same region, nothing to do
-        }
+  ConnectedComponents components(width, height);
+  int region = components.label(&values[0], dist, false, &labels[0]);
 
-        int minreg, maxreg;
-        /*
-        falschrum??
-        minreg = regdat[x][y - 1];
-        maxreg = regdat[x - 1][y];
-        */
-        maxreg = regdat[x][y - 1];
-        minreg = regdat[x - 1][y];
-        regdat[x][y] = maxreg;
-        cout << "mergeRegion" << endl;
-        mergeregion(x, y, maxreg, minreg, regdat);
-        cout << "mergeRegion done" << endl;
-      }
+  for(int x = 0; x < width; x++) {
+    for(int y = 0; y < height; y++) {
+      regdat[x][y] = labels[y * width + x];
     }
   }
 
@@ -19,6 +19,14 @@ using std::list;
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <string.h>
+
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #include "slam6d/globals.icc"
 #include "slam6d/point_type.h"
@@ -28,6 +36,7 @@ using std::list;
 #include "show/colormanager.h"
 #include "show/scancolormanager.h"
 #include "show/viewcull.h"
+#include "show/vertexbuffer.h"
 
 compactTree::~compactTree(){
   //deletetNodes(*root);
@@ -35,6 +44,14 @@ compactTree::~compactTree(){
 
   delete[] mins;
   delete[] maxs;
+
+  if (mapped) {
+#ifndef _MSC_VER
+    munmap(mapped, mappedSize);
+#else
+    delete[] mapped;
+#endif
+  }
 } 
 
 
@@ -177,7 +194,7 @@ unsigned long compactTree::maxTargetPoints( cbitoct &node ) {
   return max*POPCOUNT(node.valid);
 }
 
-void compactTree::displayOctTreeAll( cbitoct &node, double *center, double size) {
+void compactTree::extractOctTreeAll(vertexBuffer &vb, cbitoct &node, double *center, double size) {
   double ccenter[3];
   cbitunion<tshort> *children;
   cbitoct::getChildren(node, children);
@@ -188,29 +205,24 @@ void compactTree::displayOctTreeAll( cbitoct &node, double *center, double size)
       if (  ( 1 << i ) & node.leaf ) {   // if ith node is leaf get center
         tshort *point = children->getPoints();
         lint length = children->getLength();
-        glBegin(GL_POINTS);
         for(unsigned int iterator = 0; iterator < length; iterator++ ) {
-          if(cm) cm->setColor(point);
-          //cout << "C " << point[1] << " " << cm << endl;
-          //glVertex3f( point[0], point[1], point[2]);
-          glVertex3f( point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2]);
+          vb.add(point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2], point);
           point+=POINTDIM;
         }
-        glEnd();
       } else { // recurse
-        displayOctTreeAll( children->node, ccenter, size/2.0);
+        extractOctTreeAll(vb, children->node, ccenter, size/2.0);
       }
       ++children; // next child
     }
   }
 }
 
-void compactTree::displayOctTreeAllCulled( cbitoct &node, double *center, double size ) {
+void compactTree::extractOctTreeAllCulled(vertexBuffer &vb, cbitoct &node, double *center, double size ) {
   int res = CubeInFrustum2(center[0], center[1], center[2], size);
   if (res==0) return;  // culled do not continue with this branch of the tree
 
   if (res == 2) { // if entirely within frustrum discontinue culling
-    displayOctTreeAll(node, center, size);
+    extractOctTreeAll(vb, node, center, size);
     return;
   }
 
@@ -226,31 +238,27 @@ void compactTree::displayOctTreeAllCulled( cbitoct &node, double *center, double
         if ( CubeInFrustum(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {
           tshort *point = children->getPoints();
           lint length = children->getLength();
-          glBegin(GL_POINTS);
           for(unsigned int iterator = 0; iterator < length; iterator++ ) {
-            if(cm) cm->setColor(point);
-            //glVertex3f( point[0], point[1], point[2]);
-            glVertex3f( point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2]);
+            vb.add(point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2], point);
             point+=POINTDIM;
           }
-          glEnd();
         }
       } else { // recurse
-        displayOctTreeAllCulled( children->node, ccenter, size/2.0);
+        extractOctTreeAllCulled(vb, children->node, ccenter, size/2.0);
       }
       ++children; // next child
     }
   }
 }
 
-void compactTree::displayOctTreeCulledLOD(long targetpts, cbitoct &node, double *center, double size ) {
+void compactTree::extractOctTreeCulledLOD(vertexBuffer &vb, long targetpts, cbitoct &node, double *center, double size ) {
   if (targetpts <= 0) return; // no need to display anything
 
   int res = CubeInFrustum2(center[0], center[1], center[2], size);
   if (res==0) return;  // culled do not continue with this branch of the tree
 
   if (res == 2) { // if entirely within frustrum discontinue culling
-    displayOctTreeLOD(targetpts, node, center, size);
+    extractOctTreeLOD(vb, targetpts, node, center, size);
     return;
   }
 
@@ -273,16 +281,11 @@ void compactTree::displayOctTreeCulledLOD(long targetpts, cbitoct &node, double
         if ( CubeInFrustum(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {
           tshort *point = children->getPoints();
           lint length = children->getLength();
-          glBegin(GL_POINTS);
           if (length > 10 && !LOD(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {  // only a single pixel on screen only paint one point
-            if(cm) cm->setColor(point);
-            //glVertex3f( point[0], point[1], point[2]);
-            glVertex3f( point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2]);
+            vb.add(point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2], point);
           } else if (length <= newtargetpts) {        // more points requested than possible, plot all
             for(unsigned int iterator = 0; iterator < length; iterator++ ) {
-              if(cm) cm->setColor(point);
-              //glVertex3f( point[0], point[1], point[2]);
-              glVertex3f( point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2]);
+              vb.add(point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2], point);
               point+=POINTDIM;
             }
           } else {                         // select points to show
@@ -293,24 +296,21 @@ void compactTree::displayOctTreeCulledLOD(long targetpts, cbitoct &node, double
             for(unsigned int iterator = 0; iterator < newtargetpts; iterator++ ) {
               index = (double)iterator * each;
               p = point + index - index%POINTDIM;
-              if(cm) cm->setColor(p);
-              //glVertex3f( p[0], p[1], p[2]);
-              glVertex3f( p[0] * precision + ccenter[0], p[1] * precision + ccenter[1], p[2] * precision + ccenter[2]);
+              vb.add(p[0] * precision + ccenter[0], p[1] * precision + ccenter[1], p[2] * precision + ccenter[2], p);
               //point += each;
             }
           }
-          glEnd();
         }
 
       } else { // recurse
-        displayOctTreeCulledLOD(newtargetpts, children->node, ccenter, size/2.0);
+        extractOctTreeCulledLOD(vb, newtargetpts, children->node, ccenter, size/2.0);
       }
       ++children; // next child
     }
   }
 }
 
-void compactTree::displayOctTreeLOD(long targetpts, cbitoct &node, double *center, double size ) {
+void compactTree::extractOctTreeLOD(vertexBuffer &vb, long targetpts, cbitoct &node, double *center, double size ) {
   if (targetpts <= 0) return; // no need to display anything
 
   double ccenter[3];
@@ -331,16 +331,11 @@ void compactTree::displayOctTreeLOD(long targetpts, cbitoct &node, double *cente
       if (  ( 1 << i ) & node.leaf ) {   // if ith node is leaf get center
         tshort *point = children->getPoints();
         lint length = children->getLength();
-        glBegin(GL_POINTS);
         /*          if (length > 10 && !LOD(ccenter[0], ccenter[1], ccenter[2], size/2.0) ) {  // only a single pixel on screen only paint one point
-                    if(cm) cm->setColor(point);
-        //glVertex3f( point[0], point[1], point[2]);
-        glVertex3f( point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2]);
+                    vb.add(point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2], point);
         } else*/ if (length <= newtargetpts) {        // more points requested than possible, plot all
           for(unsigned int iterator = 0; iterator < length; iterator++ ) {
-            if(cm) cm->setColor(point);
-            //glVertex3f( point[0], point[1], point[2]);
-            glVertex3f( point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2]);
+            vb.add(point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2], point);
             point+=POINTDIM;
           }
         } else {                         // select points to show
@@ -351,27 +346,24 @@ void compactTree::displayOctTreeLOD(long targetpts, cbitoct &node, double *cente
           for(unsigned int iterator = 0; iterator < newtargetpts; iterator++ ) {
             index = (double)iterator * each;
             p = point + index - index%POINTDIM;
-            if(cm) cm->setColor(p);
-            //glVertex3f( p[0], p[1], p[2]);
-            glVertex3f( p[0] * precision + ccenter[0], p[1] * precision + ccenter[1], p[2] * precision + ccenter[2]);
+            vb.add(p[0] * precision + ccenter[0], p[1] * precision + ccenter[1], p[2] * precision + ccenter[2], p);
             //point += each;
           }
         }
-      glEnd();
       } else { // recurse
-        displayOctTreeLOD(newtargetpts, children->node, ccenter, size/2.0);
+        extractOctTreeLOD(vb, newtargetpts, children->node, ccenter, size/2.0);
       }
       ++children; // next child
     }
   }
 }
 
-void compactTree::displayOctTreeCulledLOD2(float ratio, cbitoct &node, double *center, double size ) {
+void compactTree::extractOctTreeCulledLOD2(vertexBuffer &vb, float ratio, cbitoct &node, double *center, double size ) {
   int res = CubeInFrustum2(center[0], center[1], center[2], size);
   if (res==0) return;  // culled do not continue with this branch of the tree
 
   if (res == 2) { // if entirely within frustrum discontinue culling
-    displayOctTreeLOD2(ratio, node, center, size);
+    extractOctTreeLOD2(vb, ratio, node, center, size);
     return;
   }
 
@@ -398,18 +390,15 @@ void compactTree::displayOctTreeCulledLOD2(float ratio, cbitoct &node, double *c
               for(int iterator = 0; iterator < l; iterator++ ) {
                 index = (double)iterator * each;
                 p = point + index - index%POINTDIM;
-                if(cm) cm->setColor(p);
-                glVertex3f( p[0] * precision + ccenter[0], p[1] * precision + ccenter[1], p[2] * precision + ccenter[2]);
+                vb.add(p[0] * precision + ccenter[0], p[1] * precision + ccenter[1], p[2] * precision + ccenter[2], p);
               }
             } else if ((int)length <= l) { 
               for(unsigned int iterator = 0; iterator < length; iterator++ ) {
-                if(cm) cm->setColor(point);
-                glVertex3f( point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2]);
+                vb.add(point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2], point);
                 point+=POINTDIM;
               }
             } else if (l == 1) {
-                if(cm) cm->setColor(point);
-                glVertex3f( point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2]);
+                vb.add(point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2], point);
             }
           }
         }
@@ -417,7 +406,7 @@ void compactTree::displayOctTreeCulledLOD2(float ratio, cbitoct &node, double *c
         int l = LOD2(ccenter[0], ccenter[1], ccenter[2], size/2.0);  // only a single pixel on screen only paint one point
         l = max((int)(l*l*ratio), 0);
         if (l > 0) {
-          displayOctTreeCulledLOD2(ratio, children->node, ccenter, size/2.0);
+          extractOctTreeCulledLOD2(vb, ratio, children->node, ccenter, size/2.0);
         }
       }
       ++children; // next child
@@ -425,7 +414,7 @@ void compactTree::displayOctTreeCulledLOD2(float ratio, cbitoct &node, double *c
   }
 }
 
-void compactTree::displayOctTreeLOD2(float ratio, cbitoct &node, double *center, double size ) {
+void compactTree::extractOctTreeLOD2(vertexBuffer &vb, float ratio, cbitoct &node, double *center, double size ) {
   double ccenter[3];
   cbitunion<tshort> *children;
   cbitoct::getChildren(node, children);
@@ -448,25 +437,22 @@ void compactTree::displayOctTreeLOD2(float ratio, cbitoct &node, double *center,
             for(int iterator = 0; iterator < l; iterator++ ) {
               index = (double)iterator * each;
               p = point + index - index%POINTDIM;
-              if(cm) cm->setColor(p);
-              glVertex3f( p[0] * precision + ccenter[0], p[1] * precision + ccenter[1], p[2] * precision + ccenter[2]);
+              vb.add(p[0] * precision + ccenter[0], p[1] * precision + ccenter[1], p[2] * precision + ccenter[2], p);
             }
           } else if ((int)length <= l) { 
             for(unsigned int iterator = 0; iterator < length; iterator++ ) {
-              if(cm) cm->setColor(point);
-              glVertex3f( point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2]);
+              vb.add(point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2], point);
               point+=POINTDIM;
             }
           }
         } else {
-          if(cm) cm->setColor(point);
-          glVertex3f( point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2]);
+          vb.add(point[0] * precision + ccenter[0], point[1] * precision + ccenter[1], point[2] * precision + ccenter[2], point);
         }
       } else { // recurse
         int l = LOD2(ccenter[0], ccenter[1], ccenter[2], size/2.0);  // only a single pixel on screen only paint one point
         l = max((int)(l*l*ratio), 0);
         if (l > 0) {
-          displayOctTreeLOD2(ratio, children->node, ccenter, size/2.0);
+          extractOctTreeLOD2(vb, ratio, children->node, ccenter, size/2.0);
         }
       }
       ++children; // next child
@@ -632,11 +618,29 @@ long compactTree::countLeaves() { return 1 + countLeaves(*root); }
 void compactTree::setColorManager(ColorManager *_cm) { cm = _cm; }
 
 void compactTree::drawLOD(float ratio) { 
+  updateLOD(ratio, vbuffer);
+  vbuffer.draw();
+}
+
+bool compactTree::updateLOD(float ratio, vertexBuffer &vb) { 
+  if (!vb.isCurrent(ratio, current_lod_mode, cm)) {
+    extractLOD(ratio, vb);
+  }
+  return true;
+}
+
+void compactTree::draw() { 
+  if (!vbuffer.isCurrent(1.0, -1, cm)) {
+    extract(vbuffer);
+  }
+  vbuffer.draw();
+}
+
+void compactTree::extractLOD(float ratio, vertexBuffer &vb) { 
+    vb.begin(ratio, current_lod_mode, cm);
     switch (current_lod_mode) {
       case 1:
-        glBegin(GL_POINTS);
-        displayOctTreeCulledLOD2(ratio , *root, center, size);
-        glEnd();
+        extractOctTreeCulledLOD2(vb, ratio , *root, center, size);
         break;
       case 2:
         /*
@@ -655,17 +659,16 @@ void compactTree::drawLOD(float ratio) {
 */
       //break;
       case 0:
-        glBegin(GL_POINTS);
-        displayOctTreeCulledLOD(maxtargetpoints * ratio, *root, center, size); 
-        glEnd();
+        extractOctTreeCulledLOD(vb, maxtargetpoints * ratio, *root, center, size); 
         break;
       default:
       break;
     }
 }
 
-void compactTree::draw() { 
-  displayOctTreeAllCulled(*root, center, size); 
+void compactTree::extract(vertexBuffer &vb) { 
+  vb.begin(1.0, -1, cm);
+  extractOctTreeAllCulled(vb, *root, center, size); 
 }
 
 void compactTree::displayOctTree(double minsize ) { 
@@ -686,6 +689,11 @@ void compactTree::deserialize(std::string filename ) {
 
   // read magic bits
   file.read(buffer, 2);
+  if ( buffer[0] == 'X' && buffer[1] == 'M') {
+    file.close();
+    deserializeMapped(filename);
+    return;
+  }
   if ( buffer[0] != 'X' || buffer[1] != 'T') {
     std::cerr << "Not an octree file!!" << endl;
     file.close();
@@ -838,3 +846,254 @@ void compactTree::serialize(std::ofstream &of, cbitoct &node) {
     }
   }
 }
+
+/**
+ * Reads the type of the points from the header of an octree file, in
+ * either format
+ */
+PointType compactTree::readType(std::string filename) {
+  char buffer[2];
+
+  std::ifstream file;
+  file.open (filename.c_str(), std::ios::in | std::ios::binary);
+
+  // read magic bits
+  file.read(buffer, 2);
+  if ( buffer[0] != 'X' || (buffer[1] != 'T' && buffer[1] != 'M')) {
+    std::cerr << "Not an octree file!!" << endl;
+    file.close();
+    return PointType();
+  }
+
+  PointType type = PointType::deserialize(file);
+  file.close();
+  return type;
+}
+
+/**
+ * Number of bytes before the nodes of a mapped octree file, the nodes
+ * start at a multiple of 8
+ */
+static inline size_t mappedHeaderSize(unsigned int pointdim) {
+  size_t header = 2 + sizeof(unsigned int) + 5 * sizeof(float) + sizeof(int)
+    + 2 * pointdim * sizeof(float) + sizeof(unsigned long long);
+  return (header + 7) & ~((size_t)7);
+}
+
+/**
+ * Writes the tree as it is laid out in memory. The header is that of
+ * serialize() (with the magic bits XM) plus the number of points for the
+ * level of detail, so opening the tree does not have to traverse it.
+ * It is followed by all nodes,
+ * children stored next to each other in depth first order, and then by
+ * all points. Nodes point to their children and leaves to their points
+ * relative to their own position, as in the allocator, so the file can
+ * be mapped and used without being read. Nodes and points are paged in
+ * by the operating system the first time they are drawn.
+ *
+ * The file uses the bit field layout and byte order of this machine.
+ */
+void compactTree::serializeMapped(std::string filename) {
+  // lay out all nodes first, leaves remember where their points go
+  vector<cbitunion<tshort> > image(1);
+  vector<unsigned long> leaves;
+  unsigned long pointbytes = 0;
+  image[0].node.valid = root->valid;
+  image[0].node.leaf = root->leaf;
+  serializeNodes(*root, image, 0, pointbytes, leaves);
+
+  size_t header = mappedHeaderSize(POINTDIM);
+  unsigned long nodebytes = image.size() * sizeof(cbitunion<tshort>);
+  if (nodebytes + pointbytes >= (1ul << (POINTERBITS - 1))) {
+    std::cerr << "Octree too large to be mapped, " << filename << " not written" << endl;
+    return;
+  }
+
+  // leaves point from their node to their points
+  for (unsigned int i = 0; i < leaves.size(); i++) {
+    unsigned long index = leaves[i];
+    image[index].points.pointer = nodebytes + image[index].points.pointer
+      - index * sizeof(cbitunion<tshort>);
+  }
+
+  char buffer[sizeof(float) * 20];
+  float *p = reinterpret_cast<float*>(buffer);
+
+  std::ofstream file;
+  file.open (filename.c_str(), std::ios::out | std::ios::binary);
+
+  // write magic bits
+  buffer[0] = 'X';
+  buffer[1] = 'M';
+  file.write(buffer, 2);
+
+  // write header
+  pointtype.serialize(file);
+
+  p[0] = voxelSize;
+  p[1] = center[0]; 
+  p[2] = center[1]; 
+  p[3] = center[2];
+  p[4] = size;
+
+  int *ip = reinterpret_cast<int*>(&(buffer[5 * sizeof(float)]));
+  *ip = POINTDIM;
+
+  file.write(buffer, 5 * sizeof(float) + sizeof(int));
+
+  float *fminmax = new float[2*POINTDIM];
+  for (unsigned int i = 0; i < POINTDIM; i++) {
+    fminmax[i] = mins[i];
+    fminmax[i+POINTDIM] = maxs[i];
+  }
+  file.write(reinterpret_cast<char*>(fminmax), 2*POINTDIM * sizeof(float));
+  delete[] fminmax;
+
+  unsigned long long targetpoints = maxtargetpoints;
+  file.write(reinterpret_cast<char*>(&targetpoints), sizeof(unsigned long long));
+
+  // pad the header so the nodes are aligned
+  memset(buffer, 0, 8);
+  file.write(buffer, header - (2 + sizeof(unsigned int) + 5 * sizeof(float) + sizeof(int)
+                               + 2 * POINTDIM * sizeof(float) + sizeof(unsigned long long)));
+
+  file.write(reinterpret_cast<char*>(&image[0]), nodebytes);
+  serializePoints(file, *root);
+
+  file.close();
+}
+
+/**
+ * Appends the children of node to image and links the copy of node at
+ * index to them. The pointer of a leaf is set to the offset of its
+ * points behind all nodes for now, the leaf is added to leaves.
+ */
+void compactTree::serializeNodes(cbitoct &node, vector<cbitunion<tshort> > &image, unsigned long index,
+                                 unsigned long &pointbytes, vector<unsigned long> &leaves) {
+  unsigned long first = image.size();
+  image.resize(first + POPCOUNT(node.valid));
+  image[index].node.child_pointer = (first - index) * sizeof(cbitunion<tshort>);
+
+  cbitunion<tshort> *children;
+  cbitoct::getChildren(node, children);
+  unsigned long c = first;
+  for (short i = 0; i < 8; i++) {
+    if (  ( 1 << i ) & node.valid ) {   // if ith node exists
+      if (  ( 1 << i ) & node.leaf ) {   // if ith node is leaf reserve its points
+        lint length = children->getLength();
+        image[c].points.length = length;
+        image[c].points.pointer = pointbytes;
+        leaves.push_back(c);
+        pointbytes += POINTDIM * length * sizeof(tshort);
+      } else {
+        image[c].node.valid = children->node.valid;
+        image[c].node.leaf = children->node.leaf;
+        serializeNodes(children->node, image, c, pointbytes, leaves);
+      }
+      ++children; // next child
+      ++c;
+    }
+  }
+}
+
+/**
+ * Writes the points of all leaves, in the order serializeNodes reserved them
+ */
+void compactTree::serializePoints(std::ofstream &of, cbitoct &node) {
+  cbitunion<tshort> *children;
+  cbitoct::getChildren(node, children);
+  for (short i = 0; i < 8; i++) {
+    if (  ( 1 << i ) & node.valid ) {   // if ith node exists
+      if (  ( 1 << i ) & node.leaf ) {   // if ith node is leaf write points 
+        of.write(reinterpret_cast<char*>(children->getPoints()), POINTDIM*children->getLength()*sizeof(tshort) );
+      } else {
+        serializePoints(of, children->node);
+      }
+      ++children; // next child
+    }
+  }
+}
+
+/**
+ * Maps a file written by serializeMapped. Only the header is read, the
+ * root of the tree points into the mapped file.
+ *
+ * @return false if the file could not be mapped
+ */
+bool compactTree::deserializeMapped(std::string filename) {
+#ifndef _MSC_VER
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Could not open " << filename << endl;
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return false;
+  }
+  mappedSize = st.st_size;
+  void *data = mmap(0, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);  // the mapping stays valid
+  if (data == MAP_FAILED) {
+    std::cerr << "Could not map " << filename << endl;
+    mappedSize = 0;
+    return false;
+  }
+  mapped = (char*)data;
+#else
+  // no mapping, the whole file is read at once
+  std::ifstream file;
+  file.open (filename.c_str(), std::ios::in | std::ios::binary | std::ios::ate);
+  mappedSize = file.tellg();
+  mapped = new char[mappedSize];
+  file.seekg(0);
+  file.read(mapped, mappedSize);
+  file.close();
+#endif
+
+  // read header
+  const char *header = mapped + 2;
+  unsigned int types;
+  memcpy(&types, header, sizeof(unsigned int));
+  pointtype = PointType(types);
+  header += sizeof(unsigned int);
+
+  float p[5];
+  memcpy(p, header, 5 * sizeof(float));
+  voxelSize = p[0];
+  center[0] = p[1];
+  center[1] = p[2];
+  center[2] = p[3];
+  size = p[4];
+  header += 5 * sizeof(float);
+
+  int pointdim;
+  memcpy(&pointdim, header, sizeof(int));
+  POINTDIM = pointdim;
+  header += sizeof(int);
+
+  mins = new double[POINTDIM];
+  maxs = new double[POINTDIM];
+  for (unsigned int i = 0; i < POINTDIM; i++) {
+    float f;
+    memcpy(&f, header + i * sizeof(float), sizeof(float));
+    mins[i] = f;
+    memcpy(&f, header + (i + POINTDIM) * sizeof(float), sizeof(float));
+    maxs[i] = f;
+  }
+  header += 2 * POINTDIM * sizeof(float);
+
+  unsigned long long targetpoints;
+  memcpy(&targetpoints, header, sizeof(unsigned long long));
+  maxtargetpoints = targetpoints;
+
+  double vs = size;
+  while (vs > voxelSize) {
+    vs = vs * 0.5;
+  }
+  precision = vs / TSHORT_MAXP1;  // 2^15
+
+  root = &((cbitunion<tshort>*)(mapped + mappedHeaderSize(POINTDIM)))->node;
+  return true;
+}
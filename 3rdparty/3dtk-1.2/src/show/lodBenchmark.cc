@@ -0,0 +1,513 @@
+/**
+ * @file
+ * @brief Measures the culling and LOD traversal of the display octrees
+ *
+ * lodBenchmark
+ *
+ * A synthetic city block is stored in a compactTree (or Show_BOctTree)
+ * and a camera flies a fixed circle around it, or along a camera path
+ * saved by show. For every frame the frustum is set without an OpenGL
+ * context and the points show would render are extracted into a vertex
+ * buffer. The extraction frames per second and the points per frame are
+ * printed for both LOD modes and for the full culled point cloud.
+ *
+ * Afterwards the block is split into several scans that are culled
+ * together by the ScanCuller of show, optionally with a point budget.
+ */
+
+#include "show/compacttree.h"
+#include "show/show_Boctree.h"
+#include "show/NurbsPath.h"
+#include "slam6d/point.h"
+#include "show/scanculler.h"
+#include "show/vertexbuffer.h"
+#include "show/viewcull.h"
+#include "slam6d/globals.icc"
+
+#include <cstdlib>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <vector>
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::ifstream;
+using std::vector;
+
+#ifdef _MSC_VER
+  #include "XGetopt.h"
+#else
+  #include <getopt.h>
+#endif
+
+#ifdef __linux__
+  #include <malloc.h>
+#endif
+
+/**
+ * Explains the usage of this program's command line parameters
+ *
+ * @param prog name of the program
+ */
+void usage(char* prog)
+{
+  cout << endl
+       << "Usage: " << prog << " [-n NR] [-f NR] [-p FILE] [-v NR] [-l NR] [-s NR] [-B NR] [-b]"
+       << endl << endl;
+
+  cout << "  -n NR   number of synthetic points (default 2000000)" << endl
+       << "  -f NR   number of frames of the camera path (default 100)" << endl
+       << "  -p FILE use the camera path FILE saved by show instead of a circle" << endl
+       << "  -v NR   voxel size of the octree (default 20 units)" << endl
+       << "  -l NR   level of detail in ]0,1] (default 1.0)" << endl
+       << "  -s NR   number of scans for the ScanCuller (default 8)" << endl
+       << "  -B NR   point budget of the ScanCuller (default 0, no limit)" << endl
+       << "  -b      use Show_BOctTree instead of compactTree" << endl
+       << endl;
+
+  exit(1);
+}
+
+/**
+ * Creates the points of a synthetic city block around the origin.
+ * The block is 100 m wide, its walls are up to 20 m high and carry
+ * a simple facade pattern. A third of the points lie on the ground.
+ *
+ * @param nrPoints number of points to create
+ * @param pts receives the points, three floats each
+ */
+void createCityBlock(int nrPoints, vector<float*>& pts)
+{
+  const float half = 5000.0;
+
+  srand(0);
+  pts.resize(nrPoints);
+  for (int i = 0; i < nrPoints; ++i) {
+    float u = (float)rand() / RAND_MAX;
+    float v = (float)rand() / RAND_MAX;
+    float *p = new float[3];
+
+    if (i % 3 == 0) {
+      // ground
+      p[0] = (2 * u - 1) * half;
+      p[1] = 0;
+      p[2] = (2 * v - 1) * half;
+    } else {
+      // one of the four walls, with 50 cm deep window recesses
+      float along = (2 * u - 1) * half;
+      float depth = half - ((int)(along / 300) % 2 == 0 ? 0 : 50);
+      p[1] = v * 2000.0;
+      switch (i % 4) {
+        case 0:  p[0] = along;  p[2] = depth;  break;
+        case 1:  p[0] = along;  p[2] = -depth; break;
+        case 2:  p[0] = depth;  p[2] = along;  break;
+        default: p[0] = -depth; p[2] = along;  break;
+      }
+    }
+    pts[i] = p;
+  }
+}
+
+/**
+ * A camera of the path, as show stores it: the position, the point
+ * looked at and a point above the camera
+ */
+struct Camera {
+  double eye[3];
+  double target[3];
+  double up[3];
+};
+
+/**
+ * Creates a circle around the city block at eye level
+ *
+ * @param frames number of cameras
+ * @param path receives the cameras
+ */
+void circlePath(int frames, vector<Camera>& path)
+{
+  const double radius = 3000.0;
+
+  path.resize(frames);
+  for (int frame = 0; frame < frames; frame++) {
+    double angle = 2.0 * M_PI * frame / frames;
+    Camera &cam = path[frame];
+    cam.eye[0] = radius * cos(angle);
+    cam.eye[1] = 170.0;
+    cam.eye[2] = radius * sin(angle);
+    cam.target[0] = 0.0;
+    cam.target[1] = 500.0;
+    cam.target[2] = 0.0;
+    cam.up[0] = cam.eye[0];
+    cam.up[1] = cam.eye[1] + 1.0;
+    cam.up[2] = cam.eye[2];
+  }
+}
+
+/**
+ * Interpolates one coordinate track of the cameras like show does when
+ * playing a path, the NURBS are computed in the xy and the xz plane
+ *
+ * @param pts the key points
+ * @param nr number of interpolated points
+ * @param track receives the interpolated points
+ */
+void interpolate(const vector<Point>& pts, unsigned int nr, vector<Point>& track)
+{
+  NurbsPath nurbs;
+  vector<PointXY> listXY, listXZ;
+  for (unsigned int i = 0; i < pts.size(); i++) {
+    PointXY temp;
+    temp.x = pts[i].x;
+    temp.y = pts[i].y;
+    listXY.push_back(temp);
+    temp.y = pts[i].z;
+    listXZ.push_back(temp);
+  }
+
+  vector<PointXY> vectorX = nurbs.getNurbsPath(listXY, nr, 1);
+  vector<PointXY> vectorZ = nurbs.getNurbsPath(listXZ, nr, 1);
+  track.resize(vectorX.size());
+  for (unsigned int i = 0; i < vectorX.size(); i++) {
+    track[i] = Point(vectorX[i].x, vectorX[i].y, vectorZ[i].y);
+  }
+}
+
+/**
+ * Reads a camera path saved by show and interpolates it with the
+ * same number of frames show would render
+ *
+ * @param filename the path file
+ * @param path receives the cameras
+ * @return false if the file could not be read
+ */
+bool loadPath(const char *filename, vector<Camera>& path)
+{
+  ifstream pathFile(filename);
+  unsigned int length = 0;
+  if (!(pathFile >> length) || length < 2) return false;
+
+  vector<Point> cams(length), lookats(length), ups(length);
+  for (unsigned int i = 0; i < length; i++) {
+    if (!(pathFile >> cams[i].x >> cams[i].y >> cams[i].z
+                   >> lookats[i].x >> lookats[i].y >> lookats[i].z
+                   >> ups[i].x >> ups[i].y >> ups[i].z))
+      return false;
+  }
+
+  // as calcNoOfPoints in show
+  double distance = 0.0;
+  for (unsigned int i = 0; i < length - 1; i++) {
+    double dx = cams[i+1].x - cams[i].x;
+    double dy = cams[i+1].y - cams[i].y;
+    double dz = cams[i+1].z - cams[i].z;
+    distance += sqrt(dx*dx + dy*dy + dz*dz);
+  }
+  unsigned int nr = (unsigned int)(distance / 2);
+  if (nr < 1) return false;
+
+  vector<Point> eyes, targets, above;
+  interpolate(cams, nr, eyes);
+  interpolate(lookats, nr, targets);
+  interpolate(ups, nr, above);
+
+  path.resize(eyes.size());
+  for (unsigned int i = 0; i < eyes.size(); i++) {
+    Camera &cam = path[i];
+    cam.eye[0] = eyes[i].x;    cam.eye[1] = eyes[i].y;    cam.eye[2] = eyes[i].z;
+    cam.target[0] = targets[i].x; cam.target[1] = targets[i].y; cam.target[2] = targets[i].z;
+    cam.up[0] = above[i].x;    cam.up[1] = above[i].y;    cam.up[2] = above[i].z;
+  }
+  return true;
+}
+
+/**
+ * Computes the matrices gluLookAt and gluPerspective would create
+ *
+ * @param cam the camera
+ * @param viewport x, y, width and height of the viewport
+ * @param modelview receives the camera matrix
+ * @param projection receives the projection matrix
+ */
+void getMatrices(const Camera &cam, const int *viewport, double *modelview, double *projection)
+{
+  const double fovy = 60.0, neardistance = 10.0, fardistance = 40000.0;
+  double aspect = (double)viewport[2] / viewport[3];
+
+  for (int i = 0; i < 16; i++) {
+    projection[i] = 0.0;
+    modelview[i] = 0.0;
+  }
+  double f = 1.0 / tan(rad(fovy) / 2.0);
+  projection[0] = f / aspect;
+  projection[5] = f;
+  projection[10] = (fardistance + neardistance) / (neardistance - fardistance);
+  projection[11] = -1.0;
+  projection[14] = 2.0 * fardistance * neardistance / (neardistance - fardistance);
+
+  double forward[3], side[3], up[3];
+  for (int i = 0; i < 3; i++) {
+    forward[i] = cam.target[i] - cam.eye[i];
+    up[i] = cam.up[i] - cam.eye[i];
+  }
+  Normalize3(forward);
+  Cross(forward, up, side);
+  Normalize3(side);
+  Cross(side, forward, up);
+
+  for (int i = 0; i < 3; i++) {
+    modelview[4*i + 0] = side[i];
+    modelview[4*i + 1] = up[i];
+    modelview[4*i + 2] = -forward[i];
+    modelview[12] -= side[i] * cam.eye[i];
+    modelview[13] -= up[i] * cam.eye[i];
+    modelview[14] += forward[i] * cam.eye[i];
+  }
+  modelview[15] = 1.0;
+}
+
+const int viewport[4] = {0, 0, 960, 540};
+
+/**
+ * Extracts the points of all frames of the camera path and prints
+ * the frames per second and points per frame
+ *
+ * @param tree the display octree
+ * @param lod the level of detail, negative for all points
+ * @param path the cameras
+ * @param vb the buffer to fill
+ */
+template <class Tree>
+void runPath(Tree *tree, float lod, const vector<Camera>& path, vertexBuffer &vb)
+{
+  int frames = path.size();
+  unsigned long total = 0;
+  unsigned long points = 0;
+  for (int frame = 0; frame < frames; frame++) {
+    double modelview[16], projection[16];
+    getMatrices(path[frame], viewport, modelview, projection);
+    ExtractFrustum(modelview, projection, viewport, 1);
+
+    unsigned long start = GetCurrentTimeInMilliSec();
+    if (lod < 0) tree->extract(vb);
+    else tree->extractLOD(lod, vb);
+    total += GetCurrentTimeInMilliSec() - start;
+    points += vb.size();
+  }
+
+  double seconds = total / 1000.0;
+  cout << "  frames per second: " << (seconds > 0 ? frames / seconds : 0)
+       << ", points per frame: " << points / frames << endl;
+}
+
+/**
+ * Runs the camera path once for every LOD mode and once without LOD
+ *
+ * @param tree the display octree
+ * @param lod the level of detail
+ * @param path the cameras
+ */
+template <class Tree>
+void runAll(Tree *tree, float lod, const vector<Camera>& path)
+{
+  vertexBuffer vb;
+  for (int mode = 0; mode < 2; mode++) {
+    cout << "LOD mode " << mode << ", level of detail " << lod << ":" << endl;
+    runPath(tree, lod, path, vb);
+    ((colordisplay*)tree)->cycleLOD();  // as show does it
+  }
+  cout << "All points in the frustum:" << endl;
+  runPath(tree, -1, path, vb);
+}
+
+/**
+ * Culls all scans for every frame of the camera path with the
+ * ScanCuller and prints the frames per second, the points per frame
+ * and how many scans had to be traversed per frame
+ *
+ * @param culler the culler of all scans
+ * @param poses the pose of every scan
+ * @param lod the level of detail
+ * @param path the cameras
+ */
+void runCuller(ScanCuller &culler, const vector<const double*>& poses, float lod,
+               const vector<Camera>& path)
+{
+  int frames = path.size();
+  unsigned long total = 0;
+  unsigned long points = 0;
+  unsigned long traversals = 0;
+  for (int frame = 0; frame < frames; frame++) {
+    double modelview[16], projection[16];
+    getMatrices(path[frame], viewport, modelview, projection);
+
+    unsigned long start = GetCurrentTimeInMilliSec();
+    points += culler.cull(modelview, projection, viewport, 1, poses, lod);
+    total += GetCurrentTimeInMilliSec() - start;
+    traversals += culler.getTraversals();
+  }
+
+  double seconds = total / 1000.0;
+  cout << "  frames per second: " << (seconds > 0 ? frames / seconds : 0)
+       << ", points per frame: " << points / frames
+       << ", scans traversed per frame: " << (double)traversals / frames << endl;
+}
+
+/**
+ * Splits the points into scans taken on a circle around the block.
+ * The points of a scan are stored relative to its position, which
+ * becomes the translation of its pose.
+ *
+ * @param pts all points
+ * @param nrScans number of scans
+ * @param scanPts receives the points of every scan
+ * @param poses receives the pose of every scan
+ */
+void splitScans(const vector<float*>& pts, int nrScans,
+                vector< vector<float*> >& scanPts, vector<double*>& poses)
+{
+  scanPts.resize(nrScans);
+  poses.resize(nrScans);
+  for (int s = 0; s < nrScans; s++) {
+    double angle = 2.0 * M_PI * s / nrScans;
+    double *pose = new double[16];
+    M4identity(pose);
+    pose[12] = 2000.0 * cos(angle);
+    pose[14] = 2000.0 * sin(angle);
+    poses[s] = pose;
+  }
+
+  for (unsigned int i = 0; i < pts.size(); i++) {
+    int s = i % nrScans;
+    float *p = new float[3];
+    p[0] = pts[i][0] - poses[s][12];
+    p[1] = pts[i][1];
+    p[2] = pts[i][2] - poses[s][14];
+    scanPts[s].push_back(p);
+  }
+}
+
+/**
+ * Culls the scans with the ScanCuller, once for every LOD mode
+ *
+ * @param trees the display octree of every scan
+ * @param poses the pose of every scan
+ * @param budget the point budget
+ * @param lod the level of detail
+ * @param path the cameras
+ */
+void runScans(vector<colordisplay*>& trees, const vector<double*>& poses,
+              unsigned long budget, float lod, const vector<Camera>& path)
+{
+  vector<const double*> scanPoses(poses.begin(), poses.end());
+  ScanCuller culler(trees, budget);
+  for (int mode = 0; mode < 2; mode++) {
+    cout << "ScanCuller, " << trees.size() << " scans, LOD mode " << mode
+         << ", level of detail " << lod;
+    if (budget > 0) cout << ", budget " << budget;
+    cout << ":" << endl;
+    runCuller(culler, scanPoses, lod, path);
+    for (unsigned int i = 0; i < trees.size(); i++) {
+      trees[i]->cycleLOD();
+    }
+  }
+}
+
+/**
+ * Main program. Builds the octree and runs the camera path once
+ * for every LOD mode and once without LOD.
+ *
+ * @param argc count of the command-line arguments
+ * @param argv command-line arguments
+ */
+int main(int argc, char **argv)
+{
+  int nrPoints = 2000000;
+  int frames = 100;
+  const char *pathFile = 0;
+  double voxelSize = 20.0;
+  float lod = 1.0;
+  int nrScans = 8;
+  unsigned long budget = 0;
+  bool compact = true;
+
+  int c;
+  while ((c = getopt(argc, argv, "n:f:p:v:l:s:B:bh")) != -1) {
+    switch (c) {
+      case 'n': nrPoints = atoi(optarg); break;
+      case 'f': frames = atoi(optarg); break;
+      case 'p': pathFile = optarg; break;
+      case 'v': voxelSize = atof(optarg); break;
+      case 'l': lod = atof(optarg); break;
+      case 's': nrScans = atoi(optarg); break;
+      case 'B': budget = atol(optarg); break;
+      case 'b': compact = false; break;
+      default:  usage(argv[0]);
+    }
+  }
+
+  if (nrPoints < 1 || frames < 1 || voxelSize <= 0 || lod <= 0 || lod > 1 || nrScans < 1)
+    usage(argv[0]);
+
+  vector<Camera> path;
+  if (pathFile) {
+    if (!loadPath(pathFile, path)) {
+      cerr << "Could not read the camera path " << pathFile << endl;
+      exit(1);
+    }
+    cout << "Camera path " << pathFile << " with " << path.size() << " frames" << endl;
+  } else {
+    circlePath(frames, path);
+  }
+
+#ifdef __linux__
+  // compactTree links its nodes with 32 bit relative pointers, so all chunks
+  // of its allocator have to be mapped close to each other. Stop glibc from
+  // serving some of them from the heap once large blocks have been freed.
+  mallopt(M_MMAP_THRESHOLD, 1 << 17);
+#endif
+
+  vector<float*> pts;
+  createCityBlock(nrPoints, pts);
+
+  cout << "Building " << (compact ? "compactTree" : "Show_BOctTree")
+       << " of " << nrPoints << " points ..." << endl;
+  if (compact) {
+    compactTree *tree = new compactTree(&pts[0], nrPoints, voxelSize);
+    runAll(tree, lod, path);
+    delete tree;
+  } else {
+    Show_BOctTree<float> *tree = new Show_BOctTree<float>(&pts[0], nrPoints, (float)voxelSize);
+    runAll(tree, lod, path);
+    delete tree;
+  }
+
+  vector< vector<float*> > scanPts;
+  vector<double*> poses;
+  splitScans(pts, nrScans, scanPts, poses);
+  for (int i = 0; i < nrPoints; i++) {
+    delete[] pts[i];
+  }
+
+  cout << "Building " << nrScans << " scans ..." << endl;
+  vector<colordisplay*> trees;
+  for (int s = 0; s < nrScans; s++) {
+    int n = scanPts[s].size();
+    if (compact) {
+      trees.push_back(new compactTree(&scanPts[s][0], n, voxelSize));
+    } else {
+      trees.push_back(new Show_BOctTree<float>(&scanPts[s][0], n, (float)voxelSize));
+    }
+  }
+  runScans(trees, poses, budget, lod, path);
+
+  for (int s = 0; s < nrScans; s++) {
+    delete trees[s];
+    for (unsigned int i = 0; i < scanPts[s].size(); i++) {
+      delete[] scanPts[s][i];
+    }
+    delete[] poses[s];
+  }
+  return 0;
+}
@@ -0,0 +1,180 @@
+/**
+ * @file
+ * @brief Measures picking points in the display octrees of show
+ *
+ * pickBenchmark
+ *
+ * Random points in a box are split into scans stored in Show_BOctTrees,
+ * as show builds them without --reduce. A camera looks at the box and
+ * random pixels are picked without an OpenGL context, once for the
+ * nearest point (as a click in show) and once for all points under a
+ * brush. The picks per second are printed and every result is checked
+ * against testing all points.
+ */
+
+#include "show/show_Boctree.h"
+#include "show/scanpicker.h"
+#include "slam6d/globals.icc"
+
+#include <cstdlib>
+#include <cmath>
+#include <iostream>
+#include <vector>
+using std::cout;
+using std::endl;
+using std::vector;
+
+#ifdef _MSC_VER
+  #include "XGetopt.h"
+#else
+  #include <getopt.h>
+#endif
+
+/**
+ * Explains the usage of this program's command line parameters
+ *
+ * @param prog name of the program
+ */
+void usage(char* prog)
+{
+  cout << endl
+       << "Usage: " << prog << " [-n NR] [-s NR] [-p NR] [-r NR] [-v NR]" << endl << endl;
+
+  cout << "  -n NR   number of points of every scan (default 200000)" << endl
+       << "  -s NR   number of scans (default 10)" << endl
+       << "  -p NR   number of picks (default 200)" << endl
+       << "  -r NR   radius of the brush in pixels (default 20)" << endl
+       << "  -v NR   voxel size of the octrees (default 20 units)" << endl
+       << endl;
+
+  exit(1);
+}
+
+/**
+ * Tests all points of all scans, the reference for pickScans
+ */
+void pickAll(const vector< vector<float*> > &pts, const vector<const double*> &poses,
+             const double *modelview, const double *projection, const int *viewport,
+             int x, int y, float radius, vector<PickHit<float> > &hits)
+{
+  hits.clear();
+  for (unsigned int s = 0; s < pts.size(); s++) {
+    double scanview[16];
+    MMult(modelview, poses[s], scanview);
+    PickRay ray;
+    ray.set(scanview, projection, viewport, x, y, radius);
+    for (unsigned int i = 0; i < pts[s].size(); i++) {
+      float depth;
+      if (ray.contains(pts[s][i], depth)) {
+        PickHit<float> hit = {pts[s][i], depth, s};
+        hits.push_back(hit);
+      }
+    }
+  }
+  std::sort(hits.begin(), hits.end());
+}
+
+/**
+ * Main program. Builds the scans and picks random pixels.
+ *
+ * @param argc count of the command-line arguments
+ * @param argv command-line arguments
+ */
+int main(int argc, char **argv)
+{
+  int nrPoints = 200000;
+  int nrScans = 10;
+  int nrPicks = 200;
+  float radius = 20.0;
+  float voxelSize = 20.0;
+
+  int c;
+  while ((c = getopt(argc, argv, "n:s:p:r:v:h")) != -1) {
+    switch (c) {
+      case 'n': nrPoints = atoi(optarg); break;
+      case 's': nrScans = atoi(optarg); break;
+      case 'p': nrPicks = atoi(optarg); break;
+      case 'r': radius = atof(optarg); break;
+      case 'v': voxelSize = atof(optarg); break;
+      default:  usage(argv[0]);
+    }
+  }
+
+  if (nrPoints < 1 || nrScans < 1 || nrPicks < 1 || radius < 0 || voxelSize <= 0)
+    usage(argv[0]);
+
+  // scans of a 100 m box, every scan 10 m further along x
+  srand(0);
+  vector< vector<float*> > pts(nrScans);
+  vector<double*> scanPoses(nrScans);
+  vector<colordisplay*> trees;
+  cout << "Building " << nrScans << " scans of " << nrPoints << " points ..." << endl;
+  for (int s = 0; s < nrScans; s++) {
+    scanPoses[s] = new double[16];
+    M4identity(scanPoses[s]);
+    scanPoses[s][12] = 1000.0 * s;
+    for (int i = 0; i < nrPoints; i++) {
+      float *p = new float[3];
+      for (int k = 0; k < 3; k++) {
+        p[k] = 10000.0 * rand() / RAND_MAX - 5000.0;
+      }
+      pts[s].push_back(p);
+    }
+    trees.push_back(new Show_BOctTree<float>(&pts[s][0], nrPoints, voxelSize));
+  }
+  vector<const double*> poses(scanPoses.begin(), scanPoses.end());
+
+  // the camera looks along -z from 70 m in front of the box, as gluLookAt
+  // and gluPerspective with a field of view of 60 degrees would set it
+  const int viewport[4] = {0, 0, 960, 540};
+  double modelview[16], projection[16] = {0};
+  M4identity(modelview);
+  modelview[12] = -1000.0 * (nrScans - 1) / 2.0;
+  modelview[14] = -12000.0;
+  double f = 1.0 / tan(rad(60.0) / 2.0), neardistance = 10.0, fardistance = 40000.0;
+  projection[0] = f * viewport[3] / viewport[2];
+  projection[5] = f;
+  projection[10] = (fardistance + neardistance) / (neardistance - fardistance);
+  projection[11] = -1.0;
+  projection[14] = 2.0 * fardistance * neardistance / (neardistance - fardistance);
+
+  vector<int> xs(nrPicks), ys(nrPicks);
+  for (int i = 0; i < nrPicks; i++) {
+    xs[i] = rand() % viewport[2];
+    ys[i] = rand() % viewport[3];
+  }
+
+  for (int brush = 0; brush < 2; brush++) {
+    float r = brush ? radius : 5.0;
+    unsigned int k = brush ? 0 : 1;
+    vector<PickHit<float> > hits, reference;
+    unsigned long total = 0, found = 0;
+    int wrong = 0;
+    for (int i = 0; i < nrPicks; i++) {
+      unsigned long start = GetCurrentTimeInMilliSec();
+      pickScans(trees, poses, modelview, projection, viewport, xs[i], ys[i], r, k, hits);
+      total += GetCurrentTimeInMilliSec() - start;
+      found += hits.size();
+
+      pickAll(pts, poses, modelview, projection, viewport, xs[i], ys[i], r, reference);
+      if (k > 0 && reference.size() > k) reference.resize(k);
+      if (hits.size() != reference.size() || (!hits.empty() && hits[0].depth != reference[0].depth))
+        wrong++;
+    }
+
+    double seconds = total / 1000.0;
+    cout << (brush ? "Brush" : "Nearest point") << ", radius " << r << " pixels:" << endl
+         << "  picks per second: " << (seconds > 0 ? nrPicks / seconds : 0)
+         << ", points per pick: " << (double)found / nrPicks
+         << ", wrong picks: " << wrong << endl;
+  }
+
+  for (int s = 0; s < nrScans; s++) {
+    delete trees[s];
+    for (int i = 0; i < nrPoints; i++) {
+      delete[] pts[s][i];
+    }
+    delete[] scanPoses[s];
+  }
+  return 0;
+}
@@ -0,0 +1,45 @@
+/**
+ * @file
+ * @brief Implementation of the pick rays
+ */
+
+#include "show/raypick.h"
+#include "show/viewcull.h"
+#include <math.h>
+
+void PickRay::set(const double *modelview, const double *projection, const int *viewport,
+                  int x, int y, float radius)
+{
+  double nx, ny, nz, fx, fy, fz;
+  gluUnProject(x, viewport[3] - y, 0.0, modelview, projection, viewport, &nx, &ny, &nz);
+  gluUnProject(x, viewport[3] - y, 1.0, modelview, projection, viewport, &fx, &fy, &fz);
+
+  origin[0] = nx;
+  origin[1] = ny;
+  origin[2] = nz;
+  double d[3] = {fx - nx, fy - ny, fz - nz};
+  double t = sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+  for (int i = 0; i < 3; i++) {
+    dir[i] = d[i] / t;
+    invdir[i] = dir[i] != 0.0 ? 1.0 / dir[i] : 0.0;
+  }
+
+  // edge length of a pixel at unit distance from the eye (perspective)
+  // or anywhere (orthographic)
+  double pixel = 2.0 / (projection[5] * viewport[3]);
+  if (projection[15] == 0.0) {
+    // the eye is at the origin of the camera coordinates
+    double eye[3];
+    for (int i = 0; i < 3; i++) {
+      eye[i] = -(modelview[4*i + 0] * modelview[12] + modelview[4*i + 1] * modelview[13]
+                 + modelview[4*i + 2] * modelview[14]);
+    }
+    double e = sqrt((nx - eye[0]) * (nx - eye[0]) + (ny - eye[1]) * (ny - eye[1])
+                    + (nz - eye[2]) * (nz - eye[2]));
+    slope = radius * pixel;
+    width = slope * e;
+  } else {
+    slope = 0.0;
+    width = radius * pixel;
+  }
+}
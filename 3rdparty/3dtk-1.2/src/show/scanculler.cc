@@ -0,0 +1,116 @@
+/**
+ * @file
+ * @brief Implementation of the parallel culling of all scans
+ */
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "show/scanculler.h"
+#include "show/viewcull.h"
+#include "slam6d/globals.icc"
+
+ScanCuller::ScanCuller(const vector<colordisplay*> &_trees, unsigned long _budget) :
+  trees(_trees), buffered(_trees.size(), false), budget(_budget), scale(1.0), ratio(1.0),
+  points(0), traversals(0)
+{
+  for (unsigned int i = 0; i < trees.size(); i++) {
+    buffers.push_back(new vertexBuffer());
+  }
+}
+
+ScanCuller::~ScanCuller()
+{
+  for (unsigned int i = 0; i < buffers.size(); i++) {
+    delete buffers[i];
+  }
+}
+
+/**
+ * Selects the points of all scans for the next frame
+ *
+ * @param modelview the camera matrix
+ * @param projection the projection matrix
+ * @param viewport x, y, width and height of the viewport
+ * @param detail as for ExtractFrustum
+ * @param poses the transformation matrix of each scan, NULL for scans not shown
+ * @param lod the requested level of detail
+ * @return the number of points selected
+ */
+unsigned long ScanCuller::cull(const double *modelview, const double *projection, const int *viewport,
+                               short detail, const vector<const double*> &poses, float lod)
+{
+  ratio = lod * scale;
+  points = extract(modelview, projection, viewport, detail, poses, ratio);
+  unsigned int visited = traversals;
+
+  if (budget > 0 && points > budget) {
+    // over budget, select fewer points right away
+    scale *= (float)budget / points;
+    ratio = lod * scale;
+    points = extract(modelview, projection, viewport, detail, poses, ratio);
+    traversals += visited;
+  } else if (budget > 0 && scale < 1.0 && points < budget / 2) {
+    // there is room, use it from the next frame on
+    if (points > 0) {
+      scale = min(1.0f, 0.9f * scale * budget / points);
+    } else {
+      scale = 1.0;
+    }
+  }
+
+  return points;
+}
+
+/**
+ * Updates the buffers of all scans in parallel, every thread culls
+ * with its own frustum (the variables of viewcull are thread private)
+ *
+ * @return the number of points in all buffers
+ */
+unsigned long ScanCuller::extract(const double *modelview, const double *projection, const int *viewport,
+                                  short detail, const vector<const double*> &poses, float lod)
+{
+  unsigned long nrpoints = 0;
+  unsigned int nrtraversals = 0;
+  int n = trees.size();
+
+#ifdef _OPENMP
+  omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic) reduction(+:nrpoints, nrtraversals)
+#endif
+  for (int i = 0; i < n; i++) {
+    if (!poses[i]) continue;
+
+    double scanview[16];
+    MMult(modelview, poses[i], scanview);
+    ExtractFrustum(scanview, projection, viewport, detail);
+
+    unsigned int fills = buffers[i]->getFills();
+    buffered[i] = trees[i]->updateLOD(lod, *buffers[i]);
+    if (buffered[i]) {
+      nrpoints += buffers[i]->size();
+      nrtraversals += buffers[i]->getFills() - fills;
+    }
+  }
+
+  traversals = nrtraversals;
+  return nrpoints;
+}
+
+/**
+ * Draws the points selected for the scan. The scan pose must be
+ * set in OpenGL. Trees that could not store their points are
+ * drawn directly, this needs the frustum of the scan.
+ *
+ * @param scan index of the scan
+ */
+void ScanCuller::display(unsigned int scan)
+{
+  if (buffered[scan]) {
+    trees[scan]->displayBuffer(*buffers[scan]);
+  } else {
+    trees[scan]->displayLOD(ratio);
+  }
+}
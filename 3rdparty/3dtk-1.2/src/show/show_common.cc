@@ -7,6 +7,8 @@
 #include "show/compacttree.h"
 #include "show/NurbsPath.h"
 #include "show/vertexarray.h"
+#include "show/scanculler.h"
+#include "show/scanpicker.h"
 #include "slam6d/scan.h"
 #include "glui/glui.h"  /* Header File For The glui functions */
 #include <fstream>
@@ -53,6 +55,10 @@ vector< ::SDisplay*> displays;
  */
 //Show_BOctTree **octpts;
 vector<colordisplay*> octpts;
+/**
+ * selects the points of all octrees shown in a frame
+ */
+ScanCuller *culler;
 /**
  * Storing the base directory
  */
@@ -191,6 +197,11 @@ int START_HEIGHT         = 576;
 GLdouble aspect          = (double)START_WIDTH/(double)START_HEIGHT;          // Current aspect ratio
 bool advanced_controls = false;
 
+/**
+ * compact octrees are saved and loaded as memory mapped files (.moct)
+ */
+bool mapOct = false;
+
 bool fullscreen = false;
 int current_width = START_WIDTH;
 int current_height = START_HEIGHT;
@@ -211,6 +222,11 @@ double voxelSize = 0.20;
 float adaption_rate = 1.0;
 float LevelOfDetail = 0.0001;
 
+/**
+ * maximal number of points drawn per frame, 0 for no limit
+ */
+unsigned long pointBudget = 0;
+
 
 // Defines for Point Semantic
 #define TYPE_UNKNOWN         0x0000
@@ -303,6 +319,9 @@ void usage(char* prog)
 	  << "   " << prog << " [options] directory" << endl << endl;
   cout << bold << "OPTIONS" << normal << endl
 
+	  << bold << "  -b" << normal << " NR, " << bold << "--budget=" << normal << "NR" << endl
+	  << "         draw at most NR points per frame, the level of detail is lowered if needed" << endl
+	  << endl
 	  << bold << "  -e" << normal << " NR, " << bold << "--end=" << normal << "NR" << endl
 	  << "         end after scan NR" << endl
 	  << endl
@@ -377,6 +396,10 @@ void usage(char* prog)
 	  << "         All reflectivity/amplitude/deviation/type settings are read from file." << endl
 	  << "         --reflectance/--amplitude and similar parameters are therefore ignored." << endl
 	  << "         only works when using octree display" << endl
+    << bold << "  --mapOct" << endl << normal
+	  << "         with --saveOct/--loadOct the octrees are stored in files (.moct) that are" << endl
+	  << "         memory mapped when loading, points are only read when they are displayed" << endl
+	  << "         only works when using compact octree display" << endl
     << endl << endl;
   
   exit(1);
@@ -414,6 +437,7 @@ int parseArgs(int argc,char **argv, string &dir, int& start, int& end, int& maxD
     { "origin",          optional_argument,   0,  'o' },
     { "format",          required_argument,   0,  'f' },  
     { "fps",             required_argument,   0,  'F' },  
+    { "budget",          required_argument,   0,  'b' },
     { "scale",           required_argument,   0,  'S' },
     { "start",           required_argument,   0,  's' },
     { "end",             required_argument,   0,  'e' },
@@ -432,10 +456,11 @@ int parseArgs(int argc,char **argv, string &dir, int& start, int& end, int& maxD
     { "saveOct",         no_argument,         0,  '0' },
     { "loadOct",         no_argument,         0,  '1' },
     { "advanced",        no_argument,         0,  '2' },
+    { "mapOct",          no_argument,         0,  '3' },
     { 0,           0,   0,   0}                    // needed, cf. getopt.h
   };
 
-  while ((c = getopt_long(argc, argv,"F:f:s:e:r:m:M:O:o:l:wtRadhTc", longopts, NULL)) != -1)
+  while ((c = getopt_long(argc, argv,"F:b:f:s:e:r:m:M:O:o:l:wtRadhTc", longopts, NULL)) != -1)
     switch (c)
 	 {
 	 case 's':
@@ -494,6 +519,9 @@ int parseArgs(int argc,char **argv, string &dir, int& start, int& end, int& maxD
    case 'F':
      fps = atof(optarg);
      break;
+   case 'b':
+     pointBudget = atol(optarg);
+     break;
    case 'S':
      scale = atof(optarg);
      break;
@@ -516,6 +544,9 @@ int parseArgs(int argc,char **argv, string &dir, int& start, int& end, int& maxD
    case '2':
      advanced_controls = true; 
      break;
+   case '3':
+     mapOct = true;
+     break;
    default:
      abort ();
    }
@@ -845,13 +876,25 @@ void initShow(int argc, char **argv){
     loadOct = true;
   }
 
+#ifndef USE_COMPACT_TREE
+  if (mapOct) {
+    cerr << "--mapOct requires the compact octree display, ignored" << endl;
+    mapOct = false;
+  }
+#endif
+  string octExtension = mapOct ? ".moct" : ".oct";
+
   // if we want to load display file get pointtypes from the files first
   if (loadOct) {
-    string scanFileName = dir + "scan" + to_string(start,3) + ".oct";
+    string scanFileName = dir + "scan" + to_string(start,3) + octExtension;
     cout << "Getting point information from " << scanFileName << endl;
     cout << "Attention! All subsequent oct-files must be of the same type!" << endl;
 
+#ifdef USE_COMPACT_TREE
+    pointtype = compactTree::readType(scanFileName);
+#else
     pointtype = BOctTree<sfloat>::readType(scanFileName);
+#endif
   }
   scandirectory = dir;
 
@@ -895,8 +938,8 @@ void initShow(int argc, char **argv){
   
   if (loadOct) {
     for (int i = start; i <= end; i++) {
-      string scanFileName = dir + "scan" + to_string(i,3) + ".oct";
-      cout << "Reading octree " << scanFileName << endl;
+      string scanFileName = dir + "scan" + to_string(i,3) + octExtension;
+      cout << (mapOct ? "Mapping octree " : "Reading octree ") << scanFileName << endl;
 #ifdef USE_COMPACT_TREE
       octpts.push_back(new compactTree(scanFileName, cm));
 #else
@@ -926,9 +969,13 @@ void initShow(int argc, char **argv){
         delete[] pts;
       }
       if (saveOct) {
-        string scanFileName = dir + "scan" + to_string(i+start,3) + ".oct";
+        string scanFileName = dir + "scan" + to_string(i+start,3) + octExtension;
         cout << "Saving octree " << scanFileName << endl;
-        tree->serialize(scanFileName);
+        if (mapOct) {
+          tree->serializeMapped(scanFileName);
+        } else {
+          tree->serialize(scanFileName);
+        }
       }
       octpts.push_back(tree);
       cout << "Scan " << i << " octree finished. Deleting original points.." << endl;
@@ -968,6 +1015,7 @@ void initShow(int argc, char **argv){
   //cm->setColorMap(cmap);
   resetMinMax(0);
 
+  culler = new ScanCuller(octpts, pointBudget);
   selected_points = new set<sfloat*>[octpts.size()];
   
   // sets (and computes if necessary) the pose that is used for the reset button
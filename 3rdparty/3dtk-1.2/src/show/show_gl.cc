@@ -104,6 +104,24 @@ void DrawPoints(GLenum mode, bool interruptable)
       vector<int> sequence;
       calcPointSequence(sequence, current_frame);
 #ifdef USE_GL_POINTS
+      if (pointmode != 1 && !interruptable) {
+        // select the points of all scans at once, scans whose view did
+        // not change keep the points of the last frame
+        if (current_frame != (int)MetaMatrix.back().size() - 1) {
+          cm->setMode(ScanColorManager::MODE_ANIMATION);
+        }
+        vector<const double*> poses(octpts.size(), (const double*)0);
+        for (unsigned int i = 0; i < sequence.size(); i++) {
+          if (MetaAlgoType[sequence[i]][current_frame] != Scan::INVALID)
+            poses[sequence[i]] = MetaMatrix[sequence[i]][current_frame];
+        }
+        GLdouble modelMatrix[16], projMatrix[16];
+        GLint viewport[4];
+        glGetDoublev(GL_MODELVIEW_MATRIX, modelMatrix);
+        glGetDoublev(GL_PROJECTION_MATRIX, projMatrix);
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        culler->cull(modelMatrix, projMatrix, viewport, pointsize, poses, LevelOfDetail);
+      }
       //for(int iterator = (int)octpts.size()-1; iterator >= 0; iterator--) {
       for(unsigned int i = 0; i < sequence.size(); i++) {
         int iterator = sequence[i];
@@ -146,7 +164,7 @@ void DrawPoints(GLenum mode, bool interruptable)
           }
           octpts[iterator]->display();
         } else {
-          octpts[iterator]->displayLOD(LevelOfDetail);
+          culler->display(iterator);
         }
         if (!selected_points[iterator].empty()) {
           glColor4f(1.0, 0.0, 0.0, 1.0);
@@ -1095,16 +1113,31 @@ void selectPoints(int x, int y) {
 
       //        selected_points[iterator].clear();
     }*/
-    for(int iterator = (int)octpts.size()-1; iterator >= 0; iterator--) {
-      glPushMatrix();
-      glMultMatrixd(MetaMatrix[iterator].back());
-      calcRay(x, y, 1.0, 40000.0);
-      if (select_voxels) {
+    if (select_voxels) {
+      for(int iterator = (int)octpts.size()-1; iterator >= 0; iterator--) {
+        glPushMatrix();
+        glMultMatrixd(MetaMatrix[iterator].back());
+        calcRay(x, y, 1.0, 40000.0);
         octpts[iterator]->selectRay(selected_points[iterator], selection_depth);
-      } else if (brush_size == 0) {
-        sfloat *sp = 0;
-        octpts[iterator]->selectRay(sp);
-        if (sp != 0) {
+        glPopMatrix();
+      }
+    } else {
+      // pick in all scans at once
+      GLdouble modelMatrix[16], projMatrix[16];
+      GLint viewport[4];
+      glGetDoublev(GL_MODELVIEW_MATRIX, modelMatrix);
+      glGetDoublev(GL_PROJECTION_MATRIX, projMatrix);
+      glGetIntegerv(GL_VIEWPORT, viewport);
+      vector<const double*> poses;
+      for (unsigned int iterator = 0; iterator < octpts.size(); iterator++) {
+        poses.push_back(MetaMatrix[iterator].back());
+      }
+
+      vector<PickHit<sfloat> > hits;
+      if (brush_size == 0) {
+        pickScans(octpts, poses, modelMatrix, projMatrix, viewport, x, y, 5.0, 1, hits);
+        if (!hits.empty()) {
+          sfloat *sp = hits[0].point;
           cout << "Selected point: " << sp[0] << " " << sp[1] << " " << sp[2] << endl;
 
           if (sp2 != 0) {
@@ -1112,13 +1145,14 @@ void selectPoints(int x, int y) {
           }
           sp2 = sp;
 
-          selected_points[iterator].insert(sp);
+          selected_points[hits[0].scan].insert(sp);
         }
       } else { // select multiple points with a given brushsize
-        octpts[iterator]->selectRayBrushSize(selected_points[iterator], brush_size);
+        pickScans(octpts, poses, modelMatrix, projMatrix, viewport, x, y, brush_size, 0, hits);
+        for (unsigned int i = 0; i < hits.size(); i++) {
+          selected_points[hits[i].scan].insert(hits[i].point);
+        }
       }
-
-      glPopMatrix();
     }
 
   } else {
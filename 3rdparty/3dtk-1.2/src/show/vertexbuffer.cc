@@ -0,0 +1,114 @@
+/**
+ * @file
+ * @brief Implementation of a reusable buffer of decoded points
+ */
+
+#ifdef WITH_GLEE
+#include <GLee.h>
+#endif
+
+#include "show/vertexbuffer.h"
+#include "show/viewcull.h"
+
+vertexBuffer::vertexBuffer() :
+  cm(0), valid(false), colored(false), textured(false), fills(0), vbo(0), uploaded(false)
+{
+}
+
+vertexBuffer::~vertexBuffer()
+{
+#ifdef WITH_GLEE
+  if (vbo) glDeleteBuffersARB(1, &vbo);
+#endif
+}
+
+void vertexBuffer::begin(float _ratio, int _mode, ColorManager *_cm)
+{
+  vertices.clear();
+  texcoords.clear();
+  colors.clear();
+  uploaded = false;
+  fills++;
+
+  for (int i = 0; i < 16; i++) viewmatrix[i] = matrix[i];
+  for (int i = 0; i < 4; i++) viewport[i] = VP[i];
+  detail = DETAIL;
+  ratio = _ratio;
+  mode = _mode;
+  cm = _cm;
+  revision = cm ? cm->getRevision() : 0;
+  valid = true;
+
+  colored = cm != 0;
+  if (colored) {
+    textured = cm->isTextured();
+    colordim = cm->getColorDim();
+    min = cm->getMin();
+    extent = cm->getExtent();
+  }
+}
+
+bool vertexBuffer::isCurrent(float _ratio, int _mode, ColorManager *_cm) const
+{
+  if (!valid || ratio != _ratio || mode != _mode || cm != _cm || detail != DETAIL)
+    return false;
+  if (cm && revision != cm->getRevision())
+    return false;
+  for (int i = 0; i < 4; i++)
+    if (viewport[i] != VP[i]) return false;
+  for (int i = 0; i < 16; i++)
+    if (viewmatrix[i] != matrix[i]) return false;
+  return true;
+}
+
+void vertexBuffer::draw()
+{
+  if (vertices.empty()) return;
+
+  const GLvoid *vertexdata = &vertices[0];
+  const GLvoid *texcoorddata = texcoords.empty() ? 0 : &texcoords[0];
+  const GLvoid *colordata = colors.empty() ? 0 : &colors[0];
+
+#ifdef WITH_GLEE
+  // upload the buffer once, afterwards the arrays are offsets into it
+  if (GLEE_ARB_vertex_buffer_object) {
+    GLsizeiptrARB vsize = vertices.size() * sizeof(GLfloat);
+    GLsizeiptrARB tsize = texcoords.size() * sizeof(GLfloat);
+    GLsizeiptrARB csize = colors.size() * sizeof(GLubyte);
+
+    if (!vbo) glGenBuffersARB(1, &vbo);
+    glBindBufferARB(GL_ARRAY_BUFFER_ARB, vbo);
+    if (!uploaded) {
+      glBufferDataARB(GL_ARRAY_BUFFER_ARB, vsize + tsize + csize, 0, GL_DYNAMIC_DRAW_ARB);
+      glBufferSubDataARB(GL_ARRAY_BUFFER_ARB, 0, vsize, vertexdata);
+      if (tsize) glBufferSubDataARB(GL_ARRAY_BUFFER_ARB, vsize, tsize, texcoorddata);
+      if (csize) glBufferSubDataARB(GL_ARRAY_BUFFER_ARB, vsize + tsize, csize, colordata);
+      uploaded = true;
+    }
+    vertexdata = (const GLvoid *)0;
+    if (texcoorddata) texcoorddata = (const GLvoid *)vsize;
+    if (colordata) colordata = (const GLvoid *)(vsize + tsize);
+  }
+#endif
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glVertexPointer(3, GL_FLOAT, 0, vertexdata);
+  if (texcoorddata) {
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glTexCoordPointer(1, GL_FLOAT, 0, texcoorddata);
+  }
+  if (colordata) {
+    glEnableClientState(GL_COLOR_ARRAY);
+    glColorPointer(3, GL_UNSIGNED_BYTE, 0, colordata);
+  }
+
+  glDrawArrays(GL_POINTS, 0, size());
+
+  if (colordata) glDisableClientState(GL_COLOR_ARRAY);
+  if (texcoorddata) glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+
+#ifdef WITH_GLEE
+  if (GLEE_ARB_vertex_buffer_object) glBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+#endif
+}
@@ -29,6 +29,10 @@ float right[3];
 /** how much detail is shown, 0 means everything is plotted */
 short DETAIL;
 
+#ifdef _OPENMP
+#pragma omp threadprivate(frustum, matrix, VP, right, DETAIL)
+#endif
+
 double SX, SY, SZ, EX, EY, EZ;
 float origin[3], dir[3];   /*ray */
 float dist;
@@ -78,6 +82,17 @@ void remViewport() {
   glGetDoublev(GL_PROJECTION_MATRIX,projMatrix);
   glGetIntegerv(GL_VIEWPORT,viewport);
 
+  remViewport(modelMatrix, projMatrix, viewport);
+}
+
+/**
+ * Remembers the given viewport without querying OpenGL
+ *
+ * @param modelMatrix the modelview matrix
+ * @param projMatrix the projection matrix
+ * @param viewport x, y, width and height of the viewport
+ */
+void remViewport(const double *modelMatrix, const double *projMatrix, const int *viewport) {
   MMult( projMatrix, modelMatrix, matrix );
   VP[0] = 0.5*viewport[2];
   VP[1] = 0.5*viewport[2] + viewport[0];
@@ -91,20 +106,40 @@ void remViewport() {
 }
 
 void ExtractFrustum(short detail)
+{
+  GLdouble modelMatrix[16];
+  GLdouble projMatrix[16];
+  int viewport[4];
+  glGetDoublev(GL_MODELVIEW_MATRIX,modelMatrix);
+  glGetDoublev(GL_PROJECTION_MATRIX,projMatrix);
+  glGetIntegerv(GL_VIEWPORT,viewport);
+
+  ExtractFrustum(modelMatrix, projMatrix, viewport, detail);
+}
+
+/**
+ * Extracts the viewing frustum from the given matrices instead of the
+ * current OpenGL state, so that culling also works without a context
+ *
+ * @param modelMatrix the modelview matrix
+ * @param projMatrix the projection matrix
+ * @param viewport x, y, width and height of the viewport
+ * @param detail how much detail is shown, 0 means everything is plotted
+ */
+void ExtractFrustum(const double *modelMatrix, const double *projMatrix, const int *viewport, short detail)
 {
    DETAIL = detail + 1;
-   remViewport();
+   remViewport(modelMatrix, projMatrix, viewport);
 
    float   proj[16];
    float   modl[16];
    float   clip[16];
    float   t;
 
-   /* Get the current PROJECTION matrix from OpenGL */
-   glGetFloatv( GL_PROJECTION_MATRIX, proj );
-
-   /* Get the current MODELVIEW matrix from OpenGL */
-   glGetFloatv( GL_MODELVIEW_MATRIX, modl );
+   for (int i = 0; i < 16; i++) {
+     proj[i] = projMatrix[i];
+     modl[i] = modelMatrix[i];
+   }
 
    /* Combine the two matrices (multiply projection by modelview) */
    clip[ 0] = modl[ 0] * proj[ 0] + modl[ 1] * proj[ 4] + modl[ 2] * proj[ 8] + modl[ 3] * proj[12];
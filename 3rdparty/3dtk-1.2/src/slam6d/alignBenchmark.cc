@@ -0,0 +1,333 @@
+/**
+ * @file
+ * @brief Measures the closed form alignment of point pairs
+ *
+ * alignBenchmark
+ *
+ * Random model points are moved by a known transformation and a little
+ * noise. The pairs are aligned by icp6D_QUAT, icp6D_SVD and
+ * icp6D_FASTQUAT, the pairs per second and the difference to the
+ * transformation of icp6D_QUAT are printed. The accumulation of the
+ * cross covariance and the solution of the eigen problem are timed on
+ * their own for icp6D_QUAT and icp6D_FASTQUAT, the eigen problems of
+ * random and of anisotropic cross covariances as in ICP.
+ */
+
+#include "slam6d/icp6Dquat.h"
+#include "slam6d/icp6Dsvd.h"
+#include "slam6d/icp6Dfastquat.h"
+#include "slam6d/globals.icc"
+#include "slam6d/fixedmatrix.icc"
+
+#include "newmat/newmat.h"
+#include "newmat/newmatap.h"
+using namespace NEWMAT;
+
+#include <cstdlib>
+#include <cmath>
+#include <iostream>
+#include <vector>
+using std::cout;
+using std::endl;
+using std::vector;
+
+#ifdef _MSC_VER
+  #include "XGetopt.h"
+#else
+  #include <getopt.h>
+#endif
+
+/**
+ * Explains the usage of this program's command line parameters
+ *
+ * @param prog name of the program
+ */
+void usage(char* prog)
+{
+  cout << endl
+       << "Usage: " << prog << " [-n NR] [-r NR] [-s NR]" << endl << endl;
+
+  cout << "  -n NR   number of point pairs (default 100000)" << endl
+       << "  -r NR   number of runs (default 50)" << endl
+       << "  -s NR   number of eigen problems solved (default 200000)" << endl
+       << endl;
+
+  exit(1);
+}
+
+/**
+ * Gives access to the eigen solver of icp6D_QUAT
+ */
+class QuatSolver : public icp6D_QUAT
+{
+public:
+  QuatSolver() : icp6D_QUAT(true) {};
+  void solve(double Q[4][4], double q[4]) { maxEigenVector(Q, q); };
+};
+
+/**
+ * Largest difference of two transformation matrices
+ */
+double maxDiff(const double *a, const double *b)
+{
+  double diff = 0.0;
+  for (int i = 0; i < 16; i++) diff = max(diff, fabs(a[i] - b[i]));
+  return diff;
+}
+
+/**
+ * Rayleigh quotient of a symmetric 4x4 matrix and a unit vector
+ */
+double rayleigh(const double Q[4][4], const double *v)
+{
+  double r = 0.0;
+  for (int i = 0; i < 4; i++)
+    for (int j = 0; j < 4; j++)
+      r += v[i] * Q[i][j] * v[j];
+  return r;
+}
+
+/**
+ * The cross covariance as icp6D_QUAT::Point_Point_Align sums it up
+ */
+double quatCovariance(const vector<PtPair> &pairs, double S[3][3])
+{
+  double sum = 0.0;
+  for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++)
+      S[i][j] = 0.0;
+  for (unsigned int i = 0; i < pairs.size(); i++) {
+    sum += sqr(pairs[i].p1.x - pairs[i].p2.x)
+         + sqr(pairs[i].p1.y - pairs[i].p2.y)
+         + sqr(pairs[i].p1.z - pairs[i].p2.z);
+    S[0][0] += pairs[i].p2.x * pairs[i].p1.x;
+    S[0][1] += pairs[i].p2.x * pairs[i].p1.y;
+    S[0][2] += pairs[i].p2.x * pairs[i].p1.z;
+    S[1][0] += pairs[i].p2.y * pairs[i].p1.x;
+    S[1][1] += pairs[i].p2.y * pairs[i].p1.y;
+    S[1][2] += pairs[i].p2.y * pairs[i].p1.z;
+    S[2][0] += pairs[i].p2.z * pairs[i].p1.x;
+    S[2][1] += pairs[i].p2.z * pairs[i].p1.y;
+    S[2][2] += pairs[i].p2.z * pairs[i].p1.z;
+  }
+  return sum;
+}
+
+/**
+ * Aligns the pairs runs times
+ *
+ * @return pairs per second
+ */
+double alignRate(icp6Dminimizer *minimizer, const vector<PtPair> &pairs,
+                 const double *cm, const double *cd, int runs, double *alignxf)
+{
+  unsigned long start = GetCurrentTimeInMilliSec();
+  for (int i = 0; i < runs; i++) {
+    minimizer->Point_Point_Align(pairs, alignxf, cm, cd);
+  }
+  double ms = max(1.0, (double)(GetCurrentTimeInMilliSec() - start));
+  return 1000.0 * runs * pairs.size() / ms;
+}
+
+/**
+ * The cross covariance S = C R^T + noise of points with the covariance C
+ * and the rotated points
+ *
+ * @param C covariance of the points
+ * @param R rotation, R[k + 4*j] is row k, column j
+ * @param noise largest noise added to each element
+ * @param S the cross covariance, row by row
+ */
+void rotatedCovariance(const double C[3][3], const double *R, double noise, double *S)
+{
+  for (int j = 0; j < 3; j++)
+    for (int k = 0; k < 3; k++)
+      S[3*j + k] = C[j][0]*R[k] + C[j][1]*R[k + 4] + C[j][2]*R[k + 8]
+                 + noise * rand() / RAND_MAX;
+}
+
+/**
+ * Solves the eigen problems of the cross covariances by icp6D_QUAT and
+ * icp6D_FASTQUAT, prints the solutions per second and how many of them
+ * are not the eigenvector of the largest eigenvalue
+ *
+ * @param name name of the cross covariances
+ * @param covariances 1000 cross covariances, row by row
+ * @param solves number of eigen problems solved
+ */
+void solveRate(const char *name, const vector<double> &covariances, int solves)
+{
+  QuatSolver quatSolver;
+  vector<double> q1(4 * 1000), q2(4 * 1000);
+  unsigned long start = GetCurrentTimeInMilliSec();
+  for (int i = 0; i < solves; i++) {
+    double Q[4][4];
+    HornMatrix((const double (*)[3])&covariances[9 * (i % 1000)], Q);
+    quatSolver.solve(Q, &q1[4 * (i % 1000)]);
+  }
+  double quatsolve = max(1.0, (double)(GetCurrentTimeInMilliSec() - start));
+
+  int fallbacks = 0;
+  start = GetCurrentTimeInMilliSec();
+  for (int i = 0; i < solves; i++) {
+    double Q[4][4];
+    HornMatrix((const double (*)[3])&covariances[9 * (i % 1000)], Q);
+    if (!maxEigenVectorSym4(Q, &q2[4 * (i % 1000)])) {
+      quatSolver.solve(Q, &q2[4 * (i % 1000)]);
+      if (i < 1000) fallbacks++;
+    }
+  }
+  double fastsolve = max(1.0, (double)(GetCurrentTimeInMilliSec() - start));
+
+  // a solution is wrong if its Rayleigh quotient is smaller than the
+  // largest eigenvalue that newmat finds
+  int quatwrong = 0, fastwrong = 0;
+  for (int i = 0; i < 1000 && i < solves; i++) {
+    double Q[4][4];
+    HornMatrix((const double (*)[3])&covariances[9 * i], Q);
+    SymmetricMatrix N(4);
+    for (int j = 0; j < 4; j++)
+      for (int k = 0; k <= j; k++)
+        N(j + 1, k + 1) = Q[j][k];
+    DiagonalMatrix D(4);
+    EigenValues(N, D);
+    double eps = 1e-9 * max(1.0, fabs(D(4)));
+    if (rayleigh(Q, &q1[4 * i]) < D(4) - eps) quatwrong++;
+    if (rayleigh(Q, &q2[4 * i]) < D(4) - eps) fastwrong++;
+  }
+
+  cout << name << " cross covariances:" << endl
+       << "solve QUAT:     " << 1000.0 * solves / quatsolve << " solutions/s, "
+       << quatwrong << " wrong" << endl
+       << "solve FASTQUAT: " << 1000.0 * solves / fastsolve << " solutions/s, "
+       << fastwrong << " wrong, " << fallbacks << " of "
+       << min(1000, solves) << " solved by QUAT" << endl;
+}
+
+/**
+ * Main program. Creates the pairs and aligns them.
+ *
+ * @param argc count of the command-line arguments
+ * @param argv command-line arguments
+ */
+int main(int argc, char **argv)
+{
+  int nrPairs = 100000;
+  int runs = 50;
+  int solves = 200000;
+
+  int c;
+  while ((c = getopt(argc, argv, "n:r:s:")) != -1) {
+    switch (c) {
+      case 'n': nrPairs = atoi(optarg); break;
+      case 'r': runs = atoi(optarg); break;
+      case 's': solves = atoi(optarg); break;
+      default:  usage(argv[0]);
+    }
+  }
+
+  if (nrPairs < 4 || runs < 1 || solves < 1)
+    usage(argv[0]);
+
+  // model points in a 40 m cube, the data points are moved by 10 degrees
+  // and half a meter, with 1 cm of noise
+  srand(0);
+  double rPos[3] = {30.0, -20.0, 40.0};
+  double rPosTheta[3] = {rad(4.0), rad(-10.0), rad(3.0)};
+  double transMat[16], transMatInv[16];
+  EulerToMatrix4(rPos, rPosTheta, transMat);
+  M4inv(transMat, transMatInv);
+
+  vector<PtPair> pairs;
+  double cm[3] = {0.0, 0.0, 0.0};
+  double cd[3] = {0.0, 0.0, 0.0};
+  for (int i = 0; i < nrPairs; i++) {
+    double p1[3], p2[3];
+    for (int j = 0; j < 3; j++) p1[j] = 4000.0 * rand() / RAND_MAX - 2000.0;
+    transform3(transMatInv, p1, p2);
+    for (int j = 0; j < 3; j++) {
+      p2[j] += 2.0 * rand() / RAND_MAX - 1.0;
+      cm[j] += p1[j];
+      cd[j] += p2[j];
+    }
+    pairs.push_back(PtPair(p1, p2));
+  }
+  for (int j = 0; j < 3; j++) {
+    cm[j] /= nrPairs;
+    cd[j] /= nrPairs;
+  }
+
+  cout << "Aligning " << nrPairs << " pairs, " << runs << " runs ..." << endl;
+
+  icp6D_QUAT quat(true);
+  icp6D_SVD svd(true);
+  icp6D_FASTQUAT fastquat(true);
+  double quatxf[16], svdxf[16], fastxf[16];
+  double quatrate = alignRate(&quat, pairs, cm, cd, runs, quatxf);
+  double svdrate = alignRate(&svd, pairs, cm, cd, runs, svdxf);
+  double fastrate = alignRate(&fastquat, pairs, cm, cd, runs, fastxf);
+
+  cout << "QUAT:     " << quatrate << " pairs/s" << endl
+       << "SVD:      " << svdrate << " pairs/s, difference " << maxDiff(svdxf, quatxf) << endl
+       << "FASTQUAT: " << fastrate << " pairs/s, difference " << maxDiff(fastxf, quatxf) << endl
+       << "          difference to the true transformation " << maxDiff(fastxf, transMat) << endl;
+
+  // the phases of FASTQUAT
+  double S[3][3];
+  unsigned long start = GetCurrentTimeInMilliSec();
+  for (int i = 0; i < runs; i++) {
+    quatCovariance(pairs, S);
+  }
+  double quataccumulate = max(1.0, (double)(GetCurrentTimeInMilliSec() - start));
+
+  start = GetCurrentTimeInMilliSec();
+  for (int i = 0; i < runs; i++) {
+    icp6D_FASTQUAT::crossCovariance(pairs, cm, cd, S);
+  }
+  double fastaccumulate = max(1.0, (double)(GetCurrentTimeInMilliSec() - start));
+
+  cout << "accumulate QUAT:     " << 1000.0 * runs * nrPairs / quataccumulate << " pairs/s" << endl
+       << "accumulate FASTQUAT: " << 1000.0 * runs * nrPairs / fastaccumulate << " pairs/s" << endl;
+
+  // cross covariances of point clouds with random spread and rotation
+  vector<double> covariances(9 * 1000);
+  for (int i = 0; i < 1000; i++) {
+    double A[3][3], C[3][3], R[16];
+    double rPosTheta[3] = {2.0 * M_PI * rand() / RAND_MAX,
+                           2.0 * M_PI * rand() / RAND_MAX,
+                           2.0 * M_PI * rand() / RAND_MAX};
+    double rPos[3] = {0.0, 0.0, 0.0};
+    EulerToMatrix4(rPos, rPosTheta, R);
+    for (int j = 0; j < 3; j++)
+      for (int k = 0; k < 3; k++)
+        A[j][k] = 2.0 * rand() / RAND_MAX - 1.0;
+    for (int j = 0; j < 3; j++)
+      for (int k = 0; k < 3; k++)
+        C[j][k] = A[j][0]*A[k][0] + A[j][1]*A[k][1] + A[j][2]*A[k][2];
+    rotatedCovariance(C, R, 0.01, &covariances[9 * i]);
+  }
+  solveRate("random", covariances, solves);
+
+  // as in ICP, point clouds that spread 100 to 1000 times more along one
+  // axis than along the next one, like long corridors, rotated by less
+  // than a degree
+  for (int i = 0; i < 1000; i++) {
+    double C[3][3], R[16];
+    double rPosTheta[3] = {rad(2.0 * rand() / RAND_MAX - 1.0),
+                           rad(2.0 * rand() / RAND_MAX - 1.0),
+                           rad(2.0 * rand() / RAND_MAX - 1.0)};
+    double rPos[3] = {0.0, 0.0, 0.0};
+    EulerToMatrix4(rPos, rPosTheta, R);
+    double spread = 1.0;
+    for (int j = 0; j < 3; j++) {
+      for (int k = 0; k < 3; k++)
+        C[(i + j) % 3][k] = 0.0;
+      C[(i + j) % 3][(i + j) % 3] = sqr(spread);
+      spread *= 100.0 + 900.0 * rand() / RAND_MAX;
+    }
+    rotatedCovariance(C, R, 0.01, &covariances[9 * i]);
+  }
+  solveRate("anisotropic", covariances, solves);
+
+  return 0;
+}
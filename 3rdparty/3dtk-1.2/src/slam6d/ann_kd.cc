@@ -74,3 +74,36 @@ double *ANNtree::FindClosest(double *_p, double maxdist2, int threadNum)
   return pts[idx];
 }  
 
+/**
+ * Finds the k closest points within the tree,
+ * wrt. the point given as first parameter.
+ * @param _p point
+ * @param k number of points to search for
+ * @param maxdist2 maximal search distance.
+ * @param closest receives the points found, closest first
+ * @param closest_d2 receives their squared distances
+ * @return number of points found
+ */
+int ANNtree::FindKClosest(double *_p, int k, double maxdist2,
+                          double **closest, double *closest_d2)
+{
+  if (k > annkd->nPoints()) k = annkd->nPoints();
+  if (k <= 0) return 0;
+  ANNidxArray idx = new ANNidx[k];
+  ANNdistArray dist = new ANNdist[k];
+
+#pragma omp critical
+  annkd->annkSearch(_p, k, idx, dist, 0.0);
+
+  int found = 0;
+  for (int i = 0; i < k; i++) {
+    if (idx[i] == ANN_NULL_IDX || dist[i] >= maxdist2) break;
+    closest[found] = pts[idx[i]];
+    closest_d2[found] = dist[i];
+    found++;
+  }
+
+  delete [] idx;
+  delete [] dist;
+  return found;
+}
@@ -13,10 +13,25 @@ using std::endl;
 using std::ifstream;
 #include <stdexcept>
 using std::exception;
+#include <vector>
+using std::vector;
+#include <cstdio>
+#include <cstring>
+#if __cplusplus >= 201703L
+#include <charconv>
+#endif
 
 #include "slam6d/scan.h"
 #include "slam6d/globals.icc"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #ifndef _MSC_VER
 #include <getopt.h>
 #else
@@ -47,6 +62,10 @@ void usage(char* prog)
 	  << "   " << prog << " [options] directory" << endl << endl;
   cout << bold << "OPTIONS" << normal << endl
 
+	  << endl
+	  << bold << "  -b, --binary" << normal << endl
+	  << "         write \"points.bin\" instead of \"points.pts\", three doubles x y z" << endl
+	  << "         per point in the byte order of this machine" << endl
 	  << endl
 	  << bold << "  -e" << normal << " NR, " << bold << "--end=" << normal << "NR" << endl
 	  << "         end after scan NR" << endl
@@ -72,6 +91,7 @@ void usage(char* prog)
 	  << endl
 	  << bold << "  -r" << normal << " NR, " << bold << "--reduce=" << normal << "NR" << endl
 	  << "         turns on octree based point reduction (voxel size=<NR>)" << endl
+	  << "         only the reduced points are exported" << endl
 	  << endl
 	  << bold << "  -R" << normal << " NR, " << bold << "--random=" << normal << "NR" << endl
 	  << "         turns on randomized reduction, using about every <NR>-th point only" << endl
@@ -115,11 +135,12 @@ void usage(char* prog)
  * @param algo specfies the used algorithm for rotation computation
  * @param lum6DAlgo specifies the used algorithm for global SLAM correction
  * @param loopsize defines the minimal loop size
+ * @param binary write the points in binary format
  * @return 0, if the parsing was successful. 1 otherwise
  */
 int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
 		    int &start, int &end, int &maxDist, int &minDist, bool &extrapolate_pose,
-		    int &octree, reader_type &type)
+		    int &octree, reader_type &type, bool &binary)
 {
   int  c;
   // from unistd.h:
@@ -136,11 +157,12 @@ int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
     { "octree",          optional_argument,   0,  'O' },
     { "random",          required_argument,   0,  'R' },
     { "trustpose",       no_argument,         0,  'p' },
+    { "binary",          no_argument,         0,  'b' },
     { 0,           0,   0,   0}                    // needed, cf. getopt.h
   };
 
   cout << endl;
-  while ((c = getopt_long(argc, argv, "f:s:e:r:O:R:p", longopts, NULL)) != -1)
+  while ((c = getopt_long(argc, argv, "f:s:e:r:O:R:pb", longopts, NULL)) != -1)
     switch (c)
 	 {
 	 case 'r':
@@ -174,6 +196,9 @@ int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
 	 case 'p':
 	   extrapolate_pose = false;
 	   break;
+	 case 'b':
+	   binary = true;
+	   break;
 	 case 'f': 
      if (!Scan::toType(optarg, type))
        abort ();
@@ -200,55 +225,177 @@ int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
   return 0;
 }
 
-void readFrames(string dir, int start, int end, reader_type &type)
+/**
+ * Reads the last transformation of the .frames file of a scan
+ *
+ * @param dir the directory of the scans
+ * @param fileNr number of the scan
+ * @param transMat receives the transformation
+ * @return false, if there is no .frames file
+ */
+bool readFrame(const string &dir, int fileNr, double *transMat)
 {
-  ifstream frame_in;
-  int  fileCounter = start;
-  string frameFileName;
-  for (;;) {
-    if (end > -1 && fileCounter > end) break; // 'nuf read
-    frameFileName = dir + "scan" + to_string(fileCounter++,3) + ".frames";
+  string frameFileName = dir + "scan" + to_string(fileNr,3) + ".frames";
+  ifstream frame_in(frameFileName.c_str());
+  if (!frame_in.good()) return false;
+
+  cout << "Reading Frames for 3D Scan " << frameFileName << "..." << endl;
+
+  // only complete lines are taken, a truncated last line is ignored
+  M4identity(transMat);
+  double lineMat[16];
+  int algoTypeInt;
+  while (frame_in.good()) {
+    try {
+      frame_in >> lineMat >> algoTypeInt;
+    }
+    catch (const exception &e) {
+      break;
+    }
+    if (frame_in.fail()) break;
+    memcpy(transMat, lineMat, sizeof(lineMat));
+  }
+  return true;
+}
 
-    frame_in.open(frameFileName.c_str());
+/**
+ * Transforms points like Point::transform. With SSE2 the x and y
+ * coordinates are computed in one register, in the same order of
+ * operations, so the results are identical.
+ */
+class PointTransform {
+public:
+  PointTransform(const double *M) {
+    memcpy(this->M, M, sizeof(this->M));
+#ifdef __SSE2__
+    c0 = _mm_loadu_pd(M);
+    c1 = _mm_loadu_pd(M + 4);
+    c2 = _mm_loadu_pd(M + 8);
+    c3 = _mm_loadu_pd(M + 12);
+#endif
+  }
 
-    // read 3D scan
-    if (!frame_in.good()) break; // no more files in the directory
+  inline void apply(const double *p, double *q) const {
+#ifdef __SSE2__
+    __m128d xy = _mm_add_pd(_mm_mul_pd(_mm_set1_pd(p[0]), c0),
+                            _mm_mul_pd(_mm_set1_pd(p[1]), c1));
+    xy = _mm_add_pd(xy, _mm_mul_pd(_mm_set1_pd(p[2]), c2));
+    _mm_storeu_pd(q, _mm_add_pd(xy, c3));
+#else
+    q[0] = p[0] * M[0] + p[1] * M[4] + p[2] * M[8] + M[12];
+    q[1] = p[0] * M[1] + p[1] * M[5] + p[2] * M[9] + M[13];
+#endif
+    q[2] = p[0] * M[2] + p[1] * M[6] + p[2] * M[10] + M[14];
+  }
 
-    cout << "Reading Frames for 3D Scan " << frameFileName << "..." << endl;
+private:
+  double M[16];
+#ifdef __SSE2__
+  __m128d c0, c1, c2, c3;
+#endif
+};
 
-    vector <double*> Matrices;
-    vector <Scan::AlgoType> algoTypes;
-    double transMat[16];
-    int algoTypeInt;
+/** coordinates of a point, x, y and z are the first members of Point */
+inline const double *xyz(const Point &p) { return &p.x; }
+/** coordinates of a reduced point */
+inline const double *xyz(const double *p) { return p; }
 
-    while (frame_in.good()) {
-      try {
-        frame_in >> transMat >> algoTypeInt;
-      }
-      catch (const exception &e) {   
-        break;
+/** points formatted by one thread at a time */
+static const int CHUNK_SIZE = 65536;
+
+/** longest text of a point, three doubles and their separators */
+static const int MAX_POINT_CHARS = 3 * 25 + 3;
+
+/**
+ * Writes the shortest text that reads back to the same double
+ *
+ * @return the end of the text
+ */
+inline char *formatDouble(char *buf, double v)
+{
+#ifdef __cpp_lib_to_chars
+  return std::to_chars(buf, buf + 25, v).ptr;
+#else
+  return buf + sprintf(buf, "%.17g", v);
+#endif
+}
+
+/**
+ * Writes the points of one scan. Chunks of the points are transformed
+ * and formatted in parallel, each into a buffer of its own, and the
+ * buffers are written in order.
+ *
+ * @param out the output file
+ * @param pts the points
+ * @param n number of points
+ * @param transMat transformation of the points, 0 for none
+ * @param binary write three doubles per point instead of a line of text
+ * @param buffers one buffer per thread, kept between the scans
+ * @return number of points written
+ */
+template <class P>
+unsigned long writePoints(FILE *out, const P *pts, int n, const double *transMat,
+                          bool binary, vector< vector<char> > &buffers)
+{
+  double identity[16];
+  M4identity(identity);
+  const PointTransform transform(transMat ? transMat : identity);
+
+  const int chunks = (n + CHUNK_SIZE - 1) / CHUNK_SIZE;
+  const int window = (int)buffers.size();
+  vector<size_t> length(window);
+
+  for (int first = 0; first < chunks; first += window) {
+    int last = min(chunks, first + window);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int c = first; c < last; c++) {
+      vector<char> &buffer = buffers[c - first];
+      buffer.resize(CHUNK_SIZE * (binary ? 3 * sizeof(double) : MAX_POINT_CHARS));
+      char *b = &buffer[0];
+      int end = min(n, (c + 1) * CHUNK_SIZE);
+      for (int i = c * CHUNK_SIZE; i < end; i++) {
+        double q[3];
+        if (transMat) {
+          transform.apply(xyz(pts[i]), q);
+        } else {
+          memcpy(q, xyz(pts[i]), sizeof(q));
+        }
+        if (binary) {
+          memcpy(b, q, sizeof(q));
+          b += sizeof(q);
+        } else {
+          b = formatDouble(b, q[0]);
+          *b++ = ' ';
+          b = formatDouble(b, q[1]);
+          *b++ = ' ';
+          b = formatDouble(b, q[2]);
+          *b++ = '\n';
+        }
       }
+      length[c - first] = b - &buffer[0];
     }
 
-    if(type == UOS_MAP || type == UOS_MAP_FRAMES || type == RTS_MAP) {
-      Scan::allScans[fileCounter - start]->transformAll(transMat);
-      if(fileCounter == start+1) {
-        Scan::allScans[0]->transformAll(transMat);
+    for (int c = first; c < last; c++) {
+      if (fwrite(&buffers[c - first][0], 1, length[c - first], out) != length[c - first]) {
+        cerr << "Error: Cannot write the points." << endl;
+        exit(1);
       }
-    } else {
-      Scan::allScans[fileCounter - start - 1]->transformAll(transMat);
     }
-
-    frame_in.close();
-    frame_in.clear();
   }
+
+  return n;
 }
 
 /**
  * program for point export
  * Usage: bin/exportPoints 'dir',
  * with 'dir' the directory of a set of scans
- * ...
+ *
+ * The scans are read, transformed and written one at a time, so only a
+ * single scan has to fit into memory.
  */
 int main(int argc, char **argv)
 {
@@ -267,39 +414,70 @@ int main(int argc, char **argv)
   bool   eP         = true;  // should we extrapolate the pose??
   int octree       = 0;  // employ randomized octree reduction?
   reader_type type    = UOS;
+  bool   binary     = false;
 
   parseArgs(argc, argv, dir, red, rand, start, end,
-      maxDist, minDist, eP, octree, type);
+      maxDist, minDist, eP, octree, type, binary);
 
-  // Get Scans
-  Scan::readScans(type, start, end, dir, maxDist, minDist, true);
-
-  int end_reduction = (int)Scan::allScans.size();
 #ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic)
+  omp_set_num_threads(OPENMP_NUM_THREADS);
 #endif
-  for (int iterator = 0; iterator < end_reduction; iterator++) {
+
+  // the Scans created for the reduction need the directory
+  Scan::dir = dir;
+  Scan::scanIOwrapper scanIO(type);
+
+  const char *fileName = binary ? "points.bin" : "points.pts";
+  FILE *out = fopen(fileName, "wb");
+  if (!out) {
+    cerr << "Error: Cannot open \"" << fileName << "\"." << endl;
+    exit(1);
+  }
+  cout << "Export all 3D Points to file \"" << fileName << "\"" << endl;
+
+  vector< vector<char> > buffers(OPENMP_NUM_THREADS);
+  double eu[6] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+  vector <Point> ptss;
+  bool frames = eP;
+  unsigned long nrPoints = 0;
+  unsigned long startTime = GetCurrentTimeInMilliSec();
+
+  for (int iterator = 0;
+       scanIO.readScans(start, end, dir, maxDist, minDist, eu, ptss) != -1;
+       iterator++) {
+    // the frames of the first scan also belong to the map, like all
+    // frames before, the export stops using them at the first missing file
+    double transMat[16];
+    if (frames) {
+      int frameNr = start + iterator;
+      if (type == UOS_MAP || type == UOS_MAP_FRAMES || type == RTS_MAP) {
+        frameNr = max(start, frameNr - 1);
+      }
+      frames = readFrame(dir, frameNr, transMat);
+    }
+
     if (red > 0) {
       cout << "Reducing Scan No. " << iterator << endl;
+      // reduction filter for current scan!
+      Scan scan(eu, maxDist);
+      scan.setPoints(&ptss);
+      ptss.clear();
+      scan.calcReducedPoints(red, octree);
+      nrPoints += writePoints(out, scan.get_points_red(), scan.get_points_red_size(),
+                              frames ? transMat : 0, binary, buffers);
     } else {
       cout << "Copying Scan No. " << iterator << endl;
+      nrPoints += writePoints(out, ptss.empty() ? 0 : &ptss[0], (int)ptss.size(),
+                              frames ? transMat : 0, binary, buffers);
     }
-    // reduction filter for current scan!
-    Scan::allScans[iterator]->calcReducedPoints(red, octree);
+    ptss.clear();
   }
 
-  if(eP) {
-    readFrames(dir, start, end, type);
+  if (fclose(out) != 0) {
+    cerr << "Error: Cannot write the points." << endl;
+    exit(1);
   }
 
-  cout << "Export all 3D Points to file \"points.pts\"" << endl;
-  ofstream redptsout("points.pts");
-  for(unsigned int i = 0; i < Scan::allScans.size(); i++) {
-    const vector <Point> *points = Scan::allScans[i]->get_points();
-    for(unsigned int j = 0; j < points->size(); j++) {
-      redptsout << points->at(j) << endl;
-    }
-  }
-  redptsout.close();
-  redptsout.clear();
+  unsigned long ms = GetCurrentTimeInMilliSec() - startTime;
+  cout << "Exported " << nrPoints << " points in " << ms << " ms" << endl;
 }
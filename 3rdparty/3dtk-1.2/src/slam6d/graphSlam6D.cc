@@ -21,6 +21,7 @@
 using std::ofstream;
 using std::flush;
 #include "slam6d/globals.icc"
+#include "slam6d/instrument.h"
 
 using namespace NEWMAT;
 /**
@@ -93,18 +94,18 @@ void graphSlam6D::matchGraph6Dautomatic(vector <Scan *> allScans, int nrIt, int
 #else
       int thread_num = 0;
 #endif
+      // count the pairs of all other scans against the tree of scan j,
+      // stopping as soon as more than clpairs are found
+      vector <Scan*> targets;
+      vector <int> counts;
       for (int k = 0; k < (int)allScans.size(); k++) {
+        if (j != k) targets.push_back(allScans[k]);
+      }
+      Scan::countPairs(allScans[j], targets, thread_num,
+          my_icp->get_rnd(), (int)max_dist_match2_LUM, clpairs + 1, counts);
+      for (int k = 0, t = 0; k < (int)allScans.size(); k++) {
         if (j == k) continue;
-        Scan * FirstScan  = allScans[j];
-        Scan * SecondScan = allScans[k];
-        double centroid_d[3] = {0.0, 0.0, 0.0};
-        double centroid_m[3] = {0.0, 0.0, 0.0};
-        vPtPair temp;
-        double sum_dummy;
-        Scan::getPtPairs(&temp, FirstScan, SecondScan, thread_num,
-            my_icp->get_rnd(), (int)max_dist_match2_LUM, sum_dummy,
-            centroid_m, centroid_d);
-        if ((int)temp.size() > clpairs) {
+        if (counts[t++] > clpairs) {
 #ifdef _OPENMP
 #pragma omp critical
 #endif
@@ -141,18 +142,18 @@ Graph *graphSlam6D::computeGraph6Dautomatic(vector <Scan *> allScans, int clpair
 #else
     int thread_num = 0;
 #endif
+    // count the pairs of all other scans against the tree of scan j,
+    // stopping as soon as more than clpairs are found
+    vector <Scan*> targets;
+    vector <int> counts;
     for (int k = 0; k < (int)allScans.size(); k++) {
+      if (j != k) targets.push_back(allScans[k]);
+    }
+    Scan::countPairs(allScans[j], targets, thread_num,
+        my_icp->get_rnd(), (int)max_dist_match2_LUM, clpairs + 1, counts);
+    for (int k = 0, t = 0; k < (int)allScans.size(); k++) {
       if (j == k) continue;
-      Scan * FirstScan  = allScans[j];
-      Scan * SecondScan = allScans[k];
-      double centroid_d[3] = {0.0, 0.0, 0.0};
-      double centroid_m[3] = {0.0, 0.0, 0.0};
-      vPtPair temp;
-      double sum_dummy;
-      Scan::getPtPairs(&temp, FirstScan, SecondScan, thread_num,
-          my_icp->get_rnd(), (int)max_dist_match2_LUM, sum_dummy,
-          centroid_m, centroid_d);
-      if ((int)temp.size() > clpairs) {
+      if (counts[t++] > clpairs) {
 #ifdef _OPENMP
 #pragma omp critical
 #endif
@@ -208,6 +209,7 @@ void graphSlam6D::writeMatrixPGM(const Matrix &G)
  */
 ColumnVector graphSlam6D::solve(const Matrix &G, const ColumnVector &B)
 {
+  INSTRUMENT_SCOPE(INSTR_SOLVE);
   
 #ifdef WRITE_MATRIX_PGM
   writeMatrixPGM(G);
@@ -229,6 +231,7 @@ ColumnVector graphSlam6D::solve(const Matrix &G, const ColumnVector &B)
  */
 ColumnVector graphSlam6D::solveCholesky(const Matrix &G, const ColumnVector &B)
 {
+  INSTRUMENT_SCOPE(INSTR_SOLVE);
   
 #ifdef WRITE_MATRIX_PGM
   writeMatrixPGM(G);
@@ -286,6 +289,7 @@ ColumnVector graphSlam6D::solveCholesky(const Matrix &G, const ColumnVector &B)
  */
 ColumnVector graphSlam6D::solveSparseCholesky(const Matrix &G, const ColumnVector &B)
 {
+  INSTRUMENT_SCOPE(INSTR_SOLVE);
 
   long starttime = GetCurrentTimeInMilliSec();
     
@@ -328,6 +332,7 @@ ColumnVector graphSlam6D::solveSparseCholesky(const Matrix &G, const ColumnVecto
 
 ColumnVector graphSlam6D::solveSparseCholesky(GraphMatrix *G, const ColumnVector &B)
 {
+  INSTRUMENT_SCOPE(INSTR_SOLVE);
 
   long starttime = GetCurrentTimeInMilliSec();
 
@@ -370,6 +375,7 @@ ColumnVector graphSlam6D::solveSparseCholesky(GraphMatrix *G, const ColumnVector
  */
 ColumnVector graphSlam6D::solveSparseQR(const Matrix &G, const ColumnVector &B)
 {
+  INSTRUMENT_SCOPE(INSTR_SOLVE);
   
 #ifdef WRITE_MATRIX_PGM
   writeMatrixPGM(G);
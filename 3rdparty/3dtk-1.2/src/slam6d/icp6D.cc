@@ -6,6 +6,7 @@
  */
 
 #include "slam6d/icp6D.h"
+#include "slam6d/icp6Dfastquat.h"
 
 #ifdef _MSC_VER
 #ifdef OPENMP
@@ -19,6 +20,7 @@
 
 #include <iomanip>
 #include "slam6d/globals.icc"
+#include "slam6d/instrument.h"
 using std::cerr;
 
 #include <string.h>
@@ -72,6 +74,8 @@ icp6D::icp6D(icp6Dminimizer *my_icp6Dminimizer, double max_dist_match,
   // Set initial seed (for "real" random numbers)
   //  srand( (unsigned)time( NULL ) );
   this->cad_matching = cad_matching;
+  this->pyramid = false;
+  this->concurrent = false;
 }
 
 /**
@@ -91,6 +95,82 @@ int icp6D::match(Scan* PreviousScan, Scan* CurrentScan)
     return 0;
   }
 
+  return matchLevels(PreviousScan, CurrentScan, -1);
+}
+
+/**
+ * Matches a working copy of a 3D Scan against a 3D Scan. Neither scan is
+ * changed, thus several of these matchings may run at the same time as
+ * long as every one uses its own thread number.
+ * @param PreviousScan The scan forming the model
+ * @param CurrentScan The scan that is to be matched
+ * @param thread_num The search tree slot used for this matching
+ * @param relxf The resulting pose of CurrentScan relative to PreviousScan
+ * @return The number of iterations done in this matching run
+ */
+int icp6D::matchCopy(Scan* PreviousScan, Scan* CurrentScan, int thread_num, double *relxf)
+{
+  Scan *copy = CurrentScan->copyReduced();
+  int iter = matchLevels(PreviousScan, copy, thread_num);
+
+  double inv[16];
+  M4inv(PreviousScan->get_transMat(), inv);
+  MMult(inv, copy->get_transMat(), relxf);
+
+  delete copy;
+  return iter;
+}
+
+/**
+ * Matches a 3D Scan against a 3D Scan on all reduction levels
+ * @param PreviousScan The scan or metascan forming the model
+ * @param CurrentScan The current scan thas is to be matched
+ * @param thread_num The search tree slot used for a serial matching,
+ *        -1 to find the point pairs in parallel
+ * @return The number of iterations done in this matching run
+ */
+int icp6D::matchLevels(Scan* PreviousScan, Scan* CurrentScan, int thread_num)
+{
+  INSTRUMENT_SCOPE(INSTR_ICP_MATCH);
+
+  int levels = 1;
+  if (pyramid) {
+    levels = PreviousScan->get_pyramid_size();
+    if (CurrentScan->get_pyramid_size() < levels) levels = CurrentScan->get_pyramid_size();
+  }
+
+  // start on the coarsest level with a large matching distance, continue
+  // on the next finer level once the error has converged
+  int iter = 0;
+  for (int l = levels - 1; l >= 0; l--) {
+    double scale = (double)(1 << l);
+    iter += matchLevel(PreviousScan->get_pyramid_level(l),
+                       CurrentScan->get_pyramid_level(l),
+                       CurrentScan, max_dist_match2 * scale * scale, l == 0,
+                       thread_num);
+  }
+
+  return iter;
+}
+
+/**
+ * Runs ICP on one reduction level of two scans
+ * @param PreviousLevel Level of the scan forming the model
+ * @param CurrentLevel Level of the scan that is to be matched
+ * @param CurrentScan The scan the transformations are applied to, its levels follow
+ * @param max_dist_match2 the maximal distance (^2 !!!) for matching on this level
+ * @param last Whether this is the finest level, i.e., the end pose is written
+ * @param thread_num The search tree slot used for a serial matching that
+ *        writes no frames, -1 to find the point pairs in parallel
+ * @return The number of iterations done on this level
+ */
+int icp6D::matchLevel(Scan* PreviousLevel, Scan* CurrentLevel, Scan* CurrentScan,
+                      double max_dist_match2, bool last, int thread_num)
+{
+  // point to plane matching needs the normals of the model
+  bool ptplane = (my_icp6Dminimizer->getAlgorithmID() == 10);
+  if (ptplane) PreviousLevel->calcNormals();
+
   // icp main loop
   double ret = 0.0, prev_ret = 0.0, prev_prev_ret = 0.0;
   int iter = 0;
@@ -100,7 +180,20 @@ int icp6D::match(Scan* PreviousScan, Scan* CurrentScan)
     prev_prev_ret = prev_ret;
     prev_ret = ret;
 
+    if (ptplane) {
+      // the pairs go straight into the linear system, none are stored
+      PtPlaneSystem system;
+      getPtPlaneSystem(PreviousLevel, CurrentLevel, CurrentScan->get_rPos(),
+                       max_dist_match2, thread_num, system);
+      if (system.n > 6) {
+        INSTRUMENT_SCOPE(INSTR_MINIMIZE);
+        ret = my_icp6Dminimizer->Point_Plane_Align(system, alignxf);
+      } else {
+        break;
+      }
+    } else
 #ifdef _OPENMP
+    if (thread_num < 0) {
     // Implementation according to the paper 
     // "The Parallel Iterative Closest Point Algorithm"
     // by Langis / Greenspan / Godin, IEEE 3DIM 2001
@@ -112,7 +205,7 @@ int icp6D::match(Scan* PreviousScan, Scan* CurrentScan)
     // Freiburg, Germany, September 2007
     omp_set_num_threads(OPENMP_NUM_THREADS);
 
-    int max = (int)CurrentScan->get_points_red_size();
+    int max = (int)CurrentLevel->get_points_red_size();
     int step = max / OPENMP_NUM_THREADS;
 
     vector<PtPair> pairs[OPENMP_NUM_THREADS];
@@ -132,7 +225,7 @@ int icp6D::match(Scan* PreviousScan, Scan* CurrentScan)
 #pragma omp parallel 
     {
       int thread_num = omp_get_thread_num();
-      Scan::getPtPairsParallel(pairs, PreviousScan, CurrentScan,
+      Scan::getPtPairsParallel(pairs, PreviousLevel, CurrentLevel,
           thread_num, step,
           rnd, max_dist_match2,
           sum, centroid_m, centroid_d);
@@ -168,6 +261,12 @@ int icp6D::match(Scan* PreviousScan, Scan* CurrentScan)
           Si[thread_num][7] += pp[2] * qq[1];
           Si[thread_num][8] += pp[2] * qq[2];
         }
+      } else if (my_icp6Dminimizer->getAlgorithmID() == 11) {
+        double S[3][3];
+        icp6D_FASTQUAT::crossCovariance(pairs[thread_num], centroid_m[thread_num], centroid_d[thread_num], S);
+        for (int j = 0; j < 3; j++)
+          for (int k = 0; k < 3; k++)
+            Si[thread_num][k*3+j] = S[j][k];
       }
     } // end parallel
     
@@ -178,8 +277,10 @@ int icp6D::match(Scan* PreviousScan, Scan* CurrentScan)
       pairssize += n[i];
     }
     if (pairssize > 3) {
+      INSTRUMENT_SCOPE(INSTR_MINIMIZE);
       if ((my_icp6Dminimizer->getAlgorithmID() == 1) ||
-          (my_icp6Dminimizer->getAlgorithmID() == 2) ) {
+          (my_icp6Dminimizer->getAlgorithmID() == 2) ||
+          (my_icp6Dminimizer->getAlgorithmID() == 11) ) {
         ret = my_icp6Dminimizer->Point_Point_Align_Parallel(OPENMP_NUM_THREADS,
             n, sum, centroid_m, centroid_d, Si, 
             alignxf);
@@ -195,17 +296,22 @@ int icp6D::match(Scan* PreviousScan, Scan* CurrentScan)
     } else {
       //break;
     }
-#else
-
+    } else
+#endif
+    {
+    // serial matching, used without OpenMP or if this pair is one of
+    // several pairs matched at the same time
     double centroid_m[3] = {0.0, 0.0, 0.0};
     double centroid_d[3] = {0.0, 0.0, 0.0};
     vector<PtPair> pairs;
    
-    Scan::getPtPairs(&pairs, PreviousScan, CurrentScan, 0, rnd,
+    Scan::getPtPairs(&pairs, PreviousLevel, CurrentLevel,
+        thread_num < 0 ? 0 : thread_num, rnd,
         max_dist_match2, ret, centroid_m, centroid_d);
 
     // do we have enough point pairs?
     if (pairs.size() > 3) {
+      INSTRUMENT_SCOPE(INSTR_MINIMIZE);
       if (my_icp6Dminimizer->getAlgorithmID() == 3 || my_icp6Dminimizer->getAlgorithmID() == 8 ) {
         memcpy(alignxf, CurrentScan->get_transMat(), sizeof(alignxf));
       }
@@ -213,16 +319,18 @@ int icp6D::match(Scan* PreviousScan, Scan* CurrentScan)
     } else {
 	 break;
     }
-   
-#endif
+    }
 
-    if ((iter == 0 && anim != -2) || ((anim > 0) && (iter % anim == 0))) {
+    if (thread_num >= 0) {
+	 CurrentScan->transform(alignxf, Scan::ICP, -1);  // no frames for a copy
+    } else if ((iter == 0 && anim != -2) || ((anim > 0) && (iter % anim == 0))) {
 	 CurrentScan->transform(alignxf, Scan::ICP, 0);   // transform the current scan
     } else {
 	 CurrentScan->transform(alignxf, Scan::ICP, -1);  // transform the current scan
     }
     
     if ((fabs(ret - prev_ret) < epsilonICP) && (fabs(ret - prev_prev_ret) < epsilonICP)) {
+	 if (!last || thread_num >= 0) break;
 	 double id[16];
 	 M4identity(id);
 	 if(anim == -2) {
@@ -238,6 +346,53 @@ int icp6D::match(Scan* PreviousScan, Scan* CurrentScan)
 }
 
 
+/**
+ * Collects the point to plane pairs of one reduction level in a linear
+ * system, see PtPlaneSystem
+ * @param PreviousLevel Level of the scan forming the model, with normals
+ * @param CurrentLevel Level of the scan that is to be matched
+ * @param center The center of the rotation, i.e., the position of the current scan
+ * @param max_dist_match2 the maximal distance (^2 !!!) for matching on this level
+ * @param thread_num The search tree slot used for a serial matching,
+ *        -1 to find the point pairs in parallel
+ * @param system The resulting system
+ */
+void icp6D::getPtPlaneSystem(Scan* PreviousLevel, Scan* CurrentLevel, const double *center,
+                             double max_dist_match2, int thread_num, PtPlaneSystem &system)
+{
+  system.clear(center);
+  unsigned int max = (unsigned int)CurrentLevel->get_points_red_size();
+
+#ifdef _OPENMP
+  if (thread_num < 0) {
+    // one system per part of the points, summed up afterwards
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+    unsigned int step = max / OPENMP_NUM_THREADS + 1;
+    PtPlaneSystem systems[OPENMP_NUM_THREADS];
+
+    int i;
+#pragma omp parallel for schedule(static)
+    for (i = 0; i < OPENMP_NUM_THREADS; i++) {
+      unsigned int start = i * step;
+      unsigned int end = start + step < max ? start + step : max;
+      systems[i].clear(center);
+      if (start < end) {
+        Scan::getPtPlaneSystem(systems[i], PreviousLevel, CurrentLevel,
+            omp_get_thread_num(), start, end, rnd, max_dist_match2);
+      }
+    }
+
+    for (i = 0; i < OPENMP_NUM_THREADS; i++) {
+      system.add(systems[i]);
+    }
+    return;
+  }
+#endif
+
+  Scan::getPtPlaneSystem(system, PreviousLevel, CurrentLevel,
+      thread_num < 0 ? 0 : thread_num, 0, max, rnd, max_dist_match2);
+}
+
 /**
  * Computes the point to point error between two scans 
  * 
@@ -312,6 +467,11 @@ double icp6D::Point_Point_Error(Scan* PreviousScan, Scan* CurrentScan, double ma
  */
 void icp6D::doICP(vector <Scan *> allScans)
 {
+  if (concurrent && !meta) {
+    doICPConcurrent(allScans);
+    return;
+  }
+
   double id[16];
   M4identity(id);
   
@@ -331,6 +491,11 @@ void icp6D::doICP(vector <Scan *> allScans)
       }
     }
 
+    // read the next scan ahead if scans are swapped out, see Scan::maxResidentMemory
+    if (i + 1 < allScans.size()) {
+      Scan::prefetch(allScans[i+1]);
+    }
+
     if (i > 0) {
       if (meta) {
         match(my_MetaScan, CurrentScan);
@@ -354,3 +519,69 @@ void icp6D::doICP(vector <Scan *> allScans)
   }
 }
 
+/**
+ * This function matches the scans only with ICP, all scan pairs at the
+ * same time. Every pair is matched on a working copy of the current scan
+ * against the previous scan (or the first scan for CAD matching) in the
+ * initial pose, the jobs are distributed dynamically over the threads.
+ * Afterwards the relative transformations are chained along the trajectory,
+ * i.e., the odometry is always extrapolated. Matching against a meta scan
+ * depends on the previous results and is not possible this way.
+ *
+ * @param allScans Contains all necessary scans.
+ */
+void icp6D::doICPConcurrent(vector <Scan *> allScans)
+{
+  if (nns_method == cachedKD) {
+    cerr << "WARNING: cached k-d trees are not thread safe, matching scans one after another" << endl;
+    concurrent = false;
+    doICP(allScans);
+    concurrent = true;
+    return;
+  }
+
+  int n = (int)allScans.size();
+  if (n < 2) return;
+  double *relxf = new double[16 * n];
+
+  // matching jobs, each one writes its own result only
+  int i;
+#ifdef _OPENMP
+  omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (i = 1; i < n; i++) {
+#ifdef _OPENMP
+    int thread_num = omp_get_thread_num();
+#else
+    int thread_num = 0;
+#endif
+    Scan *PreviousScan = cad_matching ? allScans[0] : allScans[i-1];
+    if (i + OPENMP_NUM_THREADS < n) {
+      Scan::prefetch(allScans[i + OPENMP_NUM_THREADS]);
+    }
+    matchCopy(PreviousScan, allScans[i], thread_num, &relxf[16 * i]);
+    if (!quiet) {
+#ifdef _OPENMP
+#pragma omp critical
+#endif
+      cout << i << "*" << endl;
+    }
+  }
+
+  // chain the relative transformations
+  for (i = 1; i < n; i++) {
+    Scan *PreviousScan = cad_matching ? allScans[0] : allScans[i-1];
+    double pose[16], inv[16], delta[16];
+    MMult(PreviousScan->get_transMat(), &relxf[16 * i], pose);
+    M4inv(allScans[i]->get_transMat(), inv);
+    MMult(pose, inv, delta);
+    if (anim == -2) {
+      allScans[i]->transform(delta, Scan::ICP, -1);  // write end pose
+    } else {
+      allScans[i]->transform(delta, Scan::ICP, 0);   // write end pose
+    }
+  }
+
+  delete [] relxf;
+}
@@ -0,0 +1,238 @@
+/** @file
+ *  @brief Implementation of the ICP error function minimization via quaternions
+ *         with SIMD accumulation and a closed form eigen solver
+ */
+
+#include "slam6d/icp6Dfastquat.h"
+
+#include "slam6d/globals.icc"
+#include "slam6d/fixedmatrix.icc"
+#include <iomanip>
+using std::ios;
+using std::resetiosflags;
+using std::setiosflags;
+#include <iostream>
+using std::cout;
+using std::endl;
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * Sums up the cross covariance of the point pairs about their centroids.
+ * With SSE2 x and y of a point are loaded into one register, they are
+ * the first members of Point.
+ *
+ * @param pairs the point pairs
+ * @param centroid_m centroid of the model points p1
+ * @param centroid_d centroid of the data points p2
+ * @param S receives the sum of (p2 - centroid_d)_i * (p1 - centroid_m)_j in S[i][j]
+ * @return the sum of the squared distances of the pairs
+ */
+double icp6D_FASTQUAT::crossCovariance(const vector<PtPair> &pairs,
+							    const double centroid_m[3], const double centroid_d[3],
+							    double S[3][3])
+{
+  unsigned int n = (unsigned int)pairs.size();
+
+#ifdef __SSE2__
+  // S[0][0..1], S[1][0..1], S[2][0..1], S[0..1][2] and the squared
+  // distances in x and y
+  __m128d s0 = _mm_setzero_pd();
+  __m128d s1 = _mm_setzero_pd();
+  __m128d s2 = _mm_setzero_pd();
+  __m128d s3 = _mm_setzero_pd();
+  __m128d e = _mm_setzero_pd();
+  double s22 = 0.0, ez = 0.0;
+  __m128d mxy = _mm_loadu_pd(centroid_m);
+  __m128d dxy = _mm_loadu_pd(centroid_d);
+
+  for (unsigned int i = 0; i < n; i++) {
+    const Point &p1 = pairs[i].p1;
+    const Point &p2 = pairs[i].p2;
+    __m128d pxy = _mm_loadu_pd(&p1.x);
+    __m128d qxy = _mm_loadu_pd(&p2.x);
+
+    __m128d d = _mm_sub_pd(pxy, qxy);
+    e = _mm_add_pd(e, _mm_mul_pd(d, d));
+    double dz = p1.z - p2.z;
+    ez += dz * dz;
+
+    pxy = _mm_sub_pd(pxy, mxy);
+    qxy = _mm_sub_pd(qxy, dxy);
+    double pz = p1.z - centroid_m[2];
+    double qz = p2.z - centroid_d[2];
+    s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_unpacklo_pd(qxy, qxy), pxy));
+    s1 = _mm_add_pd(s1, _mm_mul_pd(_mm_unpackhi_pd(qxy, qxy), pxy));
+    s2 = _mm_add_pd(s2, _mm_mul_pd(_mm_set1_pd(qz), pxy));
+    s3 = _mm_add_pd(s3, _mm_mul_pd(qxy, _mm_set1_pd(pz)));
+    s22 += qz * pz;
+  }
+
+  double lanes[2];
+  _mm_storeu_pd(lanes, s0); S[0][0] = lanes[0]; S[0][1] = lanes[1];
+  _mm_storeu_pd(lanes, s1); S[1][0] = lanes[0]; S[1][1] = lanes[1];
+  _mm_storeu_pd(lanes, s2); S[2][0] = lanes[0]; S[2][1] = lanes[1];
+  _mm_storeu_pd(lanes, s3); S[0][2] = lanes[0]; S[1][2] = lanes[1];
+  S[2][2] = s22;
+  _mm_storeu_pd(lanes, e);
+  return lanes[0] + lanes[1] + ez;
+#else
+  double sum = 0.0;
+  for (int j = 0; j < 3; j++)
+    for (int k = 0; k < 3; k++)
+      S[j][k] = 0.0;
+
+  for (unsigned int i = 0; i < n; i++) {
+    const Point &p1 = pairs[i].p1;
+    const Point &p2 = pairs[i].p2;
+    sum += sqr(p1.x - p2.x) + sqr(p1.y - p2.y) + sqr(p1.z - p2.z);
+
+    double p[3] = { p1.x - centroid_m[0], p1.y - centroid_m[1], p1.z - centroid_m[2] };
+    double q[3] = { p2.x - centroid_d[0], p2.y - centroid_d[1], p2.z - centroid_d[2] };
+    for (int j = 0; j < 3; j++)
+      for (int k = 0; k < 3; k++)
+        S[j][k] += q[j] * p[k];
+  }
+  return sum;
+#endif
+}
+
+/**
+ * computes the transformation matrix consisting
+ * of a rotation and translation from the cross covariance
+ * of the point pairs using the Quaternion method of Horn
+ *
+ * @param S the cross covariance as computed by crossCovariance, any scale
+ * @param centroid_m centroid of the model points
+ * @param centroid_d centroid of the data points
+ * @param alignxf The resulting transformation matrix
+ */
+void icp6D_FASTQUAT::alignCovariance(const double S[3][3],
+							  const double centroid_m[3], const double centroid_d[3],
+							  double *alignxf)
+{
+  double Q[4][4];
+  HornMatrix(S, Q);
+
+  // the quaternion
+  double q[4];
+  if (!maxEigenVectorSym4(Q, q)) {
+    // the rotation is not unique, like icp6D_QUAT pick one
+    maxEigenVector(Q, q);
+  }
+
+  // calculate the rotation matrix
+  double m[3][3]; // rot matrix
+  quaternion2matrix(q, m);
+
+  M4identity(alignxf);
+
+  alignxf[0] = m[0][0];
+  alignxf[1] = m[1][0];
+  alignxf[2] = m[2][0];
+  alignxf[4] = m[0][1];
+  alignxf[5] = m[1][1];
+  alignxf[6] = m[2][1];
+  alignxf[8] = m[0][2];
+  alignxf[9] = m[1][2];
+  alignxf[10] = m[2][2];
+
+  // calculate the translation vector,
+  alignxf[12] = centroid_m[0] - m[0][0]*centroid_d[0] - m[0][1]*centroid_d[1] - m[0][2]*centroid_d[2];
+  alignxf[13] = centroid_m[1] - m[1][0]*centroid_d[0] - m[1][1]*centroid_d[1] - m[1][2]*centroid_d[2];
+  alignxf[14] = centroid_m[2] - m[2][0]*centroid_d[0] - m[2][1]*centroid_d[1] - m[2][2]*centroid_d[2];
+}
+
+/**
+ * computes the rotation matrix consisting
+ * of a rotation and translation that
+ * minimizes the root-mean-square error of the
+ * point pairs using the Quaternion method of Horn
+ *
+ * @param pairs Vector of point pairs (pairs of corresponding points)
+ * @param alignxf The resulting transformation matrix
+ * @return Error estimation of the matching (rms)
+ */
+double icp6D_FASTQUAT::Point_Point_Align(const vector<PtPair>& pairs, double *alignxf,
+								 const double centroid_m[3], const double centroid_d[3])
+{
+  double S[3][3];
+  double sum = crossCovariance(pairs, centroid_m, centroid_d, S);
+
+  double error = sqrt(sum / pairs.size());
+  if (!quiet) {
+    cout.setf(ios::basefield);
+    cout << "FQUAT RMS point-to-point error = "
+	    << resetiosflags(ios::adjustfield) << setiosflags(ios::internal)
+	    << resetiosflags(ios::floatfield) << setiosflags(ios::fixed)
+	    << std::setw(10) << std::setprecision(7)
+	    << error
+	    << "  using " << std::setw(6) << (int)pairs.size() << " points" << endl;
+  }
+
+  alignCovariance(S, centroid_m, centroid_d, alignxf);
+  return error;
+}
+
+/**
+ * Combines the cross covariances of the threads, see
+ * icp6D_QUAT::Point_Point_Align_Parallel. Si[i][k*3+j] holds the sum
+ * of (p1 - centroid_m[i])_k * (p2 - centroid_d[i])_j of thread i.
+ */
+double icp6D_FASTQUAT::Point_Point_Align_Parallel(const int openmp_num_threads,
+									 const unsigned int n[OPENMP_NUM_THREADS],
+									 const double sum[OPENMP_NUM_THREADS],
+									 const double centroid_m[OPENMP_NUM_THREADS][3],
+									 const double centroid_d[OPENMP_NUM_THREADS][3],
+									 const double Si[OPENMP_NUM_THREADS][9],
+									 double *alignxf)
+{
+  double s = 0.0;
+  unsigned int pairs_size = 0;
+  double cm[3] = {0.0, 0.0, 0.0};  // centroid m
+  double cd[3] = {0.0, 0.0, 0.0};  // centroid d
+
+  // formula (4)
+  for (int i = 0; i < openmp_num_threads; i++) {
+    s += sum[i];
+    // the centroids of a thread without pairs are not defined
+    if (n[i] == 0) continue;
+    pairs_size += n[i];
+    for (int j = 0; j < 3; j++) {
+      cm[j] += n[i] * centroid_m[i][j];
+      cd[j] += n[i] * centroid_d[i][j];
+    }
+  }
+  for (int j = 0; j < 3; j++) {
+    cm[j] /= pairs_size;
+    cd[j] /= pairs_size;
+  }
+
+  double ret = sqrt(s / (double)pairs_size);
+  if (!quiet) {
+    cout.setf(ios::basefield);
+    cout << "PFQUAT RMS point-to-point error = "
+      << resetiosflags(ios::adjustfield) << setiosflags(ios::internal)
+      << resetiosflags(ios::floatfield) << setiosflags(ios::fixed)
+      << std::setw(10) << std::setprecision(7)
+      << ret
+      << "  using " << std::setw(6) << pairs_size << " points" << endl;
+  }
+
+  // formula (5), the sums about the centroids of the threads are moved
+  // to the common centroids
+  double S[3][3] = { {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0} };
+  for (int i = 0; i < openmp_num_threads; i++) {
+    if (n[i] == 0) continue;
+    for (int j = 0; j < 3; j++) {
+      for (int k = 0; k < 3; k++) {
+        S[j][k] += Si[i][k*3+j] + n[i] * ((centroid_d[i][j] - cd[j]) * (centroid_m[i][k] - cm[k]));
+      }
+    }
+  }
+
+  alignCovariance(S, cm, cd, alignxf);
+  return ret;
+}
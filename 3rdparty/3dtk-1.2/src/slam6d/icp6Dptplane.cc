@@ -0,0 +1,81 @@
+/** @file 
+ *  @brief Implementation of the point to plane ICP error function minimization
+ */
+
+#include "slam6d/icp6Dptplane.h"
+
+#include "slam6d/globals.icc"
+#include <iomanip>
+using std::ios;
+using std::resetiosflags;
+using std::setiosflags;
+
+/**
+ * computes the transformation matrix consisting
+ * of a rotation and translation that
+ * minimizes the sum of the squared point to plane
+ * distances, using the <b>approximation</b>
+ * sin(x) = x.
+ *
+ * @param system The linear system of the point to plane pairs
+ * @param alignxf The resulting transformation matrix
+ * @return Error estimation of the matching (rms point to plane distance)
+ */
+double icp6D_PTPLANE::Point_Plane_Align(const PtPlaneSystem &system, double *alignxf)
+{
+  M4identity(alignxf);
+
+  // six unknowns
+  if (system.n <= 6) {
+    return 0;
+  }
+
+  double error = sqrt(system.sum / system.n);
+  if (!quiet) {
+    cout.setf(ios::basefield);
+    cout << "PTPLANE RMS point-to-plane error = "
+	    << resetiosflags(ios::adjustfield) << setiosflags(ios::internal)
+	    << resetiosflags(ios::floatfield) << setiosflags(ios::fixed)
+	    << std::setw(10) << std::setprecision(7)
+	    << error
+	    << "  using " << std::setw(6) << system.n << " points" << endl;
+  }
+
+  // the system stores the upper triangle only
+  double A[6][6];
+  double *rows[6];
+  double B[6];
+  for (int i = 0; i < 6; i++) {
+    for (int j = i; j < 6; j++) {
+      A[i][j] = A[j][i] = system.A[i][j];
+    }
+    B[i] = system.b[i];
+    rows[i] = A[i];
+  }
+
+  // Solve eqns
+  double diag[6];
+  if (!choldc(6, rows, diag)) {
+    printf("Couldn't find transform.\n");
+    return -1.0;
+  }
+  double x[6];
+  cholsl(6, rows, diag, B, x);
+
+  // Interpret results, the rotation is about the center of the system
+  double aa[4] = { Len(x), 1.0, 0.0, 0.0 };
+  if (aa[0] > 0.0) {
+    aa[1] = x[0] / aa[0];
+    aa[2] = x[1] / aa[0];
+    aa[3] = x[2] / aa[0];
+  }
+  double t[3] = { 0.0, 0.0, 0.0 };
+  AAToMatrix(aa, t, alignxf);
+
+  const double *c = system.center;
+  alignxf[12] = c[0] + x[3] - alignxf[0]*c[0] - alignxf[4]*c[1] - alignxf[8]*c[2];
+  alignxf[13] = c[1] + x[4] - alignxf[1]*c[0] - alignxf[5]*c[1] - alignxf[9]*c[2];
+  alignxf[14] = c[2] + x[5] - alignxf[2]*c[0] - alignxf[6]*c[1] - alignxf[10]*c[2];
+
+  return error;
+}
@@ -0,0 +1,206 @@
+/**
+ * @file
+ * @brief Counters and scoped timers for the hot paths of slam6D
+ *
+ * The records of the threads are kept until the end of the program and
+ * written out by an exit handler, see instrument.h.
+ */
+
+#include "slam6d/instrument.h"
+
+#ifdef WITH_INSTRUMENTATION
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+using std::cerr;
+using std::endl;
+#include <vector>
+using std::vector;
+
+#ifdef _MSC_VER
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+bool Instrument::tracing = false;
+size_t Instrument::maxEvents = 1000000;
+INSTRUMENT_TLS InstrumentThread *Instrument::current = 0;
+
+/** the records of all threads in the order of registration */
+static vector<InstrumentThread *> instrumentThreads;
+
+/** time of the first registration, the origin of the trace */
+static unsigned long long instrumentStart = 0;
+
+static const char *counterNames[INSTR_COUNTERS] = {
+  "nn_queries", "nodes_visited", "pairs_found", "trees_built",
+  "points_transformed", "frames_stored"
+};
+
+static const char *phaseNames[INSTR_PHASES] = {
+  "SearchTree::getPtPairs", "icp6D::match", "icp6Dminimizer::align",
+  "Scan::transform", "Scan::transform frames", "Scan::createTree",
+  "lum6DEuler::covarianceEuler", "lum6DEuler::FillGB3D", "graphSlam6D::solve"
+};
+
+InstrumentThread::InstrumentThread(int id)
+  : id(id), dropped(0)
+{
+  memset(counts, 0, sizeof(counts));
+  memset(calls, 0, sizeof(calls));
+  memset(ns, 0, sizeof(ns));
+  memset(depth, 0, sizeof(depth));
+}
+
+/**
+ * A monotonic clock
+ *
+ * @return the time in ns
+ */
+unsigned long long Instrument::now()
+{
+#ifdef _MSC_VER
+  static LARGE_INTEGER frequency;
+  if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  return (unsigned long long)((double)counter.QuadPart * 1e9 / frequency.QuadPart);
+#else
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+/**
+ * Creates the record of the calling thread. The first registration
+ * installs the exit handler.
+ */
+InstrumentThread *Instrument::registerThread()
+{
+#ifdef _OPENMP
+#pragma omp critical (instrument)
+#endif
+  {
+    if (instrumentThreads.empty()) {
+      instrumentStart = now();
+      tracing = getenv("SLAM6D_TRACE") != 0;
+      atexit(dump);
+    }
+    current = new InstrumentThread((int)instrumentThreads.size());
+    instrumentThreads.push_back(current);
+  }
+  return current;
+}
+
+/**
+ * Keeps a timed scope for the Chrome trace
+ */
+void Instrument::trace(InstrumentThread *t, InstrumentPhase phase,
+                       unsigned long long start, unsigned long long duration)
+{
+  if (t->events.size() >= maxEvents) {
+    t->dropped++;
+    return;
+  }
+  InstrumentEvent event = { phase, start - instrumentStart, duration };
+  t->events.push_back(event);
+}
+
+/**
+ * Writes the counters of a record as the members of a JSON object
+ */
+static void writeRecord(FILE *out, const unsigned long long *counts,
+                        const unsigned long long *calls,
+                        const unsigned long long *ns, const char *indent)
+{
+  fprintf(out, "%s\"counters\": {", indent);
+  for (int c = 0; c < INSTR_COUNTERS; c++) {
+    fprintf(out, "%s\"%s\": %llu", c ? ", " : "", counterNames[c], counts[c]);
+  }
+  fprintf(out, "},\n%s\"phases\": {\n", indent);
+  for (int p = 0; p < INSTR_PHASES; p++) {
+    fprintf(out, "%s  \"%s\": {\"calls\": %llu, \"ns\": %llu, \"mean_ns\": %llu}%s\n",
+            indent, phaseNames[p], calls[p], ns[p], calls[p] ? ns[p] / calls[p] : 0ULL,
+            p + 1 < INSTR_PHASES ? "," : "");
+  }
+  fprintf(out, "%s}", indent);
+}
+
+/**
+ * Writes the totals and the records of all threads as JSON and, if
+ * tracing, the Chrome trace. Installed as exit handler.
+ */
+void Instrument::dump()
+{
+  const char *fileName = getenv("SLAM6D_INSTRUMENT");
+  if (!fileName || !*fileName) fileName = "instrument.json";
+
+  FILE *out = fopen(fileName, "w");
+  if (!out) {
+    cerr << "ERROR: Cannot write the instrumentation to " << fileName << endl;
+    return;
+  }
+
+  unsigned long long counts[INSTR_COUNTERS], calls[INSTR_PHASES], ns[INSTR_PHASES];
+  memset(counts, 0, sizeof(counts));
+  memset(calls, 0, sizeof(calls));
+  memset(ns, 0, sizeof(ns));
+  for (size_t i = 0; i < instrumentThreads.size(); i++) {
+    const InstrumentThread *t = instrumentThreads[i];
+    for (int c = 0; c < INSTR_COUNTERS; c++) counts[c] += t->counts[c];
+    for (int p = 0; p < INSTR_PHASES; p++) {
+      calls[p] += t->calls[p];
+      ns[p] += t->ns[p];
+    }
+  }
+
+  // the totals are summed over the threads, thus a phase that runs in
+  // parallel takes longer than the wall clock time
+  fprintf(out, "{\n  \"threads\": %d,\n", (int)instrumentThreads.size());
+  writeRecord(out, counts, calls, ns, "  ");
+  fprintf(out, ",\n  \"per_thread\": [\n");
+  for (size_t i = 0; i < instrumentThreads.size(); i++) {
+    const InstrumentThread *t = instrumentThreads[i];
+    fprintf(out, "    {\n      \"id\": %d,\n", t->id);
+    writeRecord(out, t->counts, t->calls, t->ns, "      ");
+    fprintf(out, "\n    }%s\n", i + 1 < instrumentThreads.size() ? "," : "");
+  }
+  fprintf(out, "  ]\n}\n");
+  fclose(out);
+
+  if (!tracing) return;
+
+  const char *traceName = getenv("SLAM6D_TRACE");
+  FILE *trace = fopen(traceName, "w");
+  if (!trace) {
+    cerr << "ERROR: Cannot write the trace to " << traceName << endl;
+    return;
+  }
+
+  // complete events, ts and dur in microseconds
+  fprintf(trace, "{\"traceEvents\":[\n");
+  bool first = true;
+  for (size_t i = 0; i < instrumentThreads.size(); i++) {
+    const InstrumentThread *t = instrumentThreads[i];
+    for (size_t e = 0; e < t->events.size(); e++) {
+      const InstrumentEvent &event = t->events[e];
+      fprintf(trace, "%s{\"name\":\"%s\",\"cat\":\"slam6d\",\"ph\":\"X\","
+              "\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%d}",
+              first ? "" : ",\n", phaseNames[event.phase],
+              event.start / 1000.0, event.duration / 1000.0, t->id);
+      first = false;
+    }
+    if (t->dropped) {
+      cerr << "WARNING: " << t->dropped << " trace events of thread "
+           << t->id << " dropped" << endl;
+    }
+  }
+  fprintf(trace, "\n],\"displayTimeUnit\":\"ns\"}\n");
+  fclose(trace);
+}
+
+#endif
@@ -10,6 +10,7 @@
 
 #include "slam6d/kd.h"
 #include "slam6d/globals.icc"          
+#include "slam6d/instrument.h"
 
 #include <iostream>
 using std::cout;
@@ -19,6 +20,7 @@ using std::endl;
 using std::swap;
 #include <cmath>
 #include <cstring>
+#include <cstdlib>
 
 // KDtree class static variables
 KDParams KDtree::params[MAX_OPENMP_NUM_THREADS];
@@ -113,6 +115,79 @@ KDtree::KDtree(double **pts, int n)
   }
 }
 
+/**
+ * Constructor
+ *
+ * Reads a KD tree written by save. The points of the leaves are read
+ * into new arrays, which are stored in pts in the order of the leaves.
+ *
+ * @param file the file, positioned at the tree
+ * @param pts receives the points
+ * @param n number of points pts can hold
+ * @param dim number of values of a point
+ * @param next index of the next point in pts
+ */
+KDtree::KDtree(FILE *file, double **pts, int n, int dim, int &next)
+{
+  if (fread(&npts, sizeof(npts), 1, file) != 1 || npts < 0 || npts > n - next) {
+    cerr << "ERROR: Cannot read the k-d tree." << endl;
+    exit(1);
+  }
+
+  // Leaf nodes
+  if (npts) {
+    leaf.p = new double*[npts];
+    for (int i = 0; i < npts; i++) {
+      leaf.p[i] = pts[next++] = new double[dim];
+      if (fread(leaf.p[i], sizeof(double), dim, file) != (size_t)dim) {
+        cerr << "ERROR: Cannot read the k-d tree." << endl;
+        exit(1);
+      }
+    }
+    return;
+  }
+
+  // Else, interior nodes
+  double box[7];
+  if (fread(box, sizeof(double), 7, file) != 7 ||
+      fread(&node.splitaxis, sizeof(node.splitaxis), 1, file) != 1) {
+    cerr << "ERROR: Cannot read the k-d tree." << endl;
+    exit(1);
+  }
+  memcpy(node.center, box, 3 * sizeof(double));
+  node.dx = box[3];
+  node.dy = box[4];
+  node.dz = box[5];
+  node.r2 = box[6];
+  node.child1 = new KDtree(file, pts, n, dim, next);
+  node.child2 = new KDtree(file, pts, n, dim, next);
+}
+
+/**
+ * Writes the tree in preorder. The points of a leaf are written with
+ * the leaf, so the tree is read back without the original arrays.
+ *
+ * @param file the file
+ * @param dim number of values of a point
+ */
+void KDtree::save(FILE *file, int dim) const
+{
+  fwrite(&npts, sizeof(npts), 1, file);
+  if (npts) {
+    for (int i = 0; i < npts; i++) {
+      fwrite(leaf.p[i], sizeof(double), dim, file);
+    }
+    return;
+  }
+
+  double box[7] = {node.center[0], node.center[1], node.center[2],
+                   node.dx, node.dy, node.dz, node.r2};
+  fwrite(box, sizeof(double), 7, file);
+  fwrite(&node.splitaxis, sizeof(node.splitaxis), 1, file);
+  node.child1->save(file, dim);
+  node.child2->save(file, dim);
+}
+
 /**
  * Finds the closest point within the tree,
  * wrt. the point given as first parameter.
@@ -126,7 +201,13 @@ double *KDtree::FindClosest(double *_p, double maxdist2, int threadNum)
   params[threadNum].closest = 0;
   params[threadNum].closest_d2 = maxdist2;
   params[threadNum].p = _p;
+#ifdef WITH_INSTRUMENTATION
+  params[threadNum].visited = 0;
+  _FindClosest(threadNum);
+  INSTRUMENT_COUNT(INSTR_NODES_VISITED, params[threadNum].visited);
+#else
   _FindClosest(threadNum);
+#endif
   return params[threadNum].closest;
 }
 
@@ -135,6 +216,10 @@ double *KDtree::FindClosest(double *_p, double maxdist2, int threadNum)
  */
 void KDtree::_FindClosest(int threadNum)
 {
+#ifdef WITH_INSTRUMENTATION
+  params[threadNum].visited++;
+#endif
+
   // Leaf nodes
   if (npts) {
     for (int i = 0; i < npts; i++) {
@@ -170,3 +255,65 @@ void KDtree::_FindClosest(int threadNum)
 }
 
 
+
+/**
+ * Finds the k closest points within the tree,
+ * wrt. the point given as first parameter.
+ * @param _p point
+ * @param k number of points to search for
+ * @param maxdist2 maximal search distance.
+ * @param closest receives the points found, closest first
+ * @param closest_d2 receives their squared distances
+ * @return number of points found
+ */
+int KDtree::FindKClosest(double *_p, int k, double maxdist2,
+                         double **closest, double *closest_d2)
+{
+  KDKnnParams params;
+  params.p = _p;
+  params.k = k;
+  params.found = 0;
+  params.closest = closest;
+  params.closest_d2 = closest_d2;
+  params.maxdist2 = maxdist2;
+  if (k > 0) _FindKClosest(params);
+  return params.found;
+}
+
+/**
+ * Wrapped function
+ */
+void KDtree::_FindKClosest(KDKnnParams &params)
+{
+  // Leaf nodes
+  if (npts) {
+    for (int i = 0; i < npts; i++) {
+      double myd2 = Dist2(params.p, leaf.p[i]);
+      if (myd2 < params.maxdist2) {
+        params.insert(leaf.p[i], myd2);
+      }
+    }
+    return;
+  }
+
+  // Quick check of whether to abort
+  double approx_dist_bbox = max(max(fabs(params.p[0]-node.center[0])-node.dx,
+                                    fabs(params.p[1]-node.center[1])-node.dy),
+                                fabs(params.p[2]-node.center[2])-node.dz);
+  if (approx_dist_bbox >= 0 && sqr(approx_dist_bbox) >= params.maxdist2)
+    return;
+
+  // Recursive case
+  double myd = node.center[node.splitaxis] - params.p[node.splitaxis];
+  if (myd >= 0.0) {
+    node.child1->_FindKClosest(params);
+    if (sqr(myd) < params.maxdist2) {
+      node.child2->_FindKClosest(params);
+    }
+  } else {
+    node.child2->_FindKClosest(params);
+    if (sqr(myd) < params.maxdist2) {
+      node.child1->_FindKClosest(params);
+    }
+  }
+}
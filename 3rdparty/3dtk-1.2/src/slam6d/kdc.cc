@@ -10,6 +10,7 @@
 
 #include "slam6d/kdc.h"
 #include "slam6d/globals.icc"
+#include "slam6d/instrument.h"
 
 #include <iostream>
 using std::cout;
@@ -20,10 +21,59 @@ using std::swap;
 #include <cmath>
 #include <cstring>
 
+#ifdef _MSC_VER
+#include <windows.h>
+#endif
+
 #define CENTROID
 
 // KDtree_cache class static variables
 KDCacheItem KDtree_cache::cacheItem[MAX_OPENMP_NUM_THREADS];
+size_t KDtree_cache::maxCacheMemory = 0;
+size_t KDtree_cache::cacheMemory = 0;
+volatile int KDtree_cache::cacheClock = 0;
+vector<KDtree_cache*> KDtree_cache::cachedTrees;
+
+/** key of a slot whose cache was evicted, the search for a key goes on */
+#define KDCACHE_EVICTED ((const Scan*)1)
+
+/**
+ * Atomically adds delta to value
+ * @return the new value
+ */
+static inline int atomicAdd(volatile int *value, int delta)
+{
+#if defined(__GNUC__)
+  return __sync_add_and_fetch(value, delta);
+#elif defined(_MSC_VER)
+  return InterlockedExchangeAdd((volatile long *)value, delta) + delta;
+#else
+  int result;
+#pragma omp critical (kdcache_atomic)
+  result = (*value += delta);
+  return result;
+#endif
+}
+
+/**
+ * Full memory barrier, orders publishing and evicting caches
+ */
+static inline void memoryBarrier()
+{
+#if defined(__GNUC__)
+  __sync_synchronize();
+#elif defined(_MSC_VER)
+  MemoryBarrier();
+#endif
+}
+
+/**
+ * First slot of a target in the hash table of caches
+ */
+static inline unsigned int cacheSlot(const Scan *Target)
+{
+  return (unsigned int)(((size_t)Target >> 4) * 2654435761u) % KDCACHE_SLOTS;
+}
 
 /**
  * Constructor
@@ -38,6 +88,8 @@ KDCacheItem KDtree_cache::cacheItem[MAX_OPENMP_NUM_THREADS];
 KDtree_cache::KDtree_cache(double **pts, int n, KDtree_cache *_parent)
 {
   parent = _parent;
+  index = -1;
+  closest_cache = 0;
 
   // Find bbox
   double xmin = pts[0][0], xmax = pts[0][0];
@@ -231,42 +283,223 @@ void KDtree_cache::_FindClosestCacheInit(int threadNum)
   }
 }
 
-KDCacheItem* KDtree_cache::initCache(const Scan* Target)
+/**
+ * Numbers the nodes of the tree in depth-first order.
+ *
+ * @param nodes receives the nodes by index
+ */
+void KDtree_cache::numberNodes(vector<KDtree_cache*> &nodes)
 {
-  KDCacheItem *closest = 0;
-  
-  // determine cache
-  for(unsigned int i = 0; i < closest_cache.size(); i++) {
-    if (closest_cache[i]->target == Target) {
-      closest = closest_cache[i]->item; 	                 // cache found
+  index = (int)nodes.size();
+  nodes.push_back(this);
+  if (npts) return;
+  node.child1->numberNodes(nodes);
+  node.child2->numberNodes(nodes);
+}
+
+/**
+ * Returns the cache of a target scan for use by the calling thread.
+ * Finding an existing cache takes no lock, only creating one does.
+ * The cache has to be returned with releaseCache.
+ *
+ * @param Target the target scan
+ * @return the cache, or 0 if no memory may be used for it
+ */
+KDCache* KDtree_cache::acquireCache(const Scan* Target)
+{
+  KDCacheTable *table = closest_cache;
+  if (table) {
+    unsigned int h = cacheSlot(Target);
+    for (int k = 0; k < KDCACHE_SLOTS; k++) {
+      KDCache *cache = &table->slot[(h + k) % KDCACHE_SLOTS];
+      const Scan *target = cache->target;
+      if (target == 0) break;
+      if (target != Target) continue;
+      // announce the use before checking again, evictCache does it the
+      // other way round, so either sees the other
+      atomicAdd(&cache->users, 1);
+      if (cache->target == Target) {
+        cache->lastUse = atomicAdd(&cacheClock, 1);
+        return cache;
+      }
+      atomicAdd(&cache->users, -1);
       break;
     }
   }
-  // cache for this target is not initialized
-  if (closest == 0) {
-    closest = new KDCacheItem[Target->get_points_red_size()];
-    KDCache *nc = new KDCache;
-    nc->item = closest;
-    nc->target = Target;
-    closest_cache.push_back(nc);                              // append cache
+
+  KDCache *cache;
+#pragma omp critical (kdcache)
+  cache = insertCache(Target);
+  return cache;
+}
+
+/**
+ * Creates the cache of a target scan, evicting the least recently used
+ * caches if the table is full or the memory limit is reached. Has to be
+ * called in the critical section kdcache.
+ *
+ * @param Target the target scan
+ * @return the acquired cache, or 0 if no memory may be used for it
+ */
+KDCache* KDtree_cache::insertCache(const Scan* Target)
+{
+  if (closest_cache == 0) {
+    KDCacheTable *table = new KDCacheTable;
+    numberNodes(table->nodes);
+    memoryBarrier();
+    closest_cache = table;
+    cachedTrees.push_back(this);
+  }
+  KDCacheTable *table = closest_cache;
+  unsigned int h = cacheSlot(Target);
+
+  // another thread may have created it meanwhile
+  for (int k = 0; k < KDCACHE_SLOTS; k++) {
+    KDCache *cache = &table->slot[(h + k) % KDCACHE_SLOTS];
+    if (cache->target == 0) break;
+    if (cache->target == Target) {
+      atomicAdd(&cache->users, 1);
+      cache->lastUse = atomicAdd(&cacheClock, 1);
+      return cache;
+    }
+  }
+
+  int n = Target->get_points_red_size();
+  size_t bytes = n * sizeof(KDCacheEntry);
+  KDCache *cache = 0;
+  while (true) {
+    for (int k = 0; cache == 0 && k < KDCACHE_SLOTS; k++) {
+      KDCache *c = &table->slot[(h + k) % KDCACHE_SLOTS];
+      if (c->target == 0 || c->target == KDCACHE_EVICTED) cache = c;
+    }
+    if (cache && (maxCacheMemory == 0 || cacheMemory + bytes <= maxCacheMemory)) break;
+    if (!evictCache(cache ? 0 : table)) return 0;
   }
 
-  return closest;
+  cache->item = new KDCacheEntry[n];
+  for (int i = 0; i < n; i++) cache->item[i].node = -1;
+  cache->size = n;
+  atomicAdd(&cache->users, 1);
+  cache->lastUse = atomicAdd(&cacheClock, 1);
+  cacheMemory += bytes;
+  memoryBarrier();
+  cache->target = Target;
+  return cache;
+}
+
+/**
+ * Returns a cache obtained by acquireCache
+ */
+void KDtree_cache::releaseCache(KDCache *cache)
+{
+  atomicAdd(&cache->users, -1);
 }
 
+/**
+ * Deletes the least recently used cache that no thread is using. Has to
+ * be called in the critical section kdcache.
+ *
+ * @param table the table to evict from, 0 for the caches of all trees
+ * @return false if there is no such cache
+ */
+bool KDtree_cache::evictCache(KDCacheTable *table)
+{
+  while (true) {
+    KDCache *lru = 0;
+    for (unsigned int t = 0; t < (table ? 1 : cachedTrees.size()); t++) {
+      KDCacheTable *tab = table ? table : cachedTrees[t]->closest_cache;
+      for (int k = 0; k < KDCACHE_SLOTS; k++) {
+        KDCache *cache = &tab->slot[k];
+        if (cache->target == 0 || cache->target == KDCACHE_EVICTED || cache->users > 0) continue;
+        if (lru == 0 || cache->lastUse - lru->lastUse < 0) lru = cache;
+      }
+    }
+    if (lru == 0) return false;
+
+    const Scan *target = lru->target;
+    lru->target = KDCACHE_EVICTED;
+    memoryBarrier();
+    if (lru->users > 0) {
+      // acquired meanwhile
+      lru->target = target;
+      continue;
+    }
+    delete [] lru->item;
+    lru->item = 0;
+    cacheMemory -= lru->size * sizeof(KDCacheEntry);
+    lru->size = 0;
+    return true;
+  }
+}
 
-void KDtree_cache::getPtPairs(vector <PtPair> *pairs, 
+/**
+ * Deletes all caches of the tree
+ */
+void KDtree_cache::deleteCaches()
+{
+#pragma omp critical (kdcache)
+  {
+    for (int k = 0; k < KDCACHE_SLOTS; k++) {
+      KDCache *cache = &closest_cache->slot[k];
+      if (cache->item) {
+        delete [] cache->item;
+        cacheMemory -= cache->size * sizeof(KDCacheEntry);
+      }
+    }
+    for (unsigned int t = 0; t < cachedTrees.size(); t++) {
+      if (cachedTrees[t] == this) {
+        cachedTrees.erase(cachedTrees.begin() + t);
+        break;
+      }
+    }
+    delete closest_cache;
+    closest_cache = 0;
+  }
+}
+
+/**
+ * Searches the closest point, starting at the node the cache entry of
+ * the query point remembers and updating the entry afterwards
+ *
+ * @param entry the cache entry of the query point, 0 for no cache
+ * @param nodes the nodes of the cache table
+ * @param _p the query point
+ * @param maxdist2 maximal search distance
+ * @param threadNum Thread number, for parallelization
+ * @return the cache item of the search
+ */
+KDCacheItem* KDtree_cache::FindClosestCached(KDCacheEntry *entry, KDtree_cache * const *nodes,
+                                             double *_p, double maxdist2, int threadNum)
+{
+  KDCacheItem *item;
+  if (entry && entry->node >= 0) {
+    item = nodes[entry->node]->FindClosestCache(_p, maxdist2, threadNum);
+  } else {
+    item = this->FindClosestCacheInit(_p, maxdist2, threadNum);
+  }
+  if (entry) entry->node = item->node ? item->node->index : -1;
+  return item;
+}
+
+void KDtree_cache::getPtPairs(vector <PtPair> *pairs,
     double *source_alignxf,                          // source
     double * const *q_points, unsigned int startindex, unsigned int nr_qpts,  // target
     int thread_num,
     int rnd, double max_dist_match2, double &sum,
     double *centroid_m, double *centroid_d, Scan *Target)
 {
-  KDCacheItem *closest;
-  #pragma omp critical
-  {
-  closest = initCache(Target);
+  INSTRUMENT_SCOPE(INSTR_GETPTPAIRS);
+  unsigned int queries = 0;
+  size_t first = pairs->size();
+
+  // without a cache every point is searched from the root
+  KDCache *cache = Target ? acquireCache(Target) : 0;
+  if (cache && cache->size < (int)nr_qpts) {
+    releaseCache(cache);
+    cache = 0;
   }
+  KDCacheEntry *closest = cache ? cache->item : 0;
+  KDtree_cache * const *nodes = cache ? &closest_cache->nodes[0] : 0;
 
   centroid_m[0] = 0.0;
   centroid_m[1] = 0.0;
@@ -278,30 +511,29 @@ void KDtree_cache::getPtPairs(vector <PtPair> *pairs,
   double local_alignxf_inv[16];
   M4inv(source_alignxf, local_alignxf_inv);
 
+  unsigned int seed = Target ? Target->get_fileNr() : 0;
   for (unsigned int i = startindex; i < (unsigned int)nr_qpts; i++) {
-    if (rnd > 1 && rand(rnd) != 0) continue;  // take about 1/rnd-th of the numbers only
+    if (rnd > 1 && !subsample(rnd, seed, i)) continue;  // take about 1/rnd-th of the numbers only
 
     double p[3];
     transform3(local_alignxf_inv, q_points[i], p);
 
-    if (closest[i].node) {
-      closest[i] = *(closest[i].node->FindClosestCache(p, max_dist_match2, thread_num));
-    } else {
-      closest[i] = *(this->FindClosestCacheInit(p, max_dist_match2, thread_num));
-    }
-    if (closest[i].param.closest_d2 < max_dist_match2 ) {
-      transform3(source_alignxf, closest[i].param.closest, p);
+    queries++;
+    KDCacheItem *item = FindClosestCached(closest ? &closest[i] : 0, nodes,
+                                          p, max_dist_match2, thread_num);
+    if (item->param.closest_d2 < max_dist_match2 ) {
+      transform3(source_alignxf, item->param.closest, p);
 
       centroid_d[0] += q_points[i][0];
       centroid_d[1] += q_points[i][1];
       centroid_d[2] += q_points[i][2];
       centroid_m[0] += p[0];
       centroid_m[1] += p[1];
-      centroid_m[2] += p[2];	 
+      centroid_m[2] += p[2];
 
       PtPair myPair(p, q_points[i]);
-      double p12[3] = { 
-        myPair.p1.x - myPair.p2.x, 
+      double p12[3] = {
+        myPair.p1.x - myPair.p2.x,
         myPair.p1.y - myPair.p2.y,
         myPair.p1.z - myPair.p2.z };
       sum += Len2(p12);
@@ -310,6 +542,10 @@ void KDtree_cache::getPtPairs(vector <PtPair> *pairs,
     }
   }
 
+  INSTRUMENT_COUNT(INSTR_NN_QUERIES, queries);
+  INSTRUMENT_COUNT(INSTR_PAIRS_FOUND, pairs->size() - first);
+  if (cache) releaseCache(cache);
+
   centroid_m[0] /= pairs->size();
   centroid_m[1] /= pairs->size();
   centroid_m[2] /= pairs->size();
@@ -320,8 +556,107 @@ void KDtree_cache::getPtPairs(vector <PtPair> *pairs,
   return;
 }
 
+/**
+ * Tests for a closest point for SearchTree::countPairs. The search
+ * starts at the root and the cache of the target is neither used nor
+ * updated, since only few of its points are visited.
+ */
+bool KDtree_cache::HasClosest(double *_p, double maxdist2, int threadNum)
+{
+  return FindClosestCacheInit(_p, maxdist2, threadNum)->param.closest_d2 < maxdist2;
+}
 
+/**
+ * Adds the point to plane pairs like SearchTree::getPtPlaneSystem, using
+ * and updating the cache of the target like getPtPairs.
+ */
+void KDtree_cache::getPtPlaneSystem(PtPlaneSystem &system,
+    double *source_alignxf,                          // source
+    double * const *q_points, unsigned int startindex, unsigned int nr_qpts,  // target
+    int thread_num, int rnd, double max_dist_match2, Scan *Target)
+{
+  KDCache *cache = Target ? acquireCache(Target) : 0;
+  if (cache && cache->size < (int)nr_qpts) {
+    releaseCache(cache);
+    cache = 0;
+  }
+  KDCacheEntry *closest = cache ? cache->item : 0;
+  KDtree_cache * const *nodes = cache ? &closest_cache->nodes[0] : 0;
 
+  double local_alignxf_inv[16];
+  M4inv(source_alignxf, local_alignxf_inv);
 
+  unsigned int seed = Target ? Target->get_fileNr() : 0;
+  for (unsigned int i = startindex; i < nr_qpts; i++) {
+    if (rnd > 1 && !subsample(rnd, seed, i)) continue;  // take about 1/rnd-th of the numbers only
 
+    double p[3];
+    transform3(local_alignxf_inv, q_points[i], p);
 
+    KDCacheItem *item = FindClosestCached(closest ? &closest[i] : 0, nodes,
+                                          p, max_dist_match2, thread_num);
+    if (item->param.closest_d2 < max_dist_match2) {
+      double n[3];
+      transform3(source_alignxf, item->param.closest, p);
+      rotate3(source_alignxf, item->param.closest + 3, n);
+      system.add(p, n, q_points[i]);
+    }
+  }
+
+  if (cache) releaseCache(cache);
+}
+
+/**
+ * Finds the k closest points within the tree, see KDtree::FindKClosest
+ */
+int KDtree_cache::FindKClosest(double *_p, int k, double maxdist2,
+                               double **closest, double *closest_d2)
+{
+  KDKnnParams params;
+  params.p = _p;
+  params.k = k;
+  params.found = 0;
+  params.closest = closest;
+  params.closest_d2 = closest_d2;
+  params.maxdist2 = maxdist2;
+  if (k > 0) _FindKClosest(params);
+  return params.found;
+}
+
+/**
+ * Wrapped function
+ */
+void KDtree_cache::_FindKClosest(KDKnnParams &params)
+{
+  // Leaf nodes
+  if (npts) {
+    for (int i = 0; i < npts; i++) {
+      double myd2 = Dist2(params.p, leaf.p[i]);
+      if (myd2 < params.maxdist2) {
+        params.insert(leaf.p[i], myd2);
+      }
+    }
+    return;
+  }
+
+  // Quick check of whether to abort
+  double approx_dist_bbox = max(max(fabs(params.p[0]-center[0])-node.dx,
+                                    fabs(params.p[1]-center[1])-node.dy),
+                                fabs(params.p[2]-center[2])-node.dz);
+  if (approx_dist_bbox >= 0 && sqr(approx_dist_bbox) >= params.maxdist2)
+    return;
+
+  // Recursive case
+  double myd = center[node.splitaxis] - params.p[node.splitaxis];
+  if (myd >= 0.0) {
+    node.child1->_FindKClosest(params);
+    if (sqr(myd) < params.maxdist2) {
+      node.child2->_FindKClosest(params);
+    }
+  } else {
+    node.child2->_FindKClosest(params);
+    if (sqr(myd) < params.maxdist2) {
+      node.child1->_FindKClosest(params);
+    }
+  }
+}
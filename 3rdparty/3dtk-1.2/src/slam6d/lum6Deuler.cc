@@ -26,10 +26,13 @@
 #include "sparse/csparse.h"
 
 #include <cfloat>
+#include <cstring>
 #include <fstream>
 using std::ofstream;
 using std::cerr;
+using std::make_pair;
 #include "slam6d/globals.icc"
+#include "slam6d/instrument.h"
 
 using namespace NEWMAT;
 /**
@@ -55,9 +58,25 @@ lum6DEuler::lum6DEuler(icp6Dminimizer *my_icp6Dminimizer,
   : graphSlam6D(my_icp6Dminimizer,
 			 mdm, max_dist_match,
 			 max_num_iterations, quiet, meta, rnd,
-			 eP, anim, epsilonICP, nns_method, epsilonLUM)
+			 eP, anim, epsilonICP, nns_method, epsilonLUM),
+    refreshDist(-1.0)
 { }
 
+/**
+ * Switches to the pose graph only mode. The constraints of a link are
+ * computed from its point pairs once and afterwards derived from the
+ * current poses, until one of its scans moved by more than refreshDist.
+ *
+ * @param refreshDist largest movement of a point of a scan in 'units'
+ *        before the constraints are computed from the points again,
+ *        negative to compute them in every iteration
+ */
+void lum6DEuler::set_refreshDist(double refreshDist)
+{
+  this->refreshDist = refreshDist;
+  constraints.clear();
+}
+
 
 /**
  * Destructor
@@ -84,6 +103,8 @@ void lum6DEuler::covarianceEuler(Scan *first, Scan *second,
 						   int nns_method, int rnd, double max_dist_match2, 
                                  Matrix *C, ColumnVector *CD) 
 {
+  INSTRUMENT_SCOPE(INSTR_COVARIANCE);
+
   // x,y,z       denote the coordinates of uk (Here averaged over ak and bk)
   // sx,sy,sz    are the sums of their respective coordinates of uk over each paint pair
   // xpy,xpz,ypz are the sums over x*x + y*y ,x*x + z*z and y*y + z*z respectively over each point pair
@@ -232,6 +253,165 @@ void lum6DEuler::covarianceEuler(Scan *first, Scan *second,
   }
 }
 
+/**
+ * The motion of the points of a scan that corresponds to the pose
+ * difference D of covarianceEuler, p -> R p + t. D(4), D(5) and D(6)
+ * are small angles about the x, z and y axis, they are taken as the
+ * rotation vector of R.
+ *
+ * @param D the pose difference
+ * @param N the motion as transformation matrix
+ */
+static void differenceToMotion(const ColumnVector &D, double *N)
+{
+  double w[3] = { D(4), D(6), D(5) };
+  double angle2 = Len2(w);
+  double angle = sqrt(angle2);
+
+  // Rodrigues: R = I + a [w]x + b [w]x^2
+  double a = 1.0, b = 0.5;
+  if (angle > 1e-12) {
+    a = sin(angle) / angle;
+    b = (1.0 - cos(angle)) / angle2;
+  }
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      N[i + 4*j] = b * w[i] * w[j] + (i == j ? 1.0 - b * angle2 : 0.0);
+    }
+  }
+  N[1] += a * w[2];  N[4] -= a * w[2];
+  N[8] += a * w[1];  N[2] -= a * w[1];
+  N[6] += a * w[0];  N[9] -= a * w[0];
+
+  N[3] = N[7] = N[11] = 0.0;
+  N[12] = D(1);
+  N[13] = D(2);
+  N[14] = D(3);
+  N[15] = 1.0;
+}
+
+/**
+ * The inverse of differenceToMotion
+ *
+ * @param N the motion as transformation matrix
+ * @param D the pose difference
+ */
+static void motionToDifference(const double *N, ColumnVector &D)
+{
+  // sin(angle) times the axis
+  double w[3] = { 0.5 * (N[6] - N[9]), 0.5 * (N[8] - N[2]), 0.5 * (N[1] - N[4]) };
+  double s = Len(w);
+  double c = 0.5 * (N[0] + N[5] + N[10] - 1.0);
+  double f = s > 1e-12 ? atan2(s, c) / s : 1.0;
+
+  D(1) = N[12];
+  D(2) = N[13];
+  D(3) = N[14];
+  D(4) = f * w[0];
+  D(5) = f * w[2];
+  D(6) = f * w[1];
+}
+
+/**
+ * Bounds how far the points of a scan moved since it had the
+ * transformation oldTransMat: the movement of its old position plus the
+ * angle of the rotation times the largest distance of a point to it.
+ *
+ * @param scan the scan
+ * @param oldTransMat the former transformation of the scan
+ * @param oldPos the former position of the scan
+ * @param radius largest distance of a point to the position
+ * @return the distance in 'units'
+ */
+static double scanMovement(const Scan *scan, const double *oldTransMat,
+                           const double *oldPos, double radius)
+{
+  double inv[16], K[16];
+  M4inv(oldTransMat, inv);
+  MMult(scan->get_transMat(), inv, K);
+
+  double d[3];
+  for (int i = 0; i < 3; i++) {
+    d[i] = K[i] * oldPos[0] + K[i+4] * oldPos[1] + K[i+8] * oldPos[2] + K[i+12] - oldPos[i];
+  }
+  double c = 0.5 * (K[0] + K[5] + K[10] - 1.0);
+  double angle = acos(max(-1.0, min(1.0, c)));
+
+  return Len(d) + angle * radius;
+}
+
+/**
+ * Computes the constraints of a link in the pose graph only mode. They
+ * are computed from the point pairs if the link is new or one of its
+ * scans moved by more than refreshDist since. Otherwise the pose
+ * difference is the motion that takes the second scan back to the
+ * relative pose the point pairs agreed on, weighted with their inverse
+ * covariance.
+ *
+ * @param first pointer to the first scan of the link
+ * @param second pointer to the second scan of the link
+ * @param constraint the cached constraint of the link
+ * @param C pointer to the inverse of the covariance matrix Cij
+ * @param CD pointer to the vector Cij*Dij
+ * @return true, if the constraints were computed from the points
+ */
+bool lum6DEuler::linkConstraint(Scan *first, Scan *second, lumConstraint *constraint,
+                                Matrix *C, ColumnVector *CD)
+{
+  Scan *scans[2] = { first, second };
+
+  bool refresh = !constraint->valid;
+  for (int k = 0; k < 2 && !refresh; k++) {
+    refresh = scanMovement(scans[k], constraint->transMat[k], constraint->rPos[k],
+                           constraint->radius[k]) > refreshDist;
+  }
+
+  if (refresh) {
+    constraint->C.ReSize(6,6);
+    covarianceEuler(first, second, nns_method, (int)my_icp->get_rnd(),
+                    (int)max_dist_match2_LUM, &constraint->C, CD);
+
+    for (int k = 0; k < 2; k++) {
+      memcpy(constraint->transMat[k], scans[k]->get_transMat(), 16 * sizeof(double));
+      memcpy(constraint->rPos[k], scans[k]->get_rPos(), 3 * sizeof(double));
+      double radius2 = 0.0;
+      double * const *points_red = scans[k]->get_points_red();
+      for (int j = 0; j < scans[k]->get_points_red_size(); j++) {
+        radius2 = max(radius2, Dist2(points_red[j], constraint->rPos[k]));
+      }
+      constraint->radius[k] = sqrt(radius2);
+    }
+
+    // the point pairs agree if the second scan is moved by D
+    ColumnVector D(6);
+    D = 0.0;
+    if (constraint->C.MaximumAbsoluteValue() > 0.0) {
+      D = constraint->C.i() * (*CD);
+    }
+    double N[16], moved[16], inv[16];
+    differenceToMotion(D, N);
+    MMult(N, second->get_transMat(), moved);
+    M4inv(first->get_transMat(), inv);
+    MMult(inv, moved, constraint->relative);
+    constraint->valid = true;
+
+    *C = constraint->C;
+    return true;
+  }
+
+  // the motion that takes the second scan to first * relative
+  double target[16], inv[16], N[16];
+  MMult(first->get_transMat(), constraint->relative, target);
+  M4inv(second->get_transMat(), inv);
+  MMult(target, inv, N);
+
+  ColumnVector D(6);
+  motionToDifference(N, D);
+  *C = constraint->C;
+  *CD = constraint->C * D;
+  return false;
+}
+
 /**
  * A function to fill the linear system G X = B.
  *
@@ -243,8 +423,20 @@ void lum6DEuler::covarianceEuler(Scan *first, Scan *second,
  */
 void lum6DEuler::FillGB3D(Graph *gr, GraphMatrix* G, ColumnVector* B,vector<Scan *> allScans )
 {
+  INSTRUMENT_SCOPE(INSTR_FILLGB);
+
+  // the cached constraints are looked up before the parallel loop
+  vector <lumConstraint*> linkConstraints(gr->getNrLinks(), (lumConstraint*)0);
+  if (refreshDist >= 0.0) {
+    for(int i = 0; i < gr->getNrLinks(); i++){
+      linkConstraints[i] = &constraints[make_pair(allScans[gr->getLink(i,0)],
+                                                  allScans[gr->getLink(i,1)])];
+    }
+  }
+  int refreshed = 0;
+
 #ifdef _OPENMP
-#pragma omp parallel for schedule(dynamic)
+#pragma omp parallel for schedule(dynamic) reduction(+:refreshed)
 #endif
   for(int i = 0; i < gr->getNrLinks(); i++){
     int a = gr->getLink(i,0) - 1;
@@ -254,10 +446,27 @@ void lum6DEuler::FillGB3D(Graph *gr, GraphMatrix* G, ColumnVector* B,vector<Scan
   
     //    cout << "i " << i << " a: " << a << " b: " << b << endl; 
 
+    // keep the scans of the link in memory and read the scans of the link
+    // started after the running ones ahead, see Scan::maxResidentMemory
+    Scan::acquire(FirstScan);
+    Scan::acquire(SecondScan);
+    if (i + OPENMP_NUM_THREADS < gr->getNrLinks()) {
+      Scan::prefetch(allScans[gr->getLink(i + OPENMP_NUM_THREADS, 0)]);
+      Scan::prefetch(allScans[gr->getLink(i + OPENMP_NUM_THREADS, 1)]);
+    }
+
     Matrix Cab(6,6);
     ColumnVector CDab(6);
-    covarianceEuler(FirstScan, SecondScan, nns_method, (int)my_icp->get_rnd(), 
-                    (int)max_dist_match2_LUM, &Cab, &CDab); 
+    if (linkConstraints[i]) {
+      if (linkConstraint(FirstScan, SecondScan, linkConstraints[i], &Cab, &CDab)) {
+        refreshed++;
+      }
+    } else {
+      covarianceEuler(FirstScan, SecondScan, nns_method, (int)my_icp->get_rnd(), 
+                      (int)max_dist_match2_LUM, &Cab, &CDab); 
+    }
+    Scan::release(FirstScan);
+    Scan::release(SecondScan);
 
 #pragma omp critical
     {
@@ -277,6 +486,10 @@ void lum6DEuler::FillGB3D(Graph *gr, GraphMatrix* G, ColumnVector* B,vector<Scan
     }
   }
 
+  if (refreshDist >= 0.0) {
+    cout << "Constraints computed from points: " << refreshed
+         << " of " << gr->getNrLinks() << endl;
+  }
 //  G->print();
 }
 
@@ -30,6 +30,7 @@ using std::stringstream;
 #include "slam6d/kd.h"
 #include "slam6d/kdc.h"
 #include "slam6d/ann_kd.h"
+#include "slam6d/instrument.h"
 
 #ifdef _OPENMP
 #include <omp.h>
@@ -37,8 +38,12 @@ using std::stringstream;
 
 #ifdef _MSC_VER
 #include <windows.h>
+#include <direct.h>
 #else
 #include <dlfcn.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 #endif
 
 #ifdef _MSC_VER
@@ -49,13 +54,38 @@ using std::stringstream;
 #endif
 
 #include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cfloat>
+#include <algorithm>
 using std::flush;
+using std::sort;
 
 vector <Scan *>  Scan::allScans;
 unsigned int     Scan::numberOfScans = 0;
 unsigned int     Scan::max_points_red_size = 0;
 bool             Scan::outputFrames = false;
 string           Scan::dir;
+string           Scan::cacheDir;
+size_t           Scan::maxResidentMemory = 0;
+string           Scan::swapFileName;
+
+/**
+ * The scans with a search tree in memory, the most recently used first,
+ * see Scan::maxResidentMemory
+ */
+static list<Scan *> residentScans;
+
+/**
+ * Memory of the scans in residentScans
+ */
+static size_t residentMemory = 0;
+
+/**
+ * The swap file and its length, opened on first use
+ */
+static FILE *swapFile = 0;
+static long long swapFileEnd = 0;
 
 /**
  * default Constructor
@@ -158,6 +188,56 @@ Scan::Scan(const double _rPos[3], const double _rPosTheta[3], vector<double *> &
 }
 
 
+/**
+ * Constructor for a scan whose points are held by the caller, e.g., in the
+ * point cloud of another library. The coordinates are taken directly from
+ * the caller's memory instead of being read from a file. The caller keeps
+ * the ownership of the memory, the scan does not refer to it afterwards.
+ *
+ * @param euler 6D pose: estimation of the scan location, e.g. based on odometry
+ * @param xyz x, y and z coordinate of the first point
+ * @param n number of points
+ * @param stride distance of two consecutive points in floats, e.g., 4 for padded points
+ * @param maxDist Regard only points up to an (Euclidean) distance of maxDist
+ * @param minDist Regard only points from an (Euclidean) distance of minDist
+ */
+Scan::Scan(const double *euler, const float *xyz, unsigned int n, unsigned int stride,
+           int maxDist, int minDist)
+{
+  kd = 0;
+  ann_kd_tree = 0;
+  nns_method = 1;
+  cuda_enabled = false;
+  maxDist2 = (maxDist != -1 ? sqr((double)maxDist) : maxDist);
+  double minDist2 = (minDist != -1 ? sqr((double)minDist) : minDist);
+
+  rPos[0] = euler[0];
+  rPos[1] = euler[1];
+  rPos[2] = euler[2];
+  rPosTheta[0] = euler[3];
+  rPosTheta[1] = euler[4];
+  rPosTheta[2] = euler[5];
+  M4identity(transMat);
+  EulerToMatrix4(euler, &euler[3], transMatOrg);
+
+  fileNr = -1; // there is no file to store frames for
+  scanNr = numberOfScans++;
+
+  points_red_size = 0;
+  points_red = points_red_lum = 0;
+  M4identity(dalignxf);
+
+  points.reserve(n);
+  for (unsigned int i = 0; i < n; i++, xyz += stride) {
+    Point p(xyz[0], xyz[1], xyz[2]);
+    double d2 = sqr(p.x) + sqr(p.y) + sqr(p.z);
+    // maxDist2 = -1 indicates no limitation
+    if (maxDist2 != -1 && d2 >= maxDist2) continue;
+    if (minDist2 != -1 && d2 <= minDist2) continue;
+    points.push_back(p);
+  }
+}
+
 /**
  * Constructor
  * @param _rPos[3] 3D position: estimation of the scan location, e.g. based on odometry
@@ -223,6 +303,7 @@ Scan::Scan(const vector < Scan* >& MetaScan, int nns_method, bool cuda_enabled)
   points_red = new double*[numpts];  
   int k = 0;
   for (int i = 0; i < end_loop; i++) {
+    acquire(MetaScan[i]);
     for (int j = 0; j < MetaScan[i]->points_red_size; j++) {
 	 points_red[k] = new double[3];
 	 points_red[k][0] = MetaScan[i]->points_red[j][0];
@@ -230,6 +311,7 @@ Scan::Scan(const vector < Scan* >& MetaScan, int nns_method, bool cuda_enabled)
 	 points_red[k][2] = MetaScan[i]->points_red[j][2];
 	 k++;
     }
+    release(MetaScan[i]);
   }
 
   fileNr = -1; // no need to store something from a meta scan!
@@ -269,8 +351,16 @@ Scan::~Scan()
     fout.clear();
   }
 
+  if (swapState.swapped) {
+    // nothing of the scan is in memory
+    points_red_size = 0;
+  }
   if (this->kd != 0) deleteTree();
 
+  for (unsigned int i = 0; i < pyramid.size(); i++) {
+    delete pyramid[i];
+  }
+
   // delete Scan from ScanList
   vector <Scan*>::iterator Iter;
   for(Iter = allScans.begin(); Iter != allScans.end();) {
@@ -308,6 +398,7 @@ Scan::Scan(const Scan& s)
   // copy data points
   for (unsigned int i = 0; i < s.points.size(); points.push_back(s.points[i++]));    
   // copy reduced data
+  acquire(&s);
   points_red_size = s.points_red_size;
   points_red = new double*[points_red_size];
   for (int i = 0; i < points_red_size; i++) {
@@ -316,6 +407,7 @@ Scan::Scan(const Scan& s)
     points_red[i][1] = s.points_red[i][1];
     points_red[i][2] = s.points_red[i][2];
   }
+  release(&s);
   memcpy(dalignxf, s.dalignxf, sizeof(dalignxf));
   nns_method = s.nns_method;
   cuda_enabled = s.cuda_enabled;
@@ -390,10 +482,14 @@ void Scan::transformAll(const double alignxf[16])
  */
 void Scan::transform(const double alignxf[16], const AlgoType type, int islum)
 {
+  INSTRUMENT_SCOPE(INSTR_TRANSFORM);
   int end_meta = (int)meta_parts.size();
   for(int i = 0; i < end_meta; i++) {
     meta_parts[i]->transform(alignxf, type, -1);
   }
+  for(unsigned int i = 0; i < pyramid.size(); i++) {
+    pyramid[i]->transform(alignxf, INVALID);
+  }
   int end_loop = (int)points.size();
 #ifdef TRANSFORM_ALL_POINTS
   /*
@@ -418,10 +514,20 @@ void Scan::transform(const double alignxf[16], const AlgoType type, int islum)
 	  << rPosTheta[0] << ", " << rPosTheta[1] << ", " << rPosTheta[2] << ") ---> ";
 #endif
 
+  // a swapped out scan gets the transformation when it is read back
+  int end_red = points_red_size;
+  if (swapState.swapped) {
+    double tempxf[16];
+    MMult(alignxf, swapState.xf, tempxf);
+    memcpy(swapState.xf, tempxf, sizeof(tempxf));
+    end_red = 0;
+  }
+  INSTRUMENT_COUNT(INSTR_POINTS_TRANSFORMED, end_red);
+
 #ifdef _OPENMP
 #pragma omp parallel for
 #endif
-  for (int i = 0; i < points_red_size; i++) {
+  for (int i = 0; i < end_red; i++) {
     double x_neu, y_neu, z_neu;
     x_neu = points_red[i][0] * alignxf[0] + points_red[i][1] * alignxf[4] + points_red[i][2] * alignxf[8];
     y_neu = points_red[i][0] * alignxf[1] + points_red[i][1] * alignxf[5] + points_red[i][2] * alignxf[9];
@@ -451,6 +557,8 @@ void Scan::transform(const double alignxf[16], const AlgoType type, int islum)
   bool in_meta;
   int  found = 0;
   if (type != INVALID) {
+    INSTRUMENT_SCOPE(INSTR_FRAMES);
+    INSTRUMENT_COUNT(INSTR_FRAMES_STORED, islum >= 0 ? 1 : 0);
 
     switch (islum) {
     case -1:
@@ -700,6 +808,79 @@ void Scan::calcReducedPoints(double voxelSize, int nrpts)
   if (points_red_size > (int)max_points_red_size) max_points_red_size = points_red_size;
 }
 
+/**
+ * Builds coarser reduction levels of the scan for coarse-to-fine matching.
+ * The voxel size is doubled from level to level. Has to be called while
+ * the original points are still present; the levels are put into the pose
+ * of the scan and get their search trees in finishSearch.
+ *
+ * @param levels number of levels including the scan itself
+ * @param voxelSize voxel size of the scan itself
+ * @param nrpts number of points per voxel, see calcReducedPoints
+ */
+void Scan::calcPyramid(int levels, double voxelSize, int nrpts)
+{
+  if (voxelSize <= 0.0) {
+    cerr << "WARNING: reduction levels require a voxel size (-r), none built" << endl;
+    return;
+  }
+
+  for (int l = 1; l < levels; l++) {
+    Scan *level = new Scan();
+    level->fileNr = -1; // no need to store frames for a level
+#ifdef _OPENMP
+#pragma omp critical (numberOfScans)
+#endif
+    level->scanNr = numberOfScans++;
+    level->maxDist2 = maxDist2;
+    memcpy(level->transMatOrg, transMatOrg, sizeof(transMatOrg));
+
+    level->points = points;
+    level->calcReducedPoints(voxelSize * (1 << l), nrpts);
+    level->clearPoints();
+    pyramid.push_back(level);
+  }
+}
+
+/**
+ * Creates a working copy of the reduced points and the pose of the scan,
+ * including its reduction levels. The copy has no search tree, writes no
+ * frames and is not listed in allScans. It may be transformed freely while
+ * the scan itself remains untouched, e.g., to match several scans at once.
+ *
+ * @return the copy, to be deleted by the caller
+ */
+Scan* Scan::copyReduced() const
+{
+  Scan *copy = new Scan();
+  copy->fileNr = -1; // no need to store frames for a copy
+  copy->scanNr = scanNr;
+  copy->maxDist2 = maxDist2;
+  copy->nns_method = nns_method;
+  memcpy(copy->transMat, transMat, sizeof(transMat));
+  memcpy(copy->transMatOrg, transMatOrg, sizeof(transMatOrg));
+  memcpy(copy->rPos, rPos, sizeof(rPos));
+  memcpy(copy->rPosTheta, rPosTheta, sizeof(rPosTheta));
+  memcpy(copy->rQuat, rQuat, sizeof(rQuat));
+
+  acquire(this);
+  copy->points_red_size = points_red_size;
+  copy->points_red = new double*[points_red_size];
+  for (int i = 0; i < points_red_size; i++) {
+    copy->points_red[i] = new double[3];
+    copy->points_red[i][0] = points_red[i][0];
+    copy->points_red[i][1] = points_red[i][1];
+    copy->points_red[i][2] = points_red[i][2];
+  }
+  release(this);
+
+  for (unsigned int i = 0; i < pyramid.size(); i++) {
+    copy->pyramid.push_back(pyramid[i]->copyReduced());
+  }
+
+  return copy;
+}
+
 /**
  * Calculates the search trees for all scans
  */
@@ -794,6 +975,8 @@ void Scan::getNoPairsSimple(vector <double*> &diff,
   unsigned int numpts_target;
   KDtree *kd = 0;
 
+  acquire(Source);
+  acquire(Target);
   kd = new KDtree(Target->points_red, Target->points_red_size);
   numpts_target = Source->points_red_size;
   
@@ -814,6 +997,8 @@ void Scan::getNoPairsSimple(vector <double*> &diff,
   }
   
   delete kd;
+  release(Source);
+  release(Target);
   return;
 }
 
@@ -838,11 +1023,13 @@ void Scan::getPtPairsSimple(vector <PtPair> *pairs,
   unsigned int numpts_target;
   KDtree *kd = 0;
 
+  acquire(Source);
+  acquire(Target);
   kd = new KDtree(Source->points_red, Source->points_red_size);
   numpts_target = Target->points_red_size;
 
   for (unsigned int i = 0; i < numpts_target; i++) {
-    if (rnd > 1 && rand(rnd) != 0) continue;  // take about 1/rnd-th of the numbers only
+    if (rnd > 1 && !subsample(rnd, Target->fileNr, i)) continue;  // take about 1/rnd-th of the numbers only
 
     double p[3];
     p[0] = Target->points_red[i][0];
@@ -869,6 +1056,8 @@ void Scan::getPtPairsSimple(vector <PtPair> *pairs,
   centroid_d[2] /= pairs[thread_num].size();
 
   delete kd;
+  release(Source);
+  release(Target);
   return;
 }
 
@@ -896,10 +1085,14 @@ void Scan::getPtPairs(vector <PtPair> *pairs,
 				  int rnd, double max_dist_match2, double &sum,
 				  double *centroid_m, double *centroid_d)
 {
+  acquire(Source);
+  acquire(Target);
   Source->kd->getPtPairs(pairs, Source->dalignxf,
       Target->points_red, 0, Target->points_red_size, 
       thread_num, 
       rnd, max_dist_match2, sum, centroid_m, centroid_d, Target);
+  release(Source);
+  release(Target);
 }
 
 
@@ -930,11 +1123,103 @@ void Scan::getPtPairsParallel(vector <PtPair> *pairs, Scan* Source, Scan* Target
 						double *sum,
 						double centroid_m[OPENMP_NUM_THREADS][3], double centroid_d[OPENMP_NUM_THREADS][3])
 {
+  acquire(Source);
+  acquire(Target);
   Source->kd->getPtPairs(&pairs[thread_num], Source->dalignxf, 
       Target->points_red, thread_num * step, thread_num * step + step, 
       thread_num, 
       rnd, max_dist_match2, sum[thread_num],
       centroid_m[thread_num], centroid_d[thread_num], Target);
+  release(Source);
+  release(Target);
+}
+
+
+/**
+ * Adds the point to plane pairs of two scans to a linear system instead
+ * of storing them, see PtPlaneSystem. The function uses the search tree
+ * and the normals stored in the Source scan, thus calcNormals has to be
+ * called before.
+ *
+ * @param system The system the pairs are added to
+ * @param Source The scan whose points are matched to Targets' points
+ * @param Target The scan to whiche the opints are matched
+ * @param thread_num number of the thread (for parallelization)
+ * @param startindex index of the first point of Target
+ * @param endindex index behind the last point of Target
+ * @param rnd randomized point selection
+ * @param max_dist_match2 maximal allowed distance for matching
+ */
+void Scan::getPtPlaneSystem(PtPlaneSystem &system,
+                            Scan* Source, Scan* Target,
+                            int thread_num, unsigned int startindex, unsigned int endindex,
+                            int rnd, double max_dist_match2)
+{
+  acquire(Source);
+  acquire(Target);
+  Source->kd->getPtPlaneSystem(system, Source->dalignxf,
+      Target->points_red, startindex, endindex,
+      thread_num, rnd, max_dist_match2, Target);
+  release(Source);
+  release(Target);
+}
+
+
+/**
+ * Counts the corresponding point pairs of two scans up to a threshold,
+ * e.g., to decide whether the scans overlap. No point pairs are stored
+ * and the search stops as soon as the outcome is known. The function
+ * uses the search tree stored in the Source scan.
+ *
+ * @param Source The scan whose points are matched to Targets' points
+ * @param Target The scan to whiche the opints are matched
+ * @param thread_num number of the thread (for parallelization)
+ * @param rnd randomized point selection, like getPtPairs
+ * @param max_dist_match2 maximal allowed distance for matching
+ * @param threshold number of pairs that suffices
+ * @return the number of pairs found, at most threshold
+ */
+int Scan::countPairs(Scan* Source, Scan* Target,
+                     int thread_num, int rnd,
+                     double max_dist_match2, int threshold)
+{
+  acquire(Source);
+  acquire(Target);
+  int count = Source->kd->countPairs(Source->dalignxf,
+      Target->points_red, 0, Target->points_red_size,
+      thread_num, rnd, max_dist_match2, threshold, Target);
+  release(Source);
+  release(Target);
+  return count;
+}
+
+/**
+ * Counts the corresponding point pairs of many scans against the search
+ * tree of one scan, see countPairs above.
+ *
+ * @param Source The scan whose search tree is used
+ * @param Targets The scans whose points are matched to Sources' points
+ * @param thread_num number of the thread (for parallelization)
+ * @param rnd randomized point selection, like getPtPairs
+ * @param max_dist_match2 maximal allowed distance for matching
+ * @param threshold number of pairs that suffices
+ * @param counts the number of pairs per target, at most threshold
+ */
+void Scan::countPairs(Scan* Source, const vector <Scan*> &Targets,
+                      int thread_num, int rnd,
+                      double max_dist_match2, int threshold,
+                      vector <int> &counts)
+{
+  counts.resize(Targets.size());
+  acquire(Source);
+  for (unsigned int i = 0; i < Targets.size(); i++) {
+    acquire(Targets[i]);
+    counts[i] = Source->kd->countPairs(Source->dalignxf,
+        Targets[i]->points_red, 0, Targets[i]->points_red_size,
+        thread_num, rnd, max_dist_match2, threshold, Targets[i]);
+    release(Targets[i]);
+  }
+  release(Source);
 }
 
 
@@ -944,6 +1229,7 @@ void Scan::getPtPairsParallel(vector <PtPair> *pairs, Scan* Source, Scan* Target
  */
 void Scan::createTree(int nns_method, bool cuda_enabled)
 {
+  INSTRUMENT_SCOPE(INSTR_CREATETREE);
   this->nns_method = nns_method;
   this->cuda_enabled = cuda_enabled;
   M4identity(dalignxf);
@@ -951,17 +1237,46 @@ void Scan::createTree(int nns_method, bool cuda_enabled)
   memcpy(temp, transMat, sizeof(transMat));
   M4inv(temp, treeTransMat_inv);
 
+  // every point is followed by its normal, see calcNormals
   points_red_lum = new double*[points_red_size];
   for (int j = 0; j < points_red_size; j++) {
-    points_red_lum[j] = new double[3];
+    points_red_lum[j] = new double[6];
     points_red_lum[j][0] = points_red[j][0];
     points_red_lum[j][1] = points_red[j][1];
     points_red_lum[j][2] = points_red[j][2];
+    points_red_lum[j][3] = points_red_lum[j][4] = points_red_lum[j][5] = 0.0;
   }
+  normals_red = false;
+
+  buildTree();
+  
+  if (cuda_enabled) createANNTree();
 
+  if (maxResidentMemory > 0) {
+#ifdef _OPENMP
+#pragma omp critical (swap)
+#endif
+    {
+      // a new tree gets a new place in the swap file
+      unlistResident();
+      swapState.offset = -1;
+      listResident();
+      evict(this);
+    }
+  }
+
+  return;
+}
+
+/**
+ * Builds the search tree of the type nns_method over points_red_lum
+ */
+void Scan::buildTree()
+{
   //  cout << "d2 tree" << endl;
   //  kd = new D2Tree(points_red_lum, points_red_size, 105);
   //  cout << "successfull" << endl;
+  INSTRUMENT_COUNT(INSTR_TREES_BUILT, 1);
 
   switch(nns_method)
   { 
@@ -986,10 +1301,6 @@ void Scan::createTree(int nns_method, bool cuda_enabled)
         kd = new BOctTree<double>(points_red_lum, points_red_size, 10.0, pointtype, true);
     break;
   }
-  
-  if (cuda_enabled) createANNTree();
-
-  return;
 }
 
 void Scan::createANNTree()
@@ -1005,21 +1316,413 @@ void Scan::createANNTree()
 }
 
 
+/**
+ * Fits a plane to points and returns its normal, i.e., the eigenvector
+ * of the smallest eigenvalue of their covariance. The eigenvalue is
+ * computed in closed form, the eigenvector as the longest cross product
+ * of two rows of the covariance minus the eigenvalue.
+ *
+ * @param pts the points
+ * @param n number of points
+ * @param normal the unit normal, 0 if there are too few points
+ *        or they do not span a plane
+ */
+static void fitNormal(double * const *pts, int n, double *normal)
+{
+  normal[0] = normal[1] = normal[2] = 0.0;
+  if (n < 3) return;
+
+  double c[3] = {0.0, 0.0, 0.0};
+  for (int i = 0; i < n; i++) {
+    c[0] += pts[i][0];
+    c[1] += pts[i][1];
+    c[2] += pts[i][2];
+  }
+  c[0] /= n;
+  c[1] /= n;
+  c[2] /= n;
+
+  double C[3][3] = {{0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}};
+  for (int i = 0; i < n; i++) {
+    double d[3] = {pts[i][0] - c[0], pts[i][1] - c[1], pts[i][2] - c[2]};
+    for (int j = 0; j < 3; j++) {
+      for (int k = j; k < 3; k++) C[j][k] += d[j] * d[k];
+    }
+  }
+  C[1][0] = C[0][1];
+  C[2][0] = C[0][2];
+  C[2][1] = C[1][2];
+
+  // smallest eigenvalue of the symmetric matrix
+  double q = (C[0][0] + C[1][1] + C[2][2]) / 3.0;
+  double p1 = sqr(C[0][1]) + sqr(C[0][2]) + sqr(C[1][2]);
+  double p2 = sqr(C[0][0] - q) + sqr(C[1][1] - q) + sqr(C[2][2] - q) + 2.0 * p1;
+  if (p2 <= 0.0) return;                          // all points coincide
+  double p = sqrt(p2 / 6.0);
+  double B[3][3];
+  for (int j = 0; j < 3; j++) {
+    for (int k = 0; k < 3; k++) B[j][k] = (C[j][k] - (j == k ? q : 0.0)) / p;
+  }
+  double r = 0.5 * (B[0][0] * (B[1][1] * B[2][2] - B[1][2] * B[2][1])
+                  - B[0][1] * (B[1][0] * B[2][2] - B[1][2] * B[2][0])
+                  + B[0][2] * (B[1][0] * B[2][1] - B[1][1] * B[2][0]));
+  if (r < -1.0) r = -1.0;
+  if (r > 1.0) r = 1.0;
+  double lambda = q + 2.0 * p * cos(acos(r) / 3.0 + 2.0 * M_PI / 3.0);
+
+  for (int j = 0; j < 3; j++) C[j][j] -= lambda;
+  double best = 0.0;
+  for (int j = 0; j < 3; j++) {
+    double v[3];
+    Cross(C[j], C[(j + 1) % 3], v);
+    double len2 = Len2(v);
+    if (len2 > best) {
+      best = len2;
+      normal[0] = v[0];
+      normal[1] = v[1];
+      normal[2] = v[2];
+    }
+  }
+  if (best > 0.0) {
+    Normalize3(normal);
+  }
+}
+
+/**
+ * Computes the normal of every reduced point from its k closest points
+ * in the search tree and stores it behind the point in points_red_lum,
+ * i.e., in the frame of the tree, where the point to plane matching
+ * finds it. The normals are computed once per search tree, later calls
+ * return at once.
+ *
+ * @param k number of points the normals are fitted to
+ */
+void Scan::calcNormals(int k)
+{
+  if (normals_red) return;
+  acquire(this);
+  if (kd == 0) {
+    cerr << "ERROR: the normals are computed from the search tree, create it first." << endl;
+    exit(1);
+  }
+
+#ifdef _OPENMP
+#pragma omp critical (normals)
+#endif
+  if (!normals_red) {
+#ifdef _OPENMP
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel
+#endif
+    {
+      double **closest = new double*[k];
+      double *closest_d2 = new double[k];
+      int i;
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+      for (i = 0; i < points_red_size; i++) {
+        int n = kd->FindKClosest(points_red_lum[i], k, DBL_MAX, closest, closest_d2);
+        fitNormal(closest, n, points_red_lum[i] + 3);
+      }
+      delete [] closest;
+      delete [] closest_d2;
+    }
+    swapState.treeStored = false;
+    normals_red = true;
+  }
+  release(this);
+}
+
 /**
  * Delete the search tree
  */
 void Scan::deleteTree()
 {
+  if (maxResidentMemory > 0) {
+#ifdef _OPENMP
+#pragma omp critical (swap)
+#endif
+    {
+      // the reduced points are still needed
+      if (swapState.swapped) swapIn();
+      unlistResident();
+    }
+  }
+
   for (int j = 0; j < points_red_size; j++) {
     delete [] points_red_lum[j];
   }
   delete [] points_red_lum;
+  points_red_lum = 0;
   
   delete kd;
+  kd = 0;
   
   return;
 }
 
+/**
+ * Opens the swap file, see Scan::swapFileName
+ */
+static void openSwapFile()
+{
+  if (swapFile) return;
+  if (Scan::swapFileName == "") {
+    swapFile = tmpfile();
+  } else {
+    swapFile = fopen(Scan::swapFileName.c_str(), "w+b");
+  }
+  if (!swapFile) {
+    cerr << "ERROR: Cannot open the swap file " << Scan::swapFileName << endl;
+    exit(1);
+  }
+}
+
+/**
+ * Moves to a position in the swap file
+ */
+static void seekSwapFile(long long offset)
+{
+#ifdef _MSC_VER
+  int ret = _fseeki64(swapFile, offset, SEEK_SET);
+#else
+  int ret = fseeko(swapFile, (off_t)offset, SEEK_SET);
+#endif
+  if (ret != 0) {
+    cerr << "ERROR: Cannot seek in the swap file." << endl;
+    exit(1);
+  }
+}
+
+/**
+ * Position in the swap file
+ */
+static long long tellSwapFile()
+{
+#ifdef _MSC_VER
+  return _ftelli64(swapFile);
+#else
+  return ftello(swapFile);
+#endif
+}
+
+/**
+ * Makes sure the reduced points and the search tree of a scan are in
+ * memory and keeps them there until release is called, see
+ * maxResidentMemory. The calls may be nested and come from several
+ * threads. Scans without a search tree are always in memory.
+ *
+ * @param scan the scan
+ */
+void Scan::acquire(const Scan *scan)
+{
+  if (maxResidentMemory == 0) return;
+  Scan *s = const_cast<Scan *>(scan);
+
+#ifdef _OPENMP
+#pragma omp critical (swap)
+#endif
+  {
+    s->swapState.pins++;
+    if (s->swapState.swapped) {
+      s->swapIn();
+    } else if (s->swapState.listed) {
+      residentScans.splice(residentScans.begin(), residentScans, s->swapState.entry);
+    }
+    evict(s);
+  }
+}
+
+/**
+ * Allows the scan to be swapped out again, see acquire
+ *
+ * @param scan the scan
+ */
+void Scan::release(const Scan *scan)
+{
+  if (maxResidentMemory == 0) return;
+  Scan *s = const_cast<Scan *>(scan);
+
+#ifdef _OPENMP
+#pragma omp critical (swap)
+#endif
+  s->swapState.pins--;
+}
+
+/**
+ * Announces that the scan and its reduction levels will be used soon,
+ * e.g., as the next scan in sequential ICP. If they are in memory they
+ * become the most recently used scans, otherwise the operating system is
+ * asked to read their part of the swap file ahead.
+ *
+ * @param scan the scan
+ */
+void Scan::prefetch(const Scan *scan)
+{
+  if (maxResidentMemory == 0) return;
+
+#ifdef _OPENMP
+#pragma omp critical (swap)
+#endif
+  for (int l = (int)scan->pyramid.size(); l >= 0; l--) {
+    Scan *s = (l == 0 ? const_cast<Scan *>(scan) : scan->pyramid[l - 1]);
+    if (s->swapState.swapped) {
+#if !defined(_MSC_VER) && defined(POSIX_FADV_WILLNEED)
+      posix_fadvise(fileno(swapFile), (off_t)s->swapState.offset,
+                    (off_t)s->swapState.length, POSIX_FADV_WILLNEED);
+#endif
+    } else if (s->swapState.listed) {
+      residentScans.splice(residentScans.begin(), residentScans, s->swapState.entry);
+    }
+  }
+}
+
+/**
+ * Adds the scan to the resident scans as the most recently used one.
+ * Scans with a tree for CUDA stay in memory. Called within the critical
+ * section swap.
+ */
+void Scan::listResident()
+{
+  if (swapState.listed || cuda_enabled) return;
+
+  // the reduced points, their copies with normals and roughly the tree
+  swapState.bytes = (size_t)points_red_size * (9 * sizeof(double) + 4 * sizeof(double *));
+  swapState.entry = residentScans.insert(residentScans.begin(), this);
+  swapState.listed = true;
+  residentMemory += swapState.bytes;
+}
+
+/**
+ * Removes the scan from the resident scans. Called within the critical
+ * section swap.
+ */
+void Scan::unlistResident()
+{
+  if (!swapState.listed) return;
+
+  residentScans.erase(swapState.entry);
+  swapState.listed = false;
+  residentMemory -= swapState.bytes;
+}
+
+/**
+ * Swaps out the least recently used scans that are not acquired until
+ * the resident scans fit into maxResidentMemory or no such scan is left.
+ * Called within the critical section swap.
+ *
+ * @param keep a scan that stays in memory in any case
+ */
+void Scan::evict(const Scan *keep)
+{
+  list<Scan *>::iterator it = residentScans.end();
+  while (residentMemory > maxResidentMemory && it != residentScans.begin()) {
+    Scan *s = *(--it);
+    if (s == keep || s->swapState.pins > 0) continue;
+    ++it;
+    s->swapOut();  // removes s from the list, it stays valid
+  }
+}
+
+/**
+ * Writes the reduced points and the search tree to the swap file and
+ * releases them. The points are written every time, since the scan may
+ * have been transformed, the search tree only if it changed since. A
+ * k-d tree (simpleKD) is stored as it is, for the other search trees the
+ * points with normals are stored and the tree is built again on reading.
+ * Called within the critical section swap.
+ */
+void Scan::swapOut()
+{
+  openSwapFile();
+  if (swapState.offset < 0) {
+    swapState.offset = swapFileEnd;
+    swapState.treeStored = false;
+  }
+
+  seekSwapFile(swapState.offset);
+  for (int i = 0; i < points_red_size; i++) {
+    fwrite(points_red[i], sizeof(double), 3, swapFile);
+  }
+  if (!swapState.treeStored) {
+    if (nns_method == simpleKD) {
+      ((KDtree *)kd)->save(swapFile, 6);
+    } else {
+      for (int i = 0; i < points_red_size; i++) {
+        fwrite(points_red_lum[i], sizeof(double), 6, swapFile);
+      }
+    }
+    swapState.length = tellSwapFile() - swapState.offset;
+    swapState.treeStored = true;
+    swapFileEnd = max(swapFileEnd, swapState.offset + swapState.length);
+  }
+  if (ferror(swapFile)) {
+    cerr << "ERROR: Cannot write the swap file." << endl;
+    exit(1);
+  }
+
+  unlistResident();
+  for (int i = 0; i < points_red_size; i++) {
+    delete [] points_red[i];
+    delete [] points_red_lum[i];
+  }
+  delete [] points_red;
+  delete [] points_red_lum;
+  delete kd;
+  points_red = points_red_lum = 0;
+  kd = 0;
+
+  M4identity(swapState.xf);
+  swapState.swapped = true;
+}
+
+/**
+ * Reads the reduced points and the search tree back from the swap file,
+ * see swapOut, and applies the transformations since. Called within the
+ * critical section swap.
+ */
+void Scan::swapIn()
+{
+  seekSwapFile(swapState.offset);
+  bool good = true;
+  points_red = new double*[points_red_size];
+  for (int i = 0; i < points_red_size; i++) {
+    points_red[i] = new double[3];
+    good = good && fread(points_red[i], sizeof(double), 3, swapFile) == 3;
+  }
+  points_red_lum = new double*[points_red_size];
+  if (nns_method == simpleKD) {
+    int next = 0;
+    kd = new KDtree(swapFile, points_red_lum, points_red_size, 6, next);
+    good = good && next == points_red_size;
+  } else {
+    for (int i = 0; i < points_red_size; i++) {
+      points_red_lum[i] = new double[6];
+      good = good && fread(points_red_lum[i], sizeof(double), 6, swapFile) == 6;
+    }
+    buildTree();
+  }
+  if (!good) {
+    cerr << "ERROR: Cannot read the swap file." << endl;
+    exit(1);
+  }
+
+  const double *xf = swapState.xf;
+  for (int i = 0; i < points_red_size; i++) {
+    double *p = points_red[i];
+    double x_neu = p[0] * xf[0] + p[1] * xf[4] + p[2] * xf[8];
+    double y_neu = p[0] * xf[1] + p[1] * xf[5] + p[2] * xf[9];
+    double z_neu = p[0] * xf[2] + p[1] * xf[6] + p[2] * xf[10];
+    p[0] = x_neu + xf[12];
+    p[1] = y_neu + xf[13];
+    p[2] = z_neu + xf[14];
+  }
+
+  swapState.swapped = false;
+  listResident();
+}
+
 
 bool Scan::toType(const char* string, reader_type &type) {
   if (strcasecmp(string, "uos") == 0) type = UOS;
@@ -1106,11 +1809,264 @@ void Scan::toGlobal(double voxelSize, int nrpts) {
   this->transform(this->transMatOrg, INVALID);
 }
 
+/**
+ * Reduces the points of the scan, puts them into the initial pose and
+ * builds the search tree(s). Afterwards the original points are released.
+ *
+ * @param voxelSize The maximal size of each voxel for the reduction
+ * @param nrpts number of points per voxel, see calcReducedPoints
+ * @param nns_method the search tree to build
+ * @param cuda_enabled build ANN trees for CUDA
+ * @param pyramid_levels number of reduction levels, see calcPyramid
+ * @param cacheFile if not empty, the reduced points are stored in this file
+ */
+void Scan::prepareSearch(double voxelSize, int nrpts, int nns_method, bool cuda_enabled,
+                         int pyramid_levels, const string &cacheFile)
+{
+  calcReducedPoints(voxelSize, nrpts);
+  if (pyramid_levels > 1) {
+    calcPyramid(pyramid_levels, voxelSize, nrpts);
+  }
+  clearPoints();
+  if (cacheFile != "") {
+    writeCache(cacheFile);
+  }
+  finishSearch(nns_method, cuda_enabled);
+}
+
+/**
+ * Puts the reduced points of the scan and of its reduction levels into
+ * the initial pose and builds their search trees.
+ *
+ * @param nns_method the search tree to build
+ * @param cuda_enabled build ANN trees for CUDA
+ */
+void Scan::finishSearch(int nns_method, bool cuda_enabled)
+{
+  transform(transMatOrg, INVALID); //transform points to initial position
+  for (unsigned int i = 0; i < pyramid.size(); i++) {
+    pyramid[i]->createTree(nns_method, cuda_enabled);
+  }
+  createTree(nns_method, cuda_enabled);
+}
+
+/**
+ * Magic bytes of the files in the cache of reduced scans
+ */
+static const char cacheMagic[4] = {'R', 'S', 'C', '1'};
+
+/**
+ * 64 bit FNV-1a hash, used as key of the cache of reduced scans
+ */
+static void cacheHash(unsigned long long &hash, const void *data, size_t n)
+{
+  const unsigned char *bytes = (const unsigned char *)data;
+  for (size_t i = 0; i < n; i++) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+}
+
+/**
+ * Lists the input files of a scan. The scan IO libraries do not tell
+ * which files they read, so all regular files in the directory are taken
+ * whose first number in the name is the number of the scan, e.g.,
+ * scan007.3d and scan007.pose, but not the files written by the programs.
+ * The .frames files are input for the readers that take the pose from
+ * them.
+ *
+ * @param dir directory of the scans
+ * @param fileNr number of the scan
+ * @param type the reader of the scan
+ * @param files receives the sorted names of the files
+ */
+static void scanFiles(const string &dir, int fileNr, reader_type type, vector<string> &files)
+{
+  vector<string> names;
+#ifdef _MSC_VER
+  WIN32_FIND_DATA data;
+  HANDLE find = FindFirstFile((dir + "*").c_str(), &data);
+  if (find == INVALID_HANDLE_VALUE) return;
+  do {
+    if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) names.push_back(data.cFileName);
+  } while (FindNextFile(find, &data));
+  FindClose(find);
+#else
+  DIR *d = opendir(dir.c_str());
+  if (d == 0) return;
+  struct dirent *entry;
+  while ((entry = readdir(d)) != 0) {
+    struct stat st;
+    if (stat((dir + entry->d_name).c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+      names.push_back(entry->d_name);
+    }
+  }
+  closedir(d);
+#endif
+
+  const char *written[] = {".red", ".pmc", ".frames"};
+  unsigned int nrWritten = sizeof(written) / sizeof(written[0]);
+  // these readers take the pose from the .frames file, the last one
+  if (type == UOS_FRAMES || type == UOS_MAP_FRAMES) nrWritten--;
+  for (unsigned int i = 0; i < names.size(); i++) {
+    size_t digit = names[i].find_first_of("0123456789");
+    if (digit == string::npos || atoi(names[i].c_str() + digit) != fileNr) continue;
+    bool input = true;
+    for (unsigned int j = 0; j < nrWritten; j++) {
+      size_t len = strlen(written[j]);
+      if (names[i].size() >= len &&
+          names[i].compare(names[i].size() - len, len, written[j]) == 0) input = false;
+    }
+    if (input) files.push_back(names[i]);
+  }
+  sort(files.begin(), files.end());
+}
+
+/**
+ * Determines the file of a scan in the cache of reduced scans. Its name
+ * is the hash of the names and the contents of the input files of the
+ * scan and of the parameters for reading and reducing it.
+ *
+ * @return the name of the file, empty if no input files are found
+ */
+static string cacheFileName(reader_type type, int fileNr, int maxDist, int minDist,
+                            double voxelSize, int nrpts, int pyramid_levels)
+{
+  vector<string> files;
+  scanFiles(Scan::dir, fileNr, type, files);
+  if (files.empty()) return "";
+
+  unsigned long long hash = 14695981039346656037ULL;
+  char buffer[65536];
+  for (unsigned int i = 0; i < files.size(); i++) {
+    cacheHash(hash, files[i].c_str(), files[i].size() + 1);
+    ifstream in((Scan::dir + files[i]).c_str(), std::ios::binary);
+    while (in.good()) {
+      in.read(buffer, sizeof(buffer));
+      cacheHash(hash, buffer, in.gcount());
+    }
+  }
+  int type_ = type;
+  cacheHash(hash, &type_, sizeof(type_));
+  cacheHash(hash, &maxDist, sizeof(maxDist));
+  cacheHash(hash, &minDist, sizeof(minDist));
+  cacheHash(hash, &voxelSize, sizeof(voxelSize));
+  cacheHash(hash, &nrpts, sizeof(nrpts));
+  cacheHash(hash, &pyramid_levels, sizeof(pyramid_levels));
+
+  char name[17];
+  snprintf(name, sizeof(name), "%016llx", hash);
+  return Scan::cacheDir + name + ".red";
+}
+
+/**
+ * Reads a scan from the cache of reduced scans, with its pose and the
+ * reduced points of the scan and its reduction levels in the coordinates
+ * of the scan.
+ *
+ * @param filename the file in the cache, see cacheFileName
+ * @param maxDist the maximal distance of the points
+ * @return the scan, or 0 if the file is missing or unreadable
+ */
+Scan* Scan::readCache(const string &filename, int maxDist)
+{
+  if (filename == "") return 0;
+  ifstream in(filename.c_str(), std::ios::binary);
+  if (!in.good()) return 0;
+
+  char magic[4];
+  double euler[6];
+  int levels;
+  in.read(magic, sizeof(magic));
+  in.read((char *)euler, sizeof(euler));
+  in.read((char *)&levels, sizeof(levels));
+  if (!in.good() || memcmp(magic, cacheMagic, sizeof(magic)) != 0 || levels < 1) {
+    cerr << "WARNING: Ignoring invalid cache file " << filename << endl;
+    return 0;
+  }
+
+  Scan *scan = new Scan(euler, maxDist);
+  for (int l = 0; l < levels; l++) {
+    Scan *level = scan;
+    if (l > 0) {
+      level = new Scan();
+      level->fileNr = -1; // no need to store frames for a level
+#ifdef _OPENMP
+#pragma omp critical (numberOfScans)
+#endif
+      level->scanNr = numberOfScans++;
+      level->maxDist2 = scan->maxDist2;
+      memcpy(level->transMatOrg, scan->transMatOrg, sizeof(transMatOrg));
+      scan->pyramid.push_back(level);
+    }
+    in.read((char *)&level->points_red_size, sizeof(level->points_red_size));
+    if (!in.good() || level->points_red_size < 0) level->points_red_size = 0;
+    level->points_red = new double*[level->points_red_size];
+    for (int i = 0; i < level->points_red_size; i++) {
+      level->points_red[i] = new double[3];
+      in.read((char *)level->points_red[i], 3 * sizeof(double));
+    }
+  }
+  if (!in.good()) {
+    cerr << "WARNING: Ignoring truncated cache file " << filename << endl;
+    delete scan;
+    return 0;
+  }
+
+  if (scan->points_red_size > (int)max_points_red_size) max_points_red_size = scan->points_red_size;
+  return scan;
+}
+
+/**
+ * Writes the pose and the reduced points of the scan and its reduction
+ * levels to the cache of reduced scans. Has to be called before the
+ * points are transformed, see prepareSearch. The file is written under
+ * a temporary name first, so other runs never read half of it.
+ *
+ * @param filename the file in the cache, see cacheFileName
+ */
+void Scan::writeCache(const string &filename) const
+{
+  string tmpname = filename + ".tmp" + to_string(scanNr);
+  ofstream out(tmpname.c_str(), std::ios::binary);
+  double euler[6] = {rPos[0], rPos[1], rPos[2], rPosTheta[0], rPosTheta[1], rPosTheta[2]};
+  int levels = (int)pyramid.size() + 1;
+  out.write(cacheMagic, sizeof(cacheMagic));
+  out.write((const char *)euler, sizeof(euler));
+  out.write((const char *)&levels, sizeof(levels));
+  for (int l = 0; l < levels; l++) {
+    const Scan *level = (l == 0 ? this : pyramid[l - 1]);
+    out.write((const char *)&level->points_red_size, sizeof(level->points_red_size));
+    for (int i = 0; i < level->points_red_size; i++) {
+      out.write((const char *)level->points_red[i], 3 * sizeof(double));
+    }
+  }
+  out.close();
+
+  if (!out.good() || rename(tmpname.c_str(), filename.c_str()) != 0) {
+    cerr << "WARNING: Cannot write cache file " << filename << endl;
+    remove(tmpname.c_str());
+  }
+}
+
+/**
+ * Reads the scans, reduces them and builds their search trees. While one
+ * scan is read, the previous ones are processed in parallel.
+ *
+ * If cacheDir is set, the reduced points of every scan are stored there,
+ * under the hash of its input files and of the reading and reduction
+ * parameters (cacheFileName). As long as the following runs find the
+ * scans in the cache, they are neither read nor reduced again, only their
+ * search trees are built. From the first scan not found on, the scans are
+ * read from the input files again, since the scan IO libraries count the
+ * scans themselves.
+ */
 void Scan::readScansRedSearch(reader_type type,
              int start, int end, const string &_dir, int maxDist, int minDist,
 						double voxelSize, int nrpts, // reduction parameters
 						int nns_method, bool cuda_enabled, 
-						bool openFileForWriting)
+						bool openFileForWriting,
+						int pyramid_levels)
 {
   outputFrames = openFileForWriting;
   dir = _dir;
@@ -1119,6 +2075,18 @@ void Scan::readScansRedSearch(reader_type type,
   int _fileNr;
   scanIOwrapper my_ScanIO(type);
 
+  if (cacheDir != "") {
+#ifndef _MSC_VER
+    if (cacheDir[cacheDir.length()-1] != '/') cacheDir = cacheDir + "/";
+    mkdir(cacheDir.c_str(), 0755);
+#else
+    if (cacheDir[cacheDir.length()-1] != '\\') cacheDir = cacheDir + "\\";
+    _mkdir(cacheDir.c_str());
+#endif
+  }
+  bool fromCache = (cacheDir != "");
+  int cacheNr = start;
+
 #ifndef _MSC_VER 
 #ifdef _OPENMP
 #pragma omp parallel
@@ -1128,12 +2096,38 @@ void Scan::readScansRedSearch(reader_type type,
 #endif
 #endif
       // read Scan-by-scan until no scan is available anymore
-      while ((_fileNr = my_ScanIO.readScans(start, end, dir, maxDist, minDist, eu, ptss)) != -1) {
-        Scan *currentScan = new Scan(eu, maxDist);
-        currentScan->fileNr = _fileNr;
+      while (true) {
+        Scan *currentScan = 0;
+        string cacheFile;
+        bool cached = false;
+
+        if (fromCache) {
+          if (end > -1 && cacheNr > end) break;
+          cacheFile = cacheFileName(type, cacheNr, maxDist, minDist,
+                                    voxelSize, nrpts, pyramid_levels);
+          currentScan = readCache(cacheFile, maxDist);
+          if (currentScan) {
+            cout << "Reading scan " << cacheNr << " from cache " << cacheFile << endl;
+            currentScan->fileNr = cacheNr++;
+            cached = true;
+          } else {
+            fromCache = false;
+            start = cacheNr;
+          }
+        }
 
-        currentScan->points = ptss;    // copy points
-        ptss.clear();                  // clear points
+        if (!cached) {
+          if ((_fileNr = my_ScanIO.readScans(start, end, dir, maxDist, minDist, eu, ptss)) == -1) break;
+          currentScan = new Scan(eu, maxDist);
+          currentScan->fileNr = _fileNr;
+
+          currentScan->points = ptss;    // copy points
+          ptss.clear();                  // clear points
+          if (cacheDir != "") {
+            cacheFile = cacheFileName(type, _fileNr, maxDist, minDist,
+                                      voxelSize, nrpts, pyramid_levels);
+          }
+        }
         allScans.push_back(currentScan);
 
 #ifndef _MSC_VER 
@@ -1142,11 +2136,14 @@ void Scan::readScansRedSearch(reader_type type,
 #endif
 #endif
         {
-          cout << "reducing scan " << currentScan->fileNr << " and creating searchTree" << endl;
-          currentScan->calcReducedPoints(voxelSize, nrpts);
-          currentScan->transform(currentScan->transMatOrg, INVALID); //transform points to initial position
-          currentScan->clearPoints();
-          currentScan->createTree(nns_method, cuda_enabled);
+          if (cached) {
+            cout << "creating searchTree of scan " << currentScan->fileNr << endl;
+            currentScan->finishSearch(nns_method, cuda_enabled);
+          } else {
+            cout << "reducing scan " << currentScan->fileNr << " and creating searchTree" << endl;
+            currentScan->prepareSearch(voxelSize, nrpts, nns_method, cuda_enabled, pyramid_levels,
+                                       cacheFile);
+          }
         }
       }
 #ifndef _MSC_VER 
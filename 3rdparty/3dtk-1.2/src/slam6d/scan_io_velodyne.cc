@@ -21,6 +21,14 @@ using std::swap;
 #include<cmath>
 #include<cstring>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 
@@ -277,32 +285,23 @@ int laser_phi_compare(const void *_a, const void *_b)
     return 1;
 }
 
-/** valid only for v > 0 **/
-static inline double mod2pi_positive(double vin)
-{
-    double q = vin * TWOPI_INV + 0.5;
-    int qi = (int) q;
-
-    return vin - qi*TWOPI;
-}
-
-/** Map v to [-PI, PI] **/
-static inline double mod2pi(double vin)
-{
-    if (vin < 0)
-        return -mod2pi_positive(-vin);
-    else
-        return mod2pi_positive(vin);
-}
-
-/** Return vin such that it is within PI degrees of ref **/
-static inline double mod2pi_ref(double ref, double vin)
-{
-    return ref + mod2pi(vin - ref);
-}
-
-
+/** number of rotation steps of 0.01 degree in a turn */
+#define ROTATION_STEPS 36000
+/** bytes of a packet in the log, with the header in front */
+#define PACKET_STRIDE (BLOCK_OFFSET + BLOCK_SIZE)
+/** returns per revolution */
+#define RETURNS_PER_CIRCLE (CIRCLELENGTH*12*32)
 
+/**
+ * sine and cosine of the rotation ctheta = 2 pi - rot of every rotation
+ * step, and of the vertical and rotational correction of every laser
+ */
+double sinRotation[ROTATION_STEPS];
+double cosRotation[ROTATION_STEPS];
+double sinVertCorrection[VELODYNE_NUM_LASERS];
+double cosVertCorrection[VELODYNE_NUM_LASERS];
+double sinRotCorrection[VELODYNE_NUM_LASERS];
+double cosRotCorrection[VELODYNE_NUM_LASERS];
 
 int velodyne_calib_precompute()
 {
@@ -331,172 +330,235 @@ int velodyne_calib_precompute()
         vertoffsetCorrection[i] = velodyne_calibrated[i][3] * METERS_PER_CM;
         
         horizdffsetCorrection[i] = velodyne_calibrated[i][4] * METERS_PER_CM;  
+
+        sinVertCorrection[i] = sin ( vertCorrection[i] );
+        cosVertCorrection[i] = cos ( vertCorrection[i] );
+        sinRotCorrection[i] = sin ( rotCorrection[i] );
+        cosRotCorrection[i] = cos ( rotCorrection[i] );
+    }
+
+    for ( i = 0; i < ROTATION_STEPS; i++ )
+    {
+        double ctheta = 2 * M_PI - ( i / 100.0 ) * RADIANS_PER_LSB;
+        sinRotation[i] = sin ( ctheta );
+        cosRotation[i] = cos ( ctheta );
     }
 
     return 0;
 }
 
 
+/**
+ * The log file, mapped into memory once and read revolution by
+ * revolution
+ */
+struct velodyne_log
+{
+    string fileName;
+    int fd;
+    const BYTE *data;
+    size_t size;
+    /** bytes before this offset were released already */
+    size_t released;
+};
 
+velodyne_log velodyneLog = { "", -1, 0, 0, 0 };
 
-
-int read_one_packet ( FILE *fp, vector<Point> &ptss, int maxDist, int minDist )
+/**
+ * Maps the log file into memory, unless it is mapped already
+ *
+ * @return false if the file cannot be mapped
+ */
+bool velodyne_open_log ( const string &fileName )
 {
-  int maxDist2 = sqr(maxDist);
-  int minDist2 = sqr(minDist);
-  
-    int  c, i, j;
-    unsigned char Head = 0;
-    BYTE buf[BLOCK_SIZE];
-    Point point;
-    BYTE *p;
-    unsigned short *ps;
-    unsigned short *pshort;
-    short *pt;
+    if ( velodyneLog.data && velodyneLog.fileName == fileName )
+        return true;
 
+    if ( velodyneLog.data )
+    {
+        munmap ( ( void* ) velodyneLog.data, velodyneLog.size );
+        close ( velodyneLog.fd );
+        velodyneLog.data = 0;
+    }
 
-    double ctheta;
-    double theta, phi;
+    int fd = open ( fileName.c_str(), O_RDONLY );
+    if ( fd < 0 )
+        return false;
 
-    double sin_ctheta, cos_ctheta;
-    double sin_theta, cos_theta;
-    double sin_phi, cos_phi;
+    struct stat st;
+    if ( fstat ( fd, &st ) != 0 || st.st_size == 0 )
+    {
+        close ( fd );
+        return false;
+    }
 
-    unsigned short physicalNO;
-    //unsigned short logicalNO;
+    void *data = mmap ( 0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    if ( data == MAP_FAILED )
+    {
+        close ( fd );
+        return false;
+    }
+    madvise ( data, st.st_size, MADV_SEQUENTIAL );
 
-    double rotational;
-    double distance;
-    double corredistance;
-    int intensity;
-    //    int physical;
-	int size;
+    // the calibration tables are computed once for the whole log
+    velodyne_calib_precompute();
 
+    velodyneLog.fileName = fileName;
+    velodyneLog.fd = fd;
+    velodyneLog.data = ( const BYTE* ) data;
+    velodyneLog.size = st.st_size;
+    velodyneLog.released = 0;
+    return true;
+}
 
-    
-//    unsigned short rot;
-  
+/**
+ * Tells the kernel that the log is not needed before an offset anymore,
+ * so long logs do not fill the page cache of the process
+ */
+void velodyne_release_log ( size_t offset )
+{
+    size_t page = sysconf ( _SC_PAGESIZE );
+    offset -= offset % page;
+    if ( offset > velodyneLog.released )
+    {
+        madvise ( ( void* ) ( velodyneLog.data + velodyneLog.released ),
+                  offset - velodyneLog.released, MADV_DONTNEED );
+        velodyneLog.released = offset;
+    }
+}
 
-    double x, y, z;
 
-    /*
-    int circle_col = 0;
-    int circle_row = 0;
-    int circle_col_other = 0; 
-    int circle_row_other = 0;
-   */
+/**
+ * The returns of one revolution as structure of arrays, in the order
+ * of the packets, blocks and lasers
+ */
+vector<double> returnX, returnY, returnZ;
+vector<float> returnReflectance;
+vector<char> returnValid;
 
+/**
+ * Decodes one packet into the arrays of the returns
+ *
+ * @param buf the 1200 bytes of data of the packet
+ * @param heads the first laser of each of the 12 blocks
+ * @param first index of the first return of the packet in the arrays
+ */
+void decode_packet ( const BYTE *buf, const int *heads, int first,
+                     int maxDist, int minDist )
+{
+    int maxDist2 = sqr(maxDist);
+    int minDist2 = sqr(minDist);
 
-    for ( c = 0 ; c < CIRCLELENGTH; c++ )
+    const BYTE *p = buf;
+    for ( int i = 0; i < 12; i++ )
     {
+        unsigned short rot;
+        memcpy ( &rot, p + 2, sizeof ( rot ) );
+        int step = rot % ROTATION_STEPS;
+        double sin_ctheta = sinRotation[step];
+        double cos_ctheta = cosRotation[step];
 
-		fseeko(fp , BLOCK_OFFSET, SEEK_CUR);
-        size=fread ( buf, 1, BLOCK_SIZE, fp );
-		
-		if(size<BLOCK_SIZE)
-			return -1;
-		
-		
-        ps = ( unsigned short * ) buf;
-        p = buf;
-        physicalNO = 0;
-
+        for ( int j = 0; j < 32; j++ )
+        {
+            int physicalNO = j + heads[i];
+            int index = first + i * 32 + j;
+
+            short raw;
+            memcpy ( &raw, p + 4 + j * 3, sizeof ( raw ) );
+            double distance = fabs ( raw * 0.002 );
+            int intensity = p[4 + j * 3 + 2];
+
+            //vertCorrection  rotCorrection  distCorrection  vertOffsetCorrection  horizOffsetCorrection
+            double corredistance = ( distance + distCorrection[physicalNO] ) * ( 1.0 + vertoffsetCorrection[physicalNO] );
+
+            // theta = ctheta + rotCorrection, phi = vertCorrection
+            double sin_theta = sin_ctheta * cosRotCorrection[physicalNO] + cos_ctheta * sinRotCorrection[physicalNO];
+            double cos_theta = cos_ctheta * cosRotCorrection[physicalNO] - sin_ctheta * sinRotCorrection[physicalNO];
+            double sin_phi = sinVertCorrection[physicalNO];
+            double cos_phi = cosVertCorrection[physicalNO];
+
+            double x = corredistance * cos_theta * cos_phi;
+            double y = corredistance * sin_theta * cos_phi;
+            double z = corredistance * sin_phi;
+
+            x -= horizdffsetCorrection[physicalNO] * cos_ctheta;
+            y -= horizdffsetCorrection[physicalNO] * sin_ctheta;
+
+            double px = -100 * y;
+            double py = 100 * z;
+            double pz = 100 * x;
+            double d2 = sqr(px) + sqr(py) + sqr(pz);
+
+            returnX[index] = px;
+            returnY[index] = py;
+            returnZ[index] = pz;
+            returnReflectance[index] = intensity / 256.0;
+            returnValid[index] = (maxDist == -1 || d2 < maxDist2*1.0)
+              && (minDist == -1 || d2 > minDist2*1.0) && (py > -180);
+        }
+        p = p + 100;
+    }
+}
 
-        for ( i = 0; i < 12; i++ )
+/**
+ * Decodes the packets of one revolution in parallel
+ *
+ * @param rev the first packet of the revolution, with its header
+ * @param packets number of complete packets of the revolution
+ * @param ptss receives the points in the order of the returns
+ * @return number of decoded returns
+ */
+int read_revolution ( const BYTE *rev, int packets, vector<Point> &ptss,
+                      int maxDist, int minDist )
+{
+    int n = packets * 12 * 32;
+    returnX.resize ( RETURNS_PER_CIRCLE );
+    returnY.resize ( RETURNS_PER_CIRCLE );
+    returnZ.resize ( RETURNS_PER_CIRCLE );
+    returnReflectance.resize ( RETURNS_PER_CIRCLE );
+    returnValid.resize ( RETURNS_PER_CIRCLE );
+
+    // each block starts with 0xEEFF for the lower and 0xDDFF for the
+    // upper lasers, otherwise the lasers of the block before are kept
+    int heads[CIRCLELENGTH * 12];
+    int Head = 0;
+    for ( int c = 0; c < packets; c++ )
+    {
+        const BYTE *p = rev + c * PACKET_STRIDE + BLOCK_OFFSET;
+        for ( int i = 0; i < 12; i++ )
         {
-            //Each frame start with 0xEEFF || 0xDDFF
-            if ( *ps == 0xEEFF )
+            unsigned short id;
+            memcpy ( &id, p + i * 100, sizeof ( id ) );
+            if ( id == 0xEEFF )
                 Head = 0;
-            else if ( *ps == 0xDDFF )
+            else if ( id == 0xDDFF )
                 Head = 32;
-
-
-            pshort = ( unsigned short * ) ( p + 2 );
-            //rot = ( ( unsigned short ) ( *pshort ) / 100.0 );
-
-
-            //circle_col =  c * 6 + i / 2;
-            rotational = ( ( double ) ( *pshort ) ) / 100.0;
-
-    
-
-
-            for ( j = 0; j < 32; j++ )
-            {
-               
-                physicalNO  = j + Head;
-                //logicalNO = velodyne_physical_to_logical ( physicalNO );
-
-                //circle_col =  c * 6 + i / 2;
-                //circle_row =  logicalNO;
-
-
-                //circle_col_other =  c * 6 + i / 2;  /////????
-                //circle_row_other =  logicalNO / 2;
-
-             
-                
-                pt = ( short * ) ( p + 4 + j * 3 );
-                
-                distance = absf ( ( *pt ) * 0.002 );
-
-                BYTE *inty = ( BYTE * ) ( p + 4 + j * 3 + 2 );
-                intensity = *inty;
-
-                ctheta = 2 * M_PI - rotational * RADIANS_PER_LSB;
-                if ( ctheta == 2*M_PI )
-                    ctheta = 0;
-
-                
-                sin_ctheta = sin ( ctheta );
-                cos_ctheta = cos ( ctheta );
-
-                //vertCorrection  rotCorrection  distCorrection  vertOffsetCorrection  horizOffsetCorrection
-                corredistance = ( distance + distCorrection[physicalNO] ) * ( 1.0 + vertoffsetCorrection[physicalNO] );
-                theta     = mod2pi_ref ( M_PI, ctheta + rotCorrection[physicalNO] ); /////////????////////
-                phi    = vertCorrection[physicalNO];  ////////?????/////////////////
-
-
-                sin_theta = sin ( theta );
-                cos_theta = cos ( theta );
-                sin_phi = sin ( phi );
-                cos_phi = cos ( phi );
-
-                /////////////////////?a???/////////////////////
-                x = corredistance * cos_theta * cos_phi;
-                y = corredistance * sin_theta * cos_phi;
-                z = corredistance * sin_phi;
-
-                x -= horizdffsetCorrection[physicalNO] * cos_ctheta;
-                y -= horizdffsetCorrection[physicalNO] * sin_ctheta;
-
-         
-				point.x=y;
-				point.y=z;
-				point.z=x;
-				point.x *= -100;
-                point.y *= 100;
-                point.z *= 100;
-				
-				point.reflectance=intensity/256.0;
-
-				if ((maxDist == -1 || sqr(point.x) + sqr(point.y) + sqr(point.z) < maxDist2*1.0)
-				  && (minDist == -1 || sqr(point.x) + sqr(point.y) + sqr(point.z) > minDist2*1.0)&&(point.y>-180))
-				  {
-				    ptss.push_back(point);
-				    //printf("%f %f %f %f %f %f\n",point.x,point.y,point.z,point.reflectance,minDist2*1.0,minDist2*1.0);
-				  }
-            }
-            p = p + 100;
-            ps = ( unsigned short * ) p;
+            heads[c * 12 + i] = Head;
         }
+    }
 
-
+#ifdef _OPENMP
+    omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(static)
+#endif
+    for ( int c = 0; c < packets; c++ )
+    {
+        decode_packet ( rev + c * PACKET_STRIDE + BLOCK_OFFSET, heads + c * 12,
+                        c * 12 * 32, maxDist, minDist );
     }
 
-    
+    Point point;
+    for ( int k = 0; k < n; k++ )
+    {
+        if ( !returnValid[k] ) continue;
+        point.x = returnX[k];
+        point.y = returnY[k];
+        point.z = returnZ[k];
+        point.reflectance = returnReflectance[k];
+        ptss.push_back(point);
+    }
 
-    return 0;
+    return n;
 }
 
 
@@ -520,6 +582,11 @@ int read_one_packet ( FILE *fp, vector<Point> &ptss, int maxDist, int minDist )
  *    Export SOP
  *    Write out as .dat file 
  * 
+ * The log scan.bin is mapped into memory on the first call, every call
+ * decodes the next revolution of CIRCLELENGTH packets. Pages of the
+ * log before the revolution are given back, so logs of any length can
+ * be streamed. The decoded returns per second are printed.
+ *
  * @param start Starts to read with this scan
  * @param end Stops with this scan
  * @param dir The directory from which to read
@@ -527,16 +594,18 @@ int read_one_packet ( FILE *fp, vector<Point> &ptss, int maxDist, int minDist )
  * @param minDist Reads only Points from this Distance
  * @param euler Initital pose estimates (will not be applied to the points
  * @param ptss Vector containing the read points
+ * @return the number of the scan, -1 at the end of the log
  */
 int ScanIO_velodyne::readScans(int start, int end, string &dir, int maxDist, int minDist,
 						  double *euler, vector<Point> &ptss)
 {
   static int fileCounter = start;
+  static double decodedReturns = 0.0;
+  static double decodeMilliSec = 0.0;
   string scanFileName;
   string poseFileName;
   
 
-  FILE *scan_in = 0;
   FILE *pose_in = 0;
 
   if (end > -1 && fileCounter > end) return -1; // 'nuf read
@@ -545,8 +614,7 @@ int ScanIO_velodyne::readScans(int start, int end, string &dir, int maxDist, int
   scanFileName = dir + "scan"  + ".bin";
   poseFileName = dir + "scan"  + ".pose";
   
-  scan_in = fopen(scanFileName.c_str(),"rb");  
-  if(scan_in==NULL)
+  if (!velodyne_open_log(scanFileName))
   {
 	cerr << "ERROR: Missing file " << scanFileName <<" "<<strerror(errno)<< endl; exit(1); 
 	return 0;
@@ -563,46 +631,31 @@ int ScanIO_velodyne::readScans(int start, int end, string &dir, int maxDist, int
      // cout<<"we get pose info"<<endl;
   }
   
-  velodyne_calib_precompute();
+  // the log starts with a header of 24 bytes
+  size_t offset = 24 + (size_t)PACKET_STRIDE*CIRCLELENGTH*fileCounter;
+  int packets = 0;
+  if (offset < velodyneLog.size) {
+    packets = (velodyneLog.size - offset) / PACKET_STRIDE;
+    if (packets > CIRCLELENGTH) packets = CIRCLELENGTH;
+  }
+  if (packets == 0) return -1; // end of the log
+
   cout << "Processing Scan " << scanFileName;
   cout.flush();
   
- 
-
-
-
-#if 0
-  raw_packet_t raw_tmp;
-  fseeko(scan_in, 0, SEEK_SET);
-  fread(&raw_tmp,sizeof(raw_packet_t),1,scan_in);
-  int revolution=raw_tmp.revolution+fileCounter+1;
-  int i=0;
-
-  while(raw_tmp.revolution!=revolution)
-  {
-      printf("%d %d\n",i++,raw_tmp.revolution);
-      fread(&raw_tmp,sizeof(raw_packet_t),1,scan_in);
-  }
-#else
-  
-   
-  
-  cout.flush();
   ptss.reserve(12*32*CIRCLELENGTH);
- #if 0
-  fseeko(scan_in, 0, SEEK_SET);
-  fseeko(scan_in, BLOCK_SIZE*CIRCLELENGTH*fileCounter, SEEK_CUR);
- #else
-  fseeko(scan_in, 24, SEEK_SET);
-  fseeko(scan_in, (BLOCK_SIZE+BLOCK_OFFSET)*CIRCLELENGTH*fileCounter, SEEK_CUR);
- #endif
-  
-#endif
-  read_one_packet(scan_in, ptss, maxDist, minDist);
+  unsigned long startTime = GetCurrentTimeInMilliSec();
+  decodedReturns += read_revolution(velodyneLog.data + offset, packets, ptss, maxDist, minDist);
+  decodeMilliSec += GetCurrentTimeInMilliSec() - startTime;
+  velodyne_release_log(offset);
   cout << " with " << ptss.size() << " Points";
 
   
-  cout << " done " << fileCounter<<endl;
+  cout << " done " << fileCounter;
+  if (decodeMilliSec > 0) {
+    cout << " (" << (long)(1000.0 * decodedReturns / decodeMilliSec) << " points/s decoded)";
+  }
+  cout << endl;
   if(pose_in)
   {
       double poseinfo[6];
@@ -620,7 +673,6 @@ int ScanIO_velodyne::readScans(int start, int end, string &dir, int maxDist, int
 
     fclose(pose_in);
   }
-  fclose(scan_in);
   fileCounter++;
   
   return fileCounter-1;
@@ -6,6 +6,7 @@
 
 #include "slam6d/searchTree.h"
 #include "slam6d/globals.icc"
+#include "slam6d/instrument.h"
 
 void SearchTree::getPtPairs(vector <PtPair> *pairs, 
     double *source_alignxf,                          // source
@@ -14,6 +15,10 @@ void SearchTree::getPtPairs(vector <PtPair> *pairs,
     int rnd, double max_dist_match2, double &sum,
     double *centroid_m, double *centroid_d, Scan *Target)
 {
+  INSTRUMENT_SCOPE(INSTR_GETPTPAIRS);
+  unsigned int queries = 0;
+  size_t first = pairs->size();
+
   centroid_m[0] = 0.0;
   centroid_m[1] = 0.0;
   centroid_m[2] = 0.0;
@@ -24,12 +29,14 @@ void SearchTree::getPtPairs(vector <PtPair> *pairs,
   double local_alignxf_inv[16];
   M4inv(source_alignxf, local_alignxf_inv);
 
+  unsigned int seed = Target ? Target->get_fileNr() : 0;
   for (unsigned int i = startindex; i < (unsigned int)nr_qpts; i++) {
-    if (rnd > 1 && rand(rnd) != 0) continue;  // take about 1/rnd-th of the numbers only
+    if (rnd > 1 && !subsample(rnd, seed, i)) continue;  // take about 1/rnd-th of the numbers only
 
     double p[3];
     transform3(local_alignxf_inv, q_points[i], p);
 
+    queries++;
     double *closest = this->FindClosest(p, max_dist_match2, thread_num);
     if (closest) {
       transform3(source_alignxf, closest, p);
@@ -60,6 +67,8 @@ void SearchTree::getPtPairs(vector <PtPair> *pairs,
     }
 
   }
+  INSTRUMENT_COUNT(INSTR_NN_QUERIES, queries);
+  INSTRUMENT_COUNT(INSTR_PAIRS_FOUND, pairs->size() - first);
 
   if (pairs->size() == 0) return;
 
@@ -73,3 +82,62 @@ void SearchTree::getPtPairs(vector <PtPair> *pairs,
   return;
 }
 
+int SearchTree::countPairs(double *source_alignxf,                  // source
+    double * const *q_points, unsigned int startindex, unsigned int nr_qpts,  // target
+    int thread_num, int rnd, double max_dist_match2, int threshold,
+    Scan *Target)
+{
+  if (threshold <= 0) return 0;
+
+  double local_alignxf_inv[16];
+  M4inv(source_alignxf, local_alignxf_inv);
+
+  unsigned int seed = Target ? Target->get_fileNr() : 0;
+  int count = 0;
+  for (unsigned int i = startindex; i < nr_qpts; i++) {
+    // give up if even all remaining points would not suffice
+    if (count + (int)(nr_qpts - i) < threshold) break;
+    if (rnd > 1 && !subsample(rnd, seed, i)) continue;  // take about 1/rnd-th of the numbers only
+
+    double p[3];
+    transform3(local_alignxf_inv, q_points[i], p);
+
+    if (this->HasClosest(p, max_dist_match2, thread_num)) {
+      if (++count >= threshold) break;
+    }
+  }
+
+  return count;
+}
+
+int SearchTree::FindKClosest(double *_p, int k, double maxdist2,
+    double **closest, double *closest_d2)
+{
+  cout << "this function is not implemented for this search tree!!!" << endl;
+  exit(-1);
+}
+
+void SearchTree::getPtPlaneSystem(PtPlaneSystem &system,
+    double *source_alignxf,                          // source
+    double * const *q_points, unsigned int startindex, unsigned int nr_qpts,  // target
+    int thread_num, int rnd, double max_dist_match2, Scan *Target)
+{
+  double local_alignxf_inv[16];
+  M4inv(source_alignxf, local_alignxf_inv);
+
+  unsigned int seed = Target ? Target->get_fileNr() : 0;
+  for (unsigned int i = startindex; i < nr_qpts; i++) {
+    if (rnd > 1 && !subsample(rnd, seed, i)) continue;  // take about 1/rnd-th of the numbers only
+
+    double p[3];
+    transform3(local_alignxf_inv, q_points[i], p);
+
+    double *closest = this->FindClosest(p, max_dist_match2, thread_num);
+    if (closest) {
+      double n[3];
+      transform3(source_alignxf, closest, p);
+      rotate3(source_alignxf, closest + 3, n);
+      system.add(p, n, q_points[i]);
+    }
+  }
+}
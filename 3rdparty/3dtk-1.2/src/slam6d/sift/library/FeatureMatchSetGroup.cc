@@ -54,3 +54,53 @@ FeatureMatchSetGroup::FeatureMatchSetGroup(const char * filename)
   
   in.close();	
 }
+
+void FeatureMatchSetGroup::consume(FeatureMatchSet &set)
+{
+  matchsets.push_back(set);
+}
+
+void FeatureMatchSetGroup::stream(const char * filename, FeatureMatchSetConsumer &consumer)
+{
+  ifstream in(filename, ios::binary);
+  if (!in.good()) {cerr << "File not found" << endl; throw 1; }
+  
+  int length;
+  in.read((char*) &length, sizeof(length));
+  
+  for (int i = 0 ; i < length && in.good() ; i++) 
+    {
+      FeatureMatchSet mset(in);
+      consumer.consume(mset);
+    }
+  
+  in.close();
+}
+
+FeatureMatchSetWriter::FeatureMatchSetWriter(const char * filename)
+  : out(filename, ios::binary), length(0)
+{
+  if (!out.good()) {cerr << "Could not open " << filename << endl; throw 1; }
+  out.write((char*)&length, sizeof(length));
+}
+
+FeatureMatchSetWriter::~FeatureMatchSetWriter()
+{
+  close();
+}
+
+void FeatureMatchSetWriter::consume(FeatureMatchSet &set)
+{
+  set.serialize(out);
+  length++;
+  streampos end = out.tellp();
+  out.seekp(0);
+  out.write((char*)&length, sizeof(length));
+  out.seekp(end);
+  out.flush();
+}
+
+void FeatureMatchSetWriter::close()
+{
+  if (out.is_open()) out.close();
+}
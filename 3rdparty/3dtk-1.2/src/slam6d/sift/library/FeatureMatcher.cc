@@ -0,0 +1,197 @@
+/**
+ * @file FeatureMatcher.cc
+ * @brief Implementation of Class FeatureMatcher
+ */
+#include "slam6d/sift/library/FeatureMatcher.h"
+#include <algorithm>
+#include <iostream>
+#include <map>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "autopano-sift-c_modified/AutoPanoSift.h"
+#undef bool
+#undef true
+#undef false
+#undef min
+#undef max
+#undef abs
+
+using namespace std;
+
+/**
+ * Orders matches by the fitness autopano uses for its score filtration,
+ * best matches first. ArrayList_Sort keeps its comparator in a global
+ * variable and can not be used by several threads.
+ */
+class MatchFitness
+{
+ public:
+  MatchFitness() : weighter(MatchWeighter_new0()) {}
+  ~MatchFitness() { MatchWeighter_delete(weighter); }
+  bool operator()(Match *m1, Match *m2) const
+  {
+    return MatchWeighter_OverallFitness(weighter, m1) < MatchWeighter_OverallFitness(weighter, m2);
+  }
+ private:
+  MatchWeighter *weighter;
+};
+
+FeatureMatcher::FeatureMatcher(ArrayList *keysets)
+{
+  this->keysets = keysets;
+  searchDepth = 40;
+  ratio = 0.6;
+  maxDistance = 0;
+
+  int count = ArrayList_Count(keysets);
+  trees.resize(count);
+#ifdef _OPENMP
+  omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int i = 0 ; i < count ; i++)
+    {
+      KeypointXMLList *keys = (KeypointXMLList*) ArrayList_GetItem(keysets, i);
+      trees[i] = KDTree_CreateKDTree(keys->array);
+    }
+}
+
+FeatureMatcher::~FeatureMatcher()
+{
+  for (unsigned int i = 0 ; i < trees.size() ; i++)
+    {
+      if (trees[i]) KDTree_delete(trees[i]);
+    }
+}
+
+void FeatureMatcher::setPositions(const vector<Coord> &positions, double maxDistance)
+{
+  if ((int) positions.size() != ArrayList_Count(keysets))
+    {
+      cerr << "FeatureMatcher: " << positions.size() << " positions for "
+	   << ArrayList_Count(keysets) << " keysets, matching all pairs" << endl;
+      return;
+    }
+  this->positions = positions;
+  this->maxDistance = maxDistance;
+}
+
+Feature FeatureMatcher::getFeature(KeypointN *p)
+{
+  vector<int> desc;
+  for (int d = 0 ; d < p->dim ; d++)
+    {
+      desc.push_back(p->descriptor[d]);
+    }
+  Feature feat(p->x, p->y, p->scale, p->orientation, desc);
+  return feat;
+}
+
+bool FeatureMatcher::isCandidate(int first, int second)
+{
+  if (positions.empty()) return true;
+  return (positions[first] - positions[second]).abs() <= maxDistance;
+}
+
+bool FeatureMatcher::matchPair(int first, int second, int minimumMatches, int bestMatches,
+			       FeatureMatchSet &set)
+{
+  KeypointXMLList *keys1 = (KeypointXMLList*) ArrayList_GetItem(keysets, first);
+  KeypointXMLList *keys2 = (KeypointXMLList*) ArrayList_GetItem(keysets, second);
+  KDTree *kd = trees[second];
+  if (kd == NULL || ArrayList_Count(keys2->array) < 2) return false;
+
+  ArrayList *matches = ArrayList_new0((void*) Match_delete);
+  for (int j = 0 ; j < ArrayList_Count(keys1->array) ; j++)
+    {
+      KeypointN *kp = (KeypointN*) ArrayList_GetItem(keys1->array, j);
+      SortedLimitedList *nn = KDTree_NearestNeighbourListBBF(kd, (IKDTreeDomain*) kp, 2, searchDepth);
+      if (SortedLimitedList_Count(nn) == 2)
+	{
+	  KDTreeBestEntry *be1 = (KDTreeBestEntry*) SortedLimitedList_GetItem(nn, 0);
+	  KDTreeBestEntry *be2 = (KDTreeBestEntry*) SortedLimitedList_GetItem(nn, 1);
+	  if (be1->distance <= ratio * be2->distance)
+	    {
+	      KeypointN *kpN = (KeypointN*) KDTreeBestEntry_Neighbour(be1);
+	      ArrayList_AddItem(matches, Match_new(kp, kpN, be1->distance, be2->distance));
+	    }
+	}
+      SortedLimitedList_delete(nn);
+    }
+
+  // the same filtration as MultiMatch_LocateMatchSets without RANSAC:
+  // drop keypoints matched more than once (MatchKeys_FilterJoins) ...
+  map<KeypointN*, int> references;
+  for (int j = 0 ; j < ArrayList_Count(matches) ; j++)
+    {
+      Match *m = (Match*) ArrayList_GetItem(matches, j);
+      references[m->kp1]++;
+      references[m->kp2]++;
+    }
+  vector<Match*> best;
+  for (int j = 0 ; j < ArrayList_Count(matches) ; j++)
+    {
+      Match *m = (Match*) ArrayList_GetItem(matches, j);
+      if (references[m->kp1] <= 1 && references[m->kp2] <= 1) best.push_back(m);
+    }
+  // ... and keep the best ones
+  if (bestMatches > 0 && (int) best.size() > bestMatches)
+    {
+      stable_sort(best.begin(), best.end(), MatchFitness());
+      best.resize(bestMatches);
+    }
+
+  bool enough = (int) best.size() >= minimumMatches;
+  if (enough)
+    {
+      set.firstscan = keys1->imageFile;
+      set.secondscan = keys2->imageFile;
+      for (unsigned int j = 0 ; j < best.size() ; j++)
+	{
+	  FeatureMatch match(getFeature(best[j]->kp1), getFeature(best[j]->kp2),
+			     best[j]->dist1, best[j]->dist2);
+	  set.matches.push_back(match);
+	}
+    }
+
+  ArrayList_delete(matches);
+  return enough;
+}
+
+int FeatureMatcher::match(FeatureMatchSetConsumer &consumer, int minimumMatches, int bestMatches)
+{
+  int count = ArrayList_Count(keysets);
+  vector< pair<int, int> > pairs;
+  for (int n0 = 0 ; n0 < count ; n0++)
+    {
+      for (int n1 = n0 + 1 ; n1 < count ; n1++)
+	{
+	  if (isCandidate(n0, n1)) pairs.push_back(make_pair(n0, n1));
+	}
+    }
+  cout << "Matching " << pairs.size() << " of " << count * (count - 1) / 2 << " pairs" << endl;
+
+  int found = 0;
+#ifdef _OPENMP
+  omp_set_num_threads(OPENMP_NUM_THREADS);
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int i = 0 ; i < (int) pairs.size() ; i++)
+    {
+      FeatureMatchSet set;
+      if (!matchPair(pairs[i].first, pairs[i].second, minimumMatches, bestMatches, set))
+	continue;
+#ifdef _OPENMP
+#pragma omp critical (featurematcher)
+#endif
+      {
+	cout << set.firstscan << " - " << set.secondscan << ": " << set.matches.size() << " matches" << endl;
+	consumer.consume(set);
+	found++;
+      }
+    }
+  return found;
+}
@@ -14,6 +14,12 @@
 #include <vigra/imageinfo.hxx>
 #include <vigra/impex.hxx>
 #include <math.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 
@@ -23,6 +29,9 @@ using namespace std;
 
 PanoramaMap::PanoramaMap()
 {
+  data = 0;
+  width = 0;
+  height = 0;
 }
 
 //Implementation of projections
@@ -46,11 +55,18 @@ PanoramaMap::PanoramaMap(PolarPointCloud* cloud, int nwidth, int nheight, int me
 	  data[i][j].z = 0;
 	}
     }
+
+  //the projections find the pixel of every point in parallel, the pixels
+  //are filled with the farthest point afterwards
+  long length = cloud->getLength();
+  const vector<PolarPoint> *pdata = cloud->getData();
+  vector<long> pixel(length, -1);
+#ifdef _OPENMP
+  omp_set_num_threads(OPENMP_NUM_THREADS);
+#endif
   
   if( method == STANDARD)
     {
-      long length = cloud->getLength();
-      const vector<PolarPoint> *pdata = cloud->getData();
       //adding the langitude to x axis and latitude to y axis
       double xmaxt = (double) nwidth / 2 / M_PI;
       int xmax = nwidth - 1;
@@ -59,6 +75,9 @@ PanoramaMap::PanoramaMap(PolarPointCloud* cloud, int nwidth, int nheight, int me
       double ylow = (0 - MIN_ANGLE) / 360 * 2 * M_PI;
       int ymax = nheight - 1;
       
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
       for (int i = 0 ; i < length ; i++)
         {
 	  int x = (int) ( xmaxt * (*pdata)[i].a);
@@ -76,23 +95,13 @@ PanoramaMap::PanoramaMap(PolarPointCloud* cloud, int nwidth, int nheight, int me
             data[x][y].y += (*pdata)[i].y;
             data[x][y].z += (*pdata)[i].z;
 	  */
-	  //adding the point with max distance
-	  if( data[x][y].meta < (*pdata)[i].d )
-            {
-	      data[x][y].value = (*pdata)[i].r;
-	      data[x][y].meta = (*pdata)[i].d;
-	      data[x][y].x = (*pdata)[i].x;
-	      data[x][y].y = (*pdata)[i].y;
-	      data[x][y].z = (*pdata)[i].z;
-	    }
+	  pixel[i] = x * nheight + y;
         }
       projection = STANDARD;
     }
   //cylindrical projection
   if(method == CYLINDRICAL)
     {
-      long length = cloud->getLength();
-      const vector<PolarPoint> *pdata = cloud->getData();
       //adding the longitude to x and tan(latitude) to y
       //find the x and y range
       double xmaxt = (double) nwidth / 2 / M_PI;
@@ -101,6 +110,9 @@ PanoramaMap::PanoramaMap(PolarPointCloud* cloud, int nwidth, int nheight, int me
       double ylow = (MIN_ANGLE) / 360 * 2 * M_PI;
       int ymax = nheight - 1;
       //go through all points and find the x and y of image pixel coresponding to them
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
       for (int i = 0 ; i < length ; i++)
         {
 	  int x = (int) ( xmaxt * (*pdata)[i].a);
@@ -109,23 +121,13 @@ PanoramaMap::PanoramaMap(PolarPointCloud* cloud, int nwidth, int nheight, int me
 	  int y = (int) ((double) ymaxt * (tan((*pdata)[i].b) - tan(ylow)));
 	  if (y < 0) y = 0;
 	  if (y > ymax) y = ymax;
-	  //adding the point with max distance
-	  if( data[x][y].meta < (*pdata)[i].d )
-            {
-	      data[x][y].value = (*pdata)[i].r;
-	      data[x][y].meta = (*pdata)[i].d;
-	      data[x][y].x = (*pdata)[i].x;
-	      data[x][y].y = (*pdata)[i].y;
-	      data[x][y].z = (*pdata)[i].z;
-            }
+	  pixel[i] = x * nheight + y;
         }
       projection = CYLINDRICAL;
     }
   //Z axes Projection
   if(method == NEW)
     {
-      long length = cloud->getLength();
-      const vector<PolarPoint> *pdata = cloud->getData();
       //find the x and y range and add longitude to x and z to y
       double xmaxt = (double) nwidth / 2 / M_PI;
       int xmax = nwidth - 1;
@@ -135,6 +137,9 @@ PanoramaMap::PanoramaMap(PolarPointCloud* cloud, int nwidth, int nheight, int me
       int ymax = nheight - 1;
       double ylow = cloud->minz;
       //double ylow = (200);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
       for (int i = 0 ; i < length ; i++)
         {
 	  int x = (int) ( xmaxt * (*pdata)[i].a);
@@ -158,23 +163,13 @@ PanoramaMap::PanoramaMap(PolarPointCloud* cloud, int nwidth, int nheight, int me
 	      if (y > ymax) y = ymax;
             }
 	  */
-	  //add the point with max distance
-	  if( data[x][y].meta < (*pdata)[i].d )
-            {
-	      data[x][y].value = (*pdata)[i].r;
-	      data[x][y].meta = (*pdata)[i].d;
-	      data[x][y].x = (*pdata)[i].x;
-	      data[x][y].y = (*pdata)[i].y;
-	      data[x][y].z = (*pdata)[i].z;
-            }
+	  pixel[i] = x * nheight + y;
         }
       projection = NEW;
     }
   //Mercator Projection
   if( method == MERCATOR)
     {
-      long length = cloud->getLength();
-      const vector<PolarPoint> *pdata = cloud->getData();
       //find the x and y range
       double xmaxt = (double) nwidth / 2 / M_PI;
       int xmax = nwidth - 1;
@@ -182,6 +177,9 @@ PanoramaMap::PanoramaMap(PolarPointCloud* cloud, int nwidth, int nheight, int me
       double ylow = log(tan(MIN_ANGLE / 360 * 2 * M_PI) + (1/cos(MIN_ANGLE / 360 * 2 * M_PI)));
       int ymax = nheight - 1;
       //go through all points and find the x and y
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
       for (int i = 0 ; i < length ; i++)
         {
 	  int x = (int) ( xmaxt * (*pdata)[i].a);
@@ -190,24 +188,17 @@ PanoramaMap::PanoramaMap(PolarPointCloud* cloud, int nwidth, int nheight, int me
 	  int y = (int) ( ymaxt * (log(tan((*pdata)[i].b) + (1/cos((*pdata)[i].b))) - ylow) );
 	  if (y < 0) y = 0;
 	  if (y > ymax) y = ymax;
-	  //add the point with max distance
-	  if( data[x][y].meta < (*pdata)[i].d )
-            {
-	      data[x][y].value = (*pdata)[i].r;
-	      data[x][y].meta = (*pdata)[i].d;
-	      data[x][y].x = (*pdata)[i].x;
-	      data[x][y].y = (*pdata)[i].y;
-	      data[x][y].z = (*pdata)[i].z;
-            }
+	  pixel[i] = x * nheight + y;
         }
       projection = MERCATOR;
     }
   //Rectilinear Projection
   if(method == RECTILINEAR)
     {
-      long length = cloud->getLength();
-      const vector<PolarPoint> *pdata = cloud->getData(); 
       //go through all points 
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
       for (int i = 0 ; i < length ; i++)
 	{
 	  //check for point in the first 90 degree
@@ -241,15 +232,7 @@ PanoramaMap::PanoramaMap(PolarPointCloud* cloud, int nwidth, int nheight, int me
 	      int y = (int) (ymaxt) * (( (cos(p1) * sin((*pdata)[i].b) - sin(p1) * cos((*pdata)[i].b) * cos((*pdata)[i].a - l0)) / c) - ylow);
 	      if (y < 0) y = 0;
 	      if (y > ymax) y = ymax;
-	      //add the point with max distance
-	      if( data[x][y].meta < (*pdata)[i].d )
-		{
-		  data[x][y].value = (*pdata)[i].r;
-		  data[x][y].meta = (*pdata)[i].d;
-		  data[x][y].x = (*pdata)[i].x;
-		  data[x][y].y = (*pdata)[i].y;
-		  data[x][y].z = (*pdata)[i].z;
-		}
+	      pixel[i] = x * nheight + y;
 	    }
 	  //same as first interval
 	  if((*pdata)[i].a < (M_PI) && (*pdata)[i].a > (M_PI/2))
@@ -282,14 +265,7 @@ PanoramaMap::PanoramaMap(PolarPointCloud* cloud, int nwidth, int nheight, int me
 	      int y = (int) (ymaxt) * (((cos(p1) * sin((*pdata)[i].b) - sin(p1) * cos((*pdata)[i].b) * cos((*pdata)[i].a - l0)) / c) - ylow);
 	      if (y < 0) y = 0;
 	      if (y > ymax) y = ymax;
-	      if( data[x][y].meta < (*pdata)[i].d )
-		{
-		  data[x][y].value = (*pdata)[i].r;
-		  data[x][y].meta = (*pdata)[i].d;
-		  data[x][y].x = (*pdata)[i].x;
-		  data[x][y].y = (*pdata)[i].y;
-		  data[x][y].z = (*pdata)[i].z;
-		}
+	      pixel[i] = x * nheight + y;
 	    }
 	  //same as fisrt interval
 	  if((*pdata)[i].a < (3*M_PI/2) && (*pdata)[i].a > (M_PI))
@@ -322,14 +298,7 @@ PanoramaMap::PanoramaMap(PolarPointCloud* cloud, int nwidth, int nheight, int me
 	      int y = (int) (ymaxt) * (((cos(p1) * sin((*pdata)[i].b) - sin(p1) * cos((*pdata)[i].b) * cos((*pdata)[i].a - l0)) / c) - ylow);
 	      if (y < 0) y = 0;
 	      if (y > ymax) y = ymax;
-	      if( data[x][y].meta < (*pdata)[i].d )
-		{
-		  data[x][y].value = (*pdata)[i].r;
-		  data[x][y].meta = (*pdata)[i].d;
-		  data[x][y].x = (*pdata)[i].x;
-		  data[x][y].y = (*pdata)[i].y;
-		  data[x][y].z = (*pdata)[i].z;
-		}
+	      pixel[i] = x * nheight + y;
 	    }
 	  //same as first interval
 	  if((*pdata)[i].a < (2*M_PI) && (*pdata)[i].a > (3*M_PI/2))
@@ -362,14 +331,7 @@ PanoramaMap::PanoramaMap(PolarPointCloud* cloud, int nwidth, int nheight, int me
 	      int y = (int) (ymaxt) * (((cos(p1) * sin((*pdata)[i].b) - sin(p1) * cos((*pdata)[i].b) * cos((*pdata)[i].a - l0)) / c) - ylow);
 	      if (y < 0) y = 0;
 	      if (y > ymax) y = ymax;
-	      if( data[x][y].meta < (*pdata)[i].d )
-		{
-		  data[x][y].value = (*pdata)[i].r;
-		  data[x][y].meta = (*pdata)[i].d;
-		  data[x][y].x = (*pdata)[i].x;
-		  data[x][y].y = (*pdata)[i].y;
-		  data[x][y].z = (*pdata)[i].z;
-		}
+	      pixel[i] = x * nheight + y;
 	    }
 	}
       projection = RECTILINEAR;
@@ -377,12 +339,10 @@ PanoramaMap::PanoramaMap(PolarPointCloud* cloud, int nwidth, int nheight, int me
   //PANNINI Projection
   if(method == PANNINI)
     {
-      long length = cloud->getLength();
       //double d = 0;
       d = panninid;
       n = imagen;
       cout << "Parameter d is:" << d <<", Number of images per scan is:" << n << endl;
-      const vector<PolarPoint> *pdata = cloud->getData(); 
       double l0, p1, iminx, imaxx, iminy, imaxy, interval;
       interval = 2 * M_PI / n;
       //iminy = -M_PI/3;
@@ -391,6 +351,9 @@ PanoramaMap::PanoramaMap(PolarPointCloud* cloud, int nwidth, int nheight, int me
       //latitude of projection center
       p1 = 0;
       //go through all points 
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) private(l0, iminx, imaxx)
+#endif
       for (int i = 0 ; i < length ; i++)
 	{
 	  for(int j = 0 ; j < n ; j++)
@@ -430,15 +393,7 @@ PanoramaMap::PanoramaMap(PolarPointCloud* cloud, int nwidth, int nheight, int me
 		  int y = (int) (ymaxt) * ( (s * tan((*pdata)[i].b) * (cos(p1) - sin(p1) * (1/tan((*pdata)[i].b)) * cos((*pdata)[i].a - l0) ) ) - ylow );
 		  if (y < 0) y = 0;
 		  if (y > ymax) y = ymax;
-		  //add the point with max distance
-		  if( data[x][y].meta < (*pdata)[i].d )
-		    {
-		      data[x][y].value = (*pdata)[i].r;
-		      data[x][y].meta = (*pdata)[i].d;
-		      data[x][y].x = (*pdata)[i].x;
-		      data[x][y].y = (*pdata)[i].y;
-		      data[x][y].z = (*pdata)[i].z;
-		    }
+		  pixel[i] = x * nheight + y;
 		}
 	    }
 	}
@@ -447,11 +402,9 @@ PanoramaMap::PanoramaMap(PolarPointCloud* cloud, int nwidth, int nheight, int me
   //Stereographic Projection
   if(method == STEREOGRAPHIC)
     {
-      long length = cloud->getLength();
       r = stereor;
       n = imagen;
       cout << "Paremeter r is:" << r << ", Number of images per scan is:" << n << endl;
-      const vector<PolarPoint> *pdata = cloud->getData();
       // l0 and p1 are the center of projection iminx, imaxx, iminy, imaxy are the bounderis of intervals
       double l0, p1, iminx, imaxx, iminy, imaxy, interval;
       interval = 2 * M_PI / n;
@@ -461,6 +414,9 @@ PanoramaMap::PanoramaMap(PolarPointCloud* cloud, int nwidth, int nheight, int me
       //latitude of projection center
       p1 = 0;
       //go through ll points
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) private(l0, iminx, imaxx)
+#endif
       for ( int i = 0 ; i < length ; i++)
 	{
 	  for ( int j = 0 ; j < n ; j++)
@@ -499,20 +455,60 @@ PanoramaMap::PanoramaMap(PolarPointCloud* cloud, int nwidth, int nheight, int me
 		  int y = (int) (ymaxt) * (k * ( cos(p1) * sin((*pdata)[i].b) - sin(p1) * cos((*pdata)[i].b) * cos((*pdata)[i].a - l0) ) - ylow);
 		  if (y < 0) y = 0;
 		  if (y > ymax) y = ymax;
-		  //add the point with max distance
-		  if (data[x][y].meta < (*pdata)[i].d)
-		    {
-		      data[x][y].value = (*pdata)[i].r;
-		      data[x][y].meta = (*pdata)[i].d;
-		      data[x][y].x = (*pdata)[i].x;
-		      data[x][y].y = (*pdata)[i].y;
-		      data[x][y].z = (*pdata)[i].z;
-		    }
+		  pixel[i] = x * nheight + y;
 		}
 	    }
 	}
       projection = STEREOGRAPHIC;
     }
+  //every thread keeps the farthest point of every pixel in its own
+  //z-buffer, the z-buffers are merged in the order of the points
+  vector<long> farthest(nwidth * nheight, -1);
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+  {
+    vector<long> zbuffer(nwidth * nheight, -1);
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+    for (long i = 0 ; i < length ; i++)
+      {
+	long p = pixel[i];
+	if (p < 0) continue;
+	if (zbuffer[p] < 0 ? (*pdata)[i].d > 0 : (*pdata)[zbuffer[p]].d < (*pdata)[i].d)
+	  zbuffer[p] = i;
+      }
+#ifdef _OPENMP
+    //iteration t runs on thread t, which got the t-th block of points
+#pragma omp for ordered schedule(static, 1)
+    for (int t = 0 ; t < omp_get_num_threads() ; t++)
+#pragma omp ordered
+#endif
+      {
+	for (long p = 0 ; p < nwidth * nheight ; p++)
+	  {
+	    long i = zbuffer[p];
+	    if (i >= 0 && (farthest[p] < 0 || (*pdata)[farthest[p]].d < (*pdata)[i].d))
+	      farthest[p] = i;
+	  }
+      }
+  }
+
+  for (int x = 0 ; x < nwidth ; x++)
+    {
+      for (int y = 0 ; y < nheight ; y++)
+	{
+	  long i = farthest[x * nheight + y];
+	  if (i < 0) continue;
+	  data[x][y].value = (*pdata)[i].r;
+	  data[x][y].meta = (*pdata)[i].d;
+	  data[x][y].x = (*pdata)[i].x;
+	  data[x][y].y = (*pdata)[i].y;
+	  data[x][y].z = (*pdata)[i].z;
+	}
+    }
+
   //use the added values and index to find the mean 
   /*
     int ind;
@@ -557,6 +553,13 @@ PanoramaMap::PanoramaMap(const char* filename)
   ifstream in(filename, ios::binary);
   if (!in.good()) {cerr << "File not found" << endl; throw 1; }
   
+  deserialize(in);
+  
+  in.close();
+}
+
+void PanoramaMap::deserialize(istream &in)
+{
   int stringsize;
   in.read((char*) &stringsize, sizeof(stringsize));
   scanid = "";
@@ -578,10 +581,7 @@ PanoramaMap::PanoramaMap(const char* filename)
   
   for (int x = 0 ; x < width ; x++)
     {
-      for (int y = 0 ; y < height ; y++)
-	{
-	  in.read((char *) &(data[x][y]), sizeof(data[x][y]));
-	}
+      in.read((char *) data[x], height * sizeof(SuperPixel));
     }
   
   in.read((char*) &mina, sizeof(mina));
@@ -591,8 +591,6 @@ PanoramaMap::PanoramaMap(const char* filename)
   in.read((char*) &minz, sizeof(minz));
   in.read((char*) &maxz, sizeof(maxz));
   in.read((char*) &projection, sizeof(projection));
-  
-  in.close();
 }
 
 PanoramaMap::~PanoramaMap() 
@@ -643,6 +641,12 @@ void PanoramaMap::serialize(const char* filename)
   string str(filename);
   cout << filename << endl;
   ofstream out(filename, ios::binary);
+  serialize(out);
+  out.close();
+}
+
+void PanoramaMap::serialize(ostream &out)
+{
   int stringsize = scanid.size();
   out.write((char*) &stringsize, sizeof(stringsize));
   for (int i = 0 ; i < stringsize ; i++)
@@ -655,10 +659,7 @@ void PanoramaMap::serialize(const char* filename)
   out.write((char *) &height, sizeof(height));
   for (int x = 0 ; x < width ; x++) 
     {
-      for (int y = 0 ; y < height ; y++) 
-	{
-	  out.write((char *) &(data[x][y]), sizeof(data[x][y]));
-	}
+      out.write((char *) data[x], height * sizeof(SuperPixel));
     }
   
   out.write((char*) &mina, sizeof(mina));
@@ -668,6 +669,74 @@ void PanoramaMap::serialize(const char* filename)
   out.write((char*) &minz, sizeof(minz));
   out.write((char*) &maxz, sizeof(maxz));
   out.write((char*) &projection, sizeof(projection));
+}
+
+//what a cached map depends on, compared byte by byte
+struct PanoramaCacheKey
+{
+  char magic[4];
+  long long scansize;
+  long long scantime;
+  int width;
+  int height;
+  int method;
+  int n;
+  double d;
+  double r;
+};
+
+static bool getCacheKey(PanoramaCacheKey &key, const char* scanfile, int width, int height, int method, double panninid, int imagen, double stereor)
+{
+  struct stat st;
+  if (stat(scanfile, &st) != 0) return false;
+  
+  memset(&key, 0, sizeof(key));
+  memcpy(key.magic, "PMC1", 4);
+  key.scansize = st.st_size;
+  key.scantime = st.st_mtime;
+  key.width = width;
+  key.height = height;
+  key.method = method;
+  //only the parameters the projection uses
+  if (method == PANNINI || method == STEREOGRAPHIC) key.n = imagen;
+  if (method == PANNINI) key.d = panninid;
+  if (method == STEREOGRAPHIC) key.r = stereor;
+  return true;
+}
+
+bool PanoramaMap::readCache(const char* cachefile, const char* scanfile, int nwidth, int nheight, int method, double panninid, int imagen, double stereor)
+{
+  PanoramaCacheKey key, cached;
+  if (!getCacheKey(key, scanfile, nwidth, nheight, method, panninid, imagen, stereor)) return false;
+  
+  ifstream in(cachefile, ios::binary);
+  if (!in.good()) return false;
+  in.read((char*) &cached, sizeof(cached));
+  if (!in.good() || memcmp(&key, &cached, sizeof(key)) != 0) return false;
+  
+  in.read((char*) &d, sizeof(d));
+  in.read((char*) &n, sizeof(n));
+  in.read((char*) &r, sizeof(r));
+  deserialize(in);
+  if (!in.good())
+    {
+      cerr << "Broken panorama cache " << cachefile << endl;
+      return false;
+    }
+  in.close();
+  return true;
+}
+
+void PanoramaMap::writeCache(const char* cachefile, const char* scanfile, double panninid, int imagen, double stereor)
+{
+  PanoramaCacheKey key;
+  if (!getCacheKey(key, scanfile, width, height, projection, panninid, imagen, stereor)) return;
   
+  ofstream out(cachefile, ios::binary);
+  out.write((char*) &key, sizeof(key));
+  out.write((char*) &d, sizeof(d));
+  out.write((char*) &n, sizeof(n));
+  out.write((char*) &r, sizeof(r));
+  serialize(out);
   out.close();
 }
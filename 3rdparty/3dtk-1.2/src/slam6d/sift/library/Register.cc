@@ -151,7 +151,6 @@ Register::Register(FeatureMatchSetGroup *group, std::vector<PanoramaMap*> &tmaps
   //mind = 200;
   mina = 2.0 / 360.0 * 2 * M_PI;
   
-  assert(group);
   vector<PanoramaMap*>::iterator ita;
   for (ita = tmaps.begin(); ita != tmaps.end() ; ita++)
     {
@@ -163,88 +162,99 @@ Register::Register(FeatureMatchSetGroup *group, std::vector<PanoramaMap*> &tmaps
 
 void Register::registerScans()
 {
-  list< list<ScanTransform> >	 components;
+  assert(group);
+  components.clear();
   list<FeatureMatchSet>::iterator it;
   for (it = group->matchsets.begin() ; it != group->matchsets.end() ; it++)
     {
-      if (maps.find(it->firstscan) == maps.end() || maps.find(it->secondscan) == maps.end())
-	{
-	  continue;
-	}
-      
-      double tr[4][4];
-      bool fits;
-      mc = 0;
-      fits = Register::registerSet(&(*it), maps[it->firstscan], maps[it->secondscan], tr);
+      consume(*it);
+    }
+  writeComponents();
+}
+
+void Register::consume(FeatureMatchSet &set)
+{
+  FeatureMatchSet *it = &set;
+  if (maps.find(it->firstscan) == maps.end() || maps.find(it->secondscan) == maps.end())
+    {
+      return;
+    }
+  
+  double tr[4][4];
+  bool fits;
+  mc = 0;
+  fits = Register::registerSet(&(*it), maps[it->firstscan], maps[it->secondscan], tr);
+  
+  if (fits)
+    {	  
+      bool foundfirst = false;
+      list< list<ScanTransform> >::iterator first_component;
+      list<ScanTransform>::iterator first_ind;
+      bool foundsecond = false;
+      list< list<ScanTransform> >::iterator second_component;
+      list<ScanTransform>::iterator second_ind;
       
-      if (fits)
-	{	  
-	  bool foundfirst = false;
-	  list< list<ScanTransform> >::iterator first_component;
-	  list<ScanTransform>::iterator first_ind;
-	  bool foundsecond = false;
-	  list< list<ScanTransform> >::iterator second_component;
-	  list<ScanTransform>::iterator second_ind;
-	  
-	  for (list< list<ScanTransform> >::iterator f = components.begin() ; f != components.end() ; f++)
+      for (list< list<ScanTransform> >::iterator f = components.begin() ; f != components.end() ; f++)
+	{
+	  for (list<ScanTransform>::iterator s = f->begin() ; s != f->end() ; s++)
 	    {
-	      for (list<ScanTransform>::iterator s = f->begin() ; s != f->end() ; s++)
+	      if (s->scanid == it->firstscan)
 		{
-		  if (s->scanid == it->firstscan)
-		    {
-		      foundfirst = true;
-		      first_component = f;
-		      first_ind = s;
-		    }
-		  if (s->scanid == it->secondscan)
-		    {
-		      foundsecond = true;
-		      second_component = f;
-		      second_ind = s;
-		    }
+		  foundfirst = true;
+		  first_component = f;
+		  first_ind = s;
+		}
+	      if (s->scanid == it->secondscan)
+		{
+		  foundsecond = true;
+		  second_component = f;
+		  second_ind = s;
 		}
 	    }
-	  
-	  if (!foundfirst && !foundsecond)
-	    {
-	      list<ScanTransform> newcomponent;
-	      ScanTransform first(it->firstscan);
-	      ScanTransform second(it->secondscan, tr);
-	      newcomponent.push_back(first);
-	      newcomponent.push_back(second);
-	      components.push_back(newcomponent);     
-	    } else
-	    if (foundfirst && foundsecond)
+	}
+      
+      if (!foundfirst && !foundsecond)
+	{
+	  list<ScanTransform> newcomponent;
+	  ScanTransform first(it->firstscan);
+	  ScanTransform second(it->secondscan, tr);
+	  newcomponent.push_back(first);
+	  newcomponent.push_back(second);
+	  components.push_back(newcomponent);     
+	} else
+	if (foundfirst && foundsecond)
+	  {
+	    if (first_component != second_component)
 	      {
-		if (first_component != second_component)
+		//merge components
+		for (list<ScanTransform>::iterator ni = second_component->begin() ; ni != second_component->end() ; ni++)
 		  {
-		    //merge components
-		    for (list<ScanTransform>::iterator ni = second_component->begin() ; ni != second_component->end() ; ni++)
-		      {
-			ScanTransform secondtr = first_ind->multiply(ScanTransform("", tr).multiply(second_ind->inverse().multiply(*ni)));
-			secondtr.scanid = ni->scanid;
-			first_component->push_back(secondtr);			
-		      }
-		    components.erase(second_component);
+		    ScanTransform secondtr = first_ind->multiply(ScanTransform("", tr).multiply(second_ind->inverse().multiply(*ni)));
+		    secondtr.scanid = ni->scanid;
+		    first_component->push_back(secondtr);			
 		  }
-	      } else
-	      if (foundfirst)
-                {
-		  //add second
-		  ScanTransform secondtr = first_ind->multiply(ScanTransform("", tr));
-		  secondtr.scanid = it->secondscan;
-		  first_component->push_back(secondtr);
-		} else
-		if (foundsecond)
-		  {
-		    //add first
-		    ScanTransform firsttr = second_ind->multiply(ScanTransform("", tr).inverse());
-		    firsttr.scanid = it->firstscan;
-		    second_component->push_back(firsttr); 
-		  }
-	}
+		components.erase(second_component);
+	      }
+	  } else
+	  if (foundfirst)
+	    {
+	      //add second
+	      ScanTransform secondtr = first_ind->multiply(ScanTransform("", tr));
+	      secondtr.scanid = it->secondscan;
+	      first_component->push_back(secondtr);
+	    } else
+	    if (foundsecond)
+	      {
+		//add first
+		ScanTransform firsttr = second_ind->multiply(ScanTransform("", tr).inverse());
+		firsttr.scanid = it->firstscan;
+		second_component->push_back(firsttr); 
+	      }
     }
-  
+}
+
+void Register::writeComponents()
+{
   cout << "Number of components: " << components.size() << endl;
   int i = 1;
   for (list< list<ScanTransform> >::iterator f = components.begin() ; f != components.end() ; f++)
@@ -28,6 +28,8 @@
 #include "slam6d/sift/library/PanoramaMap.h"
 #include "slam6d/sift/library/FeatureSet.h"
 #include "slam6d/sift/library/FeatureMatchSetGroup.h"
+#include "slam6d/sift/library/FeatureMatcher.h"
+#include <fstream>
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -46,28 +48,21 @@
 void usage(int argc, char** argv)
 {
   printf("\n");
-  printf("USAGE: %s [ -o FILE.matches] file1.keyset file2.keyset [file3.keyset] ...\n",/* [ -m MIN_DIM ]\n",*/argv[0]);
+  printf("USAGE: %s [ -o FILE.matches] [ -m <maxmatches> ] [ -p FILE -d <maxdist> ] [ -g ] file1.keyset file2.keyset [file3.keyset] ...\n",/* [ -m MIN_DIM ]\n",*/argv[0]);
   printf("\n");
   printf("\n");
   printf("\tOptions:\n");
   printf("\t\t-o FILE.matches\t\tserialize the FeatureMatchSetGroup class\n");
   printf("\t\t-m <maxmatches>\t\tfilter and return the best <maxmatches> matches\n");
+  printf("\t\t-p FILE\t\t\tpositions of the scans, one line \"x y z\" per input file\n");
+  printf("\t\t-d <maxdist>\t\tonly match scans whose positions are closer than <maxdist>\n");
+  printf("\t\t-g\t\t\tmatch with one global k-d tree of all keypoints as autopano does,\n");
+  printf("\t\t\t\t\tinstead of matching every pair of scans in parallel\n");
   printf("\t\tfile.keyxml\t\tinput file. The xml file output returned by generatesiftfeatures -x\n");
   printf("\n");
   exit(1);
 }
 
-Feature getFeatureFromKeypointN(KeypointN* p)
-{
-  vector<int> desc;
-  for (int d = 0 ; d < p->dim ; d++) 
-    {
-      desc.push_back(p->descriptor[d]);
-    }
-  Feature feat(p->x, p->y, p->scale, p->orientation, desc);
-  return feat;
-}
-
 FeatureMatchSetGroup *getFeatureMatchSetGroup(ArrayList* matchsets)
 {
   FeatureMatchSetGroup *res = new FeatureMatchSetGroup();
@@ -84,8 +79,8 @@ FeatureMatchSetGroup *getFeatureMatchSetGroup(ArrayList* matchsets)
 	{
 	  Match* m = (Match*) ArrayList_GetItem(matches, j);
 	  FeatureMatch match(
-			     getFeatureFromKeypointN(m->kp1),
-			     getFeatureFromKeypointN(m->kp2),
+			     FeatureMatcher::getFeature(m->kp1),
+			     FeatureMatcher::getFeature(m->kp2),
 			     m->dist1,
 			     m->dist2
 			     );
@@ -99,12 +94,13 @@ FeatureMatchSetGroup *getFeatureMatchSetGroup(ArrayList* matchsets)
 /**
  *   parseArgs - reade the comand line options
  */
-int parseArgs(int argc, char **argv, string &output, int &maxmatches, vector<string> &inputfiles)
+int parseArgs(int argc, char **argv, string &output, int &maxmatches, string &positions, double &maxdist,
+	      bool &global, vector<string> &inputfiles)
 {
   int c;
   opterr = 0;
   //read the command line and get the options
-  while ((c = getopt (argc, argv, "o:m:")) != -1)
+  while ((c = getopt (argc, argv, "o:m:p:d:g")) != -1)
     switch (c)
       {
       case 'o':
@@ -117,8 +113,21 @@ int parseArgs(int argc, char **argv, string &output, int &maxmatches, vector<str
 	  usage(argc, argv);
 	}
 	break;
+      case 'p':
+	positions = optarg;
+	break;
+      case 'd':
+	maxdist = atof(optarg);
+	if (maxdist <= 0) {
+	  fprintf( stderr, "maxdist has to be positive\n");
+	  usage(argc, argv);
+	}
+	break;
+      case 'g':
+	global = true;
+	break;
       case '?':
-	if (optopt == 'o' || optopt == 'm')
+	if (optopt == 'o' || optopt == 'm' || optopt == 'p' || optopt == 'd')
 	  fprintf (stderr, "Option -%c requires an argument.\n", optopt);
 	else
 	  fprintf (stderr, "Unknown option character `%c'\n", optopt);
@@ -134,6 +143,12 @@ int parseArgs(int argc, char **argv, string &output, int &maxmatches, vector<str
       usage(argc, argv);
     }
   
+  if (positions.empty() != (maxdist == 0) || (global && !positions.empty()))
+    {
+      printf("-p and -d have to be given together and can not be used with -g\n");
+      usage(argc, argv);
+    }
+
   if (optind > argc - 2) 
     {
       printf("%d %d\n", optind, argc);
@@ -158,13 +173,18 @@ int main (int argc, char* argv[])
   vector<string> inputfiles;
   string output;
   int maxmatches = 0;
+  string positions;
+  double maxdist = 0;
+  bool global = false;
   vector<string>::iterator it;
   
-  parseArgs(argc, argv, output, maxmatches, inputfiles);
+  parseArgs(argc, argv, output, maxmatches, positions, maxdist, global, inputfiles);
   cout<<endl;
   cout<<"matchsiftfeatures will procees with the following parameters: "<<endl;
   cout<<"Output: "<<output<<endl;
   cout<<"Maxmatches: "<<maxmatches<<endl;
+  if (!positions.empty())
+    cout<<"Positions: "<<positions<<", maximal distance: "<<maxdist<<endl;
   cout<<"Inputfiles :"<<endl;
   for (it = inputfiles.begin() ; it != inputfiles.end() ; it++) 
     {
@@ -186,17 +206,37 @@ int main (int argc, char* argv[])
   
   WriteLine ("\nMatching...");
   clock_t start = clock();
-  ArrayList* msList = MultiMatch_LocateMatchSets (mm, 3, maxmatches, false, false);
+  if (global)
+    {
+      ArrayList* msList = MultiMatch_LocateMatchSets (mm, 3, maxmatches, false, false);
+      FeatureMatchSetGroup *msg = getFeatureMatchSetGroup(msList);
+      msg->serialize(output.c_str());
+      delete msg;
+    }
+  else
+    {
+      FeatureMatcher matcher(mm->keySets);
+      if (!positions.empty())
+	{
+	  vector<Coord> coords;
+	  ifstream in(positions.c_str());
+	  float x, y, z;
+	  while (in >> x >> y >> z)
+	    {
+	      coords.push_back(Coord(x, y, z));
+	    }
+	  matcher.setPositions(coords, maxdist);
+	}
+      // every pair is written as soon as it is matched
+      FeatureMatchSetWriter writer(output.c_str());
+      matcher.match(writer, 3, maxmatches);
+      writer.close();
+    }
   clock_t end = clock();
   double time = ((double)((int) end - (int) start)) / CLOCKS_PER_SEC;
   
   cout << "Matched in time: " << time << endl;
   
-  FeatureMatchSetGroup *msg = getFeatureMatchSetGroup(msList);
-  
-  msg->serialize(output.c_str());
-  
-  delete msg;
   ArrayList_delete(keyfiles);
   MultiMatch_delete(mm);
   
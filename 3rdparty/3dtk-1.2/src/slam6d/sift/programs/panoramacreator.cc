@@ -13,6 +13,10 @@
 #include <iostream>
 #include <ctime>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #ifndef _MSC_VER
 #include <getopt.h>
 #else
@@ -36,7 +40,7 @@ struct size
 void usage(int argc, char** argv)
 {
   printf("\n");
-  printf("USAGE: %s [-m] [-j] [-d] [-v] [-n] [-R] [-p] -s <WIDTHxHEIGHT> [-s <WIDTHxHEIGHT> ...] FILE1.ppc [FILE2.ppc] ...\n",argv[0]);
+  printf("USAGE: %s [-m] [-j] [-d] [-v] [-n] [-R] [-p] [-c] [-t NR] -s <WIDTHxHEIGHT> [-s <WIDTHxHEIGHT> ...] FILE1.ppc [FILE2.ppc] ...\n",argv[0]);
   printf("\n");
   printf("\n");
   printf("\tOptions:\n");
@@ -48,6 +52,9 @@ void usage(int argc, char** argv)
   printf("\t\t-R \t\t\tthe R parameter for stereographic projection,default is 1:\n");
   printf("\t\t-n \t\t\tthe number of images per scan ,default is 4:\n"); 
   printf("\t\t-s <WxH>\t\tsize of output in widthxheight\n");
+  printf("\t\t-c \t\t\tkeep the maps in FILE_WxH_PROJECTION.pmc files and reuse them\n");
+  printf("\t\t\t\t\tas long as the scan file and the parameters are unchanged\n");
+  printf("\t\t-t NR\t\t\tnumber of scans processed at the same time, default is 1:\n");
   printf("\t\t\t\t\tinput files should be serialization of PolarPointCloud class returned by readscan\n");
   printf("\n");
   printf("\tExample:\n");
@@ -59,14 +66,14 @@ void usage(int argc, char** argv)
 /**
  *   parseArgs - reade the comand line options
  */
-int parseArgs(int argc, char **argv, string &reader, int &method, string &projection, bool &writeMaps, bool &writeRangeImage, bool &writeRefelectanceJpeg, string &input,vector<struct size> &sizes, double &d, int &n, double &r)
+int parseArgs(int argc, char **argv, string &reader, int &method, string &projection, bool &writeMaps, bool &writeRangeImage, bool &writeRefelectanceJpeg, vector<string> &inputs,vector<struct size> &sizes, double &d, int &n, double &r, bool &cache, int &jobs)
 {
   int c; 
   int width;
   int height;
   opterr = 0;
   //reade the command line and get the options
-  while ((c = getopt (argc, argv, "r:mjdR:v:n:s:p:")) != -1)
+  while ((c = getopt (argc, argv, "r:mjdR:v:n:s:p:ct:")) != -1)
     switch (c)
       {
       case 'p':
@@ -93,6 +100,13 @@ int parseArgs(int argc, char **argv, string &reader, int &method, string &projec
       case 'j':
 	writeRefelectanceJpeg = true;
 	break;
+      case 'c':
+	cache = true;
+	break;
+      case 't':
+	jobs = atoi(optarg);
+	if (jobs < 1) {printf("Invalid number of scans\n"); usage(argc, argv);}
+	break;
       case 's':
 	char *pch;
 	pch = strtok(optarg, "x");
@@ -153,10 +167,69 @@ int parseArgs(int argc, char **argv, string &reader, int &method, string &projec
       printf("One of the options -m or -j or -d must be included\n");
       usage(argc, argv);
     }
-  input = argv[optind];
+  for (int index = optind ; index < argc ; index++)
+    {
+      inputs.push_back(argv[index]);
+    }
   return 1;
 }
 
+/**
+ *   createMaps - creates the maps of one scan in all sizes and writes them
+ */
+void createMaps(string input, int method, bool writeMaps, bool writeRangeImage, bool writeRefelectanceJpeg, vector<struct size> &sizes, double d, int n, double r, bool cache)
+{
+  clock_t start, end;
+  vector<struct size>::iterator it;
+  char outputmap[1000];
+  char outputjpg[1000];
+  char cachefile[1000];
+  //the scan is only read if a map is not cached
+  PolarPointCloud *polarcloud = 0;
+  //creating the map and refelectance and range images
+  for (it = sizes.begin() ; it != sizes.end() ; it++ )
+    {
+      PanoramaMap *map = new PanoramaMap();
+      sprintf(cachefile, "%s_%dx%d_%d.pmc", input.c_str(), it->width, it->height, method);
+      if (cache && map->readCache(cachefile, input.c_str(), it->width, it->height, method, d, n, r))
+	{
+	  printf("Read map from cache: %s\n", cachefile);
+	}
+      else
+	{
+	  delete map;
+	  if (!polarcloud) polarcloud = new PolarPointCloud(input.c_str());
+	  printf("Creating Map %s %d %d\n", input.c_str(), it->width, it->height);
+	  start = clock();
+	  map = new PanoramaMap(polarcloud, it->width, it->height, method, d, n, r);
+	  end = clock();
+	  double time = ((double)((int) end - (int) start)) / CLOCKS_PER_SEC;
+	  printf("Finished creating map with time: %f\n", time);
+	  if (cache) map->writeCache(cachefile, input.c_str(), d, n, r);
+	}
+      if (writeMaps)
+	{
+	  sprintf(outputmap, "%s_%dx%d.map", input.c_str(), it->width, it->height);
+	  map->serialize(outputmap);
+	  printf("Wrote map to: %s\n", outputmap);
+	}
+      if (writeRangeImage)
+	{
+	  sprintf(outputjpg, "%s_%dx%d_Range_%d.jpg", input.c_str(), it->width, it->height, method);
+	  map->toJpeg(outputjpg, RANGE);
+	  printf("Wrote image to: %s\n", outputjpg);
+	}
+      if (writeRefelectanceJpeg)
+	{
+	  sprintf(outputjpg, "%s_%dx%d_Refelectance_%d.jpg", input.c_str(), it->width, it->height, method);
+	  map->toJpeg(outputjpg, REFELCTANCE);
+	  printf("Wrote image to: %s\n", outputjpg);
+	}
+      delete map;
+    }
+  delete polarcloud;
+}
+
 /**
  *   main - reads the inputs and create the panorama images and map file
  */
@@ -168,13 +241,15 @@ int main(int argc, char** argv)
   bool writeMaps = false;
   bool writeRangeImage = false;
   bool writeRefelectanceJpeg = false;
-  string input;
+  vector<string> inputs;
   vector<struct size> sizes;
   double d = 1;
   int n = 4;
   double r = 1;
+  bool cache = false;
+  int jobs = 1;
   
-  parseArgs(argc, argv, reader, method, projection, writeMaps, writeRangeImage, writeRefelectanceJpeg, input, sizes, d, n, r);
+  parseArgs(argc, argv, reader, method, projection, writeMaps, writeRangeImage, writeRefelectanceJpeg, inputs, sizes, d, n, r, cache, jobs);
   cout<<endl;
   cout<<"panoramacreator will proceed with the following parameters: "<<endl;
   cout<<"Reader: "<<reader<<endl;
@@ -182,41 +257,23 @@ int main(int argc, char** argv)
   cout<<"Maps: "<<writeMaps<<endl;  
   cout<<"RangeImage: "<<writeRangeImage<<endl;
   cout<<"RefelectanceImage: "<<writeRefelectanceJpeg<<endl;  
-  cout<<"Input: "<<input<<endl;
+  cout<<"Cache: "<<cache<<endl;
+  cout<<"Scans at the same time: "<<jobs<<endl;
+  cout<<"Input: "<<endl;
+  for (unsigned int i = 0 ; i < inputs.size() ; i++)
+    {
+      cout<<"    "<<inputs[i]<<endl;
+    }
   cout<<endl;
 
-  clock_t start, end;
-  vector<struct size>::iterator it;
-  char outputmap[1000];
-  char outputjpg[1000];
-  PolarPointCloud polarcloud(input.c_str());
-  //creating the map and refelectance and range images
-  for (it = sizes.begin() ; it != sizes.end() ; it++ )
+  //with one scan at a time the points of every scan are projected in
+  //parallel, otherwise the scans are
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(jobs)
+#endif
+  for (int i = 0 ; i < (int) inputs.size() ; i++)
     {
-      cout << "Creating Map " << it->width << " " << it->height << endl;
-      start = clock();
-      PanoramaMap map(&polarcloud, it->width, it->height, method, d, n, r);
-      end = clock();
-      double time = ((double)((int) end - (int) start)) / CLOCKS_PER_SEC;
-      cout << "Finished creating map with time: " << time << endl;
-      if (writeMaps)
-	{
-	  sprintf(outputmap, "%s_%dx%d.map", input.c_str(), it->width, it->height);
-	  map.serialize(outputmap);
-	  printf("Wrote map to: %s\n", outputmap);
-	}
-      if (writeRangeImage)
-	{
-	  sprintf(outputjpg, "%s_%dx%d_Range_%d.jpg", input.c_str(), it->width, it->height, method);
-	  map.toJpeg(outputjpg, RANGE);
-	  printf("Wrote image to: %s\n", outputjpg);
-	}
-      if (writeRefelectanceJpeg)
-	{
-	  sprintf(outputjpg, "%s_%dx%d_Refelectance_%d.jpg", input.c_str(), it->width, it->height, method);
-	  map.toJpeg(outputjpg, REFELCTANCE);
-	  printf("Wrote image to: %s\n", outputjpg);
-	}
+      createMaps(inputs[i], method, writeMaps, writeRangeImage, writeRefelectanceJpeg, sizes, d, n, r, cache);
     }
   return 0;
 }
@@ -166,15 +166,6 @@ int main(int argc, char** argv)
     }
   cout<<endl;
     
-  FeatureMatchSetGroup group;
-  for (int i = 0 ; i < (int) input.size() ; i++) 
-    {
-      cout << "Reading match set group: " << input[i] << endl;
-      FeatureMatchSetGroup group_2(input[i]);
-      group.matchsets.merge(group_2.matchsets);
-    }
-  cout << group.matchsets.size() << endl;
-
   vector<PanoramaMap*> maps;
   for (int index = 0 ; index < (int) smap.size() ; index++)
     {
@@ -184,7 +175,7 @@ int main(int argc, char** argv)
     }
   
   cout << "Checking..\n";
-  Register reg(&group, maps);
+  Register reg(NULL, maps);
   if (modemax != 0) reg.mode_maximum = modemax;
   if (d != 0) reg.d = d;
   if (t != 0) reg.t = t;
@@ -192,9 +183,15 @@ int main(int argc, char** argv)
   if (r != 0) reg.mind = r;
   if (a != 0) reg.mina = a / 360.0 * 2 * M_PI;
   
+  // the match sets are registered while they are read, one at a time
   cout << "Registering..\n";
   clock_t start = clock();
-  reg.registerScans();
+  for (int i = 0 ; i < (int) input.size() ; i++) 
+    {
+      cout << "Reading match set group: " << input[i] << endl;
+      FeatureMatchSetGroup::stream(input[i], reg);
+    }
+  reg.writeComponents();
   clock_t end = clock();
   double time = ((double)((int) end - (int) start)) / CLOCKS_PER_SEC;
   
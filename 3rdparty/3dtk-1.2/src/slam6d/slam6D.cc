@@ -32,6 +32,7 @@ using std::endl;
 using std::ifstream;
 
 #include "slam6d/scan.h"
+#include "slam6d/kdc.h"
 
 #include "slam6d/icp6Dapx.h"
 #include "slam6d/icp6Dsvd.h"
@@ -42,6 +43,8 @@ using std::ifstream;
 #include "slam6d/icp6Dlumeuler.h"
 #include "slam6d/icp6Dlumquat.h"
 #include "slam6d/icp6Dquatscale.h"
+#include "slam6d/icp6Dptplane.h"
+#include "slam6d/icp6Dfastquat.h"
 #include "slam6d/icp6D.h"
 #ifdef WITH_CUDA
 #include "slam6d/cuda/icp6Dcuda.h"
@@ -130,6 +133,9 @@ void usage(char* prog)
     << "           7 = Lu & Milios style, i.e., uncertainty based, with Euler angles" << endl
     << "           8 = Lu & Milios style, i.e., uncertainty based, with Quaternion" << endl
 		<< "           9 = unit quaternion with scale method by Horn" << endl
+    << "          10 = point to plane, small angle approximation" << endl
+    << "               (needs the k-d trees or ANNTree, -t 0, 1 or 2)" << endl
+    << "          11 = unit quaternion based method by Horn, SIMD accumulation" << endl
     << endl
     << bold << "  -A" << normal << " NR, " << bold << "--anim=" << normal << "NR   [default: first and last frame only]" << endl
     << "         if specified, use only every NR-th frame for animation" << endl
@@ -144,6 +150,26 @@ void usage(char* prog)
     << bold << "  --cache" << normal << endl
     << "         turns on cached k-d tree search" << endl
     << endl
+    << bold << "  --cachemem=" << normal << "NR" << endl
+    << "         limits the caches of the cached k-d trees (-t 1) to NR MB, the least" << endl
+    << "         recently used caches are dropped [default: no limit]" << endl
+    << endl
+    << bold << "  --scancache=" << normal << "DIR" << endl
+    << "         stores the reduced scans in DIR and reads them from there in later" << endl
+    << "         runs with the same scans and the same -f, -m, -M, -r, -O and --pyramid" << endl
+    << endl
+    << bold << "  --swapmem=" << normal << "NR" << endl
+    << "         keeps the reduced points and search trees of at most NR MB of scans in" << endl
+    << "         memory, the least recently used scans are swapped out to a file and" << endl
+    << "         read back when needed [default: no limit]" << endl
+    << endl
+    << bold << "  --swapfile=" << normal << "FILE" << endl
+    << "         the file scans are swapped out to (--swapmem) [default: a temporary file]" << endl
+    << endl
+    << bold << "  --concurrent" << normal << endl
+    << "         match all pairs of consecutive scans at the same time and chain" << endl
+    << "         the resulting transformations afterwards (not with --metascan)" << endl
+    << endl
     << bold << "  -d" << normal << " NR, " << bold << "--dist=" << normal << "NR   [default: 25]" << endl
     << "         sets the maximal point-to-point distance for matching with ICP to <NR> 'units'" << endl
     << "         (unit of scan data, e.g. cm)" << endl
@@ -224,6 +250,10 @@ void usage(char* prog)
     << "         Trust the pose file, do not extrapolate the last transformation." << endl
     << "         (just for testing purposes, or gps input.)" << endl
     << endl
+    << bold << "  --pyramid=" << normal << "NR   [default: 1]" << endl
+    << "         matches coarse-to-fine on NR reduction levels, the voxel size (-r)" << endl
+    << "         and the matching distance (-d) are doubled from level to level" << endl
+    << endl
     << bold << "  -q, --quiet" << normal << endl
     << "         Quiet mode. Suppress (most) messages" << endl
     << endl
@@ -233,6 +263,11 @@ void usage(char* prog)
     << bold << "  -r" << normal << " NR, " << bold << "--reduce=" << normal << "NR" << endl
     << "         turns on octree based point reduction (voxel size=<NR>)" << endl
     << endl
+    << bold << "  --refreshSLAM=" << normal << "NR" << endl
+    << "         Lu & Milios (-G 1) computes the constraints of a link from the point" << endl
+    << "         pairs only again if a scan moved by more than NR 'units', otherwise" << endl
+    << "         only the pose graph is linearized again" << endl
+    << endl
     << bold << "  -R" << normal << " NR, " << bold << "--random=" << normal << "NR" << endl
     << "         turns on randomized reduction, using about every <NR>-th point only" << endl
     << endl
@@ -286,6 +321,13 @@ void usage(char* prog)
  * @param algo specfies the used algorithm for rotation computation
  * @param lum6DAlgo specifies the used algorithm for global SLAM correction
  * @param loopsize defines the minimal loop size
+ * @param pyramid number of reduction levels for coarse-to-fine ICP
+ * @param concurrent match all scan pairs at the same time?
+ * @param cacheDir directory of the cache of reduced scans, empty for none
+ * @param cacheMem memory limit of the cached k-d trees in MB, 0 for none
+ * @param refreshSLAM movement before the LUM constraints are computed from points again
+ * @param swapMem memory limit of the resident scans in MB, 0 for none
+ * @param swapFile file the scans are swapped out to, empty for a temporary one
  * @return 0, if the parsing was successful. 1 otherwise
  */
 int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
@@ -294,7 +336,9 @@ int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
     bool &extrapolate_pose, bool &meta, int &algo, int &loopSlam6DAlgo, int &lum6DAlgo, int &anim,
     int &mni_lum, string &net, double &cldist, int &clpairs, int &loopsize,
     double &epsilonICP, double &epsilonSLAM,  int &nns_method, bool &exportPts, double &distLoop,
-    int &iterLoop, double &graphDist, int &octree, bool &cuda_enabled, reader_type &type)
+    int &iterLoop, double &graphDist, int &octree, bool &cuda_enabled, reader_type &type,
+    int &pyramid, bool &concurrent, string &cacheDir, int &cacheMem, double &refreshSLAM,
+    int &swapMem, string &swapFile)
 {
   int  c;
   // from unistd.h:
@@ -337,6 +381,13 @@ int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
     { "iterLoop",        required_argument,   0,  '1' }, // use the long format only
     { "graphDist",       required_argument,   0,  '3' }, // use the long format only
     { "cuda",            no_argument,         0,  'u' }, // cuda will be enabled
+    { "pyramid",         required_argument,   0,  '7' }, // use the long format only
+    { "concurrent",      no_argument,         0,  '0' }, // use the long format only
+    { "scancache",       required_argument,   0,  'k' }, // use the long format only
+    { "cachemem",        required_argument,   0,  'K' }, // use the long format only
+    { "refreshSLAM",     required_argument,   0,  'g' }, // use the long format only
+    { "swapmem",         required_argument,   0,  'w' }, // use the long format only
+    { "swapfile",        required_argument,   0,  'W' }, // use the long format only
     { 0,           0,   0,   0}                    // needed, cf. getopt.h
   };
 
@@ -346,7 +397,7 @@ int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
     {
       case 'a':
         algo = atoi(optarg);
-        if ((algo < 0) || (algo > 9)) {
+        if ((algo < 0) || (algo > 11)) {
           cerr << "Error: ICP Algorithm not available." << endl;
           exit(1);
         }	   
@@ -468,6 +519,28 @@ int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
       case 'u':
         cuda_enabled = true;
         break;
+      case '7':  // = --pyramid
+        pyramid = atoi(optarg);
+        if (pyramid < 1) { cerr << "Error: Need at least one reduction level.\n"; exit(1); }
+        break;
+      case '0':  // = --concurrent
+        concurrent = true;
+        break;
+      case 'k':  // = --scancache
+        cacheDir = optarg;
+        break;
+      case 'K':  // = --cachemem
+        cacheMem = atoi(optarg);
+        break;
+      case 'g':  // = --refreshSLAM
+        refreshSLAM = atof(optarg);
+        break;
+      case 'w':  // = --swapmem
+        swapMem = atoi(optarg);
+        break;
+      case 'W':  // = --swapfile
+        swapFile = optarg;
+        break;
       case '?':
         usage(argv[0]);
         return 1;
@@ -475,6 +548,12 @@ int parseArgs(int argc, char **argv, string &dir, double &red, int &rand,
         abort ();
     }
 
+  // the normals of point to plane matching need the k closest points
+  if (algo == 10 && nns_method != simpleKD && nns_method != cachedKD && nns_method != ANNTree) {
+    cerr << "Error: Point to plane ICP (-a 10) needs a k-d tree or ANNTree (-t 0, 1 or 2)." << endl;
+    exit(1);
+  }
+
   if (optind != argc-1) {
     cerr << "\n*** Directory missing ***" << endl;
     usage(argv[0]);
@@ -706,18 +785,31 @@ int main(int argc, char **argv)
   int octree       = 0;  // employ randomized octree reduction?
   bool cuda_enabled    = false;
   reader_type type    = UOS;
+  int pyramid       = 1;  // number of reduction levels for coarse-to-fine ICP
+  bool concurrent   = false;  // match all scan pairs at the same time?
+  string cacheDir   = "";  // cache of reduced scans
+  int cacheMem      = 0;  // memory limit of the cached k-d trees in MB
+  double refreshSLAM = -1.0;  // LUM constraints from points in every iteration
+  int swapMem       = 0;  // memory limit of the resident scans in MB
+  string swapFile   = "";  // file the scans are swapped out to
 
   parseArgs(argc, argv, dir, red, rand, mdm, mdml, mdmll, mni, start, end,
       maxDist, minDist, quiet, veryQuiet, eP, meta, algo, loopSlam6DAlgo, lum6DAlgo, anim,
       mni_lum, net, cldist, clpairs, loopsize, epsilonICP, epsilonSLAM,
-      nns_method, exportPts, distLoop, iterLoop, graphDist, octree, cuda_enabled, type);
+      nns_method, exportPts, distLoop, iterLoop, graphDist, octree, cuda_enabled, type,
+      pyramid, concurrent, cacheDir, cacheMem, refreshSLAM, swapMem, swapFile);
 
   cout << "slam6D will proceed with the following parameters:" << endl;
   //@@@ to do :-)
 
   // Get Scans
+  Scan::cacheDir = cacheDir;
+  KDtree_cache::maxCacheMemory = (size_t)cacheMem * 1024 * 1024;
+  Scan::maxResidentMemory = (size_t)swapMem * 1024 * 1024;
+  Scan::swapFileName = swapFile;
   Scan::readScansRedSearch(type, start, end, dir,
-					  maxDist, minDist, red, octree, nns_method, cuda_enabled, true);
+					  maxDist, minDist, red, octree, nns_method, cuda_enabled, true,
+					  pyramid);
   
   icp6Dminimizer *my_icp6Dminimizer = 0;
   switch (algo) {
@@ -748,6 +840,12 @@ int main(int argc, char **argv)
     case 9 :
 			my_icp6Dminimizer = new icp6D_QUAT_SCALE(quiet);
 			break;
+    case 10 :
+      my_icp6Dminimizer = new icp6D_PTPLANE(quiet);
+      break;
+    case 11 :
+      my_icp6Dminimizer = new icp6D_FASTQUAT(quiet);
+      break;
   }
 
   // match the scans and print the time used
@@ -771,6 +869,8 @@ int main(int argc, char **argv)
     {
       my_icp->set_cad_matching (true);
     }
+    if (my_icp) my_icp->set_pyramid(pyramid > 1);
+    if (my_icp && !cuda_enabled) my_icp->set_concurrent(concurrent);
 
     if (my_icp) my_icp->doICP(Scan::allScans);
     delete my_icp;
@@ -788,18 +888,24 @@ int main(int argc, char **argv)
       my_icp = new icp6D(my_icp6Dminimizer, mdm, mni, quiet, meta, rand, eP,
 					anim, epsilonICP, nns_method, cuda_enabled);
     }
+    my_icp->set_pyramid(pyramid > 1);
+    if (!cuda_enabled) my_icp->set_concurrent(concurrent);
     my_icp->doICP(Scan::allScans);
-    graphSlam6D *my_graphSlam6D = new lum6DEuler(my_icp6Dminimizer, mdm, mdml, mni, quiet, meta,
+    lum6DEuler *my_graphSlam6D = new lum6DEuler(my_icp6Dminimizer, mdm, mdml, mni, quiet, meta,
         rand, eP, anim, epsilonICP, nns_method, epsilonSLAM);
+    my_graphSlam6D->set_refreshDist(refreshSLAM);
     my_graphSlam6D->matchGraph6Dautomatic(Scan::allScans, mni_lum, clpairs, loopsize);
     //!!!!!!!!!!!!!!!!!!!!!!!!		  
   } else {
     graphSlam6D *my_graphSlam6D = 0;
     switch (lum6DAlgo) {
-      case 1 :
-        my_graphSlam6D = new lum6DEuler(my_icp6Dminimizer, mdm, mdml, mni, quiet, meta, rand, eP,
+      case 1 : {
+        lum6DEuler *my_lum6D = new lum6DEuler(my_icp6Dminimizer, mdm, mdml, mni, quiet, meta, rand, eP,
             anim, epsilonICP, nns_method, epsilonSLAM);
+        my_lum6D->set_refreshDist(refreshSLAM);
+        my_graphSlam6D = my_lum6D;
         break;
+      }
       case 2 :
         my_graphSlam6D = new lum6DQuat(my_icp6Dminimizer, mdm, mdml, mni, quiet, meta, rand, eP,
             anim, epsilonICP, nns_method, epsilonSLAM);
@@ -835,6 +941,8 @@ int main(int argc, char **argv)
         my_icp = new icp6D(my_icp6Dminimizer, mdm, mni, quiet, meta, rand, eP,
             anim, epsilonICP, nns_method);
       }
+      my_icp->set_pyramid(pyramid > 1);
+      if (!cuda_enabled) my_icp->set_concurrent(concurrent);
       my_icp->doICP(Scan::allScans);
 
       Graph* structure;
@@ -859,6 +967,7 @@ int main(int argc, char **argv)
           my_icp = new icp6D(my_icp6Dminimizer, mdm, mni, quiet, meta, rand, eP,
 					    anim, epsilonICP, nns_method);
         }
+        my_icp->set_pyramid(pyramid > 1);
 
         loopSlam6D *my_loopSlam6D = 0;
         switch(loopSlam6DAlgo) {
@@ -909,11 +1018,13 @@ int main(int argc, char **argv)
     cout << "Export all 3D Points to file \"points.pts\"" << endl;
     ofstream redptsout("points.pts");
     for(unsigned int i = 0; i < Scan::allScans.size(); i++) {
+      Scan::acquire(Scan::allScans[i]);
       for (int j = 0; j < Scan::allScans[i]->get_points_red_size(); j++) {
         redptsout << Scan::allScans[i]->get_points_red()[j][0] << " "
           << Scan::allScans[i]->get_points_red()[j][1] << " "
           << Scan::allScans[i]->get_points_red()[j][2] << endl;
       }
+      Scan::release(Scan::allScans[i]);
     }
     redptsout.close();
     redptsout.clear();
@@ -11,6 +11,7 @@
 #include <ostream>
 
 #include "common.h"
+#include <reader/PointBuffer.h>
 
 //==============================================================================
 // Helpers.
@@ -41,6 +42,12 @@ inline std::ostream& operator<<(std::ostream& o, const Pose& p){
 class PcReader {
 protected:
     std::vector<Pose> m_Poses;
+    std::vector<PointBuffer> m_Buffers;
+
+    // Loads the point clouds and poses into m_Buffers and m_Poses.
+    void load(const std::string &path,
+              const int &start, const int &end, const int &width,
+              const std::string &root, const std::string &ext, const std::string &poseExt);
 
 public:
     // Constants.
@@ -58,10 +65,15 @@ public:
               const int &start = 0, const int &end = 0, const int &width = 3,
               const std::string &root = "scan", const std::string &ext = ".3d", const std::string &poseExt = ".pose") = 0;
 
+    // Uses point clouds that are already loaded, e.g., by another reader.
+    virtual void read(const std::vector<PointBuffer> &buffers, const std::vector<Pose> &poses) = 0;
+
     virtual void run() = 0;
 
     // Getters and setters.
     std::vector<Pose> getPoses();
+
+    std::vector<PointBuffer> getBuffers();
 };
 
 #endif // _PC_READER_H
@@ -53,6 +53,8 @@ public:
               const int &start = 0, const int &end = 0, const int &width = 3,
               const std::string &root = "scan", const std::string &ext = ".3d", const std::string &poseExt = ".pose");
 
+    void read(const std::vector<PointBuffer> &buffers, const std::vector<Pose> &poses);
+
     void run();
 
     void printPc(const std::string &filePath);
@@ -0,0 +1,55 @@
+#ifndef _POINT_BUFFER_H
+#define _POINT_BUFFER_H
+
+//==============================================================================
+// Includes.
+//==============================================================================
+// C++ includes.
+#include <string>
+
+// PCL includes.
+#include <pcl/point_cloud.h>
+#include <pcl/point_types.h>
+
+//==============================================================================
+// Class declaration.
+//==============================================================================
+// The points of one scan, loaded once and shared by all backends. Copies of
+// a buffer share the same reference counted point cloud, which doubles as
+// the PCL view of the data. 3DTK scans are built straight from the raw
+// coordinates, see getData() and getStride().
+class PointBuffer
+{
+private:
+    // Private fields.
+    pcl::PointCloud<pcl::PointXYZ>::Ptr m_Cloud;
+
+public:
+    // Constants.
+    static const unsigned int STRIDE = sizeof(pcl::PointXYZ) / sizeof(float);
+
+    // Constructors.
+    PointBuffer();
+
+    PointBuffer(const pcl::PointCloud<pcl::PointXYZ>::Ptr &cloud);
+
+    PointBuffer(const PointBuffer &other);
+
+    ~PointBuffer();
+
+    // Public methods.
+    static PointBuffer load(const std::string &filePath);
+
+    // Getters and setters.
+    pcl::PointCloud<pcl::PointXYZ>::Ptr getCloud() const;
+
+    const float* getData() const;
+
+    unsigned int getSize() const;
+
+    unsigned int getStride() const;
+
+    long getUseCount() const;
+};
+
+#endif // _POINT_BUFFER_H
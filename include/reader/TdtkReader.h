@@ -7,11 +7,24 @@
 //==============================================================================
 #include <reader/PcReader.h>
 
+class icp6D;
+
 //==============================================================================
 // Class declaration.
 //==============================================================================
 class TdtkReader : public PcReader
 {
+private:
+    // Directory of the 3DTK cache of reduced scans, empty for none.
+    std::string m_CacheDir;
+
+    // Memory for the reduced points and search trees of the scans in MB,
+    // the rest is swapped out to a file. 0 for no limit.
+    int m_SwapMemory;
+
+    // ICP minimizer, numbered like the -a option of slam6D.
+    int m_Algorithm;
+
 public:
     // Constructors.
     TdtkReader();
@@ -25,7 +38,19 @@ public:
               const int &start = 0, const int &end = 0, const int &width = 3,
               const std::string &root = "scan", const std::string &ext = ".3d", const std::string &poseExt = ".pose");
 
+    void read(const std::vector<PointBuffer> &buffers, const std::vector<Pose> &poses);
+
     void run();
+
+    // Mean point to point error over all consecutive pairs of the read scans.
+    static double sequenceError(const double &maxDist, icp6D &icp);
+
+    // Getters and setters.
+    void setCacheDir(const std::string &cacheDir);
+
+    void setSwapMemory(const int &swapMemory);
+
+    void setAlgorithm(const int &algorithm);
 };
 
 #endif
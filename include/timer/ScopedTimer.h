@@ -0,0 +1,42 @@
+#ifndef _SCOPED_TIMER_H
+#define _SCOPED_TIMER_H
+
+//==============================================================================
+// Includes.
+//==============================================================================
+// User includes.
+#include <timer/Timer.h>
+
+// C++ includes.
+#include <string>
+
+//==============================================================================
+// Class definition.
+//==============================================================================
+// Times its own lifetime as a named phase and adds it to the TimingSink.
+// Scopes nest per thread, the phase of a scope opened within another one
+// is named "outer/inner".
+class ScopedTimer {
+private:
+    Timer m_Timer;
+    std::string m_Path;
+    bool m_Stopped;
+
+    // Not copyable, a scope is timed once.
+    ScopedTimer(const ScopedTimer &other);
+    ScopedTimer &operator=(const ScopedTimer &other);
+
+public:
+    // Constructors.
+    ScopedTimer(const std::string &name);
+    ~ScopedTimer();
+
+    // Ends the phase before the end of the scope. Scopes nested in it
+    // have to be stopped before.
+    void stop();
+
+    // The phase name within the scopes open in the calling thread.
+    static std::string path(const std::string &name);
+};
+
+#endif // _SCOPED_TIMER_H
@@ -5,22 +5,34 @@
 // Includes.
 //==============================================================================
 // C++ includes.
-#include <iostream>
-#include <ostream>
-#include <vector>
-
-// C includes.
-#include <time.h>
-#include <unistd.h>
-#include <sys/time.h>
+#include <chrono>
+#include <string>
 
 //==============================================================================
 // Class definition.
 //==============================================================================
+// Measures the time between records with three clocks: the monotonic wall
+// clock, the CPU time of the process, which sums up all threads, and the
+// CPU time of the calling thread. Only the first, the second last and the
+// last record are kept. A timer is meant to be used by one thread, the
+// thread time is wrong if it records in another thread than it started.
 class Timer {
 private:
-    std::vector<clock_t> m_CpuTimes;
-    std::vector<timeval> m_RealTimes;
+    struct Sample {
+        std::chrono::steady_clock::time_point real;
+        double cpu;     // ms of CPU time of the process.
+        double thread;  // ms of CPU time of the calling thread.
+    };
+
+    Sample m_Start;
+    Sample m_Previous;
+    Sample m_Last;
+    int m_Records;
+
+    static Sample now();
+
+    // The samples an interval is measured between.
+    const Sample &reference(const bool &sinceStart) const;
 
 public:
     // Constructors.
@@ -33,12 +45,19 @@ public:
     void reset();
     void record();
 
+    // Prints the times and adds the real, CPU and thread time to the
+    // phase msg of the TimingSink, within the open ScopedTimers.
     void printTime(const std::string &msg,
                    const bool &sinceStart = false);
 
-    // Getters and setters.
-    long getCpuTime(const bool &sinceStart = false);
-    long getRealTime(const bool &sinceStart = false);
+    // Getters and setters, in milliseconds.
+    double getRealMs(const bool &sinceStart = false) const;
+    double getCpuMs(const bool &sinceStart = false) const;
+    double getThreadMs(const bool &sinceStart = false) const;
+
+    long getCpuTime(const bool &sinceStart = false) const;
+    long getRealTime(const bool &sinceStart = false) const;
+    long getThreadTime(const bool &sinceStart = false) const;
 };
 
 #endif // _TIMER_H
@@ -0,0 +1,53 @@
+#ifndef _TIMING_SINK_H
+#define _TIMING_SINK_H
+
+//==============================================================================
+// Includes.
+//==============================================================================
+// C++ includes.
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//==============================================================================
+// Class definition.
+//==============================================================================
+// Collects the times of the phases of all readers and benchmarks, so the
+// backends report the same breakdown. A phase that runs several times gets
+// the minimum, mean and maximum of its times.
+class TimingSink {
+private:
+    struct Stats {
+        double min, max, sum;
+    };
+
+    struct Phase {
+        std::string name;
+        int runs;
+        Stats real, cpu, thread;
+    };
+
+    // In the order the phases were first added.
+    std::vector<Phase> m_Phases;
+    mutable std::mutex m_Mutex;
+
+    // Constructors.
+    TimingSink();
+    TimingSink(const TimingSink &other);
+
+public:
+    ~TimingSink();
+
+    static TimingSink &instance();
+
+    // Methods, times in milliseconds.
+    void add(const std::string &name,
+             const double &realMs, const double &cpuMs, const double &threadMs);
+
+    void clear();
+
+    void print(std::ostream &out) const;
+};
+
+#endif // _TIMING_SINK_H
@@ -0,0 +1,125 @@
+//==============================================================================
+// Includes.
+//==============================================================================
+// User includes.
+#include <common.h>
+#include <reader/TdtkReader.h>
+#include <timer/Timer.h>
+
+// C++ includes.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+using namespace std;
+
+#define MAX_OPENMP_NUM_THREADS  8
+#define OPENMP_NUM_THREADS      8
+
+// 3DTK includes.
+#include "slam6d/scan.h"
+#include "slam6d/icp6D.h"
+#include "slam6d/icp6Dquat.h"
+#include "slam6d/icp6Dptplane.h"
+
+// PCL includes.
+#include <pcl/console/parse.h>
+
+//==============================================================================
+// Helpers.
+//==============================================================================
+// Matches every scan against its predecessor like icp6D::doICP and
+// returns the number of ICP iterations of all pairs.
+static int matchSequence(icp6D &icp)
+{
+    int iterations = 0;
+    for (size_t it = 1; it < Scan::allScans.size(); ++it) {
+        Scan::allScans[it]->mergeCoordinatesWithRoboterPosition(Scan::allScans[it - 1]);
+        iterations += icp.match(Scan::allScans[it - 1], Scan::allScans[it]);
+    }
+
+    return iterations;
+}
+
+//==============================================================================
+// Main.
+//==============================================================================
+int main(int argc, char* argv[]) {
+    // Parse arguments.
+    string path = "/media/Mobile/Scans/lum";
+    pcl::console::parse_argument(argc, argv, "-p", path);
+
+    int start = 0;
+    pcl::console::parse_argument(argc, argv, "-s", start);
+
+    int end = 3;
+    pcl::console::parse_argument(argc, argv, "-e", end);
+
+    double red = 10.0;
+    pcl::console::parse_argument(argc, argv, "-r", red);
+
+    double maxDist = 25.0;
+    pcl::console::parse_argument(argc, argv, "-d", maxDist);
+
+    int iterations = 50;
+    pcl::console::parse_argument(argc, argv, "-i", iterations);
+
+    if (*path.rbegin() != '/') {
+        path += '/';
+    }
+
+    Scan::readScansRedSearch(UOS, start, end, path, -1, -1, red, 0,
+                             simpleKD, false, false);
+
+    if (Scan::allScans.size() < 2) {
+        cerr << "Need at least two scans..." << endl;
+        return 1;
+    }
+
+    // Remember the initial poses, both runs start from them.
+    vector<vector<double> > initial;
+    for (size_t it = 0; it < Scan::allScans.size(); ++it) {
+        const double *mat = Scan::allScans[it]->get_transMat();
+        initial.push_back(vector<double>(mat, mat + 16));
+    }
+
+    // The normals are computed once per scan, time them on their own.
+    Timer normalTimer;
+    normalTimer.start();
+    for (size_t it = 0; it < Scan::allScans.size(); ++it) {
+        Scan::allScans[it]->calcNormals();
+    }
+    normalTimer.record();
+    normalTimer.printTime("Normals");
+
+    icp6Dminimizer *minimizers[2] = {new icp6D_QUAT(true), new icp6D_PTPLANE(true)};
+    string names[2] = {"Point to point ICP", "Point to plane ICP"};
+
+    for (int run = 0; run < 2; ++run) {
+        for (size_t it = 0; it < Scan::allScans.size(); ++it) {
+            double mat[16];
+            memcpy(mat, &initial[it][0], sizeof(mat));
+            Scan::allScans[it]->transformToMatrix(mat, Scan::INVALID);
+        }
+
+        icp6D icp(minimizers[run], maxDist, iterations, true);
+
+        Timer timer;
+        timer.start();
+        int done = matchSequence(icp);
+        timer.record();
+
+        timer.printTime(names[run]);
+        cerr << "\t" << "ITERATIONS\t" << done << endl;
+        cerr << "\t" << "ERROR\t" << TdtkReader::sequenceError(maxDist, icp) << endl;
+    }
+
+    while (!Scan::allScans.empty()) {
+        delete Scan::allScans[0];
+    }
+    delete minimizers[0];
+    delete minimizers[1];
+
+    cout << "Program end..." << endl;
+    return 0;
+}
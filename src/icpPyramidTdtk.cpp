@@ -0,0 +1,102 @@
+//==============================================================================
+// Includes.
+//==============================================================================
+// User includes.
+#include <common.h>
+#include <reader/TdtkReader.h>
+#include <timer/Timer.h>
+
+// C++ includes.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+using namespace std;
+
+#define MAX_OPENMP_NUM_THREADS  8
+#define OPENMP_NUM_THREADS      8
+
+// 3DTK includes.
+#include "slam6d/scan.h"
+#include "slam6d/icp6D.h"
+#include "slam6d/icp6Dquat.h"
+
+// PCL includes.
+#include <pcl/console/parse.h>
+
+//==============================================================================
+// Main.
+//==============================================================================
+int main(int argc, char* argv[]) {
+    // Parse arguments.
+    string path = "/media/Mobile/Scans/lum";
+    pcl::console::parse_argument(argc, argv, "-p", path);
+
+    int start = 0;
+    pcl::console::parse_argument(argc, argv, "-s", start);
+
+    int end = 3;
+    pcl::console::parse_argument(argc, argv, "-e", end);
+
+    double red = 10.0;
+    pcl::console::parse_argument(argc, argv, "-r", red);
+
+    int levels = 3;
+    pcl::console::parse_argument(argc, argv, "-l", levels);
+
+    double maxDist = 25.0;
+    pcl::console::parse_argument(argc, argv, "-d", maxDist);
+
+    int iterations = 50;
+    pcl::console::parse_argument(argc, argv, "-i", iterations);
+
+    if (*path.rbegin() != '/') {
+        path += '/';
+    }
+
+    Scan::readScansRedSearch(UOS, start, end, path, -1, -1, red, 0,
+                             simpleKD, false, false, levels);
+
+    if (Scan::allScans.size() < 2) {
+        cerr << "Need at least two scans..." << endl;
+        return 1;
+    }
+
+    // Remember the initial poses, both runs start from them.
+    vector<vector<double> > initial;
+    for (size_t it = 0; it < Scan::allScans.size(); ++it) {
+        const double *mat = Scan::allScans[it]->get_transMat();
+        initial.push_back(vector<double>(mat, mat + 16));
+    }
+
+    icp6Dminimizer *minimizer = new icp6D_QUAT(true);
+
+    for (int pyramid = 0; pyramid <= 1; ++pyramid) {
+        for (size_t it = 0; it < Scan::allScans.size(); ++it) {
+            double mat[16];
+            memcpy(mat, &initial[it][0], sizeof(mat));
+            Scan::allScans[it]->transformToMatrix(mat, Scan::INVALID);
+        }
+
+        icp6D icp(minimizer, maxDist, iterations, true);
+        icp.set_pyramid(pyramid == 1);
+
+        Timer timer;
+        timer.start();
+        icp.doICP(Scan::allScans);
+        timer.record();
+
+        string name = pyramid ? "Pyramid ICP (" + int2String(levels, 1) + " levels)"
+                              : "Single level ICP";
+        timer.printTime(name);
+        cerr << "\t" << "ERROR\t" << TdtkReader::sequenceError(maxDist, icp) << endl;
+    }
+
+    while (!Scan::allScans.empty()) {
+        delete Scan::allScans[0];
+    }
+    delete minimizer;
+
+    cout << "Program end..." << endl;
+    return 0;
+}
@@ -0,0 +1,173 @@
+//==============================================================================
+// Includes.
+//==============================================================================
+// User includes.
+#include <common.h>
+#include <timer/Timer.h>
+
+// C++ includes.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstring>
+using namespace std;
+
+#define MAX_OPENMP_NUM_THREADS  8
+#define OPENMP_NUM_THREADS      8
+
+// 3DTK includes.
+#include "slam6d/scan.h"
+#include "slam6d/icp6D.h"
+#include "slam6d/icp6Dquat.h"
+#include "slam6d/lum6Deuler.h"
+
+// PCL includes.
+#include <pcl/console/parse.h>
+
+//==============================================================================
+// Helpers.
+//==============================================================================
+// Mean point to point error over all links of the graph.
+static double graphError(Graph &graph, const double &maxDist, icp6D &icp)
+{
+    double error = 0.0;
+    for (int it = 0; it < graph.getNrLinks(); ++it) {
+        error += icp.Point_Point_Error(Scan::allScans[graph.getLink(it, 0)],
+                                       Scan::allScans[graph.getLink(it, 1)], maxDist);
+    }
+
+    return error / graph.getNrLinks();
+}
+
+// Sets the poses of all scans.
+static void setPoses(const vector<vector<double> > &poses)
+{
+    for (size_t it = 0; it < Scan::allScans.size(); ++it) {
+        double mat[16];
+        memcpy(mat, &poses[it][0], sizeof(mat));
+        Scan::allScans[it]->transformToMatrix(mat, Scan::INVALID);
+    }
+}
+
+// Returns the poses of all scans.
+static vector<vector<double> > getPoses()
+{
+    vector<vector<double> > poses;
+    for (size_t it = 0; it < Scan::allScans.size(); ++it) {
+        const double *mat = Scan::allScans[it]->get_transMat();
+        poses.push_back(vector<double>(mat, mat + 16));
+    }
+
+    return poses;
+}
+
+// Largest difference in position and in rotation angle of two sets of poses.
+static void poseDifference(const vector<vector<double> > &a, const vector<vector<double> > &b,
+                           double &position, double &angle)
+{
+    position = angle = 0.0;
+    for (size_t it = 0; it < a.size(); ++it) {
+        double d[3] = {a[it][12] - b[it][12], a[it][13] - b[it][13], a[it][14] - b[it][14]};
+        position = max(position, sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]));
+
+        // Trace of the relative rotation.
+        double trace = 0.0;
+        for (int i = 0; i < 3; ++i) {
+            for (int j = 0; j < 3; ++j) {
+                trace += a[it][i + 4 * j] * b[it][i + 4 * j];
+            }
+        }
+        angle = max(angle, acos(max(-1.0, min(1.0, 0.5 * (trace - 1.0)))));
+    }
+}
+
+//==============================================================================
+// Main.
+//==============================================================================
+// Runs Lu and Milios with constraints from the point pairs in every
+// iteration and in the pose graph only mode from the same ICP result.
+int main(int argc, char* argv[]) {
+    // Parse arguments.
+    string path = "/media/Mobile/Scans/lum";
+    pcl::console::parse_argument(argc, argv, "-p", path);
+
+    int start = 0;
+    pcl::console::parse_argument(argc, argv, "-s", start);
+
+    int end = 3;
+    pcl::console::parse_argument(argc, argv, "-e", end);
+
+    double red = 10.0;
+    pcl::console::parse_argument(argc, argv, "-r", red);
+
+    double maxDist = 25.0;
+    pcl::console::parse_argument(argc, argv, "-d", maxDist);
+
+    int iterations = 10;
+    pcl::console::parse_argument(argc, argv, "-i", iterations);
+
+    int clpairs = 6;
+    pcl::console::parse_argument(argc, argv, "-c", clpairs);
+
+    double refresh = 5.0;
+    pcl::console::parse_argument(argc, argv, "-f", refresh);
+
+    if (*path.rbegin() != '/') {
+        path += '/';
+    }
+
+    Scan::readScansRedSearch(UOS, start, end, path, -1, -1, red, 0,
+                             simpleKD, false, false);
+
+    if (Scan::allScans.size() < 2) {
+        cerr << "Need at least two scans..." << endl;
+        return 1;
+    }
+
+    // Both runs start from the same ICP result and graph.
+    icp6Dminimizer *minimizer = new icp6D_QUAT(true);
+    icp6D icp(minimizer, maxDist, 50, true);
+    icp.doICP(Scan::allScans);
+    vector<vector<double> > initial = getPoses();
+
+    lum6DEuler graphLum(minimizer, maxDist, maxDist, 50, true);
+    Graph *graph = graphLum.computeGraph6Dautomatic(Scan::allScans, clpairs);
+    cerr << "\t" << "LINKS\t" << graph->getNrLinks() << endl;
+
+    double refreshes[2] = {-1.0, refresh};
+    string names[2] = {"LUM with point pairs", "LUM pose graph only"};
+    vector<vector<double> > result[2];
+
+    for (int run = 0; run < 2; ++run) {
+        setPoses(initial);
+
+        lum6DEuler lum(minimizer, maxDist, maxDist, 50, true);
+        lum.set_refreshDist(refreshes[run]);
+
+        Timer timer;
+        timer.start();
+        double shift = lum.doGraphSlam6D(*graph, Scan::allScans, iterations);
+        timer.record();
+
+        timer.printTime(names[run]);
+        cerr << "\t" << "SHIFT\t" << shift << endl;
+        cerr << "\t" << "ERROR\t" << graphError(*graph, maxDist, icp) << endl;
+        result[run] = getPoses();
+    }
+
+    double position, angle;
+    poseDifference(result[0], result[1], position, angle);
+    cerr << "Pose difference of the modes" << endl;
+    cerr << "\t" << "POSITION\t" << position << endl;
+    cerr << "\t" << "ANGLE\t" << angle << endl;
+
+    delete graph;
+    while (!Scan::allScans.empty()) {
+        delete Scan::allScans[0];
+    }
+    delete minimizer;
+
+    cout << "Program end..." << endl;
+    return 0;
+}
@@ -0,0 +1,73 @@
+//==============================================================================
+// Includes.
+//==============================================================================
+// User includes.
+#include <reader/PclReader.h>
+#include <reader/TdtkReader.h>
+#include <timer/Timer.h>
+#include <timer/TimingSink.h>
+
+// C++ includes.
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// Pcl includes.
+#include <pcl/console/parse.h>
+
+//==============================================================================
+// Main.
+//==============================================================================
+// Runs the PCL and the 3DTK Lu and Milios implementation on the same scans,
+// which are loaded only once and shared by both backends. With -n both run
+// repeatedly from the loaded poses and the summary gives the minimum, mean
+// and maximum time of every phase.
+int main(int argc, char* argv[]) {
+    Timer timer;
+    timer.start();
+
+    // Parse arguments.
+    string path = "/media/Mobile/Scans/lum";
+    pcl::console::parse_argument(argc, argv, "-p", path);
+    cout << "Path: " << path << "..." << endl;
+
+    int start = 0;
+    pcl::console::parse_argument(argc, argv, "-s", start);
+    cout << "Start: " << start << "..." << endl;
+
+    int end = 3;
+    pcl::console::parse_argument(argc, argv, "-e", end);
+    cout << "End: " << end << "..." << endl;
+
+    int runs = 1;
+    pcl::console::parse_argument(argc, argv, "-n", runs);
+
+    // Load the scans once.
+    PclReader pclReader(CORRESP_EST);
+    pclReader.read(path, start, end);
+
+    vector<PointBuffer> buffers = pclReader.getBuffers();
+    vector<Pose> poses = pclReader.getPoses();
+
+    timer.record();
+    timer.printTime("Shared load");
+
+    TdtkReader tdtkReader;
+    for (int run = 0; run < runs; ++run) {
+        // PCL overwrites the poses and 3DTK deletes its scans, both start
+        // again from the shared buffers.
+        pclReader.read(buffers, poses);
+        pclReader.run();
+        timer.record();
+        timer.printTime("PCL LUM");
+
+        tdtkReader.read(buffers, poses);
+        tdtkReader.run();
+        timer.record();
+        timer.printTime("3DTK LUM");
+    }
+
+    TimingSink::instance().print(cerr);
+
+    cout << "Program end..." << endl;
+}
@@ -4,6 +4,7 @@
 // User includes.
 #include <reader/PclReader.h>
 #include <timer/Timer.h>
+#include <timer/TimingSink.h>
 
 // C++ includes.
 #include <iostream>
@@ -51,6 +52,7 @@ int main(int argc, char* argv[]) {
 
     timer.record();
     timer.printTime("Total time");
+    TimingSink::instance().print(cerr);
 
     cout << "Program end..." << endl;
 }
@@ -3,19 +3,40 @@
 //==============================================================================
 // User includes.
 #include <reader/TdtkReader.h>
+#include <timer/TimingSink.h>
 
 // C++ includes.
 #include <iostream>
+#include <string>
 using namespace std;
 
+// PCL includes.
+#include <pcl/console/parse.h>
+
 //==============================================================================
 // Main.
 //==============================================================================
 int main(int argc, char* argv[]) {
+    // Reduced scans are reused from this directory in later runs.
+    string cacheDir = "";
+    pcl::console::parse_argument(argc, argv, "-c", cacheDir);
+
+    // Memory for the scans in MB, the least recently used ones are swapped
+    // out to a temporary file beyond it. 0 for no limit.
+    int swapMemory = 0;
+    pcl::console::parse_argument(argc, argv, "-m", swapMemory);
+
+    // ICP minimizer, numbered like the -a option of slam6D.
+    int algorithm = 7;
+    pcl::console::parse_argument(argc, argv, "-a", algorithm);
+
     TdtkReader reader;
+    reader.setCacheDir(cacheDir);
+    reader.setSwapMemory(swapMemory);
+    reader.setAlgorithm(algorithm);
     reader.read("/home/cprodescu/Dropbox/PhotosRemus/lum/", 0, 3);
     reader.run();
+    TimingSink::instance().print(cerr);
 
     cout << "Program end..." << endl;
 }
-
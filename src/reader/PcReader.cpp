@@ -7,6 +7,8 @@
 #include <common.h>
 
 // C++ includes.
+#include <iostream>
+#include <fstream>
 #include <string>
 using namespace std;
 
@@ -21,17 +23,89 @@ using namespace std;
 PcReader::PcReader()
 {
     this->m_Poses.clear();
+    this->m_Buffers.clear();
 }
 
 PcReader::PcReader(const PcReader &other)
 {
     this->m_Poses = other.m_Poses;
+    this->m_Buffers = other.m_Buffers;
 }
 
 PcReader::~PcReader()
 {}
 
+// Protected methods.
+void PcReader::load(const string &path,
+                    const int &start, const int &end, const int &width,
+                    const string &root, const string &ext, const string &poseExt)
+{
+    cout << "Reading scans..." << endl;
+    assert(start >= 0);
+    assert(start <= end);
+    assert(width > 0);
+
+    // Make sure that we first clear all the previously loaded point clouds.
+    this->m_Buffers.clear();
+    this->m_Poses.clear();
+
+    // Go from start to end and read point clouds.
+    for (int it = start; it <= end; ++it)
+    {
+        string fileRoot = root + int2String(it, width);
+        string fullPath = path;
+
+        if (*path.rbegin() != this->fileSep)
+        {
+            fullPath += this->fileSep;
+        }
+
+        fullPath += fileRoot;
+
+        string pcFilePath = fullPath + ext;
+        string poseFilePath = fullPath + poseExt;
+
+        cout << "Loading " << pcFilePath << "..." << endl;
+
+        // Read in the point cloud.
+        PointBuffer buffer = PointBuffer::load(pcFilePath);
+
+        // Open the stream to the pose file.
+        ifstream poseFile(poseFilePath.c_str());
+        if (poseFile.is_open() == false) {
+            die("Failed to open file \"" + poseFilePath + "\"...");
+        }
+
+        // Read in the pose.
+        Pose pose;
+        poseFile >> pose.x >> pose.y >> pose.z;
+        poseFile >> pose.roll >> pose.pitch >> pose.yaw;
+
+        // Convert from degrees to radians.
+        pose.roll = deg2Rad(pose.roll);
+        pose.pitch = deg2Rad(pose.pitch);
+        pose.yaw = deg2Rad(pose.yaw);
+
+        // Add the point cloud and pose to the list.
+        this->m_Buffers.push_back(buffer);
+        this->m_Poses.push_back(pose);
+
+        poseFile.close();
+
+        cout << "Loaded point cloud with " << buffer.getSize() << " points @pose("
+             << pose.x << ", " << pose.y << ", " << pose.z << "; "
+             << pose.roll << ", " << pose.pitch << ", " << pose.yaw
+             << ")..." << endl;
+    }
+}
+
+// Getters and setters.
 vector<Pose> PcReader::getPoses()
 {
     return this->m_Poses;
 }
+
+vector<PointBuffer> PcReader::getBuffers()
+{
+    return this->m_Buffers;
+}
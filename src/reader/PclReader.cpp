@@ -5,7 +5,7 @@
 
 // User includes.
 #include <common.h>
-#include <timer/Timer.h>
+#include <timer/ScopedTimer.h>
 
 // C++ includes.
 #include <iostream>
@@ -47,92 +47,33 @@ void PclReader::read(const string &path,
                      const int &start, const int &end, const int &width,
                      const string &root, const string &ext, const string &poseExt)
 {
-    Timer timer;
-    timer.start();
-
-    cout << "Reading scans..." << endl;
-    assert(start >= 0);
-    assert(start <= end);
-    assert(width > 0);
-
-    // Make sure that we first clear all the previously loaded point clouds.
-    this->m_PointClouds.clear();
-
-    // Go from start to end and read point clouds.
-    for (int it = start; it <= end; ++it)
     {
-        timer.record();
-
-        string fileRoot = root + int2String(it, width);
-        string fullPath = path;
-
-        if (*path.rbegin() != this->fileSep)
-        {
-            fullPath += this->fileSep;
-        }
-
-        fullPath += fileRoot;
-
-        string pcFilePath = fullPath + ext;
-        string poseFilePath = fullPath + poseExt;
-
-        cout << "Loading " << pcFilePath << "..." << endl;
-
-        // Open the stream to the pc file.
-        ifstream pcFile(pcFilePath.c_str());
-        if (pcFile.is_open() == false) {
-            die("Failed to open file \"" + pcFilePath + "\"...");
-        }
-
-        // Read in the point cloud.
-        pcl::PointCloud<pcl::PointXYZ>::Ptr p_Pc(new pcl::PointCloud<pcl::PointXYZ>);
-
-        double x, y, z;
-        while (!pcFile.eof())
-        {
-            pcl::PointXYZ pt;
-            pcFile >> pt.x >> pt.y >> pt.z;
-            p_Pc->points.push_back(pt);
-        }
-
-        // Open the stream to the pose file.
-        ifstream poseFile(poseFilePath.c_str());
-        if (poseFile.is_open() == false) {
-            die("Failed to open file \"" + poseFilePath + "\"...");
-        }
-
-        pcFile.close();
-
-        // Read in the pose.
-        Pose pose;
-        poseFile >> pose.x >> pose.y >> pose.z;
-        poseFile >> pose.roll >> pose.pitch >> pose.yaw;
-
-        // Convert from degrees to radians.
-        pose.roll = deg2Rad(pose.roll);
-        pose.pitch = deg2Rad(pose.pitch);
-        pose.yaw = deg2Rad(pose.yaw);
+        ScopedTimer timer("PCL/load");
+        this->load(path, start, end, width, root, ext, poseExt);
+    }
 
-        // Add the point cloud and pose to the list.
-        this->m_PointClouds.push_back(p_Pc);
-        this->m_Poses.push_back(pose);
+    this->read(this->m_Buffers, this->m_Poses);
+}
 
-        poseFile.close();
+void PclReader::read(const vector<PointBuffer> &buffers, const vector<Pose> &poses)
+{
+    assert(buffers.size() == poses.size());
 
-        cout << "Loaded point cloud with " << p_Pc->points.size() << " points @pose("
-                    << pose.x << ", " << pose.y << ", " << pose.z << "; "
-             << pose.roll << ", " << pose.pitch << ", " << pose.yaw
-             << ")..." << endl;
+    this->m_Buffers = buffers;
+    this->m_Poses = poses;
 
-        timer.record();
-        timer.printTime("Point cloud load");
+    // The clouds are shared with the buffers, nothing is copied.
+    this->m_PointClouds.clear();
+    for (vector<PointBuffer>::const_iterator it = buffers.begin();
+         it != buffers.end(); ++it)
+    {
+        this->m_PointClouds.push_back(it->getCloud());
     }
 }
 
 void PclReader::run()
 {
-    Timer timer;
-    timer.start();
+    ScopedTimer timer("PCL/run");
 
     cout << "Running PCL Lu and Milios Scan Matching algorithm..." << endl;
     assert(this->m_PointClouds.size() == this->m_Poses.size());
@@ -150,7 +91,7 @@ void PclReader::run()
     }
 
     // Add the correspondence results as edges to the SLAM graph.
-    timer.record();
+    ScopedTimer pairwise("pairwise");
 
     if (this->m_CorrespMethod == ICP) {
         for (int it = 0; it < this->m_PointClouds.size() - 1; ++it) {
@@ -221,18 +162,17 @@ void PclReader::run()
         assert(false);
     }
 
-    timer.record();
-    timer.printTime("Correspondence computation");
+    pairwise.stop();
 
     // Set the algorithm variables.
     lum.setMaxIterations(this->LUM_ITER);
     lum.setConvergenceThreshold(this->LUM_CONV_THRESH);
 
     // Run the LUM algorithm.
-    timer.record();
-    lum.compute();
-    timer.record();
-    timer.printTime("LUM compute");
+    {
+        ScopedTimer timer("LUM");
+        lum.compute();
+    }
 
     // Copy the new poses.
     this->m_Poses.clear();
@@ -0,0 +1,88 @@
+//==============================================================================
+// Includes.
+//==============================================================================
+#include <reader/PointBuffer.h>
+
+// User includes.
+#include <common.h>
+
+// C++ includes.
+#include <fstream>
+#include <string>
+using namespace std;
+
+//==============================================================================
+// Class implementation.
+//==============================================================================
+// Constructors.
+PointBuffer::PointBuffer() : m_Cloud(new pcl::PointCloud<pcl::PointXYZ>)
+{}
+
+PointBuffer::PointBuffer(const pcl::PointCloud<pcl::PointXYZ>::Ptr &cloud) : m_Cloud(cloud)
+{}
+
+PointBuffer::PointBuffer(const PointBuffer &other) : m_Cloud(other.m_Cloud)
+{}
+
+PointBuffer::~PointBuffer()
+{}
+
+// Public methods.
+PointBuffer PointBuffer::load(const string &filePath)
+{
+    // Open the stream to the pc file.
+    ifstream pcFile(filePath.c_str());
+    if (pcFile.is_open() == false) {
+        die("Failed to open file \"" + filePath + "\"...");
+    }
+
+    // Skip the header line, like the 3DTK reader does.
+    string header;
+    getline(pcFile, header);
+
+    // Read in the point cloud.
+    PointBuffer buffer;
+
+    pcl::PointXYZ pt;
+    while (pcFile >> pt.x >> pt.y >> pt.z)
+    {
+        buffer.m_Cloud->points.push_back(pt);
+    }
+
+    buffer.m_Cloud->width = buffer.m_Cloud->points.size();
+    buffer.m_Cloud->height = 1;
+
+    pcFile.close();
+
+    return buffer;
+}
+
+// Getters and setters.
+pcl::PointCloud<pcl::PointXYZ>::Ptr PointBuffer::getCloud() const
+{
+    return this->m_Cloud;
+}
+
+const float* PointBuffer::getData() const
+{
+    if (this->m_Cloud->points.empty()) {
+        return 0;
+    }
+
+    return this->m_Cloud->points[0].data;
+}
+
+unsigned int PointBuffer::getSize() const
+{
+    return this->m_Cloud->points.size();
+}
+
+unsigned int PointBuffer::getStride() const
+{
+    return STRIDE;
+}
+
+long PointBuffer::getUseCount() const
+{
+    return this->m_Cloud.use_count();
+}
@@ -4,12 +4,22 @@
 #include <string>
 
 #include <reader/TdtkReader.h>
+#include <timer/ScopedTimer.h>
 
 #define MAX_OPENMP_NUM_THREADS  8
 #define OPENMP_NUM_THREADS      8
 
+#include "slam6d/icp6Dapx.h"
+#include "slam6d/icp6Dsvd.h"
+#include "slam6d/icp6Dquat.h"
+#include "slam6d/icp6Dortho.h"
+#include "slam6d/icp6Dhelix.h"
+#include "slam6d/icp6Ddual.h"
 #include "slam6d/icp6Dlumeuler.h"
 #include "slam6d/icp6Dlumquat.h"
+#include "slam6d/icp6Dquatscale.h"
+#include "slam6d/icp6Dptplane.h"
+#include "slam6d/icp6Dfastquat.h"
 #include "slam6d/icp6Dminimizer.h"
 #include "slam6d/scan.h"
 #include "slam6d/icp6D.h"
@@ -21,10 +31,15 @@ using namespace std;
 // Class implementation.
 //==============================================================================
 // Constructors.
-TdtkReader::TdtkReader() : PcReader()
+TdtkReader::TdtkReader() : PcReader(),
+    m_SwapMemory(0),
+    m_Algorithm(7)
 {}
 
-TdtkReader::TdtkReader(const TdtkReader &other) : PcReader(other)
+TdtkReader::TdtkReader(const TdtkReader &other) : PcReader(other),
+    m_CacheDir(other.m_CacheDir),
+    m_SwapMemory(other.m_SwapMemory),
+    m_Algorithm(other.m_Algorithm)
 {}
 
 TdtkReader::~TdtkReader()
@@ -35,27 +50,73 @@ void TdtkReader::read(const std::string& path,
                      const int &start, const int &end, const int &width,
                      const std::string& root, const std::string &ext, const std::string &poseExt)
 {
+    ScopedTimer timer("3DTK/load");
+
+    Scan::cacheDir = this->m_CacheDir;
+    Scan::maxResidentMemory = (size_t)this->m_SwapMemory * 1024 * 1024;
     Scan::readScansRedSearch(UOS, start, end, path, 100000.0, 0,
                              -1.0, 1,
                              simpleKD, false, true);
 }
 
+void TdtkReader::read(const vector<PointBuffer> &buffers, const vector<Pose> &poses)
+{
+    ScopedTimer timer("3DTK/load");
+
+    this->m_Buffers = buffers;
+    this->m_Poses = poses;
+    Scan::maxResidentMemory = (size_t)this->m_SwapMemory * 1024 * 1024;
+
+    // Build the scans straight from the shared buffers, with the same
+    // parameters as the file based read above.
+    for (size_t it = 0; it < buffers.size() && it < poses.size(); ++it) {
+        double euler[6] = {poses[it].x, poses[it].y, poses[it].z,
+                           poses[it].roll, poses[it].pitch, poses[it].yaw};
+
+        Scan *scan = new Scan(euler, buffers[it].getData(), buffers[it].getSize(),
+                              buffers[it].getStride(), 100000, 0);
+        Scan::allScans.push_back(scan);
+        scan->prepareSearch(-1.0, 1, simpleKD, false);
+    }
+}
+
 void TdtkReader::run()
 {
+    ScopedTimer timer("3DTK/run");
+
     const int min_clpairs = 6;
     const int min_loop_size = 10;
     const int num_iterations_icp = 3;
     const int num_iterations_graphslam = 3;
 
-    icp6Dminimizer *icp6Dminimizer = new icp6D_LUMEULER(true);
+    icp6Dminimizer *icp6Dminimizer = 0;
+    switch (this->m_Algorithm) {
+        case 1:  icp6Dminimizer = new icp6D_QUAT(true); break;
+        case 2:  icp6Dminimizer = new icp6D_SVD(true); break;
+        case 3:  icp6Dminimizer = new icp6D_ORTHO(true); break;
+        case 4:  icp6Dminimizer = new icp6D_DUAL(true); break;
+        case 5:  icp6Dminimizer = new icp6D_HELIX(true); break;
+        case 6:  icp6Dminimizer = new icp6D_APX(true); break;
+        case 8:  icp6Dminimizer = new icp6D_LUMQUAT(true); break;
+        case 9:  icp6Dminimizer = new icp6D_QUAT_SCALE(true); break;
+        case 10: icp6Dminimizer = new icp6D_PTPLANE(true); break;
+        case 11: icp6Dminimizer = new icp6D_FASTQUAT(true); break;
+        default: icp6Dminimizer = new icp6D_LUMEULER(true); break;
+    }
 
     icp6D* icpAlgo = new icp6D(icp6Dminimizer, 25.0, num_iterations_icp);
-    icpAlgo->doICP(Scan::allScans);
+    {
+        ScopedTimer timer("pairwise");
+        icpAlgo->doICP(Scan::allScans);
+    }
 
     graphSlam6D *graphSlam6DAlgo = new lum6DEuler(icp6Dminimizer);
-    graphSlam6DAlgo->matchGraph6Dautomatic(Scan::allScans,
-                                           num_iterations_graphslam,
-                                           min_clpairs, min_loop_size);
+    {
+        ScopedTimer timer("LUM");
+        graphSlam6DAlgo->matchGraph6Dautomatic(Scan::allScans,
+                                               num_iterations_graphslam,
+                                               min_clpairs, min_loop_size);
+    }
 
     vector <Scan*>::iterator it = Scan::allScans.begin();
     while (!Scan::allScans.empty()) {
@@ -65,3 +126,29 @@ void TdtkReader::run()
         delete scan;
     }
 }
+
+double TdtkReader::sequenceError(const double &maxDist, icp6D &icp)
+{
+    double error = 0.0;
+    for (size_t it = 1; it < Scan::allScans.size(); ++it) {
+        error += icp.Point_Point_Error(Scan::allScans[it - 1], Scan::allScans[it], maxDist);
+    }
+
+    return error / (Scan::allScans.size() - 1);
+}
+
+// Getters and setters.
+void TdtkReader::setCacheDir(const std::string &cacheDir)
+{
+    this->m_CacheDir = cacheDir;
+}
+
+void TdtkReader::setSwapMemory(const int &swapMemory)
+{
+    this->m_SwapMemory = swapMemory;
+}
+
+void TdtkReader::setAlgorithm(const int &algorithm)
+{
+    this->m_Algorithm = algorithm;
+}
@@ -0,0 +1,56 @@
+//==============================================================================
+// Includes.
+//==============================================================================
+// User includes.
+#include <timer/ScopedTimer.h>
+#include <timer/TimingSink.h>
+
+// C++ includes.
+#include <string>
+#include <vector>
+using namespace std;
+
+//==============================================================================
+// Helpers.
+//==============================================================================
+// Phases of the scopes open in this thread, innermost last.
+static thread_local vector<string> openScopes;
+
+//==============================================================================
+// Class implementation.
+//==============================================================================
+ScopedTimer::ScopedTimer(const string &name) :
+    m_Path(path(name)),
+    m_Stopped(false)
+{
+    openScopes.push_back(this->m_Path);
+    this->m_Timer.start();
+}
+
+ScopedTimer::~ScopedTimer()
+{
+    this->stop();
+}
+
+void ScopedTimer::stop()
+{
+    if (this->m_Stopped) {
+        return;
+    }
+
+    this->m_Timer.record();
+    this->m_Stopped = true;
+    openScopes.pop_back();
+
+    TimingSink::instance().add(this->m_Path, this->m_Timer.getRealMs(),
+                               this->m_Timer.getCpuMs(), this->m_Timer.getThreadMs());
+}
+
+string ScopedTimer::path(const string &name)
+{
+    if (openScopes.empty()) {
+        return name;
+    }
+
+    return openScopes.back() + "/" + name;
+}
@@ -3,6 +3,8 @@
 //==============================================================================
 // User includes.
 #include <timer/Timer.h>
+#include <timer/ScopedTimer.h>
+#include <timer/TimingSink.h>
 
 // C++ includes.
 #include <iostream>
@@ -10,6 +12,18 @@ using namespace std;
 
 // C includes.
 #include <assert.h>
+#include <time.h>
+
+//==============================================================================
+// Helpers.
+//==============================================================================
+// Milliseconds of a CPU time clock.
+static double cpuClockMs(const clockid_t &clock)
+{
+    timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
 
 //==============================================================================
 // Class implementation.
@@ -18,33 +32,43 @@ Timer::Timer() {
     this->reset();
 }
 
-Timer::Timer(const Timer &other) {
-    this->m_CpuTimes = other.m_CpuTimes;;
-}
+Timer::Timer(const Timer &other) :
+    m_Start(other.m_Start),
+    m_Previous(other.m_Previous),
+    m_Last(other.m_Last),
+    m_Records(other.m_Records)
+{}
 
 Timer::~Timer()
 {}
 
+Timer::Sample Timer::now() {
+    Sample sample;
+    sample.real = chrono::steady_clock::now();
+    sample.cpu = cpuClockMs(CLOCK_PROCESS_CPUTIME_ID);
+    sample.thread = cpuClockMs(CLOCK_THREAD_CPUTIME_ID);
+    return sample;
+}
+
 void Timer::start() {
     this->reset();
     this->record();
 }
 
 void Timer::reset() {
-    this->m_CpuTimes.clear();
-    this->m_RealTimes.clear();
+    this->m_Start = this->m_Previous = this->m_Last = Sample();
+    this->m_Records = 0;
 }
 
 void Timer::record() {
-    // Record the times.
-    clock_t cpuTime = clock();
-
-    timeval realTime;
-    gettimeofday(&realTime, 0);
+    Sample sample = now();
 
-    // Put times in queue.
-    this->m_CpuTimes.push_back(cpuTime);
-    this->m_RealTimes.push_back(realTime);
+    if (this->m_Records == 0) {
+        this->m_Start = sample;
+    }
+    this->m_Previous = this->m_Last;
+    this->m_Last = sample;
+    ++this->m_Records;
 }
 
 void Timer::printTime(const string &msg,
@@ -52,38 +76,41 @@ void Timer::printTime(const string &msg,
 {
     cerr << msg << ": " << endl;
     cerr << "\t" << "CPU\t" << this->getCpuTime(sinceStart) << endl;
+    cerr << "\t" << "THREAD\t" << this->getThreadTime(sinceStart) << endl;
     cerr << "\t" << "REAL\t" << this->getRealTime(sinceStart) << endl;
-}
 
-long Timer::getCpuTime(const bool &sinceStart) {
-    assert(this->m_CpuTimes.size() >= 2);
+    TimingSink::instance().add(ScopedTimer::path(msg), this->getRealMs(sinceStart),
+                               this->getCpuMs(sinceStart), this->getThreadMs(sinceStart));
+}
 
-    // Get the second last recorded time.
-    clock_t ref = *(this->m_CpuTimes.rbegin() + 1);
-    clock_t last = this->m_CpuTimes.back();
+const Timer::Sample &Timer::reference(const bool &sinceStart) const {
+    assert(this->m_Records >= 2);
 
-    if (sinceStart == true) {
-        ref = this->m_CpuTimes.front();
-    }
+    // The second last recorded time.
+    return sinceStart ? this->m_Start : this->m_Previous;
+}
 
-    // Return in miliseconds.
-    return (last - ref) * 1000 / CLOCKS_PER_SEC;
+double Timer::getRealMs(const bool &sinceStart) const {
+    const Sample &ref = this->reference(sinceStart);
+    return chrono::duration<double, milli>(this->m_Last.real - ref.real).count();
 }
 
-long Timer::getRealTime(const bool &sinceStart) {
-    assert(this->m_RealTimes.size() >= 2);
+double Timer::getCpuMs(const bool &sinceStart) const {
+    return this->m_Last.cpu - this->reference(sinceStart).cpu;
+}
 
-    // Get the second last recorded time.
-    timeval ref = *(this->m_RealTimes.rbegin() + 1);
-    timeval last = this->m_RealTimes.back();
+double Timer::getThreadMs(const bool &sinceStart) const {
+    return this->m_Last.thread - this->reference(sinceStart).thread;
+}
 
-    if (sinceStart == true) {
-        ref = this->m_RealTimes.front();
-    }
+long Timer::getCpuTime(const bool &sinceStart) const {
+    return (long)(this->getCpuMs(sinceStart) + 0.5);
+}
 
-    // Return in miliseconds.
-    long secs = last.tv_sec - ref.tv_sec;
-    long usecs = last.tv_usec - ref.tv_usec;
+long Timer::getRealTime(const bool &sinceStart) const {
+    return (long)(this->getRealMs(sinceStart) + 0.5);
+}
 
-    return (long)(((secs * 1000) + (usecs / 1000.0)) + 0.5);
+long Timer::getThreadTime(const bool &sinceStart) const {
+    return (long)(this->getThreadMs(sinceStart) + 0.5);
 }
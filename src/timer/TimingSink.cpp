@@ -0,0 +1,101 @@
+//==============================================================================
+// Includes.
+//==============================================================================
+// User includes.
+#include <timer/TimingSink.h>
+
+// C++ includes.
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+using namespace std;
+
+//==============================================================================
+// Helpers.
+//==============================================================================
+static inline void printStats(ostream &out, const double &min, const double &mean,
+                              const double &max)
+{
+    out << "\t" << min << "/" << mean << "/" << max;
+}
+
+//==============================================================================
+// Class implementation.
+//==============================================================================
+// Constructors.
+TimingSink::TimingSink()
+{}
+
+TimingSink::~TimingSink()
+{}
+
+TimingSink &TimingSink::instance()
+{
+    static TimingSink sink;
+    return sink;
+}
+
+// Methods.
+void TimingSink::add(const string &name,
+                     const double &realMs, const double &cpuMs, const double &threadMs)
+{
+    lock_guard<mutex> lock(this->m_Mutex);
+
+    vector<Phase>::iterator it = this->m_Phases.begin();
+    while (it != this->m_Phases.end() && it->name != name) {
+        ++it;
+    }
+
+    const double times[3] = {realMs, cpuMs, threadMs};
+    if (it == this->m_Phases.end()) {
+        Phase phase;
+        phase.name = name;
+        phase.runs = 0;
+        Stats *stats[3] = {&phase.real, &phase.cpu, &phase.thread};
+        for (int i = 0; i < 3; ++i) {
+            stats[i]->min = stats[i]->max = times[i];
+            stats[i]->sum = 0.0;
+        }
+        this->m_Phases.push_back(phase);
+        it = this->m_Phases.end() - 1;
+    }
+
+    Stats *stats[3] = {&it->real, &it->cpu, &it->thread};
+    for (int i = 0; i < 3; ++i) {
+        stats[i]->min = std::min(stats[i]->min, times[i]);
+        stats[i]->max = std::max(stats[i]->max, times[i]);
+        stats[i]->sum += times[i];
+    }
+    ++it->runs;
+}
+
+void TimingSink::clear()
+{
+    lock_guard<mutex> lock(this->m_Mutex);
+    this->m_Phases.clear();
+}
+
+void TimingSink::print(ostream &out) const
+{
+    lock_guard<mutex> lock(this->m_Mutex);
+
+    out << "Timing summary, MIN/MEAN/MAX in ms:" << endl;
+    out << "\t" << "RUNS\tREAL\tCPU\tTHREAD\tPHASE" << endl;
+
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+    out << fixed << setprecision(1);
+
+    for (vector<Phase>::const_iterator it = this->m_Phases.begin();
+         it != this->m_Phases.end(); ++it)
+    {
+        out << "\t" << it->runs;
+        printStats(out, it->real.min, it->real.sum / it->runs, it->real.max);
+        printStats(out, it->cpu.min, it->cpu.sum / it->runs, it->cpu.max);
+        printStats(out, it->thread.min, it->thread.sum / it->runs, it->thread.max);
+        out << "\t" << it->name << endl;
+    }
+
+    out.flags(flags);
+    out.precision(precision);
+}